@@ -108,6 +108,14 @@ size_t write_file(const void *buffer, size_t byteCount, FileHandle handle)
 	return -1;
 }
 
+void* map_file(const char* fileFullPath, size_t* pSize)
+{
+	// Assets are read through the asset manager, they can not be mapped by path
+	return NULL;
+}
+
+void unmap_file(void* pData, size_t size) {}
+
 time_t get_file_last_modified_time(const char* _fileName)
 {
 	LOGF(LogLevel::eERROR,"FileSystem::Last Modified Time not supported in Android!");
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "DepthSort.h"
+
+#include <string.h>
+
+#include "../Interfaces/IMemoryManager.h"
+
+// Radix digits of the 32 bit keys, the last pass has 10 bits
+#define DEPTH_SORT_RADIX_BITS 11
+#define DEPTH_SORT_RADIX_SIZE (1 << DEPTH_SORT_RADIX_BITS)
+#define DEPTH_SORT_KEY_PASSES 3
+
+// Flips the bits of a float so the keys compare like the floats as unsigned integers: negative floats get all bits flipped,
+// positive ones only the sign
+static inline uint64_t sortableKey(float key)
+{
+	uint32_t bits;
+	memcpy(&bits, &key, sizeof(bits));
+	const uint32_t mask = (uint32_t)(-(int32_t)(bits >> 31)) | 0x80000000u;
+	return (uint64_t)(bits ^ mask) << 32;
+}
+
+// Least significant digit radix sort of passCount digits starting at firstBit, stable so items equal in those bits keep
+// their order. Passes where every item has the same digit are skipped, which is common for the upper bits of distances in
+// a small range. The result ends up in pItems, pTemp has to hold count items as well
+static void radixSortItems(uint64_t* pItems, uint64_t* pTemp, uint32_t count, uint32_t firstBit, uint32_t passCount)
+{
+	uint64_t* pSource = pItems;
+	uint64_t* pDestination = pTemp;
+	for (uint32_t pass = 0; pass < passCount; ++pass)
+	{
+		const uint32_t shift = firstBit + pass * DEPTH_SORT_RADIX_BITS;
+		uint32_t       offsets[DEPTH_SORT_RADIX_SIZE] = {};
+		for (uint32_t i = 0; i < count; ++i)
+			++offsets[(pSource[i] >> shift) & (DEPTH_SORT_RADIX_SIZE - 1)];
+		if (offsets[(pSource[0] >> shift) & (DEPTH_SORT_RADIX_SIZE - 1)] == count)
+			continue;
+
+		uint32_t sum = 0;
+		for (uint32_t digit = 0; digit < DEPTH_SORT_RADIX_SIZE; ++digit)
+		{
+			const uint32_t digitCount = offsets[digit];
+			offsets[digit] = sum;
+			sum += digitCount;
+		}
+
+		for (uint32_t i = 0; i < count; ++i)
+			pDestination[offsets[(pSource[i] >> shift) & (DEPTH_SORT_RADIX_SIZE - 1)]++] = pSource[i];
+
+		uint64_t* pSwap = pSource;
+		pSource = pDestination;
+		pDestination = pSwap;
+	}
+
+	if (pSource != pItems)
+		memcpy(pItems, pSource, count * sizeof(uint64_t));
+}
+
+// Fixes up the previous order with an insertion sort. Items that would move further than DEPTH_SORT_MAX_ITEM_MOVES, like
+// new items or the ones that took the place of a removed item, are taken out, radix sorted on their own and merged back.
+// Returns false when the items are too far from sorted for that to be cheaper than a radix sort of all of them
+static bool insertionSortItems(DepthSorter* pSorter, uint32_t count)
+{
+	uint64_t*      pItems = pSorter->pItems;
+	uint64_t*      pOutliers = pSorter->pScratch;
+	const uint32_t maxOutlierCount = count / DEPTH_SORT_MAX_OUTLIER_FRACTION;
+	const uint64_t maxMoveCount = (uint64_t)count * DEPTH_SORT_MAX_MOVES_PER_ITEM;
+	uint64_t       moveCount = 0;
+	uint32_t       sortedCount = 0;
+	uint32_t       outlierCount = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		// An item that has to move far back is found by the search for its place, one that has to move far ahead by
+		// comparing it to the item as far ahead. Left in, it would be moved by every item that passes it
+		const uint64_t item = pItems[i];
+		uint32_t       j = sortedCount;
+		while (j > 0 && pItems[j - 1] > item && sortedCount - j < DEPTH_SORT_MAX_ITEM_MOVES)
+			--j;
+
+		const uint32_t aheadIndex = i + DEPTH_SORT_MAX_ITEM_MOVES;
+		if ((j > 0 && pItems[j - 1] > item) || (aheadIndex < count && pItems[aheadIndex] < item))
+		{
+			if (outlierCount == maxOutlierCount)
+				return false;
+			pOutliers[outlierCount++] = item;
+			continue;
+		}
+
+		for (uint32_t k = sortedCount; k > j; --k)
+			pItems[k] = pItems[k - 1];
+		pItems[j] = item;
+		++sortedCount;
+		moveCount += sortedCount - 1 - j;
+		if (moveCount > maxMoveCount)
+			return false;
+	}
+
+	pSorter->mLastMoveCount = (uint32_t)moveCount + outlierCount;
+	if (!outlierCount)
+		return true;
+
+	// Equal keys have to end up ordered by item, so the outliers are sorted by item first. The rest of pScratch is the
+	// temporary, there are less outliers than half of the items
+	uint32_t itemBits = 1;
+	while (itemBits < 32 && (count - 1) >> itemBits)
+		++itemBits;
+	radixSortItems(
+		pOutliers, pOutliers + outlierCount, outlierCount, 0, (itemBits + DEPTH_SORT_RADIX_BITS - 1) / DEPTH_SORT_RADIX_BITS);
+	radixSortItems(pOutliers, pOutliers + outlierCount, outlierCount, 32, DEPTH_SORT_KEY_PASSES);
+
+	// Merge from the back, so the sorted items only move once
+	uint32_t sortedIndex = sortedCount;
+	uint32_t outlierIndex = outlierCount;
+	for (uint32_t i = count; outlierIndex > 0; --i)
+	{
+		if (sortedIndex > 0 && pItems[sortedIndex - 1] > pOutliers[outlierIndex - 1])
+			pItems[i - 1] = pItems[--sortedIndex];
+		else
+			pItems[i - 1] = pOutliers[--outlierIndex];
+	}
+
+	return true;
+}
+
+void addDepthSorter(DepthSorter** ppSorter)
+{
+	DepthSorter* pSorter = (DepthSorter*)conf_calloc(1, sizeof(DepthSorter));
+	*ppSorter = pSorter;
+}
+
+void removeDepthSorter(DepthSorter* pSorter)
+{
+	conf_free(pSorter->pItems);
+	conf_free(pSorter->pScratch);
+	conf_free(pSorter->pOrder);
+	conf_free(pSorter);
+}
+
+const uint32_t* sortDepths(DepthSorter* pSorter, const float* pKeys, uint32_t count)
+{
+	if (count > pSorter->mCapacity)
+	{
+		const uint32_t capacity = count + count / 2;
+		pSorter->pItems = (uint64_t*)conf_realloc(pSorter->pItems, capacity * sizeof(uint64_t));
+		pSorter->pScratch = (uint64_t*)conf_realloc(pSorter->pScratch, capacity * sizeof(uint64_t));
+		pSorter->pOrder = (uint32_t*)conf_realloc(pSorter->pOrder, capacity * sizeof(uint32_t));
+		pSorter->mCapacity = capacity;
+	}
+
+	// The previous order without the items that are gone, followed by the new items. Mostly new items have no order worth
+	// keeping
+	const uint32_t previousCount = pSorter->mCount;
+	pSorter->mLastMoveCount = 0;
+	pSorter->mLastSortIncremental = false;
+	if (previousCount >= count / 2 && pSorter->mRadixSortsLeft == 0)
+	{
+		uint32_t itemCount = 0;
+		for (uint32_t i = 0; i < previousCount; ++i)
+		{
+			const uint32_t item = pSorter->pOrder[i];
+			if (item < count)
+				pSorter->pItems[itemCount++] = sortableKey(pKeys[item]) | item;
+		}
+		for (uint32_t item = previousCount; item < count; ++item)
+			pSorter->pItems[itemCount++] = sortableKey(pKeys[item]) | item;
+
+		pSorter->mLastSortIncremental = insertionSortItems(pSorter, count);
+		if (!pSorter->mLastSortIncremental)
+			pSorter->mRadixSortsLeft = DEPTH_SORT_RETRY_INTERVAL;
+	}
+	else if (pSorter->mRadixSortsLeft > 0)
+	{
+		--pSorter->mRadixSortsLeft;
+	}
+
+	// The radix sort only orders by key and keeps the order of equal keys, which has to be by item for them to end up the
+	// same as after the insertion sort
+	if (!pSorter->mLastSortIncremental)
+	{
+		for (uint32_t item = 0; item < count; ++item)
+			pSorter->pItems[item] = sortableKey(pKeys[item]) | item;
+		if (count > 1)
+			radixSortItems(pSorter->pItems, pSorter->pScratch, count, 32, DEPTH_SORT_KEY_PASSES);
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+		pSorter->pOrder[i] = (uint32_t)pSorter->pItems[i];
+	pSorter->mCount = count;
+
+	return pSorter->pOrder;
+}
+
+void resetDepthSorter(DepthSorter* pSorter)
+{
+	pSorter->mCount = 0;
+	pSorter->mRadixSortsLeft = 0;
+}
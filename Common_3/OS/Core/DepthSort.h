@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Orders items by a float key every frame, like particles or transparent objects by their distance to the camera.
+//
+// The order of the last call is kept and fixed up with an insertion sort, which is close to linear when the keys only
+// changed a little since. Item i of a call is assumed to be item i of the last call: items past the last count are new and
+// items past the current count are gone, so removing an item by moving the last one into its place only disturbs the
+// order around the two of them. Items that moved far, like new ones, are sorted on their own and merged in. When too many
+// items moved far, or there is no previous order, the items are sorted from scratch with a radix sort instead, and the
+// next calls skip the fixup for a while as the keys are likely to keep changing as much.
+// The buffers are kept between calls and only grow.
+//
+// Usage:
+//   DepthSorter* pSorter = NULL;
+//   addDepthSorter(&pSorter);
+//   const uint32_t* pOrder = sortDepths(pSorter, pDistances, particleCount);    // pOrder[0] is the closest
+//   removeDepthSorter(pSorter);
+
+#pragma once
+
+#include "../Interfaces/IOperatingSystem.h"
+
+// Positions an item may move in the insertion sort before it is sorted on its own
+#define DEPTH_SORT_MAX_ITEM_MOVES 16
+// Average positions the items may move, about what a radix sort costs
+#define DEPTH_SORT_MAX_MOVES_PER_ITEM 4
+// Up to one in this many items may be sorted on their own before the items are sorted from scratch
+#define DEPTH_SORT_MAX_OUTLIER_FRACTION 8
+// Calls that sort from scratch after the insertion sort gave up, before it is tried again
+#define DEPTH_SORT_RETRY_INTERVAL 16
+
+typedef struct DepthSorter
+{
+	uint64_t* pItems;                  // Key in the upper half, item in the lower half
+	uint64_t* pScratch;                // Temporary of the radix sort
+	uint32_t* pOrder;                  // Result of the last call
+	uint32_t  mCount;
+	uint32_t  mCapacity;
+	uint32_t  mLastMoveCount;          // Positions the last call moved items to fix up the previous order
+	uint32_t  mRadixSortsLeft;         // Calls left before the insertion sort is tried again
+	bool      mLastSortIncremental;    // False when the last call sorted from scratch
+} DepthSorter;
+
+void addDepthSorter(DepthSorter** ppSorter);
+void removeDepthSorter(DepthSorter* pSorter);
+
+// Sorts the count items by increasing pKeys[item] and returns the items in that order, valid until the next call. Items
+// with equal keys are ordered by index
+const uint32_t* sortDepths(DepthSorter* pSorter, const float* pKeys, uint32_t count);
+
+// Forgets the last order, so the next call sorts from scratch. For when the items are not the ones of the last call anymore
+void resetDepthSorter(DepthSorter* pSorter);
@@ -26,6 +26,7 @@
 
 #include "../Interfaces/IThread.h"
 #include "../Interfaces/ILogManager.h"
+#include "TraceProfiler.h"
 #include "../Interfaces/IMemoryManager.h"
 
 #include "ThreadSystem.h"
@@ -59,6 +60,7 @@ struct ThreadSystem
 static void taskThreadFunc(void* pThreadData)
 {
 	ThreadSystem* pThreadSystem = (ThreadSystem*)pThreadData;
+	setTraceThreadName("ThreadSystem");
 	while (pThreadSystem->mRun)
 	{
 		pThreadSystem->mQueueMutex.Acquire();
@@ -77,6 +79,7 @@ static void taskThreadFunc(void* pThreadData)
 			else
 				++pThreadSystem->mLoadQueue.front().mStart;
 			pThreadSystem->mQueueMutex.Release();
+			TRACE_SCOPE("ThreadSystem Task");
 			resourceTask.mTask(resourceTask.mUser, resourceTask.mStart);
 		}
 		else
@@ -0,0 +1,561 @@
+/*
+ * Copyright (c) 2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "../../ThirdParty/OpenSource/EASTL/sort.h"
+#include "../../ThirdParty/OpenSource/EASTL/string.h"
+#include "../../ThirdParty/OpenSource/EASTL/vector.h"
+
+#include "../Interfaces/IFileSystem.h"
+#include "../Interfaces/ILogManager.h"
+#include "../Interfaces/IThread.h"
+
+#include "TraceProfiler.h"
+
+#include <signal.h>
+#if defined(_WIN32)
+#include <windows.h>
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#include <time.h>
+#define TRACE_THREAD_LOCAL __thread
+#endif
+
+#include "../Interfaces/IMemoryManager.h"
+
+enum
+{
+	DEFAULT_TRACE_EVENTS_PER_THREAD = 64 * 1024,
+};
+
+typedef struct TraceEvent
+{
+	const char* pName;
+	int64_t     mStart;
+	int64_t     mEnd;
+	uint32_t    mDepth;
+} TraceEvent;
+
+typedef struct TraceThreadBuffer
+{
+	/// Allocated by the owning thread on its first zone recorded during a capture
+	TraceEvent*        pEvents;
+	uint32_t           mCapacity;
+	uint32_t           mThreadIndex;
+	/// Only written by the owning thread. Readers use it to find the valid part of the ring
+	tfrg_atomic64_t    mWriteIndex;
+	char               mName[MAX_THREAD_NAME_LENGTH + 1];
+	TraceThreadBuffer* pNext;
+} TraceThreadBuffer;
+
+typedef struct TraceProfiler
+{
+	Mutex              mMutex;
+	TraceThreadBuffer* pThreadBuffers;
+	uint32_t           mThreadCount;
+	uint32_t           mEventsPerThread;
+	/// Capture window, zones outside of it are not exported
+	int64_t            mCaptureStart;
+	int64_t            mCaptureEnd;
+	/// Frames left before a requested capture is dumped, 0 if no request is pending
+	uint32_t           mFramesToCapture;
+	eastl::string      mRequestFileName;
+} TraceProfiler;
+
+tfrg_atomic32_t gTraceCaptureActive = 0;
+
+static TraceProfiler* pTraceProfiler = NULL;
+// Bumped by initTraceProfiler and exitTraceProfiler, odd while a profiler is alive. Thread buffers registered with an
+// older generation belong to a profiler that was destroyed and are never touched again
+static tfrg_atomic64_t gTraceGeneration = 0;
+// Threads currently registering or recording, exitTraceProfiler waits for them before freeing the buffers
+static tfrg_atomic64_t gTraceUsers = 0;
+
+static TRACE_THREAD_LOCAL TraceThreadBuffer* pThreadBuffer = NULL;
+static TRACE_THREAD_LOCAL uint64_t           gThreadGeneration = 0;
+static TRACE_THREAD_LOCAL uint32_t           gThreadDepth = 0;
+// Written from the signal handler, serviced in updateTraceProfiler
+static volatile sig_atomic_t gTraceSignalCount = 0;
+
+static int64_t getTraceTime()
+{
+#if defined(_WIN32)
+	static LARGE_INTEGER frequency = {};
+	if (!frequency.QuadPart)
+		QueryPerformanceFrequency(&frequency);
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (int64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+#endif
+}
+
+#if !defined(_WIN32)
+static void traceSignalHandler(int) { gTraceSignalCount = gTraceSignalCount + 1; }
+#endif
+
+void initTraceProfiler(const TraceProfilerDesc* pDesc)
+{
+	ASSERT(!pTraceProfiler);
+	pTraceProfiler = conf_new<TraceProfiler>();
+	pTraceProfiler->pThreadBuffers = NULL;
+	pTraceProfiler->mThreadCount = 0;
+	pTraceProfiler->mEventsPerThread = DEFAULT_TRACE_EVENTS_PER_THREAD;
+	pTraceProfiler->mCaptureStart = 0;
+	pTraceProfiler->mCaptureEnd = 0;
+	pTraceProfiler->mFramesToCapture = 0;
+
+	if (pDesc && pDesc->mEventsPerThread)
+		pTraceProfiler->mEventsPerThread = pDesc->mEventsPerThread;
+
+#if !defined(_WIN32)
+	if (pDesc && pDesc->mInstallSignalHandler)
+		signal(SIGUSR1, traceSignalHandler);
+#endif
+
+	// Publishes the profiler to the other threads
+	tfrg_atomic64_add_relaxed(&gTraceGeneration, 1);
+}
+
+void exitTraceProfiler()
+{
+	if (!pTraceProfiler)
+		return;
+
+	stopTraceCapture();
+
+	// Threads that still hold a buffer reject it from now on. The ones already inside a zone finish writing first
+	tfrg_atomic64_add_relaxed(&gTraceGeneration, 1);
+	while (tfrg_atomic64_load_relaxed(&gTraceUsers))
+		Thread::Sleep(0);
+
+	// Buffers stay alive until here so threads which already exited can still be exported
+	TraceThreadBuffer* pBuffer = pTraceProfiler->pThreadBuffers;
+	while (pBuffer)
+	{
+		TraceThreadBuffer* pNext = pBuffer->pNext;
+		conf_free(pBuffer->pEvents);
+		conf_free(pBuffer);
+		pBuffer = pNext;
+	}
+
+	conf_delete(pTraceProfiler);
+	pTraceProfiler = NULL;
+	pThreadBuffer = NULL;
+}
+
+// Keeps the profiler and its buffers alive until releaseTraceProfiler. The add is a full barrier, so either
+// exitTraceProfiler sees this thread as a user or this thread sees the profiler is gone
+static bool acquireTraceProfiler()
+{
+	tfrg_atomic64_add_relaxed(&gTraceUsers, 1);
+	if (tfrg_atomic64_load_relaxed(&gTraceGeneration) & 1)
+		return true;
+
+	tfrg_atomic64_add_relaxed(&gTraceUsers, (uint64_t)-1);
+	return false;
+}
+
+static void releaseTraceProfiler() { tfrg_atomic64_add_relaxed(&gTraceUsers, (uint64_t)-1); }
+
+// Must be called between acquireTraceProfiler and releaseTraceProfiler
+static TraceThreadBuffer* getThreadBuffer()
+{
+	const uint64_t generation = tfrg_atomic64_load_relaxed(&gTraceGeneration);
+	if (pThreadBuffer && gThreadGeneration == generation)
+		return pThreadBuffer;
+
+	// Registration happens once per thread, recording itself never takes the lock. The events are only allocated
+	// once the thread records a zone during a capture
+	TraceThreadBuffer* pBuffer = (TraceThreadBuffer*)conf_calloc(1, sizeof(TraceThreadBuffer));
+	pBuffer->mCapacity = pTraceProfiler->mEventsPerThread;
+	Thread::GetCurrentThreadName(pBuffer->mName, sizeof(pBuffer->mName));
+
+	MutexLock lock(pTraceProfiler->mMutex);
+	pBuffer->mThreadIndex = ++pTraceProfiler->mThreadCount;
+	pBuffer->pNext = pTraceProfiler->pThreadBuffers;
+	pTraceProfiler->pThreadBuffers = pBuffer;
+
+	pThreadBuffer = pBuffer;
+	gThreadGeneration = generation;
+	return pBuffer;
+}
+
+void setTraceThreadName(const char* pName)
+{
+	if (!acquireTraceProfiler())
+		return;
+
+	strncpy(getThreadBuffer()->mName, pName, MAX_THREAD_NAME_LENGTH);
+	releaseTraceProfiler();
+}
+
+int64_t beginTraceZone()
+{
+	++gThreadDepth;
+	// 0 means the zone is not recorded
+	const int64_t time = getTraceTime();
+	return time ? time : 1;
+}
+
+void endTraceZone(const char* pName, int64_t startTime)
+{
+	const uint32_t depth = --gThreadDepth;
+	const int64_t  endTime = getTraceTime();
+	// Zones ending after the capture stopped fall outside of the capture window anyway
+	if (!isTraceCaptureActive() || !acquireTraceProfiler())
+		return;
+
+	TraceThreadBuffer* pBuffer = getThreadBuffer();
+	// Readers only look at pEvents after seeing a write index published below
+	if (!pBuffer->pEvents)
+		pBuffer->pEvents = (TraceEvent*)conf_malloc(pBuffer->mCapacity * sizeof(TraceEvent));
+
+	const uint64_t index = tfrg_atomic64_load_relaxed(&pBuffer->mWriteIndex);
+	TraceEvent&    event = pBuffer->pEvents[index % pBuffer->mCapacity];
+	event.pName = pName;
+	event.mStart = startTime;
+	event.mEnd = endTime;
+	event.mDepth = depth;
+	tfrg_atomic64_store_release(&pBuffer->mWriteIndex, index + 1);
+
+	releaseTraceProfiler();
+}
+
+void startTraceCapture()
+{
+	if (!pTraceProfiler)
+		return;
+
+	pTraceProfiler->mCaptureStart = getTraceTime();
+	pTraceProfiler->mCaptureEnd = 0;
+	tfrg_memorybarrier_release();
+	tfrg_atomic32_store_relaxed(&gTraceCaptureActive, 1);
+	LOGF(LogLevel::eINFO, "Trace capture started");
+}
+
+void stopTraceCapture()
+{
+	if (!pTraceProfiler || !isTraceCaptureActive())
+		return;
+
+	tfrg_atomic32_store_relaxed(&gTraceCaptureActive, 0);
+	pTraceProfiler->mCaptureEnd = getTraceTime();
+}
+
+typedef struct TraceThreadCapture
+{
+	const TraceThreadBuffer*  pBuffer;
+	eastl::vector<TraceEvent> mEvents;
+} TraceThreadCapture;
+
+// Copies the valid part of every ring buffer. Threads keep recording while this runs, so after copying the write
+// index is read again and every slot the writer may have reused in the meantime is dropped. The slot of the next
+// index is the oldest one in a full ring and may be half written, so it is never part of the valid range.
+static void collectTraceCapture(eastl::vector<TraceThreadCapture>& captures)
+{
+	MutexLock lock(pTraceProfiler->mMutex);
+	for (const TraceThreadBuffer* pBuffer = pTraceProfiler->pThreadBuffers; pBuffer; pBuffer = pBuffer->pNext)
+	{
+		TraceThreadBuffer* pMutableBuffer = (TraceThreadBuffer*)pBuffer;
+		const uint64_t     end = tfrg_atomic64_load_acquire(&pMutableBuffer->mWriteIndex);
+		const uint64_t     begin = end >= pBuffer->mCapacity ? end - pBuffer->mCapacity + 1 : 0;
+
+		eastl::vector<TraceEvent> events;
+		events.reserve((size_t)(end - begin));
+		for (uint64_t i = begin; i < end; ++i)
+			events.push_back(pBuffer->pEvents[i % pBuffer->mCapacity]);
+
+		const uint64_t newEnd = tfrg_atomic64_load_acquire(&pMutableBuffer->mWriteIndex);
+		const uint64_t firstValid = newEnd >= pBuffer->mCapacity ? newEnd - pBuffer->mCapacity + 1 : 0;
+
+		TraceThreadCapture capture;
+		capture.pBuffer = pBuffer;
+		for (uint64_t i = begin > firstValid ? begin : firstValid; i < end; ++i)
+		{
+			const TraceEvent& event = events[(size_t)(i - begin)];
+			if (event.mStart >= pTraceProfiler->mCaptureStart && event.mEnd <= pTraceProfiler->mCaptureEnd)
+				capture.mEvents.push_back(event);
+		}
+
+		if (!capture.mEvents.empty())
+			captures.push_back(capture);
+	}
+}
+
+static void appendJsonString(eastl::string& json, const char* pStr)
+{
+	json.push_back('"');
+	for (; *pStr; ++pStr)
+	{
+		if (*pStr == '"' || *pStr == '\\')
+			json.push_back('\\');
+		json.push_back(*pStr);
+	}
+	json.push_back('"');
+}
+
+static void writeChromeTrace(const eastl::vector<TraceThreadCapture>& captures, eastl::string& output)
+{
+	const int64_t origin = pTraceProfiler->mCaptureStart;
+	output.append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	bool first = true;
+	for (const TraceThreadCapture& capture : captures)
+	{
+		output.append_sprintf(
+			"%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n",
+			capture.pBuffer->mThreadIndex);
+		appendJsonString(output, capture.pBuffer->mName[0] ? capture.pBuffer->mName : "Thread");
+		output.append("}}");
+		first = false;
+
+		for (const TraceEvent& event : capture.mEvents)
+		{
+			output.append(",\n{\"name\":");
+			appendJsonString(output, event.pName);
+			output.append_sprintf(
+				",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", capture.pBuffer->mThreadIndex,
+				(event.mStart - origin) / 1000.0, (event.mEnd - event.mStart) / 1000.0);
+		}
+	}
+	output.append("\n]}\n");
+}
+
+// Minimal protobuf encoding of the Perfetto trace format (perfetto/trace/trace.proto)
+enum
+{
+	PROTO_WIRE_VARINT = 0,
+	PROTO_WIRE_LENGTH = 2,
+
+	TRACE_PACKET = 1,                          // Trace.packet
+	PACKET_TIMESTAMP = 8,                      // TracePacket.timestamp
+	PACKET_TRUSTED_SEQUENCE_ID = 10,           // TracePacket.trusted_packet_sequence_id
+	PACKET_TRACK_EVENT = 11,                   // TracePacket.track_event
+	PACKET_TRACK_DESCRIPTOR = 60,              // TracePacket.track_descriptor
+	TRACK_DESCRIPTOR_UUID = 1,                 // TrackDescriptor.uuid
+	TRACK_DESCRIPTOR_THREAD = 4,               // TrackDescriptor.thread
+	THREAD_DESCRIPTOR_PID = 1,                 // ThreadDescriptor.pid
+	THREAD_DESCRIPTOR_TID = 2,                 // ThreadDescriptor.tid
+	THREAD_DESCRIPTOR_NAME = 5,                // ThreadDescriptor.thread_name
+	TRACK_EVENT_TYPE = 9,                      // TrackEvent.type
+	TRACK_EVENT_TRACK_UUID = 11,               // TrackEvent.track_uuid
+	TRACK_EVENT_NAME = 23,                     // TrackEvent.name
+	TRACK_EVENT_TYPE_SLICE_BEGIN = 1,
+	TRACK_EVENT_TYPE_SLICE_END = 2,
+};
+
+static void writeVarint(eastl::string& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((char)((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	out.push_back((char)value);
+}
+
+static void writeVarintField(eastl::string& out, uint32_t field, uint64_t value)
+{
+	writeVarint(out, (field << 3) | PROTO_WIRE_VARINT);
+	writeVarint(out, value);
+}
+
+static void writeBytesField(eastl::string& out, uint32_t field, const char* pData, size_t size)
+{
+	writeVarint(out, (field << 3) | PROTO_WIRE_LENGTH);
+	writeVarint(out, size);
+	out.append(pData, size);
+}
+
+static void writeMessageField(eastl::string& out, uint32_t field, const eastl::string& message)
+{
+	writeBytesField(out, field, message.data(), message.size());
+}
+
+typedef struct TraceSliceEdge
+{
+	int64_t     mTime;
+	const char* pName;
+	uint32_t    mDepth;
+	bool        mBegin;
+} TraceSliceEdge;
+
+// Slices must be properly nested once ordered by time: on equal timestamps ends come first (deepest first),
+// then begins (shallowest first)
+static bool compareSliceEdges(const TraceSliceEdge& a, const TraceSliceEdge& b)
+{
+	if (a.mTime != b.mTime)
+		return a.mTime < b.mTime;
+	if (a.mBegin != b.mBegin)
+		return !a.mBegin;
+	return a.mBegin ? a.mDepth < b.mDepth : a.mDepth > b.mDepth;
+}
+
+static void writePerfettoTrace(const eastl::vector<TraceThreadCapture>& captures, eastl::string& output)
+{
+	const uint32_t sequenceId = 1;
+	eastl::string  packet;
+	eastl::string  message;
+	eastl::string  nested;
+
+	eastl::vector<TraceSliceEdge> edges;
+	for (const TraceThreadCapture& capture : captures)
+	{
+		const uint64_t trackUuid = capture.pBuffer->mThreadIndex;
+		const char*    pThreadName = capture.pBuffer->mName[0] ? capture.pBuffer->mName : "Thread";
+
+		nested.clear();
+		writeVarintField(nested, THREAD_DESCRIPTOR_PID, 1);
+		writeVarintField(nested, THREAD_DESCRIPTOR_TID, trackUuid);
+		writeBytesField(nested, THREAD_DESCRIPTOR_NAME, pThreadName, strlen(pThreadName));
+		message.clear();
+		writeVarintField(message, TRACK_DESCRIPTOR_UUID, trackUuid);
+		writeMessageField(message, TRACK_DESCRIPTOR_THREAD, nested);
+		packet.clear();
+		writeVarintField(packet, PACKET_TRUSTED_SEQUENCE_ID, sequenceId);
+		writeMessageField(packet, PACKET_TRACK_DESCRIPTOR, message);
+		writeMessageField(output, TRACE_PACKET, packet);
+
+		edges.clear();
+		edges.reserve(capture.mEvents.size() * 2);
+		for (const TraceEvent& event : capture.mEvents)
+		{
+			edges.push_back({ event.mStart, event.pName, event.mDepth, true });
+			edges.push_back({ event.mEnd, event.pName, event.mDepth, false });
+		}
+		eastl::sort(edges.begin(), edges.end(), compareSliceEdges);
+
+		for (const TraceSliceEdge& edge : edges)
+		{
+			message.clear();
+			writeVarintField(message, TRACK_EVENT_TYPE, edge.mBegin ? TRACK_EVENT_TYPE_SLICE_BEGIN : TRACK_EVENT_TYPE_SLICE_END);
+			writeVarintField(message, TRACK_EVENT_TRACK_UUID, trackUuid);
+			if (edge.mBegin)
+				writeBytesField(message, TRACK_EVENT_NAME, edge.pName, strlen(edge.pName));
+			packet.clear();
+			writeVarintField(packet, PACKET_TIMESTAMP, (uint64_t)edge.mTime);
+			writeVarintField(packet, PACKET_TRUSTED_SEQUENCE_ID, sequenceId);
+			writeMessageField(packet, PACKET_TRACK_EVENT, message);
+			writeMessageField(output, TRACE_PACKET, packet);
+		}
+	}
+}
+
+TraceFormat getTraceFormatFromFileName(const char* pFileName)
+{
+	return FileSystem::GetExtension(pFileName) == ".json" ? TRACE_FORMAT_CHROME_JSON : TRACE_FORMAT_PERFETTO;
+}
+
+bool dumpTraceCapture(const char* pFileName, TraceFormat format)
+{
+	if (!pTraceProfiler)
+		return false;
+
+	stopTraceCapture();
+
+	eastl::vector<TraceThreadCapture> captures;
+	collectTraceCapture(captures);
+
+	eastl::string output;
+	if (format == TRACE_FORMAT_CHROME_JSON)
+		writeChromeTrace(captures, output);
+	else
+		writePerfettoTrace(captures, output);
+
+	File file;
+	if (!file.Open(pFileName, FM_WriteBinary, FSR_Absolute))
+	{
+		LOGF(LogLevel::eERROR, "Failed to open \"%s\" for writing the trace capture", pFileName);
+		return false;
+	}
+	file.Write(output.data(), (unsigned)output.size());
+	file.Close();
+
+	LOGF(LogLevel::eINFO, "Trace capture written to \"%s\" (%u threads)", pFileName, (uint32_t)captures.size());
+	return true;
+}
+
+void requestTraceCapture(uint32_t frameCount, const char* pFileName)
+{
+	if (!pTraceProfiler)
+		return;
+
+	pTraceProfiler->mFramesToCapture = frameCount ? frameCount : 1;
+	pTraceProfiler->mRequestFileName = pFileName;
+}
+
+void parseTraceProfilerArguments(int argc, char** argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--trace-capture") != 0)
+			continue;
+
+		if (i + 1 >= argc)
+		{
+			LOGF(LogLevel::eWARNING, "--trace-capture expects a frame count");
+			return;
+		}
+
+		const uint32_t frameCount = (uint32_t)atoi(argv[i + 1]);
+		eastl::string  fileName = FileSystem::GetProgramFileName() + "_trace.json";
+		if (i + 2 < argc && argv[i + 2][0] != '-')
+			fileName = argv[i + 2];
+
+		requestTraceCapture(frameCount, fileName.c_str());
+		return;
+	}
+}
+
+void updateTraceProfiler()
+{
+	if (!pTraceProfiler)
+		return;
+
+	if (gTraceSignalCount)
+	{
+		gTraceSignalCount = 0;
+		if (!isTraceCaptureActive())
+		{
+			startTraceCapture();
+		}
+		else
+		{
+			eastl::string fileName = FileSystem::GetProgramFileName() + "_trace.json";
+			dumpTraceCapture(fileName.c_str(), TRACE_FORMAT_CHROME_JSON);
+		}
+	}
+
+	if (pTraceProfiler->mFramesToCapture)
+	{
+		// Requests start on a frame boundary so exactly the requested frames end up in the capture
+		if (!isTraceCaptureActive())
+			startTraceCapture();
+		else if (--pTraceProfiler->mFramesToCapture == 0)
+			dumpTraceCapture(
+				pTraceProfiler->mRequestFileName.c_str(), getTraceFormatFromFileName(pTraceProfiler->mRequestFileName.c_str()));
+	}
+}
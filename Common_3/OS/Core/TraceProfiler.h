@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Hierarchical CPU trace capture for headless and production runs.
+//
+// Zones are recorded from any thread into a per thread ring buffer without taking locks and can be dumped as
+// Chrome trace_event JSON (chrome://tracing, ui.perfetto.dev) or as a Perfetto protobuf trace.
+// When no capture is running a zone costs a single relaxed load and a branch.
+//
+// Usage:
+//   TRACE_SCOPE("Update Particles");      // zone name must outlive the capture (string literal)
+//   TRACE_SCOPE_FUNCTION();
+//
+// A capture is started / dumped with
+//   - requestTraceCapture(frameCount, "capture.json")  e.g. from a debug UI or script command
+//   - the --trace-capture <frames> [file] command line option of the platform main loop
+//   - SIGUSR1 on Linux / macOS: the first signal starts a capture, the second one dumps it. Windows has no signal
+//     trigger, use the command line option or requestTraceCapture there
+// Pending requests are serviced by updateTraceProfiler(), called once per frame by the platform main loop.
+
+#pragma once
+
+#include "../Interfaces/IOperatingSystem.h"
+#include "Atomics.h"
+
+typedef enum TraceFormat
+{
+	/// Chrome trace_event JSON
+	TRACE_FORMAT_CHROME_JSON = 0,
+	/// Perfetto TracePacket protobuf
+	TRACE_FORMAT_PERFETTO,
+} TraceFormat;
+
+typedef struct TraceProfilerDesc
+{
+	/// Zones kept per thread. Older zones are overwritten once the ring buffer is full
+	uint32_t mEventsPerThread;
+	/// Install the SIGUSR1 capture toggle. Ignored on Windows
+	bool     mInstallSignalHandler;
+} TraceProfilerDesc;
+
+void initTraceProfiler(const TraceProfilerDesc* pDesc);
+/// Waits for threads still recording a zone. Threads keep running fine afterwards, their zones are dropped
+void exitTraceProfiler();
+
+void startTraceCapture();
+void stopTraceCapture();
+/// Writes the zones recorded by the last capture. Stops the capture if it is still running
+bool dumpTraceCapture(const char* pFileName, TraceFormat format);
+/// Format deduced from the extension: .json is Chrome JSON, anything else is Perfetto protobuf
+TraceFormat getTraceFormatFromFileName(const char* pFileName);
+
+/// Captures the next frameCount frames (updateTraceProfiler calls) and dumps them to pFileName
+void requestTraceCapture(uint32_t frameCount, const char* pFileName);
+/// Handles --trace-capture <frames> [file]. The file defaults to <executable>_trace.json
+void parseTraceProfilerArguments(int argc, char** argv);
+/// Services capture requests (API, command line, signal). Call once per frame
+void updateTraceProfiler();
+
+/// Name shown for the calling thread in the trace. Defaults to the OS thread name
+void setTraceThreadName(const char* pName);
+
+extern tfrg_atomic32_t gTraceCaptureActive;
+
+inline bool isTraceCaptureActive() { return tfrg_atomic32_load_relaxed(&gTraceCaptureActive) != 0; }
+
+/// Returns the zone start time
+int64_t beginTraceZone();
+void    endTraceZone(const char* pName, int64_t startTime);
+
+struct TraceScope
+{
+	explicit TraceScope(const char* pName): pName(pName), mStartTime(isTraceCaptureActive() ? beginTraceZone() : 0) {}
+	~TraceScope()
+	{
+		if (mStartTime)
+			endTraceZone(pName, mStartTime);
+	}
+
+	/// Prevent copy construction.
+	TraceScope(const TraceScope& rhs) = delete;
+	/// Prevent assignment.
+	TraceScope& operator=(const TraceScope& rhs) = delete;
+
+	const char* pName;
+	int64_t     mStartTime;
+};
+
+#define TRACE_TOKEN_PASTE0(a, b) a##b
+#define TRACE_TOKEN_PASTE(a, b) TRACE_TOKEN_PASTE0(a, b)
+
+#if defined(DISABLE_TRACE_PROFILER)
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_SCOPE_FUNCTION() do {} while (0)
+#else
+#define TRACE_SCOPE(name) TraceScope TRACE_TOKEN_PASTE(traceScope, __LINE__)(name)
+#define TRACE_SCOPE_FUNCTION() TRACE_SCOPE(__FUNCTION__)
+#endif
@@ -51,6 +51,9 @@ size_t     read_file(void* buffer, size_t byteCount, FileHandle handle);
 bool       seek_file(FileHandle handle, long offset, int origin);
 long       tell_file(FileHandle handle);
 size_t     write_file(const void* buffer, size_t byteCount, FileHandle handle);
+// Maps a whole file into memory, returns NULL if it can not be mapped. Writes to the memory do not reach the file
+void*      map_file(const char* fileFullPath, size_t* pSize);
+void       unmap_file(void* pData, size_t size);
 time_t     get_file_last_modified_time(const char* _fileName);
 time_t     get_file_last_accessed_time(const char* _fileName);
 time_t     get_file_creation_time(const char* _fileName);
@@ -37,6 +37,7 @@
 #include "../Interfaces/ILogManager.h"
 #include "../Interfaces/ITimeManager.h"
 #include "../Interfaces/IThread.h"
+#include "../Core/TraceProfiler.h"
 
 #include "../Input/InputSystem.h"
 #include "../Input/InputMappings.h"
@@ -337,6 +338,11 @@ int LinuxMain(int argc, char** argv, IApp* app)
 
 	FileSystem::SetCurrentDir(FileSystem::GetProgramDir());
 
+	TraceProfilerDesc traceDesc = {};
+	traceDesc.mInstallSignalHandler = true;
+	initTraceProfiler(&traceDesc);
+	setTraceThreadName("Main");
+
 	IApp::Settings* pSettings = &pApp->mSettings;
 	Timer           deltaTimer;
 
@@ -358,19 +364,30 @@ int LinuxMain(int argc, char** argv, IApp* app)
 	pApp->pWindow = &gWindow;
 
 	if (!pApp->Init())
+	{
+		exitTraceProfiler();
 		return EXIT_FAILURE;
+	}
 
 	if (!pApp->Load())
+	{
+		exitTraceProfiler();
 		return EXIT_FAILURE;
+	}
 
 	InputSystem::Init(pSettings->mWidth, pSettings->mHeight);
 
 	registerWindowResizeEvent(onResize);
 
+	parseTraceProfilerArguments(argc, argv);
+
 	bool quit = false;
 
 	while (!quit)
 	{
+		updateTraceProfiler();
+		TRACE_SCOPE("Frame");
+
 		float deltaTime = deltaTimer.GetMSec(true) / 1000.0f;
 		// if framerate appears to drop below about 6, assume we're at a breakpoint and simulate 20fps.
 		if (deltaTime > 0.15f)
@@ -380,8 +397,14 @@ int LinuxMain(int argc, char** argv, IApp* app)
 
 		quit = handleMessages(&gWindow);
 
-		pApp->Update(deltaTime);
-		pApp->Draw();
+		{
+			TRACE_SCOPE("Update");
+			pApp->Update(deltaTime);
+		}
+		{
+			TRACE_SCOPE("Draw");
+			pApp->Draw();
+		}
 
 #ifdef AUTOMATED_TESTING
 		//used in automated tests only.
@@ -395,6 +418,8 @@ int LinuxMain(int argc, char** argv, IApp* app)
 	pApp->Unload();
 	pApp->Exit();
 
+	exitTraceProfiler();
+
 	return 0;
 }
 /************************************************************************/
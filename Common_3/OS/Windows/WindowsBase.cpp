@@ -45,6 +45,7 @@
 #include "../Interfaces/ILogManager.h"
 #include "../Interfaces/ITimeManager.h"
 #include "../Interfaces/IThread.h"
+#include "../Core/TraceProfiler.h"
 #include "../Interfaces/IApp.h"
 #include "../Interfaces/IFileSystem.h"
 #include "../Interfaces/IMemoryManager.h"
@@ -714,6 +715,10 @@ int WindowsMain(int argc, char** argv, IApp* app)
 
 	FileSystem::SetCurrentDir(FileSystem::GetProgramDir());
 
+	TraceProfilerDesc traceDesc = {};
+	initTraceProfiler(&traceDesc);
+	setTraceThreadName("Main");
+
 	IApp::Settings* pSettings = &pApp->mSettings;
 	WindowsDesc window = {};
 	Timer deltaTimer;
@@ -745,18 +750,29 @@ int WindowsMain(int argc, char** argv, IApp* app)
 	{
 		Timer t;
 		if (!pApp->Init())
+		{
+			exitTraceProfiler();
 			return EXIT_FAILURE;
+		}
 
 		if (!pApp->Load())
+		{
+			exitTraceProfiler();
 			return EXIT_FAILURE;
+		}
 		LOGF(LogLevel::eINFO, "Application Init+Load %f", t.GetMSec(false)/1000.0f);
 	}
 	registerWindowResizeEvent(onResize);
 
+	parseTraceProfilerArguments(argc, argv);
+
 	bool quit = false;
 
 	while (!quit)
 	{
+		updateTraceProfiler();
+		TRACE_SCOPE("Frame");
+
 		float deltaTime = deltaTimer.GetMSec(true) / 1000.0f;
 		// if framerate appears to drop below about 6, assume we're at a breakpoint and simulate 20fps.
 		if (deltaTime > 0.15f)
@@ -774,8 +790,14 @@ int WindowsMain(int argc, char** argv, IApp* app)
 			continue;
 		}
 
-		pApp->Update(deltaTime);
-		pApp->Draw();
+		{
+			TRACE_SCOPE("Update");
+			pApp->Update(deltaTime);
+		}
+		{
+			TRACE_SCOPE("Draw");
+			pApp->Draw();
+		}
 
 #ifdef AUTOMATED_TESTING
 		//used in automated tests only.
@@ -790,6 +812,8 @@ int WindowsMain(int argc, char** argv, IApp* app)
 
 	pApp->Unload();
 	pApp->Exit();
+
+	exitTraceProfiler();
 	return 0;
 }
 /************************************************************************/
@@ -75,6 +75,31 @@ long tell_file(FileHandle handle) { return ftell((::FILE*)handle); }
 
 size_t write_file(const void* buffer, size_t byteCount, FileHandle handle) { return fwrite(buffer, 1, byteCount, (::FILE*)handle); }
 
+void* map_file(const char* fileFullPath, size_t* pSize)
+{
+	HANDLE file = CreateFileA(fileFullPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	LARGE_INTEGER size = {};
+	HANDLE        mapping = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+		return NULL;
+
+	// Copy on write view, pages written to are copied instead of changing the file
+	void* pData = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(mapping);
+
+	if (pData)
+		*pSize = (size_t)size.QuadPart;
+	return pData;
+}
+
+void unmap_file(void* pData, size_t size) { UnmapViewOfFile(pData); }
+
 time_t get_file_last_modified_time(const char* _fileName)
 {
 	struct stat fileInfo = {0};
@@ -33,6 +33,8 @@
 #include "../Interfaces/IMemoryManager.h"
 
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 #define RESOURCE_DIR "Shaders/Metal"
@@ -150,6 +152,30 @@ size_t write_file(const void* buffer, size_t byteCount, FileHandle handle)
 	return fwrite(buffer, 1, byteCount, (::FILE*)handle);
 }
 
+void* map_file(const char* fileFullPath, size_t* pSize)
+{
+	int fd = open(fileFullPath, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat fileInfo = {};
+	void*       pData = NULL;
+	if (fstat(fd, &fileInfo) == 0 && fileInfo.st_size > 0)
+	{
+		// Private writable mapping, pages written to are copied instead of changing the file
+		pData = mmap(NULL, (size_t)fileInfo.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (pData == MAP_FAILED)
+			pData = NULL;
+	}
+	close(fd);
+
+	if (pData)
+		*pSize = (size_t)fileInfo.st_size;
+	return pData;
+}
+
+void unmap_file(void* pData, size_t size) { munmap(pData, size); }
+
 eastl::string get_current_dir()
 {
 	return eastl::string([[[NSBundle mainBundle] bundlePath] cStringUsingEncoding:NSUTF8StringEncoding]);
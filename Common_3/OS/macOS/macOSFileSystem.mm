@@ -35,6 +35,8 @@
 #include <unistd.h>
 #include <limits.h>       // for UINT_MAX
 #include <sys/stat.h>     // for mkdir
+#include <sys/mman.h>     // for mmap
+#include <fcntl.h>        // for open
 #include <sys/errno.h>    // for errno
 #include <dirent.h>
 
@@ -69,6 +71,30 @@ long tell_file(FileHandle handle) { return ftell((::FILE*)handle); }
 
 size_t write_file(const void* buffer, size_t byteCount, FileHandle handle) { return fwrite(buffer, 1, byteCount, (::FILE*)handle); }
 
+void* map_file(const char* fileFullPath, size_t* pSize)
+{
+	int fd = open(fileFullPath, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat fileInfo = {};
+	void*       pData = NULL;
+	if (fstat(fd, &fileInfo) == 0 && fileInfo.st_size > 0)
+	{
+		// Private writable mapping, pages written to are copied instead of changing the file
+		pData = mmap(NULL, (size_t)fileInfo.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (pData == MAP_FAILED)
+			pData = NULL;
+	}
+	close(fd);
+
+	if (pData)
+		*pSize = (size_t)fileInfo.st_size;
+	return pData;
+}
+
+void unmap_file(void* pData, size_t size) { munmap(pData, size); }
+
 time_t get_file_last_modified_time(const char* _fileName)
 {
 	struct stat fileInfo = {0};
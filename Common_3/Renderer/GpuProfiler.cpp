@@ -28,6 +28,8 @@
 #include "../ThirdParty/OpenSource/MicroProfile/ProfilerBase.h"
 #include "../OS/Interfaces/IThread.h"
 #include "../OS/Interfaces/ILogManager.h"
+#include "../OS/Interfaces/IFileSystem.h"
+#include "../ThirdParty/OpenSource/EASTL/sort.h"
 #include "../OS/Interfaces/IMemoryManager.h"
 #if __linux__
 #include <linux/limits.h>    //PATH_MAX declaration
@@ -50,6 +52,29 @@ void clearChildren(GpuTimerTree* pRoot)
 	pRoot->mChildren.clear();
 }
 
+typedef struct GpuTimerSamples
+{
+	eastl::string          mPath;
+	/// Ring buffers of mStatisticsWindow entries (unbounded if the window is 0)
+	eastl::vector<int64_t> mCpuSamples;
+	eastl::vector<int64_t> mGpuSamples;
+	uint32_t               mNextSample;
+} GpuTimerSamples;
+
+typedef struct GpuProfileExporter
+{
+	GpuProfileExportDesc             mDesc;
+	File                             mFile;
+	uint64_t                         mFrameIndex;
+	/// Depth first timer tree of the current frame
+	eastl::vector<GpuProfileRecord>  mRecords;
+	eastl::vector<uint32_t>          mRecordSamples;
+	eastl::string                    mPath;
+	eastl::string                    mText;
+	eastl::string_hash_map<uint32_t> mSampleIndices;
+	eastl::vector<GpuTimerSamples>   mSamples;
+} GpuProfileExporter;
+
 static void calculateTimes(Cmd* pCmd, GpuProfiler* pGpuProfiler, GpuTimerTree* pRoot)
 {
 	if (!pRoot)
@@ -97,6 +122,234 @@ static void calculateTimes(Cmd* pCmd, GpuProfiler* pGpuProfiler, GpuTimerTree* p
 		calculateTimes(pCmd, pGpuProfiler, pRoot->mChildren[i]);
 }
 
+static void gatherExportRecords(GpuProfiler* pGpuProfiler, GpuTimerTree* pNode, uint32_t depth)
+{
+	GpuProfileExporter* pExporter = pGpuProfiler->pExporter;
+	const size_t        parentPathLength = pExporter->mPath.size();
+	if (parentPathLength)
+		pExporter->mPath.push_back('/');
+	pExporter->mPath.append(pNode->mGpuTimer.mName);
+
+	GpuProfileRecord record = {};
+	record.pName = pNode->mGpuTimer.mName.c_str();
+	record.mDepth = depth;
+	// CPU times are recorded with getUSec
+	record.mCpuTimeNs = pNode->mGpuTimer.mCpuTime * 1000;
+#if defined(DIRECT3D12) || defined(VULKAN) || defined(DIRECT3D11) || defined(METAL)
+	record.mGpuTimeNs = (int64_t)(pNode->mGpuTimer.mGpuTime / pGpuProfiler->mGpuTimeStampFrequency * 1e9);
+#endif
+	pExporter->mRecords.push_back(record);
+
+	uint32_t sampleIndex = 0;
+	eastl::string_hash_map<uint32_t>::iterator it = pExporter->mSampleIndices.find(pExporter->mPath.c_str());
+	if (it == pExporter->mSampleIndices.end())
+	{
+		sampleIndex = (uint32_t)pExporter->mSamples.size();
+		pExporter->mSampleIndices[pExporter->mPath.c_str()] = sampleIndex;
+		GpuTimerSamples samples;
+		samples.mPath = pExporter->mPath;
+		samples.mNextSample = 0;
+		pExporter->mSamples.push_back(samples);
+	}
+	else
+	{
+		sampleIndex = it->second;
+	}
+	pExporter->mRecordSamples.push_back(sampleIndex);
+
+	for (uint32_t i = 0; i < (uint32_t)pNode->mChildren.size(); ++i)
+		gatherExportRecords(pGpuProfiler, pNode->mChildren[i], depth + 1);
+
+	pExporter->mPath.resize(parentPathLength);
+}
+
+static void addExportSample(GpuProfileExporter* pExporter, GpuTimerSamples* pSamples, const GpuProfileRecord& record)
+{
+	const uint32_t window = pExporter->mDesc.mStatisticsWindow;
+	if (!window || pSamples->mCpuSamples.size() < window)
+	{
+		pSamples->mCpuSamples.push_back(record.mCpuTimeNs);
+		pSamples->mGpuSamples.push_back(record.mGpuTimeNs);
+	}
+	else
+	{
+		pSamples->mCpuSamples[pSamples->mNextSample] = record.mCpuTimeNs;
+		pSamples->mGpuSamples[pSamples->mNextSample] = record.mGpuTimeNs;
+		pSamples->mNextSample = (pSamples->mNextSample + 1) % window;
+	}
+}
+
+static void appendJsonString(eastl::string& text, const char* pStr)
+{
+	text.push_back('"');
+	for (; *pStr; ++pStr)
+	{
+		if (*pStr == '"' || *pStr == '\\')
+			text.push_back('\\');
+		text.push_back(*pStr);
+	}
+	text.push_back('"');
+}
+
+static void writeExportText(GpuProfileExporter* pExporter)
+{
+	if (pExporter->mFile.IsOpen() && !pExporter->mText.empty())
+		pExporter->mFile.Write(pExporter->mText.data(), (unsigned)pExporter->mText.size());
+	pExporter->mText.clear();
+}
+
+static void exportFrame(GpuProfiler* pGpuProfiler)
+{
+	GpuProfileExporter* pExporter = pGpuProfiler->pExporter;
+	pExporter->mRecords.clear();
+	pExporter->mRecordSamples.clear();
+	pExporter->mPath.clear();
+	for (uint32_t i = 0; i < (uint32_t)pGpuProfiler->mRoot.mChildren.size(); ++i)
+		gatherExportRecords(pGpuProfiler, pGpuProfiler->mRoot.mChildren[i], 0);
+
+	const uint32_t recordCount = (uint32_t)pExporter->mRecords.size();
+	for (uint32_t i = 0; i < recordCount; ++i)
+		addExportSample(pExporter, &pExporter->mSamples[pExporter->mRecordSamples[i]], pExporter->mRecords[i]);
+
+	if (pExporter->mDesc.pCallback)
+		pExporter->mDesc.pCallback(pExporter->mFrameIndex, pExporter->mRecords.data(), recordCount, pExporter->mDesc.pUserData);
+
+	if (pExporter->mDesc.mFormat == GPU_PROFILE_EXPORT_CSV)
+	{
+		for (const GpuProfileRecord& record : pExporter->mRecords)
+		{
+			// Timer names are user strings, quote them so commas do not break the columns
+			pExporter->mText.append_sprintf("%llu,%u,\"", (unsigned long long)pExporter->mFrameIndex, record.mDepth);
+			for (const char* pName = record.pName; *pName; ++pName)
+			{
+				if (*pName == '"')
+					pExporter->mText.push_back('"');
+				pExporter->mText.push_back(*pName);
+			}
+			pExporter->mText.append_sprintf("\",%lld,%lld\n", (long long)record.mCpuTimeNs, (long long)record.mGpuTimeNs);
+		}
+	}
+	else if (pExporter->mDesc.mFormat == GPU_PROFILE_EXPORT_JSON)
+	{
+		pExporter->mText.append_sprintf("%s{\"frame\":%llu,\"timers\":[", pExporter->mFrameIndex ? ",\n" : "", (unsigned long long)pExporter->mFrameIndex);
+		for (uint32_t i = 0; i < recordCount; ++i)
+		{
+			const GpuProfileRecord& record = pExporter->mRecords[i];
+			pExporter->mText.append(i ? ",{\"name\":" : "{\"name\":");
+			appendJsonString(pExporter->mText, record.pName);
+			pExporter->mText.append_sprintf(
+				",\"depth\":%u,\"cpu_ns\":%lld,\"gpu_ns\":%lld}", record.mDepth, (long long)record.mCpuTimeNs, (long long)record.mGpuTimeNs);
+		}
+		pExporter->mText.append("]}");
+	}
+	writeExportText(pExporter);
+
+	++pExporter->mFrameIndex;
+}
+
+// Nearest rank percentile, sorts the samples in place
+static int64_t getPercentile(eastl::vector<int64_t>& sortedSamples, double percentile)
+{
+	if (sortedSamples.empty())
+		return 0;
+	size_t rank = (size_t)ceil(percentile * sortedSamples.size());
+	rank = rank ? rank - 1 : 0;
+	return sortedSamples[rank < sortedSamples.size() ? rank : sortedSamples.size() - 1];
+}
+
+static void computeStatistics(const GpuTimerSamples* pSamples, GpuProfileStatistics* pStatistics)
+{
+	eastl::vector<int64_t> sorted(pSamples->mCpuSamples);
+	eastl::sort(sorted.begin(), sorted.end());
+	pStatistics->mSampleCount = (uint32_t)sorted.size();
+	pStatistics->mCpuP50Ns = getPercentile(sorted, 0.50);
+	pStatistics->mCpuP95Ns = getPercentile(sorted, 0.95);
+	pStatistics->mCpuP99Ns = getPercentile(sorted, 0.99);
+
+	sorted = pSamples->mGpuSamples;
+	eastl::sort(sorted.begin(), sorted.end());
+	pStatistics->mGpuP50Ns = getPercentile(sorted, 0.50);
+	pStatistics->mGpuP95Ns = getPercentile(sorted, 0.95);
+	pStatistics->mGpuP99Ns = getPercentile(sorted, 0.99);
+}
+
+bool beginGpuProfileExport(GpuProfiler* pGpuProfiler, const GpuProfileExportDesc* pDesc)
+{
+	ASSERT(pGpuProfiler && pDesc);
+	endGpuProfileExport(pGpuProfiler);
+
+	GpuProfileExporter* pExporter = conf_new<GpuProfileExporter>();
+	pExporter->mDesc = *pDesc;
+	pExporter->mFrameIndex = 0;
+
+	if (pDesc->mFormat != GPU_PROFILE_EXPORT_NONE)
+	{
+		ASSERT(pDesc->pFileName);
+		if (!pExporter->mFile.Open(pDesc->pFileName, FM_Write, FSR_Absolute))
+		{
+			LOGF(LogLevel::eERROR, "Failed to open GPU profile export file \"%s\"", pDesc->pFileName);
+			conf_delete(pExporter);
+			return false;
+		}
+
+		if (pDesc->mFormat == GPU_PROFILE_EXPORT_CSV)
+			pExporter->mText = "frame,depth,name,cpu_ns,gpu_ns\n";
+		else
+			pExporter->mText = "{\"frames\":[\n";
+		writeExportText(pExporter);
+	}
+
+	pGpuProfiler->pExporter = pExporter;
+	return true;
+}
+
+void endGpuProfileExport(GpuProfiler* pGpuProfiler)
+{
+	GpuProfileExporter* pExporter = pGpuProfiler->pExporter;
+	if (!pExporter)
+		return;
+
+	if (pExporter->mDesc.mFormat == GPU_PROFILE_EXPORT_JSON)
+	{
+		pExporter->mText.append("\n],\n\"statistics\":[");
+		for (uint32_t i = 0; i < (uint32_t)pExporter->mSamples.size(); ++i)
+		{
+			GpuProfileStatistics stats = {};
+			computeStatistics(&pExporter->mSamples[i], &stats);
+			pExporter->mText.append(i ? ",\n{\"path\":" : "\n{\"path\":");
+			appendJsonString(pExporter->mText, pExporter->mSamples[i].mPath.c_str());
+			pExporter->mText.append_sprintf(
+				",\"samples\":%u,\"cpu_p50_ns\":%lld,\"cpu_p95_ns\":%lld,\"cpu_p99_ns\":%lld,\"gpu_p50_ns\":%lld,\"gpu_p95_ns\":%lld,"
+				"\"gpu_p99_ns\":%lld}",
+				stats.mSampleCount, (long long)stats.mCpuP50Ns, (long long)stats.mCpuP95Ns, (long long)stats.mCpuP99Ns,
+				(long long)stats.mGpuP50Ns, (long long)stats.mGpuP95Ns, (long long)stats.mGpuP99Ns);
+		}
+		pExporter->mText.append("\n]}\n");
+		writeExportText(pExporter);
+	}
+
+	if (pExporter->mFile.IsOpen())
+		pExporter->mFile.Close();
+
+	conf_delete(pExporter);
+	pGpuProfiler->pExporter = NULL;
+}
+
+bool getGpuProfileStatistics(GpuProfiler* pGpuProfiler, const char* pTimerPath, GpuProfileStatistics* pStatistics)
+{
+	ASSERT(pStatistics);
+	GpuProfileExporter* pExporter = pGpuProfiler->pExporter;
+	if (!pExporter)
+		return false;
+
+	eastl::string_hash_map<uint32_t>::iterator it = pExporter->mSampleIndices.find(pTimerPath);
+	if (it == pExporter->mSampleIndices.end())
+		return false;
+
+	computeStatistics(&pExporter->mSamples[it->second], pStatistics);
+	return true;
+}
+
 double getAverageGpuTime(struct GpuProfiler* pGpuProfiler, struct GpuTimer* pGpuTimer)
 {
 	int64_t elapsedTime = 0;
@@ -202,6 +455,8 @@ void removeGpuProfiler(Renderer* pRenderer, GpuProfiler* pGpuProfiler)
 		pGpuProfiler->pGpuTimerPool[i].mGpuTimer.mName.~basic_string();
 	}
 
+	endGpuProfileExport(pGpuProfiler);
+
 	pGpuProfiler->mRoot.mChildren.~vector();
 	pGpuProfiler->mGpuPoolHash.~string_hash_map();
 
@@ -368,6 +623,9 @@ void cmdEndGpuFrameProfile(Cmd* pCmd, GpuProfiler* pGpuProfiler)
 
 	calculateTimes(pCmd, pGpuProfiler, &pGpuProfiler->mRoot);
 
+	if (pGpuProfiler->pExporter)
+		exportFrame(pGpuProfiler);
+
 #if defined(DIRECT3D12) || defined(VULKAN) || defined(DIRECT3D11) || defined(METAL)
 	unmapBuffer(pCmd->pRenderer, pGpuProfiler->pReadbackBuffer[pGpuProfiler->mBufferIndex]);
 	pGpuProfiler->pTimeStamp = NULL;
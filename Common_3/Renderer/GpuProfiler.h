@@ -37,6 +37,7 @@ struct Buffer;
 struct Queue;
 struct QueryHeap;
 struct ProfileThreadLog;
+struct GpuProfileExporter;
 
 typedef struct GpuTimer
 {
@@ -97,9 +98,63 @@ typedef struct GpuProfiler
 	char mGroupName[256] = "GPU";
 	ProfileThreadLog * pLog = nullptr;
 
+	// Headless export, see beginGpuProfileExport
+	GpuProfileExporter* pExporter = nullptr;
+
 	bool mUpdate;
 } GpuProfiler;
 
+typedef enum GpuProfileExportFormat
+{
+	/// Only gather statistics
+	GPU_PROFILE_EXPORT_NONE = 0,
+	/// One line per timer and frame: frame,depth,name,cpu_ns,gpu_ns
+	GPU_PROFILE_EXPORT_CSV,
+	/// Per frame timer trees followed by the statistics of the export window
+	GPU_PROFILE_EXPORT_JSON,
+} GpuProfileExportFormat;
+
+typedef struct GpuProfileRecord
+{
+	const char* pName;
+	uint32_t    mDepth;
+	int64_t     mCpuTimeNs;
+	/// 0 on APIs without timestamp queries
+	int64_t     mGpuTimeNs;
+} GpuProfileRecord;
+
+/// Called once per frame from cmdEndGpuFrameProfile with the timer tree in depth first order
+typedef void (*GpuProfileExportCallback)(uint64_t frameIndex, const GpuProfileRecord* pRecords, uint32_t recordCount, void* pUserData);
+
+typedef struct GpuProfileExportDesc
+{
+	GpuProfileExportFormat   mFormat;
+	/// Absolute path of the exported file. Unused for GPU_PROFILE_EXPORT_NONE
+	const char*              pFileName;
+	GpuProfileExportCallback pCallback;
+	void*                    pUserData;
+	/// Number of most recent frames the percentiles are computed over. 0 uses every exported frame
+	uint32_t                 mStatisticsWindow;
+} GpuProfileExportDesc;
+
+typedef struct GpuProfileStatistics
+{
+	uint32_t mSampleCount;
+	int64_t  mCpuP50Ns;
+	int64_t  mCpuP95Ns;
+	int64_t  mCpuP99Ns;
+	int64_t  mGpuP50Ns;
+	int64_t  mGpuP95Ns;
+	int64_t  mGpuP99Ns;
+} GpuProfileStatistics;
+
+/// Streams every following frame of the profiler to a file and / or callback until endGpuProfileExport
+bool beginGpuProfileExport(struct GpuProfiler* pGpuProfiler, const GpuProfileExportDesc* pDesc);
+/// Writes the statistics (JSON) and closes the export file
+void endGpuProfileExport(struct GpuProfiler* pGpuProfiler);
+/// Percentiles of a timer identified by its path in the tree, e.g. "GPU/Draw Scene". The frame timer is "GPU"
+bool getGpuProfileStatistics(struct GpuProfiler* pGpuProfiler, const char* pTimerPath, GpuProfileStatistics* pStatistics);
+
 double getAverageGpuTime(struct GpuProfiler* pGpuProfiler, struct GpuTimer* pGpuTimer);
 double getAverageCpuTime(struct GpuProfiler* pGpuProfiler, struct GpuTimer* pGpuTimer);
 
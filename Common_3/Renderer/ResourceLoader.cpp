@@ -26,7 +26,9 @@
 
 #include "IRenderer.h"
 #include "ResourceLoader.h"
+#include "../OS/Interfaces/ICameraController.h"
 #include "../OS/Interfaces/ILogManager.h"
+#include "../OS/Core/TraceProfiler.h"
 #include "../OS/Interfaces/IMemoryManager.h"
 #include "../OS/Interfaces/IThread.h"
 #include "../OS/Image/Image.h"
@@ -67,6 +69,8 @@ typedef struct TextureUpdateDescInternal
 	Texture* pTexture;
 	Image*   pImage;
 	bool     mFreeImage;
+	/// First mip of pImage uploaded. It maps to mip 0 of pTexture (used by texture streaming)
+	uint32_t mBaseMipLevel;
 } TextureUpdateDescInternal;
 
 //////////////////////////////////////////////////////////////////////////
@@ -423,7 +427,8 @@ static bool updateTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t a
 	// TODO: move to Image
 	bool isSwizzledZCurve = !img.IsLinearLayout();
 
-	uint32_t i = pTextureUpdate.mMipLevel;
+	const uint32_t baseMip = texUpdateDesc.mBaseMipLevel;
+	uint32_t i = max(pTextureUpdate.mMipLevel, baseMip);
 	uint32_t j = pTextureUpdate.mArrayLayer;
 	uint3 uploadOffset = pTextureUpdate.mOffset;
 
@@ -486,7 +491,7 @@ static bool updateTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t a
 
 			SubresourceDataDesc  texData;
 			texData.mArrayLayer = j /*n * nSlices + k*/;
-			texData.mMipLevel = i;
+			texData.mMipLevel = i - baseMip;
 			texData.mBufferOffset = range.mOffset;
 			texData.mRegion = calculateUploadRegion(uploadOffset, uploadRectExtent, pxBlockDim, pxImageDim);
 			texData.mRowPitch = uploadPitches.y;
@@ -606,6 +611,35 @@ static bool updateBuffer(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t ac
 	return true;
 }
 
+//////////////////////////////////////////////////////////////////////////
+// Texture Streaming Structures
+//////////////////////////////////////////////////////////////////////////
+enum
+{
+	DEFAULT_STREAMING_RETIRE_LATENCY = 3,
+};
+
+typedef struct StreamingTexture
+{
+	/// Which mips are resident and requested. pUserData points back to the StreamingTexture
+	StreamingResidency    mResidency;
+	/// CPU copy of the full mip chain. Source of every stream in and eviction upload
+	Image*                pImage;
+	/// Texture currently visible to the user
+	Texture*              pTexture;
+	Texture**             ppTexture;
+	/// Texture being filled by an in-flight stream in / evict request
+	Texture*              pPendingTexture;
+	SyncToken             mPendingToken;
+	TextureLoadDesc       mLoadDesc;
+} StreamingTexture;
+
+typedef struct RetiredTexture
+{
+	Texture* pTexture;
+	uint64_t mRetireFrame;
+} RetiredTexture;
+
 //////////////////////////////////////////////////////////////////////////
 // Resource Loader Implementation
 //////////////////////////////////////////////////////////////////////////
@@ -627,6 +661,16 @@ typedef struct ResourceLoader
 
 	tfrg_atomic64_t mTokenCompleted;
 	tfrg_atomic64_t mTokenCounter;
+
+	// Texture streaming state. Only accessed from the thread calling updateTextureStreaming
+	eastl::vector<StreamingTexture*>   mStreamingTextures;
+	eastl::vector<StreamingResidency*> mStreamingOrder;
+	eastl::vector<StreamingResidency*> mStreamingRequests;
+	eastl::vector<RetiredTexture>      mRetiredTextures;
+	uint64_t                           mStreamingFrame;
+	/// Retire latency of the last update, also used for textures removed between updates
+	uint32_t                           mStreamingRetireLatency;
+	uint64_t                           mStreamingResidentSize;
 } ResourceLoader;
 
 static bool allQueuesEmpty(ResourceLoader* pLoader)
@@ -645,6 +689,7 @@ static void streamerThreadFunc(void* pThreadData)
 {
 	ResourceLoader* pLoader = (ResourceLoader*)pThreadData;
 	ASSERT(pLoader);
+	setTraceThreadName("ResourceLoader");
 
 	uint32_t linkedGPUCount = pLoader->pRenderer->mLinkedNodeCount;
 	CopyEngine pCopyEngines[MAX_GPUS];
@@ -694,11 +739,17 @@ static void streamerThreadFunc(void* pThreadData)
 			switch (updateState[i].mRequest.mType)
 			{
 				case UPDATE_REQUEST_UPDATE_BUFFER:
+				{
+					TRACE_SCOPE("Update Buffer");
 					completed = updateBuffer(pLoader->pRenderer, &pCopyEngines[i], activeSet, updateState[i]);
 					break;
+				}
 				case UPDATE_REQUEST_UPDATE_TEXTURE:
+				{
+					TRACE_SCOPE("Update Texture");
 					completed = updateTexture(pLoader->pRenderer, &pCopyEngines[i], activeSet, updateState[i]);
 					break;
+				}
 				default: break;
 			}
 			completionMask |= completed << i;
@@ -711,6 +762,7 @@ static void streamerThreadFunc(void* pThreadData)
 
 		if (getSystemTime() > nextTimeslot || completionMask == 0)
 		{
+			TRACE_SCOPE("Streamer Flush");
 			for (uint32_t i = 0; i < linkedGPUCount; ++i)
 			{
 				streamerFlush(&pCopyEngines[i], activeSet);
@@ -748,6 +800,9 @@ static void addResourceLoader(Renderer* pRenderer, ResourceLoaderDesc* pDesc, Re
 
 	pLoader->mRun = true;
 	pLoader->mDesc = pDesc ? *pDesc : ResourceLoaderDesc{ DEFAULT_BUFFER_SIZE, DEFAULT_BUFFER_COUNT, DEFAULT_TIMESLICE_MS };
+	pLoader->mStreamingFrame = 0;
+	pLoader->mStreamingRetireLatency = DEFAULT_STREAMING_RETIRE_LATENCY;
+	pLoader->mStreamingResidentSize = 0;
 
 	pLoader->mThreadDesc.pFunc = streamerThreadFunc;
 	pLoader->mThreadDesc.pData = pLoader;
@@ -763,6 +818,10 @@ static void removeResourceLoader(ResourceLoader* pLoader)
 	pLoader->mQueueCond.Set();
 	destroy_thread(pLoader->mThread);
 
+	ASSERT(pLoader->mStreamingTextures.empty() && "Streaming textures need to be removed before the resource loader");
+	for (RetiredTexture& retired : pLoader->mRetiredTextures)
+		removeTexture(pLoader->pRenderer, retired.pTexture);
+
 	conf_delete(pLoader);
 }
 
@@ -885,11 +944,9 @@ void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token)
 	}
 }
 
-void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
+/// Loads the source image of pTextureDesc (file, raw data or binary data with header). Returns NULL on failure.
+static Image* loadTextureImage(const TextureLoadDesc* pTextureDesc)
 {
-	ASSERT(pTextureDesc->ppTexture);
-
-	bool freeImage = false;
 	Image* pImage = NULL;
 	if (pTextureDesc->pFilename)
 	{
@@ -897,28 +954,13 @@ void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
 		if (!pImage->loadImage(pTextureDesc->pFilename, pTextureDesc->mUseMipmaps, NULL, NULL, pTextureDesc->mRoot))
 		{
 			conf_delete(pImage);
-			return;
+			return NULL;
 		}
-		freeImage = true;
-	}
-	else if (!pTextureDesc->pFilename && !pTextureDesc->pRawImageData && !pTextureDesc->pBinaryImageData)
-	{
-		pTextureDesc->pDesc->mStartState = util_determine_resource_start_state(pTextureDesc->pDesc->mDescriptors);
-		addTexture(pResourceLoader->pRenderer, pTextureDesc->pDesc, pTextureDesc->ppTexture);
-		// TODO: what about barriers???
-		// Only need transition for vulkan and durango since resource will decay to srv on graphics queue in PC dx12
-		//if (pLoader->pRenderer->mSettings.mApi == RENDERER_API_VULKAN || pLoader->pRenderer->mSettings.mApi == RENDERER_API_XBOX_D3D12)
-		//{
-		//	TextureBarrier barrier = { *pEmptyTexture->ppTexture, pEmptyTexture->pDesc->mStartState };
-		//	cmdResourceBarrier(pCmd, 0, NULL, 1, &barrier, true);
-		//}
-		return;
 	}
 	else if (pTextureDesc->pRawImageData && !pTextureDesc->pBinaryImageData)
 	{
 		pImage = conf_new<Image>();
 		pImage->Create(pTextureDesc->pRawImageData->mFormat, pTextureDesc->pRawImageData->mWidth, pTextureDesc->pRawImageData->mHeight, pTextureDesc->pRawImageData->mDepth, pTextureDesc->pRawImageData->mMipLevels, pTextureDesc->pRawImageData->mArraySize, pTextureDesc->pRawImageData->pRawData);
-		freeImage = true;
 	}
 	else if (pTextureDesc->pBinaryImageData)
 	{
@@ -930,22 +972,26 @@ void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
 #ifdef _DEBUG
 		ASSERT(success);
 #endif
-		freeImage = true;
 	}
 	else
 		ASSERT(0 && "Invalid params");
 
+	if (pImage && pTextureDesc->mUseMipmaps && pImage->GetMipMapCount() <= 1)
+		pImage->GenerateMipMaps();
+
+	return pImage;
+}
+
+/// Creates a texture holding the mips [baseMipLevel, mipCount) of pImage. Contents are uploaded separately.
+static void addTextureFromImage(const TextureLoadDesc* pTextureDesc, const Image* pImage, uint32_t baseMipLevel, Texture** ppTexture)
+{
 	TextureDesc desc = {};
 	desc.mFlags = pTextureDesc->mCreationFlag;
-	desc.mWidth = pImage->GetWidth();
-	desc.mHeight = pImage->GetHeight();
-	desc.mDepth = max(1U, pImage->GetDepth());
+	desc.mWidth = pImage->GetWidth(baseMipLevel);
+	desc.mHeight = pImage->GetHeight(baseMipLevel);
+	desc.mDepth = max(1U, pImage->GetDepth(baseMipLevel));
 	desc.mArraySize = pImage->GetArrayCount();
-
-	if (pTextureDesc->mUseMipmaps && pImage->GetMipMapCount() <= 1)	
-		pImage->GenerateMipMaps();
-
-	desc.mMipLevels = pImage->GetMipMapCount();
+	desc.mMipLevels = pImage->GetMipMapCount() - baseMipLevel;
 	desc.mSampleCount = SAMPLE_COUNT_1;
 	desc.mSampleQuality = 0;
 	desc.mFormat = pImage->getFormat();
@@ -968,9 +1014,34 @@ void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
 	mbstowcs(debugName, filename.c_str(), min((size_t)MAX_PATH, filename.size()));
 	desc.pDebugName = debugName;
 
-	addTexture(pResourceLoader->pRenderer, &desc, pTextureDesc->ppTexture);
+	addTexture(pResourceLoader->pRenderer, &desc, ppTexture);
+}
+
+void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
+{
+	ASSERT(pTextureDesc->ppTexture);
 
-	TextureUpdateDescInternal updateDesc = { *pTextureDesc->ppTexture, pImage, freeImage };
+	if (!pTextureDesc->pFilename && !pTextureDesc->pRawImageData && !pTextureDesc->pBinaryImageData)
+	{
+		pTextureDesc->pDesc->mStartState = util_determine_resource_start_state(pTextureDesc->pDesc->mDescriptors);
+		addTexture(pResourceLoader->pRenderer, pTextureDesc->pDesc, pTextureDesc->ppTexture);
+		// TODO: what about barriers???
+		// Only need transition for vulkan and durango since resource will decay to srv on graphics queue in PC dx12
+		//if (pLoader->pRenderer->mSettings.mApi == RENDERER_API_VULKAN || pLoader->pRenderer->mSettings.mApi == RENDERER_API_XBOX_D3D12)
+		//{
+		//	TextureBarrier barrier = { *pEmptyTexture->ppTexture, pEmptyTexture->pDesc->mStartState };
+		//	cmdResourceBarrier(pCmd, 0, NULL, 1, &barrier, true);
+		//}
+		return;
+	}
+
+	Image* pImage = loadTextureImage(pTextureDesc);
+	if (!pImage)
+		return;
+
+	addTextureFromImage(pTextureDesc, pImage, 0, pTextureDesc->ppTexture);
+
+	TextureUpdateDescInternal updateDesc = { *pTextureDesc->ppTexture, pImage, true, 0 };
 	queueResourceUpdate(pResourceLoader, &updateDesc, token);
 }
 
@@ -1021,7 +1092,7 @@ void updateResource(BufferUpdateDesc* pBufferUpdate, SyncToken* token)
 
 void updateResource(TextureUpdateDesc* pTextureUpdate, SyncToken* token)
 {	
-	TextureUpdateDescInternal desc;
+	TextureUpdateDescInternal desc = {};
 	desc.pTexture = pTextureUpdate->pTexture;
 	if (pTextureUpdate->pRawImageData)
 	{
@@ -1030,6 +1101,7 @@ void updateResource(TextureUpdateDesc* pTextureUpdate, SyncToken* token)
 			pTextureUpdate->pRawImageData->mFormat, pTextureUpdate->pRawImageData->mWidth, pTextureUpdate->pRawImageData->mHeight,
 			pTextureUpdate->pRawImageData->mDepth, pTextureUpdate->pRawImageData->mMipLevels, pTextureUpdate->pRawImageData->mArraySize,
 			pTextureUpdate->pRawImageData->pRawData);
+		desc.pImage = pImage;
 		desc.mFreeImage = true;
 	}
 	else
@@ -1100,6 +1172,177 @@ void finishResourceLoading()
 	waitBatchCompleted();
 }
 
+/************************************************************************/
+// Texture streaming
+/************************************************************************/
+static void retireTexture(ResourceLoader* pLoader, Texture* pTexture, uint32_t latency)
+{
+	pLoader->mRetiredTextures.push_back(RetiredTexture{ pTexture, pLoader->mStreamingFrame + latency });
+}
+
+/// Builds a new texture holding [mip, mipCount) and queues its upload. The texture is swapped in once the upload completes.
+static void requestStreamingTextureMip(ResourceLoader* pLoader, StreamingTexture* pStreamingTexture, uint32_t mip)
+{
+	ASSERT(!pStreamingTexture->pPendingTexture);
+
+	addTextureFromImage(&pStreamingTexture->mLoadDesc, pStreamingTexture->pImage, mip, &pStreamingTexture->pPendingTexture);
+
+	TextureUpdateDescInternal updateDesc = { pStreamingTexture->pPendingTexture, pStreamingTexture->pImage, false, mip };
+	queueResourceUpdate(pLoader, &updateDesc, &pStreamingTexture->mPendingToken);
+}
+
+static void completeStreamingTextureRequest(ResourceLoader* pLoader, StreamingTexture* pStreamingTexture, uint32_t latency)
+{
+	StreamingResidency* pResidency = &pStreamingTexture->mResidency;
+	pLoader->mStreamingResidentSize -= getStreamingResidencySize(pResidency, pResidency->mResidentMip);
+	pLoader->mStreamingResidentSize += getStreamingResidencySize(pResidency, pResidency->mPendingMip);
+	completeStreamingResidencyRequest(pResidency);
+
+	retireTexture(pLoader, pStreamingTexture->pTexture, latency);
+	pStreamingTexture->pTexture = pStreamingTexture->pPendingTexture;
+	pStreamingTexture->pPendingTexture = NULL;
+	if (pStreamingTexture->ppTexture)
+		*pStreamingTexture->ppTexture = pStreamingTexture->pTexture;
+}
+
+void addStreamingTexture(TextureLoadDesc* pTextureDesc, StreamingTexture** ppStreamingTexture)
+{
+	ASSERT(pTextureDesc->ppTexture);
+	ASSERT(ppStreamingTexture);
+
+	Image* pImage = loadTextureImage(pTextureDesc);
+	if (!pImage)
+	{
+		*ppStreamingTexture = NULL;
+		return;
+	}
+
+	StreamingTexture* pStreamingTexture = conf_new<StreamingTexture>();
+	pStreamingTexture->pImage = pImage;
+	pStreamingTexture->ppTexture = pTextureDesc->ppTexture;
+	pStreamingTexture->mLoadDesc = *pTextureDesc;
+	// Source data is owned by the image now
+	pStreamingTexture->mLoadDesc.pFilename = NULL;
+	pStreamingTexture->mLoadDesc.pRawImageData = NULL;
+	pStreamingTexture->mLoadDesc.pBinaryImageData = NULL;
+
+	const uint32_t mipCount = min(pImage->GetMipMapCount(), (uint32_t)MAX_STREAMING_MIPS);
+	uint64_t       mipSizes[MAX_STREAMING_MIPS];
+	for (uint32_t mip = 0; mip < mipCount; ++mip)
+		mipSizes[mip] = (uint64_t)pImage->GetMipMappedSize(mip, 1) * pImage->GetArrayCount();
+	StreamingResidency* pResidency = &pStreamingTexture->mResidency;
+	initStreamingResidency(pResidency, pImage->GetWidth(), pImage->GetHeight(), pImage->GetMipMapCount(), mipSizes);
+	pResidency->pUserData = pStreamingTexture;
+
+	// Upload the mip tail right away so the texture is usable as soon as this upload completes
+	requestStreamingTextureMip(pResourceLoader, pStreamingTexture, pResidency->mTailMip);
+	waitTokenCompleted(pResourceLoader, pStreamingTexture->mPendingToken);
+	pStreamingTexture->pTexture = pStreamingTexture->pPendingTexture;
+	pStreamingTexture->pPendingTexture = NULL;
+	*pTextureDesc->ppTexture = pStreamingTexture->pTexture;
+
+	pResourceLoader->mStreamingTextures.push_back(pStreamingTexture);
+	*ppStreamingTexture = pStreamingTexture;
+}
+
+void removeStreamingTexture(StreamingTexture* pStreamingTexture)
+{
+	ResourceLoader* pLoader = pResourceLoader;
+	pLoader->mStreamingTextures.erase(eastl::find(pLoader->mStreamingTextures.begin(), pLoader->mStreamingTextures.end(), pStreamingTexture));
+
+	// The pending texture was never handed out, no frame can be using it
+	if (pStreamingTexture->pPendingTexture)
+	{
+		waitTokenCompleted(pLoader, pStreamingTexture->mPendingToken);
+		removeTexture(pLoader->pRenderer, pStreamingTexture->pPendingTexture);
+	}
+
+	// Frames in flight may still sample the visible one, it goes away with the textures replaced by stream in / evict
+	const StreamingResidency* pResidency = &pStreamingTexture->mResidency;
+	pLoader->mStreamingResidentSize -= getStreamingResidencySize(pResidency, pResidency->mResidentMip);
+	retireTexture(pLoader, pStreamingTexture->pTexture, pLoader->mStreamingRetireLatency);
+	if (pStreamingTexture->ppTexture)
+		*pStreamingTexture->ppTexture = NULL;
+
+	pStreamingTexture->pImage->Destroy();
+	conf_delete(pStreamingTexture->pImage);
+	conf_delete(pStreamingTexture);
+}
+
+void setStreamingTexturePriority(StreamingTexture* pStreamingTexture, float screenSize)
+{
+	pStreamingTexture->mResidency.mScreenSize = screenSize;
+}
+
+float calculateStreamingScreenSize(const ICameraController* pCamera, const vec3& center, float radius, float projectionScale)
+{
+	const float distance = length(center - pCamera->getViewPosition()) - radius;
+	// Camera inside the bounds: texture needs full resolution
+	if (distance <= 0.0f)
+		return FLT_MAX;
+
+	return 2.0f * radius * projectionScale / distance;
+}
+
+void updateTextureStreaming(const TextureStreamingDesc* pDesc)
+{
+	ResourceLoader* pLoader = pResourceLoader;
+	const uint32_t  latency = pDesc->mRetireLatency ? pDesc->mRetireLatency : (uint32_t)DEFAULT_STREAMING_RETIRE_LATENCY;
+	pLoader->mStreamingRetireLatency = latency;
+	++pLoader->mStreamingFrame;
+
+	// Remove textures which are no longer referenced by any frame in flight
+	for (uint32_t i = 0; i < (uint32_t)pLoader->mRetiredTextures.size();)
+	{
+		if (pLoader->mRetiredTextures[i].mRetireFrame <= pLoader->mStreamingFrame)
+		{
+			removeTexture(pLoader->pRenderer, pLoader->mRetiredTextures[i].pTexture);
+			pLoader->mRetiredTextures[i] = pLoader->mRetiredTextures.back();
+			pLoader->mRetiredTextures.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	// Swap in textures whose upload finished
+	for (StreamingTexture* pStreamingTexture : pLoader->mStreamingTextures)
+	{
+		if (pStreamingTexture->pPendingTexture && isTokenCompleted(pLoader, pStreamingTexture->mPendingToken))
+			completeStreamingTextureRequest(pLoader, pStreamingTexture, latency);
+	}
+
+	const uint32_t count = (uint32_t)pLoader->mStreamingTextures.size();
+	pLoader->mStreamingOrder.resize(count);
+	pLoader->mStreamingRequests.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+		pLoader->mStreamingOrder[i] = &pLoader->mStreamingTextures[i]->mResidency;
+
+	const uint32_t requestCount =
+		updateStreamingResidency(pDesc, pLoader->mStreamingOrder.data(), count, pLoader->mStreamingRequests.data());
+	for (uint32_t i = 0; i < requestCount; ++i)
+	{
+		StreamingResidency* pResidency = pLoader->mStreamingRequests[i];
+		requestStreamingTextureMip(pLoader, (StreamingTexture*)pResidency->pUserData, pResidency->mPendingMip);
+	}
+}
+
+StreamingTextureState getStreamingTextureState(const StreamingTexture* pStreamingTexture)
+{
+	return pStreamingTexture->mResidency.mState;
+}
+
+uint32_t getStreamingTextureResidentMip(const StreamingTexture* pStreamingTexture)
+{
+	return pStreamingTexture->mResidency.mResidentMip;
+}
+
+uint64_t getTextureStreamingResidentSize()
+{
+	return pResourceLoader->mStreamingResidentSize;
+}
+
 /************************************************************************/
 // Shader loading
 /************************************************************************/
@@ -33,6 +33,7 @@
 #include "../OS/Core/Atomics.h"
 #include "../OS/Image/ImageEnums.h"
 #include "../OS/Interfaces/IFileSystem.h"
+#include "TextureStreaming.h"
 
 typedef struct BufferLoadDesc
 {
@@ -139,6 +140,11 @@ typedef struct ShaderLoadDesc
 
 typedef tfrg_atomic64_t SyncToken;
 
+class ICameraController;
+
+/// Texture whose mip chain is streamed in by priority instead of being fully resident after load
+typedef struct StreamingTexture StreamingTexture;
+
 typedef struct ResourceLoaderDesc
 {
 	uint64_t mBufferSize;
@@ -170,6 +176,24 @@ void waitTokenCompleted(SyncToken token);
 void removeResource(Buffer* pBuffer);
 void removeResource(Texture* pTexture);
 
+/// Loads the image described by pTextureDesc but only uploads its mip tail. Higher mips are streamed in by updateTextureStreaming.
+/// *pTextureDesc->ppTexture always points to the currently resident texture and changes when mips are streamed in or evicted.
+void addStreamingTexture(TextureLoadDesc* pTextureDesc, StreamingTexture** ppStreamingTexture);
+/// The texture is only removed after the retire latency of the last updateTextureStreaming, frames in flight may still use it.
+void removeStreamingTexture(StreamingTexture* pStreamingTexture);
+/// Priority is the size in pixels the texture covers on screen along its largest axis. 0 requests the mip tail only.
+void setStreamingTexturePriority(StreamingTexture* pStreamingTexture, float screenSize);
+/// Helper to compute the streaming priority of an object with the given bounding sphere seen from pCamera.
+/// projectionScale is the screen height divided by 2 * tan(fovY / 2).
+float calculateStreamingScreenSize(const ICameraController* pCamera, const vec3& center, float radius, float projectionScale);
+/// Resolves residency targets for all streaming textures and issues stream in / evict requests. Call once per frame.
+void updateTextureStreaming(const TextureStreamingDesc* pDesc);
+StreamingTextureState getStreamingTextureState(const StreamingTexture* pStreamingTexture);
+/// Most detailed mip of the source image that is currently resident
+uint32_t getStreamingTextureResidentMip(const StreamingTexture* pStreamingTexture);
+/// Bytes of mips above the mip tails that are currently resident across all streaming textures
+uint64_t getTextureStreamingResidentSize();
+
 /// Either loads the cached shader bytecode or compiles the shader to create new bytecode depending on whether source is newer than binary
 void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShader);
 
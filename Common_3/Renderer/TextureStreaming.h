@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Residency bookkeeping of streaming textures: which mips should be resident under the memory budget, which stream in /
+// evict requests to issue and the state each texture is in. It does not touch the GPU, the resource loader turns the
+// requests into texture uploads and completes them once the uploads are done, so the transitions can be driven headless.
+//
+// Usage:
+//   initStreamingResidency(&residency, width, height, mipCount, pMipSizes);
+//   residency.mScreenSize = screenSize;
+//   const uint32_t requestCount = updateStreamingResidency(&desc, ppResidencies, count, ppRequests);
+//   // Upload mips [ppRequests[i]->mPendingMip, mipCount) of every request, then once the upload is done:
+//   completeStreamingResidencyRequest(ppRequests[i]);
+
+#pragma once
+
+#include "../OS/Interfaces/IOperatingSystem.h"
+#include "../OS/Interfaces/ILogManager.h"
+#include "../ThirdParty/OpenSource/EASTL/sort.h"
+
+#include <math.h>
+
+typedef enum StreamingTextureState
+{
+	/// Only the mip tail is resident
+	STREAMING_TEXTURE_STATE_MIP_TAIL = 0,
+	/// Higher mips are being uploaded
+	STREAMING_TEXTURE_STATE_STREAMING_IN,
+	/// Mips above the mip tail are resident
+	STREAMING_TEXTURE_STATE_RESIDENT,
+	/// High mips are being dropped to get back under the memory budget
+	STREAMING_TEXTURE_STATE_EVICTING,
+} StreamingTextureState;
+
+typedef struct TextureStreamingDesc
+{
+	/// Memory budget in bytes for all mips above the mip tail. Mip tails are always resident.
+	uint64_t mMemoryBudget;
+	/// Max number of stream in / evict requests issued per update (0 = unlimited)
+	uint32_t mMaxRequestsPerUpdate;
+	/// Number of updates a replaced texture stays alive before it is removed (should cover frames in flight)
+	uint32_t mRetireLatency;
+} TextureStreamingDesc;
+
+enum
+{
+	/// Mips whose largest dimension is at or below this size form the mip tail which is always resident
+	STREAMING_MIP_TAIL_SIZE = 64,
+	/// Mips above the mip tail that are tracked, enough for 32768 texels
+	MAX_STREAMING_MIPS = 16,
+};
+
+typedef struct StreamingResidency
+{
+	/// Bytes of mips [mip, mTailMip) for every mip above the mip tail
+	uint64_t              mStreamedSizes[MAX_STREAMING_MIPS];
+	/// Largest dimension of the most detailed mip
+	uint32_t              mSize;
+	uint32_t              mMipCount;
+	StreamingTextureState mState;
+	/// Most detailed resident mip
+	uint32_t              mResidentMip;
+	/// Most detailed mip of the in-flight request
+	uint32_t              mPendingMip;
+	/// Most detailed mip of the mip tail
+	uint32_t              mTailMip;
+	/// Mip selected by the last budget pass
+	uint32_t              mTargetMip;
+	/// Size in pixels the texture covers on screen along its largest axis. 0 requests the mip tail only
+	float                 mScreenSize;
+	bool                  mPending;
+	void*                 pUserData;
+} StreamingResidency;
+
+/// Only the mip tail starts out resident. pMipSizes holds the bytes of each of the mipCount mips
+static inline void
+	initStreamingResidency(StreamingResidency* pResidency, uint32_t width, uint32_t height, uint32_t mipCount, const uint64_t* pMipSizes)
+{
+	*pResidency = {};
+	pResidency->mSize = width > height ? width : height;
+	pResidency->mMipCount = mipCount;
+
+	uint32_t tailMip = 0;
+	while (tailMip + 1 < mipCount && (pResidency->mSize >> tailMip) > (uint32_t)STREAMING_MIP_TAIL_SIZE)
+		++tailMip;
+	ASSERT(tailMip <= MAX_STREAMING_MIPS);
+	pResidency->mTailMip = tailMip;
+
+	uint64_t size = 0;
+	for (uint32_t mip = tailMip; mip-- > 0;)
+	{
+		size += pMipSizes[mip];
+		pResidency->mStreamedSizes[mip] = size;
+	}
+
+	pResidency->mState = STREAMING_TEXTURE_STATE_MIP_TAIL;
+	pResidency->mResidentMip = tailMip;
+	pResidency->mPendingMip = tailMip;
+	pResidency->mTargetMip = tailMip;
+}
+
+/// Bytes of the mips above the mip tail that are resident when mip is the most detailed one
+static inline uint64_t getStreamingResidencySize(const StreamingResidency* pResidency, uint32_t mip)
+{
+	return mip < pResidency->mTailMip ? pResidency->mStreamedSizes[mip] : 0;
+}
+
+/// Mips of the texture that are resident, mip tail included
+static inline uint32_t getStreamingResidencyMipCount(const StreamingResidency* pResidency)
+{
+	return pResidency->mMipCount - pResidency->mResidentMip;
+}
+
+static inline uint32_t getStreamingResidencyDesiredMip(const StreamingResidency* pResidency)
+{
+	if (pResidency->mScreenSize <= 0.0f)
+		return pResidency->mTailMip;
+
+	// Pick the first mip whose texel count does not exceed the pixels it covers on screen
+	const float    ratio = floorf(log2f((float)pResidency->mSize / pResidency->mScreenSize));
+	const uint32_t mip = ratio > 0.0f ? (uint32_t)ratio : 0;
+	return mip < pResidency->mTailMip ? mip : pResidency->mTailMip;
+}
+
+static inline void beginStreamingResidencyRequest(StreamingResidency* pResidency, uint32_t mip)
+{
+	ASSERT(!pResidency->mPending);
+	pResidency->mState = mip < pResidency->mResidentMip ? STREAMING_TEXTURE_STATE_STREAMING_IN : STREAMING_TEXTURE_STATE_EVICTING;
+	pResidency->mPendingMip = mip;
+	pResidency->mPending = true;
+}
+
+/// Makes the mips of the in-flight request the resident ones
+static inline void completeStreamingResidencyRequest(StreamingResidency* pResidency)
+{
+	ASSERT(pResidency->mPending);
+	pResidency->mResidentMip = pResidency->mPendingMip;
+	pResidency->mPending = false;
+	pResidency->mState =
+		pResidency->mResidentMip == pResidency->mTailMip ? STREAMING_TEXTURE_STATE_MIP_TAIL : STREAMING_TEXTURE_STATE_RESIDENT;
+}
+
+/// Hands out the budget in priority order and begins the stream in / evict requests that move textures towards their
+/// target mip. Textures with a request in flight are left alone. ppResidencies is sorted by priority, ppRequests receives
+/// the requests that were begun, evictions first, and needs room for count of them. Returns the number of requests
+static inline uint32_t updateStreamingResidency(
+	const TextureStreamingDesc* pDesc, StreamingResidency** ppResidencies, uint32_t count, StreamingResidency** ppRequests)
+{
+	eastl::sort(ppResidencies, ppResidencies + count, [](const StreamingResidency* a, const StreamingResidency* b) {
+		return a->mScreenSize > b->mScreenSize;
+	});
+
+	// Textures that do not fit get coarser mips
+	uint64_t budgetUsed = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		StreamingResidency* pResidency = ppResidencies[i];
+		uint32_t            mip = getStreamingResidencyDesiredMip(pResidency);
+		while (mip < pResidency->mTailMip && budgetUsed + getStreamingResidencySize(pResidency, mip) > pDesc->mMemoryBudget)
+			++mip;
+		pResidency->mTargetMip = mip;
+		budgetUsed += getStreamingResidencySize(pResidency, mip);
+	}
+
+	// Evictions first so memory is released before new mips are requested
+	uint32_t       requestCount = 0;
+	const uint32_t maxRequests = pDesc->mMaxRequestsPerUpdate ? pDesc->mMaxRequestsPerUpdate : UINT32_MAX;
+	for (uint32_t pass = 0; pass < 2; ++pass)
+	{
+		const bool evict = pass == 0;
+		// Lowest priority textures are evicted first, highest priority textures stream in first
+		for (uint32_t i = 0; i < count && requestCount < maxRequests; ++i)
+		{
+			StreamingResidency* pResidency = evict ? ppResidencies[count - 1 - i] : ppResidencies[i];
+			if (pResidency->mPending || pResidency->mTargetMip == pResidency->mResidentMip)
+				continue;
+			if (evict != (pResidency->mTargetMip > pResidency->mResidentMip))
+				continue;
+
+			beginStreamingResidencyRequest(pResidency, pResidency->mTargetMip);
+			ppRequests[requestCount++] = pResidency;
+		}
+	}
+
+	return requestCount;
+}
@@ -35,6 +35,10 @@ extern "C" {
 enum FONSflags {
 	FONS_ZERO_TOPLEFT = 1,
 	FONS_ZERO_BOTTOMLEFT = 2,
+	// Glyphs are stored as signed distance fields, made once at FONS_SDF_SIZE and scaled to the size they are drawn at.
+	// The atlas holds 128 on the outline of a glyph, more inside, and changes by 128 / FONS_SDF_PADDING per pixel of
+	// FONS_SDF_SIZE. Blur is ignored.
+	FONS_SDF = 4,
 };
 
 enum FONSalign {
@@ -320,6 +324,7 @@ static int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int gl
 	return stbtt_GetGlyphKernAdvance(&font->font, glyph1, glyph2);
 }
 
+
 #endif
 
 #ifndef FONS_SCRATCH_BUF_SIZE
@@ -343,6 +348,15 @@ static int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int gl
 #ifndef FONS_MAX_STATES
 #	define FONS_MAX_STATES 20
 #endif
+#ifndef FONS_SDF_SIZE
+#	define FONS_SDF_SIZE 32
+#endif
+#ifndef FONS_SDF_PADDING
+#	define FONS_SDF_PADDING 4
+#endif
+#ifndef FONS_SDF_OVERSAMPLING
+#	define FONS_SDF_OVERSAMPLING 4
+#endif
 #ifndef FONS_MAX_FALLBACKS
 #	define FONS_MAX_FALLBACKS 20
 #endif
@@ -1093,6 +1107,115 @@ static void fons__blur(FONScontext* stash, unsigned char* dst, int w, int h, int
 //	fons__blurcols(dst, w, h, dstStride, alpha);
 }
 
+// Squared distance of every sample of f to the nearest sample that is 0, given the squared distances so far in f.
+// From "Distance Transforms of Sampled Functions" by Felzenszwalb and Huttenlocher. v and z hold n and n+1 values.
+static void fons__distanceTransform1D(const float* f, float* d, int* v, float* z, int n)
+{
+	int k = 0, q;
+	float s;
+	v[0] = 0;
+	z[0] = -1e20f;
+	z[1] = 1e20f;
+	for (q = 1; q < n; q++) {
+		s = ((f[q] + (float)(q*q)) - (f[v[k]] + (float)(v[k]*v[k]))) / (float)(2*q - 2*v[k]);
+		while (s <= z[k]) {
+			k--;
+			s = ((f[q] + (float)(q*q)) - (f[v[k]] + (float)(v[k]*v[k]))) / (float)(2*q - 2*v[k]);
+		}
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k+1] = 1e20f;
+	}
+	k = 0;
+	for (q = 0; q < n; q++) {
+		while (z[k+1] < (float)q)
+			k++;
+		d[q] = (float)((q - v[k])*(q - v[k])) + f[v[k]];
+	}
+}
+
+// Squared distance of every pixel to the nearest pixel that is inside the glyph, or outside of it
+static void fons__distanceTransform(const unsigned char* coverage, float* dist, int w, int h, int inside,
+									float* f, float* d, int* v, float* z)
+{
+	int x, y;
+	for (x = 0; x < w; x++) {
+		for (y = 0; y < h; y++)
+			f[y] = ((coverage[y*w + x] >= 128) == inside) ? 0.0f : 1e20f;
+		fons__distanceTransform1D(f, d, v, z, h);
+		for (y = 0; y < h; y++)
+			dist[y*w + x] = d[y];
+	}
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++)
+			f[x] = dist[y*w + x];
+		fons__distanceTransform1D(f, d, v, z, w);
+		for (x = 0; x < w; x++)
+			dist[y*w + x] = d[x];
+	}
+}
+
+// Makes the signed distance field of a glyph, outWidth x outHeight pixels from (outX, outY) of the glyph at size.
+// The glyph is rasterized FONS_SDF_OVERSAMPLING times larger and the distances of the pixels averaged, which works for
+// any outline the rasterizer does, cubic curves of CFF fonts included.
+static void fons__renderGlyphSDF(FONSfont* font, unsigned char* output, int outWidth, int outHeight, int outStride,
+								 float size, float scale, int outX, int outY, int glyph)
+{
+	const int os = FONS_SDF_OVERSAMPLING;
+	int w = outWidth * os, h = outHeight * os, n = w > h ? w : h;
+	int advance, lsb, x0, y0, x1, y1, x, y, i, j;
+	unsigned char* coverage;
+	float *distIn, *distOut, *f, *d, *z;
+	int* v;
+
+	// Rasterize at the larger size, placed where the glyph is in the field
+	fons__tt_buildGlyphBitmap(&font->font, glyph, size * os, scale * os, &advance, &lsb, &x0, &y0, &x1, &y1);
+	x0 -= outX * os;
+	y0 -= outY * os;
+	x1 -= outX * os;
+	y1 -= outY * os;
+
+	coverage = (unsigned char*)calloc((size_t)(w * h), 1);
+	distIn = (float*)malloc(sizeof(float) * (size_t)(w * h));
+	distOut = (float*)malloc(sizeof(float) * (size_t)(w * h));
+	f = (float*)malloc(sizeof(float) * (size_t)(n * 3 + 1));
+	v = (int*)malloc(sizeof(int) * (size_t)n);
+	if (coverage == NULL || distIn == NULL || distOut == NULL || f == NULL || v == NULL)
+		goto error;
+	d = f + n;
+	z = d + n;
+
+	if (x0 >= 0 && y0 >= 0 && x1 <= w && y1 <= h && x1 > x0 && y1 > y0)
+		fons__tt_renderGlyphBitmap(&font->font, &coverage[y0*w + x0], x1-x0, y1-y0, w, scale * os, scale * os, glyph);
+
+	fons__distanceTransform(coverage, distOut, w, h, 1, f, d, v, z);
+	fons__distanceTransform(coverage, distIn, w, h, 0, f, d, v, z);
+
+	// The outline is half a pixel from the centers of the pixels on either side of it
+	for (y = 0; y < outHeight; y++) {
+		for (x = 0; x < outWidth; x++) {
+			float distance = 0.0f, value;
+			for (j = 0; j < os; j++) {
+				for (i = 0; i < os; i++) {
+					int p = (y*os + j)*w + x*os + i;
+					distance += coverage[p] >= 128 ? 0.5f - sqrtf(distIn[p]) : sqrtf(distOut[p]) - 0.5f;
+				}
+			}
+			distance /= (float)(os * os * os);
+			value = 128.0f - distance * 128.0f / (float)FONS_SDF_PADDING;
+			output[y*outStride + x] = (unsigned char)(value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value + 0.5f));
+		}
+	}
+
+error:
+	free(coverage);
+	free(distIn);
+	free(distOut);
+	free(f);
+	free(v);
+}
+
 static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned int codepoint,
 								 short isize, short iblur)
 {
@@ -1106,9 +1229,18 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 	unsigned char* dst;
 	FONSfont* renderFont = font;
 
+	// Signed distance fields are scaled to any size, there is one per glyph
+	if (stash->params.flags & FONS_SDF) {
+		isize = FONS_SDF_SIZE*10;
+		iblur = 0;
+		size = (float)FONS_SDF_SIZE;
+	}
+
 	if (isize < 2) return NULL;
 	if (iblur > 20) iblur = 20;
 	pad = iblur+2;
+	if (stash->params.flags & FONS_SDF)
+		pad = FONS_SDF_PADDING+1;
 
 	// Reset allocator.
 	stash->nscratch = 0;
@@ -1172,8 +1304,14 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 	font->lut[h] = font->nglyphs-1;
 
 	// Rasterize
-	dst = &stash->texData[(glyph->x0+pad) + (glyph->y0+pad) * stash->params.width];
-	fons__tt_renderGlyphBitmap(&renderFont->font, dst, gw-pad*2,gh-pad*2, stash->params.width, scale,scale, g);
+	if (stash->params.flags & FONS_SDF) {
+		// The field fills the padding but for the empty border
+		dst = &stash->texData[(glyph->x0+1) + (glyph->y0+1) * stash->params.width];
+		fons__renderGlyphSDF(renderFont, dst, gw-2, gh-2, stash->params.width, size, scale, x0-FONS_SDF_PADDING, y0-FONS_SDF_PADDING, g);
+	} else {
+		dst = &stash->texData[(glyph->x0+pad) + (glyph->y0+pad) * stash->params.width];
+		fons__tt_renderGlyphBitmap(&renderFont->font, dst, gw-pad*2,gh-pad*2, stash->params.width, scale,scale, g);
+	}
 
 	// Make sure there is one pixel empty border.
 	dst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
@@ -1213,9 +1351,11 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 
 static void fons__getQuad(FONScontext* stash, FONSfont* font,
 						   int prevGlyphIndex, FONSglyph* glyph,
-						   float scale, float spacing, float* x, float* y, FONSquad* q)
+						   float scale, float spacing, short isize, float* x, float* y, FONSquad* q)
 {
 	float rx,ry,xoff,yoff,x0,y0,x1,y1;
+	// Signed distance fields are drawn scaled to the size, bitmaps at the size they were rasterized at
+	float glyphScale = (stash->params.flags & FONS_SDF) ? (float)isize / (float)(FONS_SDF_SIZE*10) : 1.0f;
 
 	if (prevGlyphIndex != -1) {
 		float adv = fons__tt_getGlyphKernAdvance(&font->font, prevGlyphIndex, glyph->index) * scale;
@@ -1225,8 +1365,8 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 	// Each glyph has 2px border to allow good interpolation,
 	// one pixel to prevent leaking, and one to allow good interpolation for rendering.
 	// Inset the texture region by one pixel for correct interpolation.
-	xoff = (short)(glyph->xoff+1);
-	yoff = (short)(glyph->yoff+1);
+	xoff = (short)(glyph->xoff+1) * glyphScale;
+	yoff = (short)(glyph->yoff+1) * glyphScale;
 	x0 = (float)(glyph->x0+1);
 	y0 = (float)(glyph->y0+1);
 	x1 = (float)(glyph->x1-1);
@@ -1238,8 +1378,8 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 
 		q->x0 = rx;
 		q->y0 = ry;
-		q->x1 = rx + x1 - x0;
-		q->y1 = ry + y1 - y0;
+		q->x1 = rx + (x1 - x0) * glyphScale;
+		q->y1 = ry + (y1 - y0) * glyphScale;
 
 		q->s0 = x0 * stash->itw;
 		q->t0 = y0 * stash->ith;
@@ -1251,8 +1391,8 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 
 		q->x0 = rx;
 		q->y0 = ry;
-		q->x1 = rx + x1 - x0;
-		q->y1 = ry - y1 + y0;
+		q->x1 = rx + (x1 - x0) * glyphScale;
+		q->y1 = ry - (y1 - y0) * glyphScale;
 
 		q->s0 = x0 * stash->itw;
 		q->t0 = y0 * stash->ith;
@@ -1260,7 +1400,7 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 		q->t1 = y1 * stash->ith;
 	}
 
-	*x += (int)(glyph->xadv / 10.0f + 0.5f);
+	*x += (int)(glyph->xadv / 10.0f * glyphScale + 0.5f);
 }
 
 static void fons__flush(FONScontext* stash)
@@ -1364,7 +1504,7 @@ FONS_DEF float fonsDrawText(FONScontext* stash,
 			continue;
 		glyph = fons__getGlyph(stash, font, codepoint, isize, iblur);
 		if (glyph != NULL) {
-			fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q);
+			fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, isize, &x, &y, &q);
 
 			if (stash->nverts+6 > FONS_VERTEX_COUNT)
 				fons__flush(stash);
@@ -1447,7 +1587,7 @@ FONS_DEF int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, FONSquad*
 		iter->y = iter->nexty;
 		glyph = fons__getGlyph(stash, iter->font, iter->codepoint, iter->isize, iter->iblur);
 		if (glyph != NULL)
-			fons__getQuad(stash, iter->font, iter->prevGlyphIndex, glyph, iter->scale, iter->spacing, &iter->nextx, &iter->nexty, quad);
+			fons__getQuad(stash, iter->font, iter->prevGlyphIndex, glyph, iter->scale, iter->spacing, iter->isize, &iter->nextx, &iter->nexty, quad);
 		iter->prevGlyphIndex = glyph != NULL ? glyph->index : -1;
 		break;
 	}
@@ -1544,7 +1684,7 @@ FONS_DEF float fonsTextBounds(FONScontext* stash,
 			continue;
 		glyph = fons__getGlyph(stash, font, codepoint, isize, iblur);
 		if (glyph != NULL) {
-			fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q);
+			fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, isize, &x, &y, &q);
 			if (q.x0 < minx) minx = q.x0;
 			if (q.x1 > maxx) maxx = q.x1;
 			if (stash->params.flags & FONS_ZERO_TOPLEFT) {
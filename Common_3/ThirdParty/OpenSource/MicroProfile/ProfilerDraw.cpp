@@ -393,6 +393,8 @@ void ProfileEndDraw(Cmd * pCmd)
 						font_id, Texts[TextCounter].mColor, font_size,
 						font_spacing, font_blur);
 			}
+			// Keep the text on top of the boxes drawn before it and under the ones drawn after it
+			pFontStash->flush(pCmd);
 			continue;
 		case ProfileDrawCommand::BOX:
 			cmdBindPipeline(pCmd, pProfilePipelineBox);
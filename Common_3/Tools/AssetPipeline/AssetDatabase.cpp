@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "AssetDatabase.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "../../OS/Interfaces/ILogManager.h"
+#include "../../OS/Interfaces/IMemoryManager.h"    //NOTE: this should be the last include in a .cpp
+
+static const char* gDatabaseFileName = "AssetPipeline.db";
+static const char* gDatabaseHeader = "AssetPipelineDatabase 1";
+
+void AssetDatabase::Load(const eastl::string& outputDir)
+{
+	mDirectory = FileSystem::AddTrailingSlash(outputDir);
+	mInputs.clear();
+	mOutputs.clear();
+
+	eastl::string path = mDirectory + gDatabaseFileName;
+	if (!FileSystem::FileExists(path, FSR_Absolute))
+		return;
+
+	File file;
+	if (!file.Open(path, FM_Read, FSR_Absolute))
+		return;
+	eastl::string text = file.ReadText();
+	file.Close();
+
+	// One record per line, the path comes last so it can contain spaces:
+	//   input <hash> <size> <modified time> <path>
+	//   output <version> <options hash> <inputs hash> <path>
+	size_t lineStart = text.find('\n');
+	if (lineStart == eastl::string::npos || text.substr(0, lineStart) != gDatabaseHeader)
+	{
+		LOGF(LogLevel::eWARNING, "Ignoring asset database %s of an unknown format.", path.c_str());
+		return;
+	}
+
+	while (++lineStart < text.size())
+	{
+		size_t lineEnd = text.find('\n', lineStart);
+		if (lineEnd == eastl::string::npos)
+			lineEnd = text.size();
+		eastl::string line = text.substr(lineStart, lineEnd - lineStart);
+		lineStart = lineEnd;
+
+		unsigned long long a = 0, b = 0, c = 0;
+		int                pathOffset = 0;
+		if (sscanf(line.c_str(), "input %llx %llu %llu %n", &a, &b, &c, &pathOffset) == 3 && pathOffset > 0)
+			mInputs[line.substr(pathOffset)] = { a, b, c, false };
+		else if (sscanf(line.c_str(), "output %llu %llx %llx %n", &a, &b, &c, &pathOffset) == 3 && pathOffset > 0)
+			mOutputs[line.substr(pathOffset)] = { (uint32_t)a, b, c, false };
+	}
+}
+
+bool AssetDatabase::Save()
+{
+	eastl::string path = mDirectory + gDatabaseFileName;
+
+	File file;
+	if (!file.Open(path, FM_Write, FSR_Absolute))
+		return false;
+
+	file.WriteLine(gDatabaseHeader);
+
+	eastl::string line;
+	for (eastl::unordered_map<eastl::string, InputRecord>::iterator it = mInputs.begin(); it != mInputs.end(); ++it)
+	{
+		// Drop the inputs of assets that were removed
+		if (!it->second.mUsed)
+			continue;
+
+		line.sprintf(
+			"input %llx %llu %llu %s", (unsigned long long)it->second.mHash, (unsigned long long)it->second.mSize,
+			(unsigned long long)it->second.mModifiedTime, it->first.c_str());
+		file.WriteLine(line);
+	}
+
+	for (eastl::unordered_map<eastl::string, OutputRecord>::iterator it = mOutputs.begin(); it != mOutputs.end(); ++it)
+	{
+		line.sprintf(
+			"output %u %llx %llx %s", it->second.mVersion, (unsigned long long)it->second.mOptionsHash,
+			(unsigned long long)it->second.mInputsHash, it->first.c_str());
+		file.WriteLine(line);
+	}
+
+	file.Close();
+	return true;
+}
+
+uint64_t AssetDatabase::GetInputHash(const eastl::string& input)
+{
+	File file;
+	if (!file.Open(input, FM_ReadBinary, FSR_Absolute))
+		return 0;
+
+	const uint64_t size = file.GetSize();
+	const uint64_t modifiedTime = (uint64_t)FileSystem::GetLastModifiedTime(input);
+
+	// A file with the same size and time as last run is assumed unchanged
+	eastl::unordered_map<eastl::string, InputRecord>::iterator it = mInputs.find(input);
+	if (it != mInputs.end() && it->second.mSize == size && it->second.mModifiedTime == modifiedTime)
+	{
+		it->second.mUsed = true;
+		file.Close();
+		return it->second.mHash;
+	}
+
+	uint64_t hash = Hash(NULL, 0);
+	uint8_t  block[64 * 1024];
+	while (!file.IsEof())
+	{
+		unsigned readBytes = file.Read(block, sizeof(block));
+		if (readBytes == 0)
+			break;
+		hash = Hash(block, readBytes, hash);
+	}
+	file.Close();
+
+	// The time only has a resolution of seconds. A file modified in the second it is hashed can still change
+	// without its time changing, so it is hashed again next run
+	const uint64_t recordedTime = modifiedTime >= (uint64_t)time(NULL) ? 0 : modifiedTime;
+	mInputs[input] = { hash, size, recordedTime, true };
+	return hash;
+}
+
+const char* AssetDatabase::CheckOutput(const eastl::string& output, uint64_t optionsHash, uint64_t inputsHash)
+{
+	eastl::unordered_map<eastl::string, OutputRecord>::iterator it = mOutputs.find(output);
+	if (it == mOutputs.end())
+		return "new";
+
+	it->second.mChecked = true;
+
+	if (it->second.mVersion != ASSET_PIPELINE_VERSION)
+		return "pipeline version changed";
+	if (it->second.mInputsHash != inputsHash)
+		return "source changed";
+	if (it->second.mOptionsHash != optionsHash)
+		return "options changed";
+	if (!FileSystem::FileExists(mDirectory + output, FSR_Absolute))
+		return "output missing";
+
+	return NULL;
+}
+
+void AssetDatabase::SetOutput(const eastl::string& output, uint64_t optionsHash, uint64_t inputsHash)
+{
+	mOutputs[output] = { ASSET_PIPELINE_VERSION, optionsHash, inputsHash, true };
+}
+
+void AssetDatabase::RemoveOutput(const eastl::string& output)
+{
+	mOutputs.erase(output);
+}
+
+uint32_t AssetDatabase::RemoveOrphans(const char* extension, bool quiet)
+{
+	const size_t extensionLength = strlen(extension);
+	uint32_t     numRemoved = 0;
+	for (eastl::unordered_map<eastl::string, OutputRecord>::iterator it = mOutputs.begin(); it != mOutputs.end();)
+	{
+		const eastl::string& output = it->first;
+		const bool           hasExtension =
+			output.size() >= extensionLength && output.compare(output.size() - extensionLength, extensionLength, extension) == 0;
+		if (it->second.mChecked || !hasExtension)
+		{
+			++it;
+			continue;
+		}
+
+		eastl::string path = mDirectory + it->first;
+		if (FileSystem::FileExists(path, FSR_Absolute) && !FileSystem::Delete(path))
+		{
+			LOGF(LogLevel::eWARNING, "Failed to remove orphaned output %s.", path.c_str());
+			++it;
+			continue;
+		}
+
+		if (!quiet)
+			LOGF(LogLevel::eINFO, "%s: removed, source no longer exists.", it->first.c_str());
+
+		it = mOutputs.erase(it);
+		++numRemoved;
+	}
+
+	return numRemoved;
+}
+
+uint64_t AssetDatabase::Hash(const void* pData, size_t size, uint64_t hash)
+{
+	const uint8_t* pBytes = (const uint8_t*)pData;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= pBytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+#include "../../OS/Interfaces/IFileSystem.h"
+
+#include "../../ThirdParty/OpenSource/EASTL/string.h"
+#include "../../ThirdParty/OpenSource/EASTL/unordered_map.h"
+
+// Bump when the pipeline produces different output for the same input, so every asset is rebuilt
+const uint32_t ASSET_PIPELINE_VERSION = 2;
+
+// Records what every output in a directory was built from: the content hash of its inputs, the options
+// and the pipeline version. An output is rebuilt when any of those changed, not when a file was touched.
+// Input hashes are cached together with the size and modification time of the file, so files that were
+// not touched since the last run are not read again.
+class AssetDatabase
+{
+	public:
+	// Loads the database stored in outputDir, if any
+	void Load(const eastl::string& outputDir);
+
+	// Writes the database to outputDir
+	bool Save();
+
+	// Content hash of a file. Returns 0 if the file can not be read
+	uint64_t GetInputHash(const eastl::string& input);
+
+	// Returns NULL if the output, relative to the output directory, is up-to-date, or why it has to be built
+	const char* CheckOutput(const eastl::string& output, uint64_t optionsHash, uint64_t inputsHash);
+
+	// Records a successfully built output
+	void SetOutput(const eastl::string& output, uint64_t optionsHash, uint64_t inputsHash);
+
+	// Forgets an output so the next run builds it again
+	void RemoveOutput(const eastl::string& output);
+
+	// Deletes the recorded outputs with extension that were not checked this run, as their inputs are gone.
+	// Outputs of other kinds are left alone, so several commands can share an output directory. Returns the number removed
+	uint32_t RemoveOrphans(const char* extension, bool quiet);
+
+	// 64 bit FNV-1a
+	static uint64_t Hash(const void* pData, size_t size, uint64_t hash = 0xcbf29ce484222325ull);
+
+	private:
+	struct InputRecord
+	{
+		uint64_t mHash;
+		uint64_t mSize;
+		uint64_t mModifiedTime;
+		bool     mUsed;
+	};
+
+	struct OutputRecord
+	{
+		uint32_t mVersion;
+		uint64_t mOptionsHash;
+		uint64_t mInputsHash;
+		bool     mChecked;
+	};
+
+	eastl::string                                       mDirectory;
+	eastl::unordered_map<eastl::string, InputRecord>  mInputs;
+	eastl::unordered_map<eastl::string, OutputRecord> mOutputs;
+};
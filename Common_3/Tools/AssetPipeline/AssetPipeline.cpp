@@ -24,11 +24,15 @@
 
 #include "AssetPipeline.h"
 #include "AssetLoader.h"
+#include "AssetDatabase.h"
+#include "MeshOptimizer.h"
+#include "BinaryMesh.h"
 
 // Tiny stl
 #include "../../ThirdParty/OpenSource/EASTL/string.h"
 #include "../../ThirdParty/OpenSource/EASTL/vector.h"
 #include "../../ThirdParty/OpenSource/EASTL/unordered_map.h"
+#include "../../ThirdParty/OpenSource/EASTL/deque.h"
 
 // Assimp
 #include "../../ThirdParty/OpenSource/assimp/4.1.0/include/assimp/Importer.hpp"
@@ -47,10 +51,13 @@
 #include "../../ThirdParty/OpenSource/ozz-animation/include/ozz/animation/offline/raw_animation.h"
 #include "../../ThirdParty/OpenSource/ozz-animation/include/ozz/animation/offline/skeleton_builder.h"
 #include "../../ThirdParty/OpenSource/ozz-animation/include/ozz/animation/offline/animation_builder.h"
+#include "../../ThirdParty/OpenSource/ozz-animation/include/ozz/animation/offline/animation_optimizer.h"
 
 #include "../../OS/Interfaces/IOperatingSystem.h"
 #include "../../OS/Interfaces/IFileSystem.h"
 #include "../../OS/Interfaces/ILogManager.h"
+#include "../../OS/Interfaces/IThread.h"
+#include "../../OS/Interfaces/ITimeManager.h"
 #include "../../OS/Interfaces/IMemoryManager.h"    //NOTE: this should be the last include in a .cpp
 
 typedef eastl::unordered_map<eastl::string, eastl::vector<eastl::string>> AnimationAssetMap;
@@ -71,34 +78,243 @@ struct BoneInfo
 	ozz::animation::offline::RawSkeleton::Joint* pParentJoint;
 };
 
-bool ImportFBX(const char* fbxFile, const aiScene** pScene)
+// The skeleton is built from the bones of the meshes, so the rigged mesh gets the full post processing
+const unsigned int gSkeletonImportFlags = (aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_FixInfacingNormals |
+										   aiProcess_ConvertToLeftHanded) & ~(aiProcess_SortByPType | aiProcess_FindInstances);
+
+// Clips only read the node animations. Skipping the mesh processing of the preset makes most of the import time go away
+const unsigned int gAnimationImportFlags = aiProcess_ConvertToLeftHanded | aiProcess_FindInvalidData | aiProcess_ValidateDataStructure;
+
+// An asset is a rigged mesh, processed into the skeleton, and the clips that use that skeleton
+struct AnimationAsset
 {
-	// Set up assimp to be able to parse our fbx files correctly
-	aiPropertyStore* propertyStore = aiCreatePropertyStore();
+	eastl::string                mName;
+	eastl::vector<eastl::string> mFiles;            // The rigged mesh followed by the animations
+	eastl::vector<eastl::string> mOutputs;          // Output of each file, relative to the output directory
+	eastl::vector<uint64_t>      mInputsHashes;     // Hash of the inputs each output is built from
+	eastl::vector<uint32_t>      mClips;    // Indices of the files that need to be processed
+	bool                         mProcessSkeleton;
+	bool                         mSkeletonReady;
+	uint32_t                     mRemainingClips;
+	ozz::animation::Skeleton     mSkeleton;
+};
 
-	// Tell Assimp to not import a bunch of useless layers of objects
-	aiSetImportPropertyInteger(propertyStore, AI_CONFIG_IMPORT_FBX_READ_ALL_GEOMETRY_LAYERS, 0);
-	aiSetImportPropertyInteger(propertyStore, AI_CONFIG_IMPORT_FBX_READ_TEXTURES, 1);
-	aiSetImportPropertyFloat(propertyStore, AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 66.0f);
+// A skeleton or clip of an asset
+struct AnimationJob
+{
+	uint32_t mAsset;
+	uint32_t mFile;    // 0 is the skeleton
+};
+
+// Jobs shared by the worker threads. A skeleton job queues the clips of its asset once the skeleton is available
+struct AnimationJobQueue
+{
+	ProcessAssetsSettings*     pSettings;
+	AssetDatabase*             pDatabase;
+	eastl::string              mOutputDir;
+	uint64_t                   mSkeletonOptionsHash;
+	uint64_t                   mAnimationOptionsHash;
+	AnimationAsset*            pAssets;
+	eastl::deque<AnimationJob> mJobs;
+	Mutex                      mMutex;
+	ConditionVariable          mCond;
+	uint32_t                   mNumBusy;
+	uint32_t                   mNumJobs;
+	uint32_t                   mNumDone;
+	int                        mAssetsProcessed;
+	bool                       mSuccess;
+};
+
+// Same processing as AssimpImporter uses for the samples, except for the cache reordering which MeshOptimizer does instead
+const unsigned int gMeshImportFlags =
+	(aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_FindDegenerates |
+	 aiProcess_FindInvalidData | aiProcess_JoinIdenticalVertices | aiProcess_ConvertToLeftHanded) &
+	~(aiProcess_SortByPType | aiProcess_FindInstances | aiProcess_ImproveCacheLocality);
+
+// A mesh of a model, with the streams that are written to the binary mesh
+struct MeshData
+{
+	eastl::vector<float>    mPositions;
+	eastl::vector<float>    mNormals;
+	eastl::vector<float>    mTangents;
+	eastl::vector<float>    mTexCoords;
+	eastl::vector<uint32_t> mIndices;
+	uint32_t                mMaterialId;
+	uint32_t                mVerticesUsed;
+	VertexCacheStatistics   mCacheBefore;
+	VertexCacheStatistics   mCacheAfter;
+	VertexFetchStatistics   mFetchBefore;
+	VertexFetchStatistics   mFetchAfter;
+
+	eastl::vector<BinaryMeshClusterCompact> mClusterCompacts;
+	eastl::vector<BinaryMeshCluster>        mClusters;
+};
+
+// A material of a model, the textures are the paths stored in the source file
+struct MaterialData
+{
+	eastl::string mName;
+	eastl::string mDiffuseMap;
+	eastl::string mNormalMap;
+	eastl::string mSpecularMap;
+	uint32_t      mFlags;
+};
+
+// The meshes of a model are optimized by all the threads, each takes the next mesh left
+struct MeshJobQueue
+{
+	ProcessAssetsSettings* pSettings;
+	MeshData*              pMeshes;
+	uint32_t               mNumMeshes;
+	uint32_t               mNextMesh;
+	Mutex                  mMutex;
+};
 
-	unsigned int flags = aiProcessPreset_TargetRealtime_MaxQuality;
-	flags |= aiProcess_FixInfacingNormals | aiProcess_ConvertToLeftHanded;
-	flags &= ~aiProcess_SortByPType;
-	flags &= ~aiProcess_FindInstances;
+bool ImportFBX(const char* fbxFile, const aiScene** pScene, unsigned int flags)
+{
+	// Set up assimp to be able to parse our fbx files correctly. Files are imported on several threads, each import has its
+	// own importer so the error string is not the one of another thread like aiGetErrorString
+	Assimp::Importer importer;
 
-	// Import an assimp scene
-	*pScene = aiImportFileExWithProperties(fbxFile, flags, nullptr, propertyStore);
+	// Tell Assimp to not import a bunch of useless layers of objects
+	importer.SetPropertyInteger(AI_CONFIG_IMPORT_FBX_READ_ALL_GEOMETRY_LAYERS, 0);
+	importer.SetPropertyInteger(AI_CONFIG_IMPORT_FBX_READ_TEXTURES, 1);
+	importer.SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 66.0f);
 
-	// If the import failed, report it
-	if (*pScene == NULL)
+	// Import an assimp scene, if the import failed, report it
+	if (importer.ReadFile(fbxFile, flags) == NULL)
 	{
-		LOGF(LogLevel::eERROR, "%s", aiGetErrorString());
+		LOGF(LogLevel::eERROR, "%s", importer.GetErrorString());
+		*pScene = NULL;
 		return false;
 	}
 
+	// The caller owns the scene and releases it with aiReleaseImport
+	*pScene = importer.GetOrphanedScene();
 	return true;
 }
 
+int CountKeys(const ozz::animation::offline::RawAnimation& animation)
+{
+	size_t numKeys = 0;
+	for (size_t i = 0; i < animation.tracks.size(); ++i)
+	{
+		const ozz::animation::offline::RawAnimation::JointTrack& track = animation.tracks[i];
+		numKeys += track.translations.size() + track.rotations.size() + track.scales.size();
+	}
+	return (int)numKeys;
+}
+
+bool RunAnimationJob(AnimationJobQueue* queue, const AnimationJob& job)
+{
+	AnimationAsset*      asset = &queue->pAssets[job.mAsset];
+	const eastl::string& file = asset->mFiles[job.mFile];
+	const eastl::string  output = queue->mOutputDir + asset->mOutputs[job.mFile];
+
+	if (job.mFile == 0)
+	{
+		if (asset->mProcessSkeleton)
+			return AssetPipeline::CreateRuntimeSkeleton(
+				file.c_str(), asset->mName.c_str(), output.c_str(), &asset->mSkeleton, queue->pSettings);
+
+		if (!AssetLoader::LoadSkeleton(output.c_str(), FSR_Absolute, &asset->mSkeleton))
+		{
+			LOGF(LogLevel::eERROR, "Failed to load skeleton %s.", output.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	eastl::string animationName = FileSystem::GetFileName(file);
+	return AssetPipeline::CreateRuntimeAnimation(
+		file.c_str(), &asset->mSkeleton, asset->mName.c_str(), animationName.c_str(), output.c_str(), queue->pSettings);
+}
+
+void ProcessAnimationJobs(void* pData)
+{
+	AnimationJobQueue* queue = (AnimationJobQueue*)pData;
+
+	queue->mMutex.Acquire();
+	while (true)
+	{
+		// Wait for work as long as a running skeleton job can still queue its clips
+		while (queue->mJobs.empty() && queue->mNumBusy > 0)
+			queue->mCond.Wait(queue->mMutex);
+		if (queue->mJobs.empty())
+			break;
+
+		AnimationJob job = queue->mJobs.front();
+		queue->mJobs.pop_front();
+		++queue->mNumBusy;
+		queue->mMutex.Release();
+
+		HiresTimer timer;
+		bool       success = RunAnimationJob(queue, job);
+		float      milliseconds = timer.GetUSec(false) / 1000.0f;
+
+		queue->mMutex.Acquire();
+		--queue->mNumBusy;
+
+		AnimationAsset* asset = &queue->pAssets[job.mAsset];
+		uint32_t        numFinished = 1;
+		if (job.mFile == 0)
+		{
+			asset->mSkeletonReady = success;
+			if (success)
+			{
+				for (uint32_t i = 0; i < (uint32_t)asset->mClips.size(); ++i)
+					queue->mJobs.push_back({ job.mAsset, asset->mClips[i] });
+			}
+			else
+			{
+				// The clips can not be processed without their skeleton
+				numFinished += asset->mRemainingClips;
+				asset->mRemainingClips = 0;
+			}
+		}
+		else
+		{
+			--asset->mRemainingClips;
+		}
+
+		if (job.mFile != 0 || asset->mProcessSkeleton)
+		{
+			// A failed output is forgotten so the next run retries it
+			const uint64_t optionsHash = job.mFile == 0 ? queue->mSkeletonOptionsHash : queue->mAnimationOptionsHash;
+			if (success)
+			{
+				queue->pDatabase->SetOutput(asset->mOutputs[job.mFile], optionsHash, asset->mInputsHashes[job.mFile]);
+				++queue->mAssetsProcessed;
+			}
+			else
+			{
+				queue->pDatabase->RemoveOutput(asset->mOutputs[job.mFile]);
+			}
+		}
+		// Only a failed skeleton fails the command, a clip that can not be processed is skipped
+		if (!success && job.mFile == 0)
+			queue->mSuccess = false;
+
+		queue->mNumDone += numFinished;
+		if (!queue->pSettings->quiet && (job.mFile != 0 || asset->mProcessSkeleton))
+		{
+			LOGF(
+				LogLevel::eINFO, "[%u/%u] %s %s in %.1f ms.", queue->mNumDone, queue->mNumJobs, asset->mName.c_str(),
+				FileSystem::GetFileName(asset->mFiles[job.mFile]).c_str(), milliseconds);
+		}
+
+		// The last clip of the asset is done with the skeleton
+		if (asset->mSkeletonReady && asset->mRemainingClips == 0 && (job.mFile != 0 || asset->mClips.empty()))
+		{
+			asset->mSkeleton.Deallocate();
+			asset->mSkeletonReady = false;
+		}
+
+		queue->mCond.SetAll();
+	}
+	queue->mMutex.Release();
+}
+
 bool AssetPipeline::ProcessAnimations(const char* animationDirectory, const char* outputDirectory, ProcessAssetsSettings* settings)
 {
 	// Check if animationDirectory exists
@@ -168,121 +384,755 @@ bool AssetPipeline::ProcessAnimations(const char* animationDirectory, const char
 		}
 	}
 
-	// No assets found. Return.
-	if (animationAssets.empty())
-		return true;
-
-	// Process the found assets
-	int  assetsProcessed = 0;
-	bool success = true;
+	HiresTimer timer;
+
+	// What the outputs were built from last time
+	AssetDatabase database;
+	database.Load(outputDir);
+
+	// Only the options that change the output of a kind of asset are part of its hash
+	const float optimizationTolerance = settings->skipOptimization ? 0.0f : settings->optimizationTolerance;
+	uint64_t    animationOptionsHash = AssetDatabase::Hash(&settings->skipOptimization, sizeof(settings->skipOptimization));
+	animationOptionsHash = AssetDatabase::Hash(&optimizationTolerance, sizeof(optimizationTolerance), animationOptionsHash);
+
+	// Build the job list, skeletons first and then the clips depending on them. Directories are created
+	// here so the workers only read the source assets and write their own output file
+	AnimationJobQueue queue;
+	queue.pSettings = settings;
+	queue.pDatabase = &database;
+	queue.mOutputDir = outputDir;
+	queue.mSkeletonOptionsHash = AssetDatabase::Hash(NULL, 0);
+	queue.mAnimationOptionsHash = animationOptionsHash;
+	queue.pAssets = (AnimationAsset*)conf_calloc(animationAssets.size(), sizeof(AnimationAsset));
+	queue.mNumBusy = 0;
+	queue.mNumJobs = 0;
+	queue.mNumDone = 0;
+	queue.mAssetsProcessed = 0;
+	queue.mSuccess = true;
+
+	uint32_t numAssets = 0;
+	uint32_t numUpToDate = 0;
+	bool     planned = true;
 	for (AnimationAssetMap::iterator it = animationAssets.begin(); it != animationAssets.end(); ++it)
 	{
-		const eastl::string& skinnedMesh = it->second[0];
+		AnimationAsset* asset = conf_placement_new<AnimationAsset>(&queue.pAssets[numAssets]);
+		asset->mName = it->first;
+		asset->mFiles = it->second;
 
-		// Create skeleton output file name
-		eastl::string skeletonOutputDir = outputDir + it->first;
-		eastl::string skeletonOutput = skeletonOutputDir + "/skeleton.ozz";
+		const uint32_t numFiles = (uint32_t)asset->mFiles.size();
+		asset->mOutputs.resize(numFiles);
+		asset->mInputsHashes.resize(numFiles);
 
 		// Check if the skeleton is already up-to-date
-		bool processSkeleton = true;
-		if (!settings->force && outputDirExists)
+		asset->mOutputs[0] = it->first + "/skeleton.ozz";
+		asset->mInputsHashes[0] = database.GetInputHash(asset->mFiles[0]);
+		const char* reason = database.CheckOutput(asset->mOutputs[0], queue.mSkeletonOptionsHash, asset->mInputsHashes[0]);
+		if (settings->force)
+			reason = "forced";
+		asset->mProcessSkeleton = reason != NULL;
+		if (reason && !settings->quiet)
+			LOGF(LogLevel::eINFO, "%s: %s.", asset->mOutputs[0].c_str(), reason);
+		if (!reason)
+			++numUpToDate;
+
+		// Check which animations are not up-to-date. The skeleton source is one of their inputs, as the
+		// clips are sampled for its joints
+		for (uint32_t i = 1; i < numFiles; ++i)
 		{
-			time_t lastModified = FileSystem::GetLastModifiedTime(skinnedMesh);
-			time_t lastProcessed = FileSystem::GetLastModifiedTime(skeletonOutput);
+			asset->mOutputs[i] = it->first + "/animations/" + FileSystem::GetFileName(asset->mFiles[i]) + ".ozz";
+			const uint64_t sourceHash = database.GetInputHash(asset->mFiles[i]);
+			asset->mInputsHashes[i] = AssetDatabase::Hash(&sourceHash, sizeof(sourceHash), asset->mInputsHashes[0]);
+
+			reason = database.CheckOutput(asset->mOutputs[i], queue.mAnimationOptionsHash, asset->mInputsHashes[i]);
+			if (settings->force)
+				reason = "forced";
+			if (reason && !settings->quiet)
+				LOGF(LogLevel::eINFO, "%s: %s.", asset->mOutputs[i].c_str(), reason);
+
+			if (reason)
+				asset->mClips.push_back(i);
+			else
+				++numUpToDate;
+		}
 
-			if (lastModified < lastProcessed && lastProcessed != ~0u && lastProcessed > settings->minLastModifiedTime)
-				processSkeleton = false;
+		// Nothing to do for this asset, not even loading the skeleton
+		if (!asset->mProcessSkeleton && asset->mClips.empty())
+		{
+			++numAssets;
+			continue;
 		}
 
-		ozz::animation::Skeleton skeleton;
-		if (processSkeleton)
+		// If output directory doesn't exist, create it.
+		if (!outputDirExists)
 		{
-			// If output directory doesn't exist, create it.
-			if (!outputDirExists)
+			if (!FileSystem::CreateDir(outputDir))
 			{
-				if (!FileSystem::CreateDir(outputDir))
-				{
-					LOGF(LogLevel::eERROR, "Failed to create output directory %s.", outputDir.c_str());
-					return false;
-				}
-				outputDirExists = true;
+				LOGF(LogLevel::eERROR, "Failed to create output directory %s.", outputDir.c_str());
+				queue.mSuccess = false;
+				planned = false;
+				++numAssets;
+				break;
 			}
+			outputDirExists = true;
+		}
+
+		eastl::string skeletonOutputDir = outputDir + it->first;
+		eastl::string animationOutputDir = skeletonOutputDir + "/animations";
+		bool          dirsCreated = true;
+		if (!FileSystem::DirExists(skeletonOutputDir) && !FileSystem::CreateDir(skeletonOutputDir))
+		{
+			LOGF(LogLevel::eERROR, "Failed to create output directory %s.", skeletonOutputDir.c_str());
+			dirsCreated = false;
+		}
+		else if (!FileSystem::DirExists(animationOutputDir) && !FileSystem::CreateDir(animationOutputDir))
+		{
+			LOGF(LogLevel::eERROR, "Failed to create output directory %s.", animationOutputDir.c_str());
+			dirsCreated = false;
+		}
+
+		if (!dirsCreated)
+		{
+			queue.mSuccess = false;
+			++numAssets;
+			continue;
+		}
+
+		asset->mRemainingClips = (uint32_t)asset->mClips.size();
+		queue.mJobs.push_back({ numAssets, 0 });
+		queue.mNumJobs += 1 + asset->mRemainingClips;
+		++numAssets;
+	}
+
+	// Process the jobs on the calling thread and numJobs - 1 workers
+	uint32_t numThreads = settings->numJobs ? settings->numJobs : Thread::GetNumCPUCores();
+	numThreads = max(min(numThreads, queue.mNumJobs), 1u);
+
+	eastl::vector<ThreadHandle> threads(numThreads - 1);
+	ThreadDesc                  threadDesc = { ProcessAnimationJobs, &queue };
+	for (uint32_t i = 0; i < numThreads - 1; ++i)
+		threads[i] = create_thread(&threadDesc);
+
+	ProcessAnimationJobs(&queue);
+
+	for (uint32_t i = 0; i < numThreads - 1; ++i)
+		destroy_thread(threads[i]);
+
+	for (uint32_t i = 0; i < numAssets; ++i)
+		queue.pAssets[i].~AnimationAsset();
+	conf_free(queue.pAssets);
+
+	// Outputs whose source is gone are only known once every asset has been checked
+	uint32_t numRemoved = 0;
+	if (planned && outputDirExists)
+		numRemoved = database.RemoveOrphans(".ozz", settings->quiet);
+
+	if (outputDirExists)
+	{
+		if (!database.Save())
+		{
+			LOGF(LogLevel::eERROR, "Failed to write the asset database to %s.", outputDir.c_str());
+			queue.mSuccess = false;
+		}
+	}
+
+	if (!settings->quiet)
+	{
+		if (queue.mNumJobs == 0 && numRemoved == 0 && queue.mSuccess)
+			LOGF(LogLevel::eINFO, "All assets already up-to-date.");
+		else
+			LOGF(
+				LogLevel::eINFO, "Processed %d assets in %.2f s using %u threads. %u up-to-date, %u removed.", queue.mAssetsProcessed,
+				timer.GetSeconds(false), numThreads, numUpToDate, numRemoved);
+	}
 
-			if (!FileSystem::DirExists(skeletonOutputDir))
+	return queue.mSuccess;
+}
+
+// Splits the triangles of a mesh in clusters of clusterSize and computes their bounds and backface culling cone. This is
+// the cluster construction of the Visibility Buffer sample, moved here so it does not run on every launch
+void BuildClusters(MeshData* mesh, uint32_t clusterSize)
+{
+	const uint32_t triangleCount = (uint32_t)mesh->mIndices.size() / 3;
+	const uint32_t clusterCount = (triangleCount + clusterSize - 1) / clusterSize;
+	mesh->mClusterCompacts.resize(clusterCount);
+	mesh->mClusters.resize(clusterCount);
+
+	eastl::vector<vec3> triangleCache(clusterSize * 3);
+	for (uint32_t i = 0; i < clusterCount; ++i)
+	{
+		const uint32_t clusterStart = i * clusterSize;
+		const uint32_t clusterTriangleCount = min(clusterStart + clusterSize, triangleCount) - clusterStart;
+
+		for (uint32_t j = 0; j < clusterTriangleCount * 3; ++j)
+		{
+			const float* pPosition = &mesh->mPositions[mesh->mIndices[clusterStart * 3 + j] * 3];
+			triangleCache[j] = vec3(pPosition[0], pPosition[1], pPosition[2]);
+		}
+
+		vec3 aabbMin = vec3(INFINITY, INFINITY, INFINITY);
+		vec3 aabbMax = -aabbMin;
+		vec3 coneAxis = vec3(0, 0, 0);
+		for (uint32_t t = 0; t < clusterTriangleCount; ++t)
+		{
+			const vec3* vtx = &triangleCache[t * 3];
+			for (uint32_t j = 0; j < 3; ++j)
 			{
-				if (!FileSystem::CreateDir(skeletonOutputDir))
-				{
-					LOGF(LogLevel::eERROR, "Failed to create output directory %s.", skeletonOutputDir.c_str());
-					success = false;
-					continue;
-				}
+				aabbMin = minPerElem(aabbMin, vtx[j]);
+				aabbMax = maxPerElem(aabbMax, vtx[j]);
 			}
 
-			// Process the skeleton
-			if (!CreateRuntimeSkeleton(skinnedMesh.c_str(), it->first.c_str(), skeletonOutput.c_str(), &skeleton, settings))
+			vec3 triangleNormal = cross(vtx[1] - vtx[0], vtx[2] - vtx[0]);
+			if (lengthSqr(triangleNormal) != 0.0f)
+				triangleNormal = normalize(triangleNormal);
+			coneAxis = coneAxis - triangleNormal;
+		}
+
+		// Cosine of the cone opening angle, it is minimized over the triangles
+		float      coneOpening = 1;
+		bool       validCluster = lengthSqr(coneAxis) != 0.0f;
+		const vec3 center = (aabbMin + aabbMax) / 2;
+		if (validCluster)
+			coneAxis = normalize(coneAxis);
+
+		// The cone apex is the furthest intersection of the line center + t * coneAxis with the planes of the triangles
+		float t = -INFINITY;
+		for (uint32_t j = 0; j < clusterTriangleCount && validCluster; ++j)
+		{
+			const vec3* vtx = &triangleCache[j * 3];
+			const vec3  triangleNormal = normalize(cross(vtx[1] - vtx[0], vtx[2] - vtx[0]));
+			const float directionalPart = dot(coneAxis, -triangleNormal);
+			if (directionalPart <= 0)
 			{
-				success = false;
-				continue;
+				// At least two triangles face each other
+				validCluster = false;
+				break;
 			}
 
-			++assetsProcessed;
+			t = max(t, dot(center - vtx[0], triangleNormal) / -directionalPart);
+			coneOpening = min(coneOpening, directionalPart);
 		}
-		else
+
+		// Triangles nearly parallel to the axis can put the apex very far away, such clusters are not culled either
+		const vec3 coneCenter = center + coneAxis * t;
+		if (length(coneCenter - center) > 16 * length(aabbMax - aabbMin))
+			validCluster = false;
+
+		BinaryMeshCluster& cluster = mesh->mClusters[i];
+		memset(&cluster, 0, sizeof(cluster));
+		for (uint32_t c = 0; c < 3; ++c)
 		{
-			if (!AssetLoader::LoadSkeleton(skeletonOutput.c_str(), FSR_Absolute, &skeleton))
-				return false;
+			cluster.mAabbMin[c] = aabbMin[c];
+			cluster.mAabbMax[c] = aabbMax[c];
+			cluster.mConeCenter[c] = validCluster ? coneCenter[c] : center[c];
+			cluster.mConeAxis[c] = coneAxis[c];
 		}
+		cluster.mConeAngleCosine = sqrtf(1 - coneOpening * coneOpening);
+		cluster.mValid = validCluster ? 1 : 0;
 
-		// If output directory doesn't exist, create it.
-		eastl::string animationOutputDir = skeletonOutputDir + "/animations";
-		if (!FileSystem::DirExists(animationOutputDir))
+		mesh->mClusterCompacts[i].mTriangleCount = clusterTriangleCount;
+		mesh->mClusterCompacts[i].mClusterStart = clusterStart;
+	}
+}
+
+void OptimizeMesh(MeshData* mesh, float overdrawThreshold)
+{
+	const uint32_t vertexCount = (uint32_t)mesh->mPositions.size() / 3;
+	const uint32_t indexCount = (uint32_t)mesh->mIndices.size();
+	uint32_t*      pIndices = mesh->mIndices.data();
+
+	// Vertex fetches are measured on the positions, the other streams are read in the same order
+	mesh->mCacheBefore = MeshOptimizer::AnalyzeVertexCache(pIndices, indexCount, vertexCount, MESH_OPTIMIZER_CACHE_SIZE);
+	mesh->mFetchBefore = MeshOptimizer::AnalyzeVertexFetch(pIndices, indexCount, vertexCount, 3 * sizeof(float));
+
+	MeshOptimizer::OptimizeVertexCache(pIndices, pIndices, indexCount, vertexCount);
+	if (overdrawThreshold >= 1.0f)
+		MeshOptimizer::OptimizeOverdraw(pIndices, pIndices, indexCount, mesh->mPositions.data(), vertexCount, overdrawThreshold);
+
+	eastl::vector<uint32_t> remap(vertexCount);
+	mesh->mVerticesUsed = MeshOptimizer::OptimizeVertexFetch(remap.data(), pIndices, indexCount, vertexCount);
+
+	eastl::vector<float>* streams[] = { &mesh->mPositions, &mesh->mNormals, &mesh->mTangents, &mesh->mTexCoords };
+	for (uint32_t i = 0; i < sizeof(streams) / sizeof(streams[0]); ++i)
+	{
+		const uint32_t       components = (uint32_t)streams[i]->size() / max(vertexCount, 1u);
+		eastl::vector<float> remapped(mesh->mVerticesUsed * components);
+		MeshOptimizer::RemapVertices(remapped.data(), streams[i]->data(), vertexCount, components * sizeof(float), remap.data());
+		streams[i]->swap(remapped);
+	}
+
+	mesh->mCacheAfter = MeshOptimizer::AnalyzeVertexCache(pIndices, indexCount, mesh->mVerticesUsed, MESH_OPTIMIZER_CACHE_SIZE);
+	mesh->mFetchAfter = MeshOptimizer::AnalyzeVertexFetch(pIndices, indexCount, mesh->mVerticesUsed, 3 * sizeof(float));
+}
+
+void ProcessMeshJobs(void* pData)
+{
+	MeshJobQueue* queue = (MeshJobQueue*)pData;
+
+	while (true)
+	{
+		queue->mMutex.Acquire();
+		const uint32_t meshIndex = queue->mNextMesh;
+		if (meshIndex < queue->mNumMeshes)
+			++queue->mNextMesh;
+		queue->mMutex.Release();
+
+		if (meshIndex >= queue->mNumMeshes)
+			break;
+
+		OptimizeMesh(&queue->pMeshes[meshIndex], queue->pSettings->overdrawThreshold);
+		BuildClusters(&queue->pMeshes[meshIndex], queue->pSettings->clusterSize);
+	}
+}
+
+uint32_t PackUnorm16(float value) { return (uint32_t)roundf(clamp(value, 0.0f, 1.0f) * 65535.0f); }
+
+// Octahedral encoding of a direction in two unorm16, like the Visibility Buffer sample packs its normals and tangents
+uint32_t PackDirection(const float* pDirection)
+{
+	const float absLength = fabsf(pDirection[0]) + fabsf(pDirection[1]) + fabsf(pDirection[2]);
+	if (absLength == 0.0f)
+		return PackUnorm16(0.5f) | (PackUnorm16(0.5f) << 16);
+
+	float x = pDirection[0] / absLength;
+	float y = pDirection[1] / absLength;
+	if (pDirection[2] < 0.0f)
+	{
+		const float oldX = x;
+		x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		y = (1.0f - fabsf(oldX)) * (y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return PackUnorm16(x * 0.5f + 0.5f) | (PackUnorm16(y * 0.5f + 0.5f) << 16);
+}
+
+// Truncating float to half conversion, denormals are flushed to zero. Matches the one the samples use
+uint32_t PackHalf(float value)
+{
+	uint32_t f32;
+	memcpy(&f32, &value, sizeof(f32));
+	const uint32_t sign = (f32 >> 16) & 0x8000;
+	const int      exponent = (int)((f32 >> 23) & 0xff) - 127;
+	const uint32_t mantissa = f32 & 0x007fffff;
+	if (exponent == 128)
+		return sign | 0x7c00 | (mantissa & 0x3ff);    // Infinity or NaN
+	if (exponent > 15)
+		return sign | 0x7c00;    // Overflow, flushed to infinity
+	if (exponent > -15)
+		return sign | (uint32_t)(exponent + 15) << 10 | mantissa >> 13;
+	return sign;
+}
+
+// Places a section of size bytes at the next aligned offset
+uint64_t AddSection(uint64_t* pOffset, uint64_t size)
+{
+	const uint64_t sectionOffset = round_up_64(*pOffset, BINARY_MESH_ALIGNMENT);
+	*pOffset = sectionOffset + size;
+	return sectionOffset;
+}
+
+bool WritePadding(File* file, uint64_t* offset)
+{
+	const uint8_t  zeros[BINARY_MESH_ALIGNMENT] = {};
+	const unsigned size = (unsigned)((BINARY_MESH_ALIGNMENT - *offset % BINARY_MESH_ALIGNMENT) % BINARY_MESH_ALIGNMENT);
+	*offset += size;
+	return file->Write(zeros, size) == size;
+}
+
+bool WriteData(File* file, uint64_t* offset, const void* pData, size_t size)
+{
+	*offset += size;
+	return file->Write(pData, (unsigned)size) == size;
+}
+
+uint32_t AddString(eastl::vector<char>& strings, const eastl::string& string)
+{
+	// Offset 0 is the empty string
+	if (string.empty())
+		return 0;
+
+	const uint32_t offset = (uint32_t)strings.size();
+	strings.insert(strings.end(), string.c_str(), string.c_str() + string.size() + 1);
+	return offset;
+}
+
+bool WriteBinaryMesh(
+	const char* meshOutput, const MeshData* pMeshes, uint32_t numMeshes, const MaterialData* pMaterials, uint32_t numMaterials,
+	const ProcessAssetsSettings* settings)
+{
+	BinaryMeshHeader header = {};
+	header.mMagic = BINARY_MESH_MAGIC;
+	header.mVersion = BINARY_MESH_VERSION;
+	header.mNumMeshes = numMeshes;
+	header.mNumMaterials = numMaterials;
+	header.mClusterSize = settings->clusterSize;
+	header.mScale = settings->meshScale;
+	for (uint32_t c = 0; c < 3; ++c)
+		header.mOffset[c] = settings->meshOffset[c];
+
+	eastl::vector<BinaryMeshInfo> meshInfos(numMeshes);
+	for (uint32_t i = 0; i < numMeshes; ++i)
+	{
+		const MeshData& mesh = pMeshes[i];
+		BinaryMeshInfo& info = meshInfos[i];
+		info.mStartIndex = header.mNumIndices;
+		info.mIndexCount = (uint32_t)mesh.mIndices.size();
+		info.mStartVertex = header.mNumVertices;
+		info.mVertexCount = mesh.mVerticesUsed;
+		info.mMaterialId = mesh.mMaterialId;
+		info.mClusterStart = header.mNumClusters;
+		info.mClusterCount = (uint32_t)mesh.mClusters.size();
+
+		for (uint32_t c = 0; c < 3; ++c)
 		{
-			if (!FileSystem::CreateDir(animationOutputDir))
+			info.mMin[c] = mesh.mVerticesUsed ? FLT_MAX : 0.0f;
+			info.mMax[c] = mesh.mVerticesUsed ? -FLT_MAX : 0.0f;
+		}
+		for (uint32_t v = 0; v < mesh.mVerticesUsed; ++v)
+		{
+			for (uint32_t c = 0; c < 3; ++c)
 			{
-				LOGF(LogLevel::eERROR, "Failed to create output directory %s.", animationOutputDir.c_str());
-				success = false;
-				skeleton.Deallocate();
-				continue;
+				info.mMin[c] = min(info.mMin[c], mesh.mPositions[v * 3 + c]);
+				info.mMax[c] = max(info.mMax[c], mesh.mPositions[v * 3 + c]);
 			}
 		}
 
-		// Process animations
-		for (size_t i = 1; i < it->second.size(); ++i)
+		header.mNumIndices += info.mIndexCount;
+		header.mNumVertices += info.mVertexCount;
+		header.mNumClusters += info.mClusterCount;
+	}
+
+	eastl::vector<char> strings(1, '\0');
+	eastl::vector<BinaryMeshMaterial> materials(numMaterials);
+	for (uint32_t i = 0; i < numMaterials; ++i)
+	{
+		materials[i].mName = AddString(strings, pMaterials[i].mName);
+		materials[i].mDiffuseMap = AddString(strings, pMaterials[i].mDiffuseMap);
+		materials[i].mNormalMap = AddString(strings, pMaterials[i].mNormalMap);
+		materials[i].mSpecularMap = AddString(strings, pMaterials[i].mSpecularMap);
+		materials[i].mFlags = pMaterials[i].mFlags;
+	}
+
+	const uint64_t numVertices = header.mNumVertices;
+	uint64_t       offset = sizeof(BinaryMeshHeader);
+	header.mMeshesOffset = AddSection(&offset, numMeshes * sizeof(BinaryMeshInfo));
+	header.mMaterialsOffset = AddSection(&offset, numMaterials * sizeof(BinaryMeshMaterial));
+	header.mStringsOffset = AddSection(&offset, strings.size());
+	header.mPositionsOffset = AddSection(&offset, numVertices * 3 * sizeof(float));
+	header.mNormalsOffset = AddSection(&offset, numVertices * 3 * sizeof(float));
+	header.mTangentsOffset = AddSection(&offset, numVertices * 3 * sizeof(float));
+	header.mTexCoordsOffset = AddSection(&offset, numVertices * 2 * sizeof(float));
+	header.mPackedNormalsOffset = AddSection(&offset, numVertices * sizeof(uint32_t));
+	header.mPackedTangentsOffset = AddSection(&offset, numVertices * sizeof(uint32_t));
+	header.mPackedTexCoordsOffset = AddSection(&offset, numVertices * sizeof(uint32_t));
+	header.mIndicesOffset = AddSection(&offset, header.mNumIndices * sizeof(uint32_t));
+	header.mClusterCompactsOffset = AddSection(&offset, header.mNumClusters * sizeof(BinaryMeshClusterCompact));
+	header.mClustersOffset = AddSection(&offset, header.mNumClusters * sizeof(BinaryMeshCluster));
+	header.mFileSize = offset;
+
+	File file;
+	if (!file.Open(meshOutput, FM_WriteBinary, FSR_Absolute))
+	{
+		LOGF(LogLevel::eERROR, "Failed to open %s for writing.", meshOutput);
+		return false;
+	}
+
+	offset = 0;
+	bool success = WriteData(&file, &offset, &header, sizeof(header));
+	success = success && WritePadding(&file, &offset) &&
+			  WriteData(&file, &offset, meshInfos.data(), numMeshes * sizeof(BinaryMeshInfo));
+	success = success && WritePadding(&file, &offset) &&
+			  WriteData(&file, &offset, materials.data(), numMaterials * sizeof(BinaryMeshMaterial));
+	success = success && WritePadding(&file, &offset) && WriteData(&file, &offset, strings.data(), strings.size());
+
+	// Streams are stored one after the other, each with the vertices of all meshes
+	eastl::vector<float> MeshData::*streams[] = { &MeshData::mPositions, &MeshData::mNormals, &MeshData::mTangents,
+												   &MeshData::mTexCoords };
+	for (uint32_t s = 0; s < sizeof(streams) / sizeof(streams[0]) && success; ++s)
+	{
+		success = WritePadding(&file, &offset);
+		for (uint32_t i = 0; i < numMeshes && success; ++i)
+		{
+			const eastl::vector<float>& stream = pMeshes[i].*streams[s];
+			success = WriteData(&file, &offset, stream.data(), stream.size() * sizeof(float));
+		}
+	}
+
+	// Followed by the packed versions of the normals, tangents and texture coordinates
+	eastl::vector<uint32_t> packed;
+	for (uint32_t s = 1; s < sizeof(streams) / sizeof(streams[0]) && success; ++s)
+	{
+		success = WritePadding(&file, &offset);
+		for (uint32_t i = 0; i < numMeshes && success; ++i)
 		{
-			const eastl::string& animationFile = it->second[i];
-			;
-			eastl::string animationName = FileSystem::GetFileName(animationFile);
+			const eastl::vector<float>& stream = pMeshes[i].*streams[s];
+			packed.resize(pMeshes[i].mVerticesUsed);
+			for (uint32_t v = 0; v < pMeshes[i].mVerticesUsed; ++v)
+			{
+				if (streams[s] == &MeshData::mTexCoords)
+					packed[v] = PackHalf(stream[v * 2]) | (PackHalf(stream[v * 2 + 1]) << 16);
+				else
+					packed[v] = PackDirection(&stream[v * 3]);
+			}
+			success = WriteData(&file, &offset, packed.data(), packed.size() * sizeof(uint32_t));
+		}
+	}
+
+	// Indices are made relative to the start of the file's vertices, like the samples expect
+	success = success && WritePadding(&file, &offset);
+	eastl::vector<uint32_t> indices;
+	for (uint32_t i = 0; i < numMeshes && success; ++i)
+	{
+		indices.resize(pMeshes[i].mIndices.size());
+		for (size_t j = 0; j < indices.size(); ++j)
+			indices[j] = pMeshes[i].mIndices[j] + meshInfos[i].mStartVertex;
+
+		success = WriteData(&file, &offset, indices.data(), indices.size() * sizeof(uint32_t));
+	}
 
-			// Create animation output file name
-			eastl::string animationOutput = outputDir + it->first + "/animations/" + animationName + ".ozz";
+	success = success && WritePadding(&file, &offset);
+	for (uint32_t i = 0; i < numMeshes && success; ++i)
+	{
+		const eastl::vector<BinaryMeshClusterCompact>& compacts = pMeshes[i].mClusterCompacts;
+		success = WriteData(&file, &offset, compacts.data(), compacts.size() * sizeof(BinaryMeshClusterCompact));
+	}
 
-			// Check if the animation is already up-to-date
-			bool processAnimation = true;
-			if (!settings->force && outputDirExists && !processSkeleton)
+	success = success && WritePadding(&file, &offset);
+	for (uint32_t i = 0; i < numMeshes && success; ++i)
+	{
+		const eastl::vector<BinaryMeshCluster>& clusters = pMeshes[i].mClusters;
+		success = WriteData(&file, &offset, clusters.data(), clusters.size() * sizeof(BinaryMeshCluster));
+	}
+
+	file.Close();
+
+	ASSERT(!success || offset == header.mFileSize);
+	if (!success)
+		LOGF(LogLevel::eERROR, "Failed to write %s.", meshOutput);
+	return success;
+}
+
+bool AssetPipeline::ProcessMeshes(const char* meshDirectory, const char* outputDirectory, ProcessAssetsSettings* settings)
+{
+	if (!FileSystem::DirExists(meshDirectory))
+	{
+		LOGF(LogLevel::eERROR, "MeshDirectory: \"%s\" does not exist.", meshDirectory);
+		return false;
+	}
+
+	eastl::string outputDir = FileSystem::AddTrailingSlash(outputDirectory);
+	bool          outputDirExists = FileSystem::DirExists(outputDir);
+
+	// Every model directly in meshDirectory is converted to a binary mesh
+	const char*                  extensions[] = { ".obj", ".fbx", ".gltf", ".glb" };
+	eastl::vector<eastl::string> meshFiles;
+	for (uint32_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); ++i)
+		FileSystem::GetFilesWithExtension(meshDirectory, extensions[i], meshFiles);
+
+	if (meshFiles.empty() && !settings->quiet)
+		LOGF(LogLevel::eWARNING, "%s does not contain any mesh files.", meshDirectory);
+
+	HiresTimer timer;
+
+	AssetDatabase database;
+	database.Load(outputDir);
+
+	const float    overdrawThreshold = settings->overdrawThreshold >= 1.0f ? settings->overdrawThreshold : 0.0f;
+	const uint32_t cacheSize = MESH_OPTIMIZER_CACHE_SIZE;
+	uint64_t       optionsHash = AssetDatabase::Hash(&overdrawThreshold, sizeof(overdrawThreshold));
+	optionsHash = AssetDatabase::Hash(&cacheSize, sizeof(cacheSize), optionsHash);
+	optionsHash = AssetDatabase::Hash(&settings->meshScale, sizeof(settings->meshScale), optionsHash);
+	optionsHash = AssetDatabase::Hash(settings->meshOffset, sizeof(settings->meshOffset), optionsHash);
+	optionsHash = AssetDatabase::Hash(&settings->clusterSize, sizeof(settings->clusterSize), optionsHash);
+
+	uint32_t numThreads = settings->numJobs ? settings->numJobs : Thread::GetNumCPUCores();
+	numThreads = max(numThreads, 1u);
+
+	bool     success = true;
+	bool     planned = true;
+	int      assetsProcessed = 0;
+	uint32_t numUpToDate = 0;
+	for (const eastl::string& file : meshFiles)
+	{
+		// foo.obj and foo.fbx in the same directory must not write the same output
+		const eastl::string output = FileSystem::GetFileNameAndExtension(file, false) + ".mesh";
+		const uint64_t      inputsHash = database.GetInputHash(file);
+
+		const char* reason = database.CheckOutput(output, optionsHash, inputsHash);
+		if (settings->force)
+			reason = "forced";
+		if (!reason)
+		{
+			++numUpToDate;
+			continue;
+		}
+		if (!settings->quiet)
+			LOGF(LogLevel::eINFO, "%s: %s.", output.c_str(), reason);
+
+		if (!outputDirExists)
+		{
+			if (!FileSystem::CreateDir(outputDir))
 			{
-				time_t lastModified = FileSystem::GetLastModifiedTime(animationFile);
-				time_t lastProcessed = FileSystem::GetLastModifiedTime(animationOutput);
+				LOGF(LogLevel::eERROR, "Failed to create output directory %s.", outputDir.c_str());
+				success = false;
+				planned = false;
+				break;
+			}
+			outputDirExists = true;
+		}
+
+		HiresTimer fileTimer;
 
-				if (lastModified < lastProcessed && lastProcessed != ~0u && lastModified > settings->minLastModifiedTime)
-					processAnimation = false;
+		const aiScene* scene = NULL;
+		if (!ImportFBX(file.c_str(), &scene, gMeshImportFlags))
+		{
+			database.RemoveOutput(output);
+			success = false;
+			continue;
+		}
+
+		// Copy the triangles of the meshes out of the scene, lines and points left by the triangulation are dropped
+		MeshJobQueue queue;
+		queue.pSettings = settings;
+		queue.mNumMeshes = scene->mNumMeshes;
+		queue.mNextMesh = 0;
+		queue.pMeshes = (MeshData*)conf_calloc(queue.mNumMeshes, sizeof(MeshData));
+		for (uint32_t i = 0; i < queue.mNumMeshes; ++i)
+		{
+			const aiMesh* aiMesh = scene->mMeshes[i];
+			MeshData*     mesh = conf_placement_new<MeshData>(&queue.pMeshes[i]);
+			mesh->mMaterialId = aiMesh->mMaterialIndex;
+
+			mesh->mPositions.resize(aiMesh->mNumVertices * 3);
+			mesh->mNormals.resize(aiMesh->mNumVertices * 3, 0.0f);
+			mesh->mTangents.resize(aiMesh->mNumVertices * 3, 0.0f);
+			mesh->mTexCoords.resize(aiMesh->mNumVertices * 2, 0.0f);
+			for (uint32_t v = 0; v < aiMesh->mNumVertices; ++v)
+			{
+				for (uint32_t c = 0; c < 3; ++c)
+					mesh->mPositions[v * 3 + c] = aiMesh->mVertices[v][c] * settings->meshScale + settings->meshOffset[c];
+				if (aiMesh->mNormals)
+					memcpy(&mesh->mNormals[v * 3], &aiMesh->mNormals[v], 3 * sizeof(float));
+				if (aiMesh->mTangents)
+					memcpy(&mesh->mTangents[v * 3], &aiMesh->mTangents[v], 3 * sizeof(float));
+				if (aiMesh->mTextureCoords[0])
+					memcpy(&mesh->mTexCoords[v * 2], &aiMesh->mTextureCoords[0][v], 2 * sizeof(float));
 			}
 
-			if (processAnimation)
+			mesh->mIndices.reserve(aiMesh->mNumFaces * 3);
+			for (uint32_t f = 0; f < aiMesh->mNumFaces; ++f)
 			{
-				// Process the animation
-				if (!CreateRuntimeAnimation(
-						animationFile.c_str(), &skeleton, it->first.c_str(), animationName.c_str(), animationOutput.c_str(), settings))
-					continue;
+				const aiFace& face = aiMesh->mFaces[f];
+				if (face.mNumIndices == 3)
+					mesh->mIndices.insert(mesh->mIndices.end(), face.mIndices, face.mIndices + 3);
+			}
+		}
+
+		eastl::vector<MaterialData> materials(scene->mNumMaterials);
+		for (uint32_t i = 0; i < scene->mNumMaterials; ++i)
+		{
+			const aiMaterial* aiMaterial = scene->mMaterials[i];
+			MaterialData&     material = materials[i];
+
+			aiString name;
+			if (aiMaterial->Get(AI_MATKEY_NAME, name) == AI_SUCCESS)
+				material.mName = name.C_Str();
+
+			// Obj files store their normal maps as bump maps
+			aiString path;
+			if (aiMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS)
+				material.mDiffuseMap = path.C_Str();
+			if (aiMaterial->GetTexture(aiTextureType_NORMALS, 0, &path) == AI_SUCCESS ||
+				aiMaterial->GetTexture(aiTextureType_HEIGHT, 0, &path) == AI_SUCCESS)
+				material.mNormalMap = path.C_Str();
+			if (aiMaterial->GetTexture(aiTextureType_SPECULAR, 0, &path) == AI_SUCCESS)
+				material.mSpecularMap = path.C_Str();
+
+			int twoSided = 0;
+			material.mFlags = 0;
+			if (aiMaterial->Get(AI_MATKEY_TWOSIDED, twoSided) == AI_SUCCESS && twoSided)
+				material.mFlags |= BINARY_MESH_MATERIAL_TWO_SIDED;
+			if (aiMaterial->GetTextureCount(aiTextureType_OPACITY) > 0)
+				material.mFlags |= BINARY_MESH_MATERIAL_ALPHA_TESTED;
+		}
+		aiReleaseImport(scene);
 
-				++assetsProcessed;
+		// Optimize the meshes on the calling thread and numThreads - 1 workers
+		const uint32_t              numMeshThreads = min(numThreads, max(queue.mNumMeshes, 1u));
+		eastl::vector<ThreadHandle> threads(numMeshThreads - 1);
+		ThreadDesc                  threadDesc = { ProcessMeshJobs, &queue };
+		for (uint32_t i = 0; i < numMeshThreads - 1; ++i)
+			threads[i] = create_thread(&threadDesc);
+
+		ProcessMeshJobs(&queue);
+
+		for (uint32_t i = 0; i < numMeshThreads - 1; ++i)
+			destroy_thread(threads[i]);
+
+		const eastl::string meshOutput = outputDir + output;
+		if (WriteBinaryMesh(
+				meshOutput.c_str(), queue.pMeshes, queue.mNumMeshes, materials.data(), (uint32_t)materials.size(), settings))
+		{
+			database.SetOutput(output, optionsHash, inputsHash);
+			++assetsProcessed;
+		}
+		else
+		{
+			database.RemoveOutput(output);
+			success = false;
+		}
+
+		if (!settings->quiet)
+		{
+			// Totals over all meshes of the file
+			uint64_t triangles = 0, clusters = 0, verticesUsed = 0;
+			uint64_t transformedBefore = 0, transformedAfter = 0, fetchedBefore = 0, fetchedAfter = 0;
+			for (uint32_t i = 0; i < queue.mNumMeshes; ++i)
+			{
+				const MeshData& mesh = queue.pMeshes[i];
+				triangles += mesh.mIndices.size() / 3;
+				clusters += mesh.mClusters.size();
+				verticesUsed += mesh.mVerticesUsed;
+				transformedBefore += mesh.mCacheBefore.mVerticesTransformed;
+				transformedAfter += mesh.mCacheAfter.mVerticesTransformed;
+				fetchedBefore += mesh.mFetchBefore.mBytesFetched;
+				fetchedAfter += mesh.mFetchAfter.mBytesFetched;
 			}
+			const double invTriangles = triangles ? 1.0 / (double)triangles : 0.0;
+			const double invVertices = verticesUsed ? 1.0 / (double)verticesUsed : 0.0;
+			const double invVertexBytes = invVertices / (3 * sizeof(float));
+
+			LOGF(
+				LogLevel::eINFO, "%s: %u meshes, %llu triangles, %llu clusters in %.1f ms.", output.c_str(), queue.mNumMeshes,
+				(unsigned long long)triangles, (unsigned long long)clusters, fileTimer.GetUSec(false) / 1000.0f);
+			LOGF(
+				LogLevel::eINFO, "    ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, position overfetch %.2f -> %.2f.",
+				transformedBefore * invTriangles, transformedAfter * invTriangles, transformedBefore * invVertices,
+				transformedAfter * invVertices, fetchedBefore * invVertexBytes, fetchedAfter * invVertexBytes);
 		}
 
-		skeleton.Deallocate();
+		for (uint32_t i = 0; i < queue.mNumMeshes; ++i)
+			queue.pMeshes[i].~MeshData();
+		conf_free(queue.pMeshes);
 	}
 
-	if (!settings->quiet && assetsProcessed == 0 && success)
-		LOGF(LogLevel::eINFO, "All assets already up-to-date.");
+	uint32_t numRemoved = 0;
+	if (planned && outputDirExists)
+		numRemoved = database.RemoveOrphans(".mesh", settings->quiet);
+
+	if (outputDirExists && !database.Save())
+	{
+		LOGF(LogLevel::eERROR, "Failed to write the asset database to %s.", outputDir.c_str());
+		success = false;
+	}
+
+	if (!settings->quiet)
+	{
+		if (assetsProcessed == 0 && numRemoved == 0 && success)
+			LOGF(LogLevel::eINFO, "All meshes already up-to-date.");
+		else
+			LOGF(
+				LogLevel::eINFO, "Processed %d meshes in %.2f s using %u threads. %u up-to-date, %u removed.", assetsProcessed,
+				timer.GetSeconds(false), numThreads, numUpToDate, numRemoved);
+	}
 
 	return success;
 }
@@ -293,7 +1143,7 @@ bool AssetPipeline::CreateRuntimeSkeleton(
 {
 	// Import the FBX with the animation
 	const aiScene* scene = NULL;
-	if (!ImportFBX(skeletonAsset, &scene))
+	if (!ImportFBX(skeletonAsset, &scene, gSkeletonImportFlags))
 		return false;
 
 	// Check if the asset contains any bones
@@ -476,7 +1326,7 @@ bool AssetPipeline::CreateRuntimeAnimation(
 {
 	// Import the FBX with the animation
 	const aiScene* scene = NULL;
-	if (!ImportFBX(animationAsset, &scene))
+	if (!ImportFBX(animationAsset, &scene, gAnimationImportFlags))
 		return false;
 
 	// Check if the asset contains any animations
@@ -574,9 +1424,35 @@ bool AssetPipeline::CreateRuntimeAnimation(
 		return false;
 	}
 
+	// Strip the keys that can be interpolated from their neighbours within the tolerance. The runtime animation
+	// stores the remaining keys quantized to 16 bits per component
+	ozz::animation::offline::RawAnimation optimizedAnimation;
+	if (!settings->skipOptimization)
+	{
+		ozz::animation::offline::AnimationOptimizer optimizer;
+		if (settings->optimizationTolerance > 0.0f)
+		{
+			optimizer.translation_tolerance = settings->optimizationTolerance;
+			optimizer.hierarchical_tolerance = settings->optimizationTolerance;
+		}
+
+		if (!optimizer(rawAnimation, *skeleton, &optimizedAnimation))
+		{
+			LOGF(LogLevel::eERROR, "Animation %s created for %s can not be optimized.", animationName, skeletonName);
+			return false;
+		}
+
+		if (!settings->quiet)
+		{
+			LOGF(
+				LogLevel::eINFO, "Animation %s of skeleton %s optimized from %d to %d keys.", animationName, skeletonName,
+				CountKeys(rawAnimation), CountKeys(optimizedAnimation));
+		}
+	}
+
 	// Build runtime animation from raw animation
 	ozz::animation::Animation animation;
-	if (!ozz::animation::offline::AnimationBuilder::Build(rawAnimation, &animation))
+	if (!ozz::animation::offline::AnimationBuilder::Build(settings->skipOptimization ? rawAnimation : optimizedAnimation, &animation))
 	{
 		LOGF(LogLevel::eERROR, "Animation %s can not be created for %s.", animationName, skeletonName);
 		return false;
@@ -29,15 +29,22 @@
 
 struct ProcessAssetsSettings
 {
-	bool quiet;                  // Only output warnings.
-	bool force;                  // Force all assets to be processed.
-	uint minLastModifiedTime;    // Force all assets older than this to be processed.
+	bool  quiet;                    // Only output warnings.
+	bool  force;                    // Force all assets to be processed, even the ones the asset database lists as up-to-date.
+	bool  skipOptimization;         // Keep every key of the animations instead of stripping the ones that can be interpolated.
+	float optimizationTolerance;    // Maximum error in meters the key reduction may introduce on a joint. 0 uses the ozz default.
+	uint  numJobs;                  // Number of threads processing assets. 0 uses one per CPU core.
+	float overdrawThreshold;        // Maximum ACMR increase the overdraw ordering of meshes may introduce, 1.05 is 5%. Below 1 skips it.
+	float meshScale;                // Scale applied to the mesh positions, before meshOffset.
+	float meshOffset[3];            // Offset added to the mesh positions.
+	uint  clusterSize;              // Triangles per culling cluster of the meshes, must match CLUSTER_SIZE of the renderer.
 };
 
 class AssetPipeline
 {
 	public:
 	static bool ProcessAnimations(const char* animationDirectory, const char* outputDirectory, ProcessAssetsSettings* settings);
+	static bool ProcessMeshes(const char* meshDirectory, const char* outputDirectory, ProcessAssetsSettings* settings);
 	static bool CreateRuntimeSkeleton(
 		const char* skeletonAsset, const char* skeletonName, const char* skeletonOutput, ozz::animation::Skeleton* skeleton,
 		ProcessAssetsSettings* settings);
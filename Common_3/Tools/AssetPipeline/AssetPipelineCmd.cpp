@@ -3,7 +3,7 @@
 #include "../../OS/Interfaces/ILogManager.h"
 
 #include <cstdio>
-#include <sys/stat.h>
+#include <cstdlib>
 
 const char* pszBases[] = {
 	"",    // FSR_BinShaders
@@ -26,33 +26,28 @@ void PrintHelp()
 	printf("Command: processanimations \"animation/directory/\" \"output/directory/\" [flags]\n");
 	printf("\t--quiet: Print only error messages.\n");
 	printf("\t--force: Force all assets to be processed. Including ones that are already up-to-date.\n");
+	printf("\tOutputs are rebuilt when the content of their source or the options change. This is tracked in\n");
+	printf("\tAssetPipeline.db in the output directory, outputs whose source was removed are deleted.\n");
+	printf("\t--nooptimize: Keep every key of the animations instead of stripping the ones that can be interpolated.\n");
+	printf("\t--tolerance <meters>: Maximum error the key reduction may introduce on a joint.\n");
+	printf("\t--jobs <count>: Number of threads processing assets. Defaults to one per CPU core.\n");
+	printf("Command: processmeshes \"mesh/directory/\" \"output/directory/\" [flags]\n");
+	printf("\tConverts every obj, fbx and gltf file to a .mesh file named after it (foo.obj.mesh) with the triangles and vertices reordered for the GPU\n");
+	printf("\tvertex cache, overdraw and vertex fetches. Prints the ACMR and ATVR before and after for each file.\n");
+	printf("\tThe .mesh file also holds packed vertex attributes, the materials and the culling clusters, ready to be mapped.\n");
+	printf("\t--quiet, --force and --jobs work like for processanimations.\n");
+	printf("\t--overdraw <threshold>: Maximum ACMR increase the overdraw ordering may introduce. Defaults to 1.05, 0 disables it.\n");
+	printf("\t--scale <scale>: Scale of the positions. Defaults to 1.\n");
+	printf("\t--offset <x> <y> <z>: Offset added to the positions after scaling. Defaults to 0 0 0.\n");
+	printf("\t--clustersize <triangles>: Triangles per culling cluster. Defaults to 256.\n");
 	printf("Other:\n");
 	printf("\t-h or -help: Print usage information.\n");
 }
 
-size_t GetFileLastModifiedTime(const char* _fileName)
-{
-	struct stat fileInfo;
-
-	if (!stat(_fileName, &fileInfo))
-	{
-		return (size_t)fileInfo.st_mtime;
-	}
-	else
-	{
-		// return an impossible large mod time as the file doesn't exist
-		return ~0;
-	}
-}
-
 int main(int argc, char** argv)
 {
-	uint appLastModified = 0;
 	if (argc > 0)
-	{
 		gApplicationName = argv[0];
-		appLastModified = (uint)GetFileLastModifiedTime(gApplicationName);
-	}
 
 	if (argc == 1)
 		PrintHelp();
@@ -63,19 +58,27 @@ int main(int argc, char** argv)
 	if (arg == "-h" || arg == "-help")
 		PrintHelp();
 
-	if (arg == "processanimations")
+	if (arg == "processanimations" || arg == "processmeshes")
 	{
+		const bool animations = arg == "processanimations";
 		if (argc < 4)
 		{
-			printf("ERROR: Invalid number of arguments for command processanimations.\n");
+			printf("ERROR: Invalid number of arguments for command %s.\n", arg.c_str());
 			return 1;
 		}
 
-		eastl::string animationDir = argv[2];
+		eastl::string inputDir = argv[2];
 		eastl::string outputDir = argv[3];
 
-		bool quiet = false;
-		bool force = false;
+		bool  quiet = false;
+		bool  force = false;
+		bool  skipOptimization = false;
+		float optimizationTolerance = 0.0f;
+		uint  numJobs = 0;
+		float overdrawThreshold = 1.05f;
+		float meshScale = 1.0f;
+		float meshOffset[3] = { 0.0f, 0.0f, 0.0f };
+		uint  clusterSize = 256;
 		for (int j = 4; j < argc; ++j)
 		{
 			arg = argv[j];
@@ -85,6 +88,23 @@ int main(int argc, char** argv)
 				quiet = true;
 			else if (arg == "--force")
 				force = true;
+			else if (arg == "--nooptimize" && animations)
+				skipOptimization = true;
+			else if (arg == "--tolerance" && animations && j + 1 < argc)
+				optimizationTolerance = (float)atof(argv[++j]);
+			else if (arg == "--jobs" && j + 1 < argc)
+				numJobs = (uint)atoi(argv[++j]);
+			else if (arg == "--overdraw" && !animations && j + 1 < argc)
+				overdrawThreshold = (float)atof(argv[++j]);
+			else if (arg == "--scale" && !animations && j + 1 < argc)
+				meshScale = (float)atof(argv[++j]);
+			else if (arg == "--offset" && !animations && j + 3 < argc)
+			{
+				for (int c = 0; c < 3; ++c)
+					meshOffset[c] = (float)atof(argv[++j]);
+			}
+			else if (arg == "--clustersize" && !animations && j + 1 < argc)
+				clusterSize = (uint)atoi(argv[++j]);
 			else
 				printf("WARNING: Unrecognized argument: %s\n", arg.c_str());
 		}
@@ -92,8 +112,24 @@ int main(int argc, char** argv)
 		ProcessAssetsSettings settings = {};
 		settings.quiet = quiet;
 		settings.force = force;
-		settings.minLastModifiedTime = appLastModified;
-		if (!AssetPipeline::ProcessAnimations(animationDir.c_str(), outputDir.c_str(), &settings))
+		settings.skipOptimization = skipOptimization;
+		settings.optimizationTolerance = optimizationTolerance;
+		settings.numJobs = numJobs;
+		settings.overdrawThreshold = overdrawThreshold;
+		settings.meshScale = meshScale;
+		for (int c = 0; c < 3; ++c)
+			settings.meshOffset[c] = meshOffset[c];
+		settings.clusterSize = clusterSize;
+
+		if (!animations && clusterSize == 0)
+		{
+			printf("ERROR: The cluster size has to be at least 1.\n");
+			return 1;
+		}
+
+		bool success = animations ? AssetPipeline::ProcessAnimations(inputDir.c_str(), outputDir.c_str(), &settings)
+								  : AssetPipeline::ProcessMeshes(inputDir.c_str(), outputDir.c_str(), &settings);
+		if (!success)
 			return 1;
 	}
 
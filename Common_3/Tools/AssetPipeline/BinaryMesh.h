@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Layout of the .mesh files written by AssetPipeline::ProcessMeshes.
+// The header is followed by the mesh and material tables, one array per vertex attribute and the clusters, all meshes of
+// the file share them. Offsets are from the start of the file and aligned to BINARY_MESH_ALIGNMENT, so a mapped file can
+// be used in place and each array uploaded as is.
+const uint32_t BINARY_MESH_MAGIC = 0x4853454D;    // "MESH"
+const uint32_t BINARY_MESH_VERSION = 2;
+const uint32_t BINARY_MESH_ALIGNMENT = 16;
+
+// BinaryMeshMaterial::mFlags
+const uint32_t BINARY_MESH_MATERIAL_TWO_SIDED = 0x1;
+const uint32_t BINARY_MESH_MATERIAL_ALPHA_TESTED = 0x2;    // Has an opacity map
+
+struct BinaryMeshHeader
+{
+	uint32_t mMagic;
+	uint32_t mVersion;
+	uint32_t mNumMeshes;
+	uint32_t mNumVertices;
+	uint32_t mNumIndices;
+	uint32_t mNumMaterials;
+	uint32_t mNumClusters;
+	uint32_t mClusterSize;                // Triangles per cluster
+	float    mScale;                      // The positions are stored scaled, then offset
+	float    mOffset[3];
+	uint64_t mMeshesOffset;               // BinaryMeshInfo per mesh, in the order of the source file
+	uint64_t mMaterialsOffset;            // BinaryMeshMaterial per material of the source file
+	uint64_t mStringsOffset;              // Null terminated strings the materials point to
+	uint64_t mPositionsOffset;            // 3 floats per vertex
+	uint64_t mNormalsOffset;              // 3 floats per vertex
+	uint64_t mTangentsOffset;             // 3 floats per vertex
+	uint64_t mTexCoordsOffset;            // 2 floats per vertex, as imported
+	uint64_t mPackedNormalsOffset;        // uint32_t per vertex, octahedral encoding in 2 unorm16
+	uint64_t mPackedTangentsOffset;       // uint32_t per vertex, octahedral encoding in 2 unorm16
+	uint64_t mPackedTexCoordsOffset;      // uint32_t per vertex, 2 halfs
+	uint64_t mIndicesOffset;              // uint32_t per index, relative to the first vertex of the file
+	uint64_t mClusterCompactsOffset;      // BinaryMeshClusterCompact per cluster
+	uint64_t mClustersOffset;             // BinaryMeshCluster per cluster
+	uint64_t mFileSize;
+};
+
+struct BinaryMeshInfo
+{
+	uint32_t mStartIndex;
+	uint32_t mIndexCount;
+	uint32_t mStartVertex;
+	uint32_t mVertexCount;
+	uint32_t mMaterialId;
+	uint32_t mClusterStart;    // First cluster of the mesh in the cluster arrays
+	uint32_t mClusterCount;
+	float    mMin[3];
+	float    mMax[3];
+};
+
+struct BinaryMeshMaterial
+{
+	uint32_t mName;           // Offsets into the strings, textures that are not set point to an empty string
+	uint32_t mDiffuseMap;
+	uint32_t mNormalMap;
+	uint32_t mSpecularMap;
+	uint32_t mFlags;
+};
+
+struct BinaryMeshClusterCompact
+{
+	uint32_t mTriangleCount;
+	uint32_t mClusterStart;    // First triangle of the cluster, relative to the mesh
+};
+
+// Bounds and backface culling cone of mClusterSize consecutive triangles of a mesh. The clusters are built as if every
+// material was one sided, a loader has to mark the clusters of two sided materials invalid
+struct BinaryMeshCluster
+{
+	float   mAabbMin[3];
+	float   mAabbMax[3];
+	float   mConeCenter[3];
+	float   mConeAxis[3];
+	float   mConeAngleCosine;
+	float   mDistanceFromCamera;
+	uint8_t mValid;
+	uint8_t mPad[3];
+};
@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "MeshOptimizer.h"
+
+#include <math.h>
+#include <string.h>
+
+// Tiny stl
+#include "../../ThirdParty/OpenSource/EASTL/vector.h"
+#include "../../ThirdParty/OpenSource/EASTL/sort.h"
+
+#include "../../OS/Interfaces/IMemoryManager.h"    //NOTE: this should be the last include in a .cpp
+
+// Tuning of the Forsyth scoring, the values are the ones from the original article
+static const uint32_t gForsythCacheSize = 32;
+static const uint32_t gForsythMaxValence = 32;
+static const float    gForsythCacheDecayPower = 1.5f;
+static const float    gForsythLastTriangleScore = 0.75f;
+static const float    gForsythValenceBoostScale = 2.0f;
+static const float    gForsythValenceBoostPower = 0.5f;
+
+static const uint32_t gInvalidIndex = ~0u;
+
+struct ForsythScoreTable
+{
+	float mCache[gForsythCacheSize];
+	float mValence[gForsythMaxValence + 1];
+
+	ForsythScoreTable()
+	{
+		for (uint32_t i = 0; i < gForsythCacheSize; ++i)
+		{
+			// The vertices of the last triangle get a fixed score, so the next triangle does not simply reuse its edge
+			if (i < 3)
+				mCache[i] = gForsythLastTriangleScore;
+			else
+				mCache[i] = powf(1.0f - (float)(i - 3) / (float)(gForsythCacheSize - 3), gForsythCacheDecayPower);
+		}
+
+		// Vertices with few triangles left are boosted, to finish them off instead of leaving lone triangles behind
+		mValence[0] = 0.0f;
+		for (uint32_t i = 1; i <= gForsythMaxValence; ++i)
+			mValence[i] = gForsythValenceBoostScale * powf((float)i, -gForsythValenceBoostPower);
+	}
+
+	float GetScore(int cachePosition, uint32_t remainingTriangles) const
+	{
+		if (remainingTriangles == 0)
+			return -1.0f;
+
+		float score = cachePosition >= 0 ? mCache[cachePosition] : 0.0f;
+		return score + mValence[remainingTriangles < gForsythMaxValence ? remainingTriangles : gForsythMaxValence];
+	}
+};
+
+// Returns the number of vertices of triangle that miss a FIFO cache, tracked with the time each vertex entered it
+static inline uint32_t
+	SimulateFifoCache(const uint32_t* pTriangle, uint32_t* pCacheTimes, uint32_t* pTime, uint32_t cacheSize)
+{
+	uint32_t misses = 0;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		const uint32_t vertex = pTriangle[i];
+		if (*pTime - pCacheTimes[vertex] > cacheSize)
+		{
+			pCacheTimes[vertex] = (*pTime)++;
+			++misses;
+		}
+	}
+	return misses;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t* pDstIndices, const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount)
+{
+	static const ForsythScoreTable scoreTable;
+
+	const uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// The output may overwrite the input
+	eastl::vector<uint32_t> indices(pIndices, pIndices + triangleCount * 3);
+
+	// Triangles using each vertex. The first remaining[v] entries of a vertex v are the ones not emitted yet
+	eastl::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	eastl::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; ++i)
+		++remaining[indices[i]];
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+
+	eastl::vector<uint32_t> adjacency(triangleCount * 3);
+	eastl::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		for (uint32_t i = 0; i < 3; ++i)
+			adjacency[fill[indices[t * 3 + i]]++] = t;
+	}
+
+	eastl::vector<int>   cachePositions(vertexCount, -1);
+	eastl::vector<float> vertexScores(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		vertexScores[v] = scoreTable.GetScore(-1, remaining[v]);
+
+	eastl::vector<float> triangleScores(triangleCount);
+	eastl::vector<bool>  emitted(triangleCount, false);
+	uint32_t             bestTriangle = 0;
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		const uint32_t* pTriangle = &indices[t * 3];
+		triangleScores[t] = vertexScores[pTriangle[0]] + vertexScores[pTriangle[1]] + vertexScores[pTriangle[2]];
+		if (triangleScores[t] > triangleScores[bestTriangle])
+			bestTriangle = t;
+	}
+
+	// Simulated LRU cache, with room for the vertices pushed out by the triangle being added
+	uint32_t cache[gForsythCacheSize + 3];
+	uint32_t newCache[gForsythCacheSize + 3];
+	uint32_t cacheCount = 0;
+	uint32_t nextUnemitted = 0;
+
+	for (uint32_t output = 0; output < triangleCount; ++output)
+	{
+		// None of the triangles around the cache is left, restart from the next one in input order
+		if (bestTriangle == gInvalidIndex)
+		{
+			while (emitted[nextUnemitted])
+				++nextUnemitted;
+			bestTriangle = nextUnemitted;
+		}
+
+		const uint32_t* pTriangle = &indices[bestTriangle * 3];
+		pDstIndices[output * 3 + 0] = pTriangle[0];
+		pDstIndices[output * 3 + 1] = pTriangle[1];
+		pDstIndices[output * 3 + 2] = pTriangle[2];
+		emitted[bestTriangle] = true;
+
+		uint32_t newCacheCount = 0;
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			const uint32_t vertex = pTriangle[i];
+
+			// Remove the triangle from the ones left around the vertex
+			uint32_t* pAdjacency = &adjacency[adjacencyOffsets[vertex]];
+			for (uint32_t j = 0; j < remaining[vertex]; ++j)
+			{
+				if (pAdjacency[j] == bestTriangle)
+				{
+					pAdjacency[j] = pAdjacency[remaining[vertex] - 1];
+					--remaining[vertex];
+					break;
+				}
+			}
+
+			bool inNewCache = false;
+			for (uint32_t j = 0; j < newCacheCount; ++j)
+				inNewCache |= newCache[j] == vertex;
+			if (!inNewCache)
+				newCache[newCacheCount++] = vertex;
+		}
+
+		// The triangle goes to the front of the cache, followed by the vertices that were in it before
+		for (uint32_t i = 0; i < cacheCount; ++i)
+		{
+			const uint32_t vertex = cache[i];
+			if (vertex != pTriangle[0] && vertex != pTriangle[1] && vertex != pTriangle[2])
+				newCache[newCacheCount++] = vertex;
+		}
+
+		// Rescore the vertices that moved or fell out of the cache, and the triangles around them
+		for (uint32_t i = 0; i < newCacheCount; ++i)
+		{
+			const uint32_t vertex = newCache[i];
+			cachePositions[vertex] = i < gForsythCacheSize ? (int)i : -1;
+
+			const float score = scoreTable.GetScore(cachePositions[vertex], remaining[vertex]);
+			const float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+
+			const uint32_t* pAdjacency = &adjacency[adjacencyOffsets[vertex]];
+			for (uint32_t j = 0; j < remaining[vertex]; ++j)
+				triangleScores[pAdjacency[j]] += delta;
+		}
+
+		cacheCount = newCacheCount < gForsythCacheSize ? newCacheCount : gForsythCacheSize;
+		memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+
+		// The next triangle is the best one using a vertex in the cache
+		bestTriangle = gInvalidIndex;
+		float bestScore = -1.0f;
+		for (uint32_t i = 0; i < cacheCount; ++i)
+		{
+			const uint32_t  vertex = cache[i];
+			const uint32_t* pAdjacency = &adjacency[adjacencyOffsets[vertex]];
+			for (uint32_t j = 0; j < remaining[vertex]; ++j)
+			{
+				if (triangleScores[pAdjacency[j]] > bestScore)
+				{
+					bestScore = triangleScores[pAdjacency[j]];
+					bestTriangle = pAdjacency[j];
+				}
+			}
+		}
+	}
+}
+
+struct OverdrawCluster
+{
+	uint32_t mStart;
+	uint32_t mEnd;
+	float    mSortKey;
+	uint32_t mIndex;
+
+	bool operator<(const OverdrawCluster& other) const
+	{
+		// Outermost clusters first, ties keep the input order so the output does not depend on the sort
+		if (mSortKey != other.mSortKey)
+			return mSortKey > other.mSortKey;
+		return mIndex < other.mIndex;
+	}
+};
+
+void MeshOptimizer::OptimizeOverdraw(
+	uint32_t* pDstIndices, const uint32_t* pIndices, uint32_t indexCount, const float* pPositions, uint32_t vertexCount,
+	float threshold)
+{
+	const uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	eastl::vector<uint32_t> indices(pIndices, pIndices + triangleCount * 3);
+
+	eastl::vector<uint32_t> cacheTimes(vertexCount, 0);
+	uint32_t                time = MESH_OPTIMIZER_CACHE_SIZE + 1;
+
+	// Hard boundaries are the triangles that miss the cache with all their vertices. Reordering at those points
+	// costs nothing, as the cache starts over there anyway
+	eastl::vector<uint32_t> hardBoundaries;
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		if (SimulateFifoCache(&indices[t * 3], cacheTimes.data(), &time, MESH_OPTIMIZER_CACHE_SIZE) == 3 || t == 0)
+			hardBoundaries.push_back(t);
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// Soft boundaries split the hard clusters further, as soon as the part so far is within threshold of the ACMR of
+	// the whole cluster when started with an empty cache
+	eastl::vector<OverdrawCluster> clusters;
+	for (uint32_t c = 0; c + 1 < (uint32_t)hardBoundaries.size(); ++c)
+	{
+		const uint32_t start = hardBoundaries[c];
+		const uint32_t end = hardBoundaries[c + 1];
+
+		time += MESH_OPTIMIZER_CACHE_SIZE + 1;
+		uint32_t clusterMisses = 0;
+		for (uint32_t t = start; t < end; ++t)
+			clusterMisses += SimulateFifoCache(&indices[t * 3], cacheTimes.data(), &time, MESH_OPTIMIZER_CACHE_SIZE);
+		const float maxACMR = threshold * (float)clusterMisses / (float)(end - start);
+
+		time += MESH_OPTIMIZER_CACHE_SIZE + 1;
+		uint32_t clusterStart = start;
+		uint32_t misses = 0;
+		for (uint32_t t = start; t < end; ++t)
+		{
+			misses += SimulateFifoCache(&indices[t * 3], cacheTimes.data(), &time, MESH_OPTIMIZER_CACHE_SIZE);
+			if (t + 1 < end && (float)misses <= maxACMR * (float)(t + 1 - clusterStart))
+			{
+				clusters.push_back({ clusterStart, t + 1, 0.0f, (uint32_t)clusters.size() });
+				clusterStart = t + 1;
+				misses = 0;
+				time += MESH_OPTIMIZER_CACHE_SIZE + 1;
+			}
+		}
+		clusters.push_back({ clusterStart, end, 0.0f, (uint32_t)clusters.size() });
+	}
+
+	// Area weighted centroid and average normal of every cluster, the mesh centroid is weighted the same way
+	eastl::vector<float> clusterCentroids(clusters.size() * 3, 0.0f);
+	eastl::vector<float> clusterNormals(clusters.size() * 3, 0.0f);
+	float                meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float                meshArea = 0.0f;
+	for (uint32_t c = 0; c < (uint32_t)clusters.size(); ++c)
+	{
+		float* pCentroid = &clusterCentroids[c * 3];
+		float* pNormal = &clusterNormals[c * 3];
+		float  area = 0.0f;
+		for (uint32_t t = clusters[c].mStart; t < clusters[c].mEnd; ++t)
+		{
+			const float* p0 = &pPositions[indices[t * 3 + 0] * 3];
+			const float* p1 = &pPositions[indices[t * 3 + 1] * 3];
+			const float* p2 = &pPositions[indices[t * 3 + 2] * 3];
+
+			const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			const float triangleArea = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (uint32_t i = 0; i < 3; ++i)
+			{
+				pCentroid[i] += (p0[i] + p1[i] + p2[i]) * (triangleArea / 3.0f);
+				pNormal[i] += n[i];
+			}
+			area += triangleArea;
+		}
+
+		for (uint32_t i = 0; i < 3; ++i)
+			meshCentroid[i] += pCentroid[i];
+		meshArea += area;
+
+		const float invArea = area > 0.0f ? 1.0f / area : 0.0f;
+		const float normalLength = sqrtf(pNormal[0] * pNormal[0] + pNormal[1] * pNormal[1] + pNormal[2] * pNormal[2]);
+		const float invNormalLength = normalLength > 0.0f ? 1.0f / normalLength : 0.0f;
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			pCentroid[i] *= invArea;
+			pNormal[i] *= invNormalLength;
+		}
+	}
+
+	const float invMeshArea = meshArea > 0.0f ? 1.0f / meshArea : 0.0f;
+	for (uint32_t i = 0; i < 3; ++i)
+		meshCentroid[i] *= invMeshArea;
+
+	// Clusters far out along their own normal are likely to occlude the rest of the mesh from the side they face
+	for (uint32_t c = 0; c < (uint32_t)clusters.size(); ++c)
+	{
+		const float* pCentroid = &clusterCentroids[c * 3];
+		const float* pNormal = &clusterNormals[c * 3];
+		clusters[c].mSortKey = (pCentroid[0] - meshCentroid[0]) * pNormal[0] + (pCentroid[1] - meshCentroid[1]) * pNormal[1] +
+							   (pCentroid[2] - meshCentroid[2]) * pNormal[2];
+	}
+
+	eastl::sort(clusters.begin(), clusters.end());
+
+	uint32_t output = 0;
+	for (uint32_t c = 0; c < (uint32_t)clusters.size(); ++c)
+	{
+		const uint32_t count = (clusters[c].mEnd - clusters[c].mStart) * 3;
+		memcpy(&pDstIndices[output], &indices[clusters[c].mStart * 3], count * sizeof(uint32_t));
+		output += count;
+	}
+}
+
+uint32_t MeshOptimizer::OptimizeVertexFetch(uint32_t* pRemap, uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount)
+{
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		pRemap[v] = gInvalidIndex;
+
+	uint32_t nextVertex = 0;
+	for (uint32_t i = 0; i < indexCount; ++i)
+	{
+		const uint32_t vertex = pIndices[i];
+		if (pRemap[vertex] == gInvalidIndex)
+			pRemap[vertex] = nextVertex++;
+		pIndices[i] = pRemap[vertex];
+	}
+
+	return nextVertex;
+}
+
+void MeshOptimizer::RemapVertices(void* pDst, const void* pSrc, uint32_t vertexCount, uint32_t vertexSize, const uint32_t* pRemap)
+{
+	const uint8_t* pSrcBytes = (const uint8_t*)pSrc;
+	uint8_t*       pDstBytes = (uint8_t*)pDst;
+	for (uint32_t v = 0; v < vertexCount; ++v)
+	{
+		if (pRemap[v] != gInvalidIndex)
+			memcpy(pDstBytes + (size_t)pRemap[v] * vertexSize, pSrcBytes + (size_t)v * vertexSize, vertexSize);
+	}
+}
+
+VertexCacheStatistics
+	MeshOptimizer::AnalyzeVertexCache(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStatistics stats = {};
+	const uint32_t        triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return stats;
+
+	eastl::vector<uint32_t> cacheTimes(vertexCount, 0);
+	uint32_t                time = cacheSize + 1;
+	for (uint32_t t = 0; t < triangleCount; ++t)
+		stats.mVerticesTransformed += SimulateFifoCache(&pIndices[t * 3], cacheTimes.data(), &time, cacheSize);
+
+	// Every vertex that was transformed at least once has a time set
+	uint32_t verticesUsed = 0;
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		verticesUsed += cacheTimes[v] != 0;
+
+	stats.mACMR = (float)stats.mVerticesTransformed / (float)triangleCount;
+	stats.mATVR = (float)stats.mVerticesTransformed / (float)verticesUsed;
+	return stats;
+}
+
+VertexFetchStatistics
+	MeshOptimizer::AnalyzeVertexFetch(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, uint32_t vertexSize)
+{
+	// Direct mapped 4 KB cache. Only vertices missing the post transform cache are fetched
+	const uint32_t lineSize = 64;
+	const uint32_t lineCount = 64;
+
+	VertexFetchStatistics stats = {};
+	if (indexCount == 0 || vertexSize == 0)
+		return stats;
+
+	eastl::vector<uint32_t> cacheTimes(vertexCount, 0);
+	uint32_t                time = MESH_OPTIMIZER_CACHE_SIZE + 1;
+	size_t                  lines[lineCount];
+	for (uint32_t i = 0; i < lineCount; ++i)
+		lines[i] = ~(size_t)0;
+
+	for (uint32_t t = 0; t < indexCount / 3; ++t)
+	{
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			const uint32_t vertex = pIndices[t * 3 + i];
+			if (time - cacheTimes[vertex] <= MESH_OPTIMIZER_CACHE_SIZE)
+				continue;
+			cacheTimes[vertex] = time++;
+
+			const size_t start = (size_t)vertex * vertexSize;
+			for (size_t line = start / lineSize; line <= (start + vertexSize - 1) / lineSize; ++line)
+			{
+				if (lines[line % lineCount] != line)
+				{
+					lines[line % lineCount] = line;
+					stats.mBytesFetched += lineSize;
+				}
+			}
+		}
+	}
+
+	uint32_t verticesUsed = 0;
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		verticesUsed += cacheTimes[v] != 0;
+
+	stats.mOverfetch = verticesUsed ? (float)stats.mBytesFetched / (float)(verticesUsed * vertexSize) : 0.0f;
+	return stats;
+}
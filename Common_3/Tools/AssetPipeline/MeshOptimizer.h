@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Size of the FIFO post transform cache the statistics are simulated with. Recent GPUs behave
+// roughly like a cache of this size, the exact number matters little for the ordering
+const uint32_t MESH_OPTIMIZER_CACHE_SIZE = 16;
+
+struct VertexCacheStatistics
+{
+	uint32_t mVerticesTransformed;
+	float    mACMR;    // Average cache miss ratio, vertices transformed per triangle. 0.5 is the best a regular grid can get
+	float    mATVR;    // Average transform to vertex ratio, vertices transformed per vertex used. 1 is the best possible
+};
+
+struct VertexFetchStatistics
+{
+	uint32_t mBytesFetched;
+	float    mOverfetch;    // Bytes fetched from memory per byte of vertex data used. 1 is the best possible
+};
+
+// Reorders triangle lists for the GPU. The functions work on a single mesh with 32 bit indices,
+// pDstIndices may be the same array as pIndices.
+class MeshOptimizer
+{
+	public:
+	// Orders the triangles to reuse the post transform cache as much as possible, using Tom Forsyth's
+	// linear-speed vertex cache optimisation
+	static void OptimizeVertexCache(uint32_t* pDstIndices, const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount);
+
+	// Orders clusters of triangles from the outside of the mesh in, so closer surfaces tend to be drawn first from any
+	// view (Sander et al. 2007). Expects triangles ordered by OptimizeVertexCache. The triangles are only split where the
+	// ACMR of the result stays within threshold times the one of the input, 1.05 is a good trade-off
+	static void OptimizeOverdraw(
+		uint32_t* pDstIndices, const uint32_t* pIndices, uint32_t indexCount, const float* pPositions, uint32_t vertexCount,
+		float threshold);
+
+	// Builds a remap table that orders the vertices by first use and applies it to the indices, so vertex fetches walk
+	// through memory linearly. Unused vertices are dropped, returns the number of vertices left
+	static uint32_t OptimizeVertexFetch(uint32_t* pRemap, uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount);
+
+	// Moves the vertices of a stream to their position in the remap table of OptimizeVertexFetch. pDst can not be pSrc
+	static void RemapVertices(void* pDst, const void* pSrc, uint32_t vertexCount, uint32_t vertexSize, const uint32_t* pRemap);
+
+	// Simulates a FIFO post transform cache of cacheSize vertices
+	static VertexCacheStatistics
+		AnalyzeVertexCache(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize);
+
+	// Simulates fetching vertices of vertexSize bytes through a small cache of 64 byte lines
+	static VertexFetchStatistics
+		AnalyzeVertexFetch(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, uint32_t vertexSize);
+};
@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/sort.h"
+#include "../../Common_3/OS/Interfaces/IFileSystem.h"
+#include "../../Common_3/OS/Interfaces/ILogManager.h"
+
+#include "Benchmark.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include <cstdio>
+
+#include "../../Common_3/OS/Interfaces/IMemoryManager.h"
+
+int64_t getBenchmarkTimeNs()
+{
+#if defined(_WIN32)
+	static LARGE_INTEGER frequency = {};
+	if (!frequency.QuadPart)
+		QueryPerformanceFrequency(&frequency);
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (int64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+#endif
+}
+
+// Nearest rank percentile of sorted samples
+static double getPercentile(const eastl::vector<int64_t>& sortedSamples, double percentile)
+{
+	const uint32_t count = (uint32_t)sortedSamples.size();
+	const uint32_t rank = (uint32_t)ceil(percentile * count);
+	return (double)sortedSamples[clamp(rank, 1u, count) - 1];
+}
+
+void runBenchmark(const BenchmarkDesc* pDesc, BenchmarkResult* pResult)
+{
+	ASSERT(pDesc->pFunc);
+	const uint32_t iterations = max(pDesc->mIterations, 1u);
+
+	for (uint32_t i = 0; i < pDesc->mWarmupIterations; ++i)
+		pDesc->pFunc(pDesc->pUserData);
+
+	// Reserve up front so the harness does not show up in the allocation counters
+	eastl::vector<int64_t> samples(iterations);
+
+	BenchmarkMemoryCounters start = {};
+	getBenchmarkMemoryCounters(&start);
+	resetBenchmarkMemoryPeak();
+	const uint64_t baseBytes = start.mCurrentBytes;
+
+	uint64_t allocations = 0;
+	uint64_t allocatedBytes = 0;
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		BenchmarkMemoryCounters before = {};
+		BenchmarkMemoryCounters after = {};
+		getBenchmarkMemoryCounters(&before);
+		const int64_t t0 = getBenchmarkTimeNs();
+		pDesc->pFunc(pDesc->pUserData);
+		samples[i] = getBenchmarkTimeNs() - t0;
+		getBenchmarkMemoryCounters(&after);
+		allocations += after.mAllocationCount - before.mAllocationCount;
+		allocatedBytes += after.mAllocatedBytes - before.mAllocatedBytes;
+	}
+
+	BenchmarkMemoryCounters end = {};
+	getBenchmarkMemoryCounters(&end);
+
+	eastl::sort(samples.begin(), samples.end());
+	double total = 0.0;
+	for (int64_t sample : samples)
+		total += (double)sample;
+	const double mean = total / iterations;
+	double variance = 0.0;
+	for (int64_t sample : samples)
+		variance += ((double)sample - mean) * ((double)sample - mean);
+
+	pResult->mGroup = pDesc->pGroup ? pDesc->pGroup : "";
+	pResult->mName = pDesc->pName ? pDesc->pName : "";
+	pResult->mInput = pDesc->pInput ? pDesc->pInput : "";
+	pResult->mIterations = iterations;
+	pResult->mMinNs = (double)samples.front();
+	pResult->mMaxNs = (double)samples.back();
+	pResult->mMeanNs = mean;
+	pResult->mMedianNs = getPercentile(samples, 0.5);
+	pResult->mP90Ns = getPercentile(samples, 0.9);
+	pResult->mP99Ns = getPercentile(samples, 0.99);
+	pResult->mStdDevNs = sqrt(variance / iterations);
+	pResult->mThroughputMBs = (pDesc->mBytesPerIteration && pResult->mMedianNs > 0.0)
+								  ? ((double)pDesc->mBytesPerIteration / (1024.0 * 1024.0)) / (pResult->mMedianNs * 1e-9)
+								  : 0.0;
+	pResult->mItemsPerSecond =
+		(pDesc->mItemsPerIteration && pResult->mMedianNs > 0.0) ? (double)pDesc->mItemsPerIteration / (pResult->mMedianNs * 1e-9) : 0.0;
+	pResult->mAllocationsPerIteration = (double)allocations / iterations;
+	pResult->mAllocatedBytesPerIteration = (double)allocatedBytes / iterations;
+	pResult->mPeakBytes = end.mPeakBytes > baseBytes ? end.mPeakBytes - baseBytes : 0;
+}
+
+void printBenchmarkResults(const eastl::vector<BenchmarkResult>& results)
+{
+	printf(
+		"%-10s %-24s %-28s %12s %12s %12s %10s %10s %12s %10s %12s\n", "group", "operation", "input", "median us", "p90 us", "p99 us",
+		"stddev %", "MB/s", "items/s", "allocs", "peak KB");
+	for (const BenchmarkResult& result : results)
+	{
+		printf(
+			"%-10s %-24s %-28s %12.2f %12.2f %12.2f %10.1f %10.2f %12.0f %10.1f %12.1f\n", result.mGroup.c_str(), result.mName.c_str(),
+			result.mInput.c_str(), result.mMedianNs / 1000.0, result.mP90Ns / 1000.0, result.mP99Ns / 1000.0,
+			result.mMeanNs > 0.0 ? 100.0 * result.mStdDevNs / result.mMeanNs : 0.0, result.mThroughputMBs, result.mItemsPerSecond,
+			result.mAllocationsPerIteration, result.mPeakBytes / 1024.0);
+	}
+}
+
+static eastl::string escapeJson(const eastl::string& str)
+{
+	eastl::string escaped;
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+			escaped.push_back('\\');
+		escaped.push_back(c);
+	}
+	return escaped;
+}
+
+bool writeBenchmarkResultsJson(const eastl::vector<BenchmarkResult>& results, const char* pSuiteName, const char* pFileName)
+{
+	eastl::string json;
+	json.append_sprintf("{\n\t\"suite\": \"%s\",\n", escapeJson(pSuiteName).c_str());
+	json.append_sprintf("\t\"memoryTracking\": %s,\n", isBenchmarkMemoryTrackingEnabled() ? "true" : "false");
+	json.append("\t\"results\": [\n");
+	for (uint32_t i = 0; i < (uint32_t)results.size(); ++i)
+	{
+		const BenchmarkResult& result = results[i];
+		json.append_sprintf(
+			"\t\t{ \"group\": \"%s\", \"name\": \"%s\", \"input\": \"%s\", \"iterations\": %u, ", escapeJson(result.mGroup).c_str(),
+			escapeJson(result.mName).c_str(), escapeJson(result.mInput).c_str(), result.mIterations);
+		json.append_sprintf(
+			"\"minNs\": %.1f, \"meanNs\": %.1f, \"medianNs\": %.1f, \"p90Ns\": %.1f, \"p99Ns\": %.1f, \"maxNs\": %.1f, \"stdDevNs\": %.1f, ",
+			result.mMinNs, result.mMeanNs, result.mMedianNs, result.mP90Ns, result.mP99Ns, result.mMaxNs, result.mStdDevNs);
+		json.append_sprintf(
+			"\"throughputMBs\": %.3f, \"itemsPerSecond\": %.1f, \"allocationsPerIteration\": %.2f, \"allocatedBytesPerIteration\": %.1f, "
+			"\"peakBytes\": %llu }%s\n",
+			result.mThroughputMBs, result.mItemsPerSecond, result.mAllocationsPerIteration, result.mAllocatedBytesPerIteration,
+			(unsigned long long)result.mPeakBytes, i + 1 < (uint32_t)results.size() ? "," : "");
+	}
+	json.append("\t]\n}\n");
+
+	File file;
+	if (!file.Open(pFileName, FM_Write, FSR_Absolute))
+	{
+		LOGF(LogLevel::eERROR, "Failed to open \"%s\" for writing benchmark results", pFileName);
+		return false;
+	}
+	file.Write(json.c_str(), (unsigned)json.size());
+	file.Close();
+	return true;
+}
+
+// The loader only understands the layout produced by writeBenchmarkResultsJson (one result object per line)
+static bool findJsonValue(const eastl::string& line, const char* pKey, eastl::string::size_type* pValueStart)
+{
+	eastl::string key;
+	key.sprintf("\"%s\": ", pKey);
+	eastl::string::size_type pos = line.find(key);
+	if (pos == eastl::string::npos)
+		return false;
+	*pValueStart = pos + key.size();
+	return true;
+}
+
+static eastl::string readJsonString(const eastl::string& line, const char* pKey)
+{
+	eastl::string            value;
+	eastl::string::size_type pos = 0;
+	if (!findJsonValue(line, pKey, &pos) || line[pos] != '"')
+		return value;
+
+	for (++pos; pos < line.size() && line[pos] != '"'; ++pos)
+	{
+		if (line[pos] == '\\' && pos + 1 < line.size())
+			++pos;
+		value.push_back(line[pos]);
+	}
+	return value;
+}
+
+static double readJsonNumber(const eastl::string& line, const char* pKey)
+{
+	eastl::string::size_type pos = 0;
+	if (!findJsonValue(line, pKey, &pos))
+		return 0.0;
+	return atof(line.c_str() + pos);
+}
+
+bool loadBenchmarkResultsJson(const char* pFileName, eastl::vector<BenchmarkResult>& results)
+{
+	File file;
+	if (!file.Open(pFileName, FM_ReadBinary, FSR_Absolute))
+	{
+		LOGF(LogLevel::eERROR, "Failed to open benchmark baseline \"%s\"", pFileName);
+		return false;
+	}
+	eastl::string json = file.ReadText();
+	file.Close();
+
+	eastl::string::size_type lineStart = 0;
+	while (lineStart < json.size())
+	{
+		eastl::string::size_type lineEnd = json.find('\n', lineStart);
+		if (lineEnd == eastl::string::npos)
+			lineEnd = json.size();
+		const eastl::string line = json.substr(lineStart, lineEnd - lineStart);
+		lineStart = lineEnd + 1;
+
+		if (line.find("\"group\": ") == eastl::string::npos)
+			continue;
+
+		BenchmarkResult result = {};
+		result.mGroup = readJsonString(line, "group");
+		result.mName = readJsonString(line, "name");
+		result.mInput = readJsonString(line, "input");
+		result.mIterations = (uint32_t)readJsonNumber(line, "iterations");
+		result.mMinNs = readJsonNumber(line, "minNs");
+		result.mMeanNs = readJsonNumber(line, "meanNs");
+		result.mMedianNs = readJsonNumber(line, "medianNs");
+		result.mP90Ns = readJsonNumber(line, "p90Ns");
+		result.mP99Ns = readJsonNumber(line, "p99Ns");
+		result.mMaxNs = readJsonNumber(line, "maxNs");
+		result.mStdDevNs = readJsonNumber(line, "stdDevNs");
+		result.mThroughputMBs = readJsonNumber(line, "throughputMBs");
+		result.mItemsPerSecond = readJsonNumber(line, "itemsPerSecond");
+		result.mAllocationsPerIteration = readJsonNumber(line, "allocationsPerIteration");
+		result.mAllocatedBytesPerIteration = readJsonNumber(line, "allocatedBytesPerIteration");
+		result.mPeakBytes = (uint64_t)readJsonNumber(line, "peakBytes");
+		results.push_back(result);
+	}
+
+	return true;
+}
+
+uint32_t compareBenchmarkResults(
+	const eastl::vector<BenchmarkResult>& baseline, const eastl::vector<BenchmarkResult>& results, double regressionThreshold)
+{
+	uint32_t regressions = 0;
+	printf(
+		"\n%-10s %-24s %-28s %14s %14s %10s %10s\n", "group", "operation", "input", "base median us", "median us", "delta %", "status");
+	for (const BenchmarkResult& result : results)
+	{
+		const BenchmarkResult* pBase = NULL;
+		for (const BenchmarkResult& base : baseline)
+		{
+			if (base.mGroup == result.mGroup && base.mName == result.mName && base.mInput == result.mInput)
+			{
+				pBase = &base;
+				break;
+			}
+		}
+
+		if (!pBase || pBase->mMedianNs <= 0.0)
+		{
+			printf(
+				"%-10s %-24s %-28s %14s %14.2f %10s %10s\n", result.mGroup.c_str(), result.mName.c_str(), result.mInput.c_str(), "-",
+				result.mMedianNs / 1000.0, "-", "new");
+			continue;
+		}
+
+		const double delta = (result.mMedianNs - pBase->mMedianNs) / pBase->mMedianNs;
+		const char*  pStatus = "ok";
+		if (delta > regressionThreshold)
+		{
+			pStatus = "REGRESSED";
+			++regressions;
+		}
+		else if (delta < -regressionThreshold)
+		{
+			pStatus = "improved";
+		}
+
+		printf(
+			"%-10s %-24s %-28s %14.2f %14.2f %+10.1f %10s\n", result.mGroup.c_str(), result.mName.c_str(), result.mInput.c_str(),
+			pBase->mMedianNs / 1000.0, result.mMedianNs / 1000.0, delta * 100.0, pStatus);
+	}
+
+	printf("%u regression(s) above %.1f%%\n", regressions, regressionThreshold * 100.0);
+	return regressions;
+}
+
+void initBenchmarkOptions(BenchmarkOptions* pOptions, const char* pDefaultJsonFile, uint32_t defaultIterations)
+{
+	pOptions->mIterations = defaultIterations;
+	pOptions->mWarmupIterations = 1;
+	pOptions->mFilter = "";
+	pOptions->mJsonFile = pDefaultJsonFile;
+	pOptions->mBaselineFile = "";
+	pOptions->mRegressionThreshold = 0.1;
+}
+
+bool parseBenchmarkOption(BenchmarkOptions* pOptions, int argc, char** argv, int* pIndex)
+{
+	eastl::string arg = argv[*pIndex];
+	arg.make_lower();
+	if (*pIndex + 1 >= argc)
+		return false;
+
+	const char* pValue = argv[*pIndex + 1];
+	if (arg == "--iterations")
+		pOptions->mIterations = (uint32_t)max(atoi(pValue), 1);
+	else if (arg == "--warmup")
+		pOptions->mWarmupIterations = (uint32_t)max(atoi(pValue), 0);
+	else if (arg == "--filter")
+		pOptions->mFilter = pValue;
+	else if (arg == "--json")
+		pOptions->mJsonFile = pValue;
+	else if (arg == "--compare")
+		pOptions->mBaselineFile = pValue;
+	else if (arg == "--threshold")
+		pOptions->mRegressionThreshold = max(atof(pValue), 0.0);
+	else
+		return false;
+
+	++(*pIndex);
+	return true;
+}
+
+void printBenchmarkOptionsHelp()
+{
+	printf("\t--iterations N: Number of measured iterations per benchmark.\n");
+	printf("\t--warmup N: Number of unmeasured iterations run before measuring (default 1).\n");
+	printf("\t--filter group: Only run the benchmark groups containing this string.\n");
+	printf("\t--json file: Output file for the machine readable results.\n");
+	printf("\t--compare baseline.json: Compare the median times against a previously saved result file.\n");
+	printf("\t--threshold T: Relative median slowdown reported as a regression when comparing (default 0.1 = 10%%).\n");
+}
+
+bool isBenchmarkGroupEnabled(const BenchmarkOptions* pOptions, const char* pGroup)
+{
+	return pOptions->mFilter.empty() || eastl::string(pGroup).find(pOptions->mFilter) != eastl::string::npos;
+}
+
+int finishBenchmarks(const eastl::vector<BenchmarkResult>& results, const char* pSuiteName, const BenchmarkOptions* pOptions)
+{
+	printBenchmarkResults(results);
+
+	if (!pOptions->mJsonFile.empty() && !writeBenchmarkResultsJson(results, pSuiteName, pOptions->mJsonFile.c_str()))
+		return 1;
+
+	if (!pOptions->mBaselineFile.empty())
+	{
+		eastl::vector<BenchmarkResult> baseline;
+		if (!loadBenchmarkResultsJson(pOptions->mBaselineFile.c_str(), baseline))
+			return 1;
+		if (compareBenchmarkResults(baseline, results, pOptions->mRegressionThreshold))
+			return 1;
+	}
+
+	return 0;
+}
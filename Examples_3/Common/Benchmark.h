@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Minimal harness shared by the headless benchmark executables.
+// Results are printed as a table, can be written as JSON and compared against a previously saved JSON baseline.
+
+#pragma once
+
+#include "../../Common_3/OS/Interfaces/IOperatingSystem.h"
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/string.h"
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/vector.h"
+
+/// Process wide allocation counters. Only collected where the allocator hooks in BenchmarkMemoryHooks.cpp are available (Linux).
+typedef struct BenchmarkMemoryCounters
+{
+	uint64_t mAllocationCount;
+	uint64_t mAllocatedBytes;
+	uint64_t mCurrentBytes;
+	uint64_t mPeakBytes;
+} BenchmarkMemoryCounters;
+
+bool isBenchmarkMemoryTrackingEnabled();
+void getBenchmarkMemoryCounters(BenchmarkMemoryCounters* pCounters);
+/// Lowers the peak to the current allocation size so the next measurement reports its own peak
+void resetBenchmarkMemoryPeak();
+
+/// Monotonic high resolution time in nanoseconds
+int64_t getBenchmarkTimeNs();
+
+typedef void (*BenchmarkFunc)(void* pUserData);
+
+typedef struct BenchmarkDesc
+{
+	/// Group the benchmark belongs to (e.g. image loader extension)
+	const char*   pGroup;
+	/// Operation being measured
+	const char*   pName;
+	/// Optional input (e.g. file name)
+	const char*   pInput;
+	BenchmarkFunc pFunc;
+	void*         pUserData;
+	uint32_t      mIterations;
+	/// Unmeasured iterations run first to warm up caches, allocators and worker threads
+	uint32_t      mWarmupIterations;
+	/// Bytes processed per iteration. Used to report throughput, 0 disables it
+	uint64_t      mBytesPerIteration;
+	/// Items (tasks, messages, joints...) processed per iteration. Used to report items/s, 0 disables it
+	uint64_t      mItemsPerIteration;
+} BenchmarkDesc;
+
+typedef struct BenchmarkResult
+{
+	eastl::string mGroup;
+	eastl::string mName;
+	eastl::string mInput;
+	uint32_t      mIterations;
+	double        mMinNs;
+	double        mMeanNs;
+	double        mMedianNs;
+	double        mP90Ns;
+	double        mP99Ns;
+	double        mMaxNs;
+	double        mStdDevNs;
+	/// MB/s computed from the median time, 0 if not applicable
+	double        mThroughputMBs;
+	/// Items/s computed from the median time, 0 if not applicable
+	double        mItemsPerSecond;
+	double        mAllocationsPerIteration;
+	double        mAllocatedBytesPerIteration;
+	/// Highest allocation size reached above the level at benchmark start
+	uint64_t      mPeakBytes;
+} BenchmarkResult;
+
+/// Command line options shared by the benchmark executables
+typedef struct BenchmarkOptions
+{
+	uint32_t      mIterations;
+	uint32_t      mWarmupIterations;
+	/// Only groups containing this string are run when not empty
+	eastl::string mFilter;
+	eastl::string mJsonFile;
+	/// Baseline JSON to compare the results against when not empty
+	eastl::string mBaselineFile;
+	/// Relative median change above which a result is reported as a regression (0.1 = 10%)
+	double        mRegressionThreshold;
+} BenchmarkOptions;
+
+void runBenchmark(const BenchmarkDesc* pDesc, BenchmarkResult* pResult);
+void printBenchmarkResults(const eastl::vector<BenchmarkResult>& results);
+bool writeBenchmarkResultsJson(const eastl::vector<BenchmarkResult>& results, const char* pSuiteName, const char* pFileName);
+bool loadBenchmarkResultsJson(const char* pFileName, eastl::vector<BenchmarkResult>& results);
+/// Prints the median delta of every result found in the baseline. Returns the number of regressions
+uint32_t compareBenchmarkResults(
+	const eastl::vector<BenchmarkResult>& baseline, const eastl::vector<BenchmarkResult>& results, double regressionThreshold);
+
+void initBenchmarkOptions(BenchmarkOptions* pOptions, const char* pDefaultJsonFile, uint32_t defaultIterations);
+/// Consumes the option at argv[*pIndex] (and its value) if it is a shared benchmark option
+bool parseBenchmarkOption(BenchmarkOptions* pOptions, int argc, char** argv, int* pIndex);
+void printBenchmarkOptionsHelp();
+bool isBenchmarkGroupEnabled(const BenchmarkOptions* pOptions, const char* pGroup);
+/// Prints, saves and optionally compares the results. Returns the process exit code
+int finishBenchmarks(const eastl::vector<BenchmarkResult>& results, const char* pSuiteName, const BenchmarkOptions* pOptions);
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Allocation tracking for the benchmark executables.
+// On glibc the C allocator entry points are interposed so every allocation is counted, including the ones made by third party
+// code (stb, tinyexr, ozz) which does not go through conf_malloc.
+// NOTE: IMemoryManager.h must not be included here since it redefines malloc and free.
+
+#include "../../Common_3/OS/Core/Atomics.h"
+
+#include "Benchmark.h"
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#define BENCHMARK_MEMORY_HOOKS 1
+#include <malloc.h>
+#include <errno.h>
+
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* ptr, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+	void  __libc_free(void* ptr);
+}
+
+static tfrg_atomic64_t gAllocationCount = 0;
+static tfrg_atomic64_t gAllocatedBytes = 0;
+static tfrg_atomic64_t gCurrentBytes = 0;
+static tfrg_atomic64_t gPeakBytes = 0;
+
+static void trackAllocation(void* ptr)
+{
+	if (!ptr)
+		return;
+
+	const uint64_t size = malloc_usable_size(ptr);
+	tfrg_atomic64_add_relaxed(&gAllocationCount, 1);
+	tfrg_atomic64_add_relaxed(&gAllocatedBytes, size);
+	const uint64_t current = tfrg_atomic64_add_relaxed(&gCurrentBytes, size) + size;
+	tfrg_atomic64_max_relaxed(&gPeakBytes, current);
+}
+
+static void trackDeallocation(void* ptr)
+{
+	if (!ptr)
+		return;
+
+	tfrg_atomic64_add_relaxed(&gCurrentBytes, (uint64_t)0 - (uint64_t)malloc_usable_size(ptr));
+}
+
+extern "C"
+{
+	void* malloc(size_t size)
+	{
+		void* ptr = __libc_malloc(size);
+		trackAllocation(ptr);
+		return ptr;
+	}
+
+	void* calloc(size_t count, size_t size)
+	{
+		void* ptr = __libc_calloc(count, size);
+		trackAllocation(ptr);
+		return ptr;
+	}
+
+	void* realloc(void* ptr, size_t size)
+	{
+		trackDeallocation(ptr);
+		void* newPtr = __libc_realloc(ptr, size);
+		// Failed realloc keeps the original block alive
+		trackAllocation(newPtr ? newPtr : (size ? ptr : NULL));
+		return newPtr;
+	}
+
+	void* memalign(size_t alignment, size_t size)
+	{
+		void* ptr = __libc_memalign(alignment, size);
+		trackAllocation(ptr);
+		return ptr;
+	}
+
+	void* aligned_alloc(size_t alignment, size_t size) { return memalign(alignment, size); }
+
+	int posix_memalign(void** ptr, size_t alignment, size_t size)
+	{
+		*ptr = memalign(alignment, size);
+		return *ptr || !size ? 0 : ENOMEM;
+	}
+
+	void free(void* ptr)
+	{
+		trackDeallocation(ptr);
+		__libc_free(ptr);
+	}
+}
+#endif
+
+bool isBenchmarkMemoryTrackingEnabled()
+{
+#if defined(BENCHMARK_MEMORY_HOOKS)
+	return true;
+#else
+	return false;
+#endif
+}
+
+void getBenchmarkMemoryCounters(BenchmarkMemoryCounters* pCounters)
+{
+#if defined(BENCHMARK_MEMORY_HOOKS)
+	pCounters->mAllocationCount = tfrg_atomic64_load_relaxed(&gAllocationCount);
+	pCounters->mAllocatedBytes = tfrg_atomic64_load_relaxed(&gAllocatedBytes);
+	pCounters->mCurrentBytes = tfrg_atomic64_load_relaxed(&gCurrentBytes);
+	pCounters->mPeakBytes = tfrg_atomic64_load_relaxed(&gPeakBytes);
+#else
+	*pCounters = {};
+#endif
+}
+
+void resetBenchmarkMemoryPeak()
+{
+#if defined(BENCHMARK_MEMORY_HOOKS)
+	tfrg_atomic64_store_relaxed(&gPeakBytes, tfrg_atomic64_load_relaxed(&gCurrentBytes));
+#endif
+}
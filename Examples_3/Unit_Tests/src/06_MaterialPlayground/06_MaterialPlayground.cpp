@@ -466,7 +466,8 @@ uint32_t   gFrameIndex = 0;
 //--------------------------------------------------------------------------------------------
 // THE FORGE OBJECTS
 //--------------------------------------------------------------------------------------------
-UIApp              gAppUI(256);
+// The material names are drawn in world space at any distance, so the glyphs are distance fields
+UIApp              gAppUI(512, 20u, true);
 ICameraController* pCameraController = NULL;
 ICameraController* pLightView = NULL;
 TextDrawDesc       gFrameTimeDraw = TextDrawDesc(0, 0xff00ff00, 18);
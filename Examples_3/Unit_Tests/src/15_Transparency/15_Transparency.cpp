@@ -40,7 +40,6 @@
 #define PT_USE_CAUSTICS (0 & USE_SHADOWS)
 
 //tiny stl
-#include "../../../../Common_3/ThirdParty/OpenSource/EASTL/sort.h"
 #include "../../../../Common_3/ThirdParty/OpenSource/EASTL/string.h"
 #include "../../../../Common_3/ThirdParty/OpenSource/EASTL/vector.h"
 
@@ -50,6 +49,7 @@
 #include "../../../../Common_3/OS/Interfaces/ILogManager.h"
 #include "../../../../Common_3/OS/Interfaces/IFileSystem.h"
 #include "../../../../Common_3/OS/Interfaces/ITimeManager.h"
+#include "../../../../Common_3/OS/Core/DepthSort.h"
 #include "../../../../Common_3/OS/Interfaces/IProfiler.h"
 #include "../../../../Middleware_3/UI/AppUI.h"
 #include "../../../../Common_3/Renderer/IRenderer.h"
@@ -133,7 +133,9 @@ typedef struct ParticleSystem
 	eastl::vector<vec3>  mParticlePositions;
 	eastl::vector<vec3>  mParticleVelocities;
 	eastl::vector<float> mParticleLifetimes;
+	eastl::vector<float> mParticleDistances;    // Squared distances to the camera, the keys of the sort
 	size_t               mLifeParticleCount;
+	DepthSorter*         pParticleSorter;
 } ParticleSystem;
 
 typedef struct Scene
@@ -478,6 +480,13 @@ WBOITVolitionSettings  gWBOITVolitionSettingsData;
 Scene                     gScene;
 eastl::vector<DrawCall> gOpaqueDrawCalls;
 eastl::vector<DrawCall> gTransparentDrawCalls;
+// Objects are identified by their index in gScene.mObjects, particle systems follow the objects. The sort keys and the
+// objects they belong to are built again every frame, the order of the sorters is kept
+eastl::vector<uint32_t> gSortObjectIds;
+eastl::vector<float>    gSortKeys;
+DepthSorter*            pOpaqueObjectSorter = NULL;
+DepthSorter*            pTransparentObjectSorter = NULL;
+eastl::vector<Vertex>   gParticleVertices;
 vec3                      gObjectsCenter = { 0, 0, 0 };
 
 ICameraController* pCameraController = NULL;
@@ -548,10 +557,14 @@ void AddParticleSystem(vec3 position, vec4 color, vec3 translucency = vec3(0.0f)
 	particleBufferDesc.ppBuffer = &pParticleBuffer;
 	addResource(&particleBufferDesc);
 
+	DepthSorter* pParticleSorter = NULL;
+	addDepthSorter(&pParticleSorter);
+
 	gScene.mParticleSystems.push_back(ParticleSystem{
 		pParticleBuffer,
 		Object{ position, scale, orientation, MESH_PARTICLE_SYSTEM, { v4ToF4(color), float4(v3ToF3(translucency), 0.0f), 1.0f, 1.0f } },
-		eastl::vector<vec3>(MAX_NUM_PARTICLES), eastl::vector<vec3>(MAX_NUM_PARTICLES), eastl::vector<float>(MAX_NUM_PARTICLES), 0 });
+		eastl::vector<vec3>(MAX_NUM_PARTICLES), eastl::vector<vec3>(MAX_NUM_PARTICLES), eastl::vector<float>(MAX_NUM_PARTICLES),
+		eastl::vector<float>(MAX_NUM_PARTICLES), 0, pParticleSorter });
 }
 
 static void CreateScene()
@@ -615,25 +628,6 @@ static void CreateScene()
 	AddObject(MESH_SPHERE, vec3(-12.5f - 5.0f, 5.0f, -20.0f), vec4(0.3f, 0.3f, 1.0f, 0.9f), vec3(0.3f, 0.3f, 1.0f), 1.5f, 1.0f, vec3(1.0f));
 }
 
-bool DistanceCompare(const float3& a, const float3& b)
-{
-	if (a.getX() < b.getX())
-		return false;
-	else if (a.getX() > b.getX())
-		return true;
-	if (a.getY() < b.getY())
-		return false;
-	else if (a.getY() > b.getY())
-		return true;
-
-	return false;
-}
-
-bool MeshCompare(const float2& a, const float2& b)
-{
-	return a.getX() > b.getX();
-}
-
 void SwapParticles(ParticleSystem* pParticleSystem, size_t a, size_t b)
 {
 	vec3  pos = pParticleSystem->mParticlePositions[a];
@@ -716,6 +710,10 @@ class Transparency: public IApp
 		CreateScene();
 		finishResourceLoading();
 
+		addDepthSorter(&pOpaqueObjectSorter);
+		addDepthSorter(&pTransparentObjectSorter);
+		gParticleVertices.resize(6 * MAX_NUM_PARTICLES);
+
 		if (!gAppUI.Init(pRenderer))
 			return false;
 		gAppUI.LoadFont("TitilliumText/TitilliumText-Bold.otf", FSR_Builtin_Fonts);
@@ -759,7 +757,12 @@ class Transparency: public IApp
 		gAppUI.Exit();
 
 		for (size_t i = 0; i < gScene.mParticleSystems.size(); ++i)
+		{
 			removeResource(gScene.mParticleSystems[i].pParticleBuffer);
+			removeDepthSorter(gScene.mParticleSystems[i].pParticleSorter);
+		}
+		removeDepthSorter(pOpaqueObjectSorter);
+		removeDepthSorter(pTransparentObjectSorter);
 
 #ifdef TARGET_IOS
 		gVirtualJoystick.Exit();
@@ -909,10 +912,10 @@ class Transparency: public IApp
 
 	void UpdateParticleSystems(float deltaTime, mat4 viewMat, vec3 camPos)
 	{
-		eastl::vector<Vertex> tempVertexBuffer(6 * MAX_NUM_PARTICLES);
-		const float             particleSize = 0.2f;
-		const vec3              camRight = vec3(viewMat[0][0], viewMat[1][0], viewMat[2][0]) * particleSize;
-		const vec3              camUp = vec3(viewMat[0][1], viewMat[1][1], viewMat[2][1]) * particleSize;
+		Vertex*     tempVertexBuffer = gParticleVertices.data();
+		const float particleSize = 0.2f;
+		const vec3  camRight = vec3(viewMat[0][0], viewMat[1][0], viewMat[2][0]) * particleSize;
+		const vec3  camUp = vec3(viewMat[0][1], viewMat[1][1], viewMat[2][1]) * particleSize;
 
 		for (size_t i = 0; i < gScene.mParticleSystems.size(); ++i)
 		{
@@ -956,16 +959,17 @@ class Transparency: public IApp
 			// Update vertex buffers
 			if (gTransparencyType == TRANSPARENCY_TYPE_ALPHA_BLEND && gAlphaBlendSettings.mSortParticles)
 			{
-				eastl::vector<float2> sortedArray;
+				// Particles barely move between frames, so the sorter only has to fix up the order of the last one
+				const uint32_t particleCount = (uint32_t)pParticleSystem->mLifeParticleCount;
+				for (uint32_t j = 0; j < particleCount; ++j)
+					pParticleSystem->mParticleDistances[j] = (float)distSqr(Point3(camPos), Point3(pParticleSystem->mParticlePositions[j]));
 
-				for (size_t j = 0; j < pParticleSystem->mLifeParticleCount; ++j)
-					sortedArray.push_back({ (float)distSqr(Point3(camPos), Point3(pParticleSystem->mParticlePositions[j])), (float)j });
+				const uint32_t* pOrder =
+					sortDepths(pParticleSystem->pParticleSorter, pParticleSystem->mParticleDistances.data(), particleCount);
 
-				eastl::quick_sort(sortedArray.begin(), sortedArray.end(), MeshCompare);
-
-				for (uint j = 0; j < sortedArray.size(); ++j)
+				for (uint j = 0; j < particleCount; ++j)
 				{
-					vec3 pos = pParticleSystem->mParticlePositions[(int)sortedArray[sortedArray.size() - j - 1][1]];
+					vec3 pos = pParticleSystem->mParticlePositions[pOrder[j]];
 					tempVertexBuffer[j * 6 + 0] = { v3ToF3(pos - camUp - camRight), float3(0.0f, 1.0f, 0.0f), float2(0.0f, 0.0f) };
 					tempVertexBuffer[j * 6 + 1] = { v3ToF3(pos + camUp - camRight), float3(0.0f, 1.0f, 0.0f), float2(0.0f, 1.0f) };
 					tempVertexBuffer[j * 6 + 2] = { v3ToF3(pos - camUp + camRight), float3(0.0f, 1.0f, 0.0f), float2(1.0f, 0.0f) };
@@ -988,32 +992,34 @@ class Transparency: public IApp
 				}
 			}
 
-			BufferUpdateDesc particleBufferUpdateDesc = { pParticleSystem->pParticleBuffer, tempVertexBuffer.data() };
+			BufferUpdateDesc particleBufferUpdateDesc = { pParticleSystem->pParticleBuffer, tempVertexBuffer };
 			particleBufferUpdateDesc.mSize = sizeof(Vertex) * 6 * pParticleSystem->mLifeParticleCount;
 			updateResource(&particleBufferUpdateDesc);
 		}
 	}
 
+	// Draws the objects of pObjectIds in the order of pOrder
 	void CreateDrawCalls(
-		float* pSortedObjects, uint objectCount, uint sizeOfObject, ObjectInfoUniformBlock* pObjectUniformBlock,
+		const uint32_t* pObjectIds, const uint32_t* pOrder, uint objectCount, ObjectInfoUniformBlock* pObjectUniformBlock,
 		MaterialUniformBlock* pMaterialUniformBlock, uint* pMaterialCount, eastl::vector<DrawCall>* pDrawCalls)
 	{
-		const uint meshIndexOffset = sizeOfObject - 2;
-		const uint objectIndexOffset = sizeOfObject - 1;
-
 		uint         instanceCount = 0;
 		uint         instanceOffset = 0;
 		MeshResource prevMesh = (MeshResource)0xFFFFFFFF;
 		for (uint i = 0; i < objectCount; ++i)
 		{
-			uint          sortedObjectIndex = (objectCount - i - 1) * sizeOfObject;
 			const Object* pObj = NULL;
-			MeshResource  mesh = (MeshResource)(int)pSortedObjects[sortedObjectIndex + meshIndexOffset];
-			int           index = (int)pSortedObjects[sortedObjectIndex + objectIndexOffset];
-			if (mesh < MESH_COUNT)
+			uint          index = pObjectIds[pOrder[i]];
+			if (index < gScene.mObjects.size())
+			{
 				pObj = &gScene.mObjects[index];
+			}
 			else
+			{
+				index -= (uint)gScene.mObjects.size();
 				pObj = &gScene.mParticleSystems[index].mObject;
+			}
+			const MeshResource mesh = pObj->mMesh;
 
 			pObjectUniformBlock->mObjectInfo[i].mToWorldMat =
 				mat4::translation(pObj->mPosition) * mat4::rotationZYX(pObj->mOrientation) * mat4::scale(pObj->mScale);
@@ -1060,84 +1066,65 @@ class Transparency: public IApp
 		gOpaqueDrawCalls.clear();
 		uint opaqueObjectCount = 0;
 		{
-			eastl::vector<float2> sortedArray = {};
+			gSortObjectIds.clear();
+			gSortKeys.clear();
 
 			for (size_t i = 0; i < gScene.mObjects.size(); ++i)
 			{
 				const Object* pObj = &gScene.mObjects[i];
 				if (pObj->mMaterial.mColor.getW() == 1.0f)
-					sortedArray.push_back({ (float)pObj->mMesh, (float)i });
+				{
+					gSortObjectIds.push_back((uint32_t)i);
+					gSortKeys.push_back((float)pObj->mMesh);
+				}
 			}
 			for (size_t i = 0; i < gScene.mParticleSystems.size(); ++i)
 			{
 				const Object* pObj = &gScene.mParticleSystems[i].mObject;
 				if (pObj->mMaterial.mColor.getW() == 1.0f)
-					sortedArray.push_back({ (float)pObj->mMesh, (float)i });
+				{
+					gSortObjectIds.push_back((uint32_t)(gScene.mObjects.size() + i));
+					gSortKeys.push_back((float)pObj->mMesh);
+				}
 			}
 
-			opaqueObjectCount = (int)sortedArray.size();
+			opaqueObjectCount = (uint)gSortObjectIds.size();
 			ASSERT(opaqueObjectCount < MAX_NUM_OBJECTS);
-			eastl::quick_sort(sortedArray.begin(), sortedArray.end(), MeshCompare);    // Sorts by mesh
+			const uint32_t* pOrder = sortDepths(pOpaqueObjectSorter, gSortKeys.data(), opaqueObjectCount);    // Sorts by mesh
 
 			CreateDrawCalls(
-				(float*)sortedArray.data(), opaqueObjectCount, sizeof(sortedArray[0]) / sizeof(float), &gObjectInfoUniformData,
-				&gMaterialUniformData, &materialCount, &gOpaqueDrawCalls);
+				gSortObjectIds.data(), pOrder, opaqueObjectCount, &gObjectInfoUniformData, &gMaterialUniformData, &materialCount,
+				&gOpaqueDrawCalls);
 		}
 
-		// Create list of transparent objects
+		// Create list of transparent objects, closest first when sorted by distance and by mesh otherwise
 		gTransparentDrawCalls.clear();
 		uint transparentObjectCount = 0;
-		if (gTransparencyType == TRANSPARENCY_TYPE_ALPHA_BLEND && gAlphaBlendSettings.mSortObjects)
-		{
-			eastl::vector<float3> sortedArray = {};
-
-			for (size_t i = 0; i < gScene.mObjects.size(); ++i)
-			{
-				const Object* pObj = &gScene.mObjects[i];
-				if (pObj->mMaterial.mColor.getW() < 1.0f)
-					sortedArray.push_back({ (float)distSqr(Point3(camPos), Point3(pObj->mPosition)) - (float)pow(maxElem(pObj->mScale), 2),
-											(float)pObj->mMesh, (float)i });
-			}
-			for (size_t i = 0; i < gScene.mParticleSystems.size(); ++i)
-			{
-				const Object* pObj = &gScene.mParticleSystems[i].mObject;
-				if (pObj->mMaterial.mColor.getW() < 1.0f)
-					sortedArray.push_back({ (float)distSqr(Point3(camPos), Point3(pObj->mPosition)) - (float)pow(maxElem(pObj->mScale), 2),
-											(float)pObj->mMesh, (float)i });
-			}
-
-			transparentObjectCount = (int)sortedArray.size();
-			ASSERT(transparentObjectCount < MAX_NUM_OBJECTS);
-			eastl::quick_sort(sortedArray.begin(), sortedArray.end(), DistanceCompare);     // Sorts by distance first, then by mesh
-
-			CreateDrawCalls(
-				(float*)sortedArray.data(), transparentObjectCount, sizeof(sortedArray[0]) / sizeof(float),
-				&gTransparentObjectInfoUniformData, &gMaterialUniformData, &materialCount, &gTransparentDrawCalls);
-		}
-		else
 		{
-			eastl::vector<float2> sortedArray = {};
+			const bool sortByDistance = gTransparencyType == TRANSPARENCY_TYPE_ALPHA_BLEND && gAlphaBlendSettings.mSortObjects;
+			gSortObjectIds.clear();
+			gSortKeys.clear();
 
-			for (size_t i = 0; i < gScene.mObjects.size(); ++i)
-			{
-				const Object* pObj = &gScene.mObjects[i];
-				if (pObj->mMaterial.mColor.getW() < 1.0f)
-					sortedArray.push_back({ (float)pObj->mMesh, (float)i });
-			}
-			for (size_t i = 0; i < gScene.mParticleSystems.size(); ++i)
+			for (size_t i = 0; i < gScene.mObjects.size() + gScene.mParticleSystems.size(); ++i)
 			{
-				const Object* pObj = &gScene.mParticleSystems[i].mObject;
+				const Object* pObj =
+					i < gScene.mObjects.size() ? &gScene.mObjects[i] : &gScene.mParticleSystems[i - gScene.mObjects.size()].mObject;
 				if (pObj->mMaterial.mColor.getW() < 1.0f)
-					sortedArray.push_back({ (float)pObj->mMesh, (float)i });
+				{
+					gSortObjectIds.push_back((uint32_t)i);
+					gSortKeys.push_back(
+						sortByDistance ? (float)distSqr(Point3(camPos), Point3(pObj->mPosition)) - (float)pow(maxElem(pObj->mScale), 2)
+									   : (float)pObj->mMesh);
+				}
 			}
 
-			transparentObjectCount = (int)sortedArray.size();
+			transparentObjectCount = (uint)gSortObjectIds.size();
 			ASSERT(transparentObjectCount < MAX_NUM_OBJECTS);
-			eastl::quick_sort(sortedArray.begin(), sortedArray.end(), MeshCompare);    // Sorts by mesh
+			const uint32_t* pOrder = sortDepths(pTransparentObjectSorter, gSortKeys.data(), transparentObjectCount);
 
 			CreateDrawCalls(
-				(float*)sortedArray.data(), transparentObjectCount, sizeof(sortedArray[0]) / sizeof(float),
-				&gTransparentObjectInfoUniformData, &gMaterialUniformData, &materialCount, &gTransparentDrawCalls);
+				gSortObjectIds.data(), pOrder, transparentObjectCount, &gTransparentObjectInfoUniformData, &gMaterialUniformData,
+				&materialCount, &gTransparentDrawCalls);
 		}
 	}
 
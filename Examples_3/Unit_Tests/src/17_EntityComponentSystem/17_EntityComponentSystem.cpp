@@ -31,8 +31,7 @@
 #include "../../../../Common_3/ThirdParty/OpenSource/EASTL/vector.h"
 #include "../../../../Common_3/ThirdParty/OpenSource/EASTL/string.h"
 
-// entt: https://github.com/skypjack/entt
-#include "../../../../Common_3/ThirdParty/OpenSource/entt/entt.hpp"
+#include "SpriteSystems.h"
 
 //Interfaces
 #include "../../../../Common_3/OS/Interfaces/ICameraController.h"
@@ -41,6 +40,7 @@
 #include "../../../../Common_3/OS/Interfaces/IFileSystem.h"
 #include "../../../../Common_3/OS/Interfaces/ITimeManager.h"
 #include "../../../../Common_3/OS/Interfaces/IProfiler.h"
+#include "../../../../Common_3/OS/Core/ThreadSystem.h"
 #include "../../../../Middleware_3/UI/AppUI.h"
 #include "../../../../Common_3/Renderer/IRenderer.h"
 #include "../../../../Common_3/Renderer/ResourceLoader.h"
@@ -128,47 +128,6 @@ const char* pszBases[FSR_Count] = {
 
 TextDrawDesc gFrameTimeDraw = TextDrawDesc(0, 0xff00ffff, 18);
 
-// Based on: https://github.com/aras-p/dod-playground
-static float RandomFloat01() { return (float)rand() / (float)RAND_MAX; }
-static float RandomFloat(float from, float to) { return RandomFloat01() * (to - from) + from; }
-
-// 2D position: just x,y coordinates
-struct PositionComponent
-{
-	float x, y;
-};
-
-// Sprite: color, sprite index (in the sprite atlas), and scale for rendering it
-struct SpriteComponent
-{
-	float colorR, colorG, colorB;
-	int   spriteIndex;
-	float scale;
-};
-
-// World bounds for our "game" logic: x,y minimum & maximum values
-struct WorldBoundsComponent
-{
-	float xMin, xMax, yMin, yMax;
-};
-
-// Move around with constant velocity. When reached world bounds, reflect back from them.
-struct MoveComponent
-{
-	float velx, vely;
-
-	void Initialize(float minSpeed, float maxSpeed)
-	{
-		// random angle
-		float angle = RandomFloat01() * 3.1415926f * 2;
-		// random movement speed between given min & max
-		float speed = RandomFloat(minSpeed, maxSpeed);
-		// velocity x & y components
-		velx = cosf(angle) * speed;
-		vely = sinf(angle) * speed;
-	}
-};
-
 const uint MaxSpriteCount = 11000;
 #ifdef _DEBUG
 const uint SpriteEntityCount = 5000;
@@ -177,117 +136,13 @@ const uint SpriteEntityCount = 10000;
 #endif
 const uint AvoidCount = 20;
 
-using EntityID = uint;
-
 entt::Registry<EntityID> registry;
 EntityID                 worldBoundsEntity;
-EntityID                 spriteEntities[SpriteEntityCount];
-EntityID                 avoidEntities[AvoidCount];
-
-struct MoveSystem
-{
-	void Update(float deltaTime)
-	{
-		const WorldBoundsComponent& bounds = registry.get<WorldBoundsComponent>(worldBoundsEntity);
 
-		// go through all the objects
-		entt::View<EntityID, PositionComponent, MoveComponent> view = registry.view<PositionComponent, MoveComponent>();
-		for (EntityID entity : view)
-		{
-			PositionComponent& position = view.get<PositionComponent>(entity);
-			MoveComponent&     move = view.get<MoveComponent>(entity);
-
-			// update position based on movement velocity & delta time
-			position.x += move.velx * deltaTime;
-			position.y += move.vely * deltaTime;
-
-			// check against world bounds; put back onto bounds and mirror the velocity component to "bounce" back
-			if (position.x < bounds.xMin)
-			{
-				move.velx = -move.velx;
-				position.x = bounds.xMin;
-			}
-			if (position.x > bounds.xMax)
-			{
-				move.velx = -move.velx;
-				position.x = bounds.xMax;
-			}
-			if (position.y < bounds.yMin)
-			{
-				move.vely = -move.vely;
-				position.y = bounds.yMin;
-			}
-			if (position.y > bounds.yMax)
-			{
-				move.vely = -move.vely;
-				position.y = bounds.yMax;
-			}
-		}
-	}
-};
-
-static float DistanceSq(const PositionComponent& a, const PositionComponent& b)
-{
-	float dx = a.x - b.x;
-	float dy = a.y - b.y;
-	return dx * dx + dy * dy;
-}
-
-struct AvoidanceSystem
-{
-	eastl::vector<float>    avoidDistanceList;
-	eastl::vector<uint32_t> avoidList;
-
-	void AddAvoidThisObjectToSystem(uint32_t id, float distance)
-	{
-		avoidList.emplace_back(id);
-		avoidDistanceList.emplace_back(distance * distance);
-	}
-
-	void ResolveCollision(EntityID id, float deltaTime)
-	{
-		PositionComponent& pos = registry.get<PositionComponent>(id);
-		MoveComponent&     move = registry.get<MoveComponent>(id);
-
-		// flip velocity
-		move.velx = -move.velx;
-		move.vely = -move.vely;
-
-		// move us out of collision, by moving just a tiny bit more than we'd normally move during a frame
-		pos.x += move.velx * deltaTime * 1.1f;
-		pos.y += move.vely * deltaTime * 1.1f;
-	}
-
-	void Update(float deltaTime)
-	{
-		entt::View<EntityID, PositionComponent> view = registry.view<PositionComponent>();
-		for (EntityID entity : view)
-		{
-			PositionComponent& position = view.get(entity);
-
-			// check each thing in avoid list
-			for (size_t ia = 0, na = avoidList.size(); ia != na; ++ia)
-			{
-				float                    avDistance = avoidDistanceList[ia];
-				uint32_t                 avoidEntity = avoidList[ia];
-				const PositionComponent& avoidposition = registry.get<PositionComponent>(avoidEntity);
-
-				// is our position closer to "thing to avoid" position than the avoid distance?
-				if (DistanceSq(position, avoidposition) < avDistance)
-				{
-					ResolveCollision(entity, deltaTime);
-
-					// also make our sprite take the color of the thing we just bumped into
-					SpriteComponent& avoidSprite = registry.get<SpriteComponent>(avoidEntity);
-					SpriteComponent& mySprite = registry.get<SpriteComponent>(entity);
-					mySprite.colorR = avoidSprite.colorR;
-					mySprite.colorG = avoidSprite.colorG;
-					mySprite.colorB = avoidSprite.colorB;
-				}
-			}
-		}
-	}
-};
+ThreadSystem* pThreadSystem = NULL;
+SystemRunner  systemRunner;
+HiresTimer    gMoveSystemTimer;
+HiresTimer    gAvoidanceSystemTimer;
 
 static MoveSystem      moveSystem;
 static AvoidanceSystem avoidanceSystem;
@@ -441,53 +296,12 @@ class EntityComponentSystem: public IApp
     pGuiWindow->AddWidget(CheckboxWidget("Toggle Micro Profiler", &bToggleMicroProfiler));
 
 		// Create sprite entities and components.
-		worldBoundsEntity = registry.create();
-		WorldBoundsComponent& bounds = registry.assign<WorldBoundsComponent>(worldBoundsEntity);
-		bounds.xMin = -80.0f;
-		bounds.xMax = 80.0f;
-		bounds.yMin = -50.0f;
-		bounds.yMax = 50.0f;
-
-		for (uint i = 0; i < SpriteEntityCount; i++)
-		{
-			spriteEntities[i] = registry.create();
-			float x = RandomFloat(bounds.xMin, bounds.xMax);
-			float y = RandomFloat(bounds.yMin, bounds.yMax);
-			registry.assign<PositionComponent>(spriteEntities[i], x, y);
-
-			SpriteComponent& sprite = registry.assign<SpriteComponent>(spriteEntities[i]);
-			sprite.colorR = 1.0f;
-			sprite.colorG = 1.0f;
-			sprite.colorB = 1.0f;
-			sprite.spriteIndex = rand() % 5;
-			sprite.scale = 1.0f;
-
-			// Move component
-			MoveComponent& move = registry.assign<MoveComponent>(spriteEntities[i]);
-			move.Initialize(0.7f, 1.0f);
-		}
+		const WorldBoundsComponent bounds = { -80.0f, 80.0f, -50.0f, 50.0f };
+		worldBoundsEntity = createSprites(registry, &avoidanceSystem, bounds, SpriteEntityCount, AvoidCount);
 
-		for (uint i = 0; i < AvoidCount; ++i)
-		{
-			avoidEntities[i] = registry.create();
-			float x = RandomFloat(bounds.xMin, bounds.xMax) * 0.2f;
-			float y = RandomFloat(bounds.yMin, bounds.yMax) * 0.2f;
-			registry.assign<PositionComponent>(avoidEntities[i], x, y);
-
-			SpriteComponent& sprite = registry.assign<SpriteComponent>(avoidEntities[i]);
-			sprite.colorR = RandomFloat(0.5f, 1.0f);
-			sprite.colorG = RandomFloat(0.5f, 1.0f);
-			sprite.colorB = RandomFloat(0.5f, 1.0f);
-			sprite.spriteIndex = 5;
-			sprite.scale = 2.0f;
-
-			// Move component
-			MoveComponent& move = registry.assign<MoveComponent>(avoidEntities[i]);
-			move.Initialize(0.3f, 0.6f);
-
-			// add to avoidance this as "Avoid This" object
-			avoidanceSystem.AddAvoidThisObjectToSystem(avoidEntities[i], 1.3f);
-		}
+		// Run the systems split in chunks over the worker threads
+		initThreadSystem(&pThreadSystem);
+		systemRunner.Initialize(pThreadSystem);
 
 		return true;
 	}
@@ -496,6 +310,8 @@ class EntityComponentSystem: public IApp
 	{
 		waitQueueIdle(pGraphicsQueue);
 
+		shutdownThreadSystem(pThreadSystem);
+
 		exitProfiler(pRenderer);
 
 		gAppUI.Exit();
@@ -587,8 +403,13 @@ class EntityComponentSystem: public IApp
 		currentTime += deltaTime * 1000.0f;
 
 		// update object systems
-		moveSystem.Update(deltaTime * 3.0f);
-		avoidanceSystem.Update(deltaTime * 3.0f);
+		gMoveSystemTimer.Reset();
+		moveSystem.Update(registry, worldBoundsEntity, deltaTime * 3.0f, &systemRunner);
+		gMoveSystemTimer.GetUSec(false);
+
+		gAvoidanceSystemTimer.Reset();
+		avoidanceSystem.Update(registry, worldBoundsEntity, deltaTime * 3.0f, &systemRunner);
+		gAvoidanceSystemTimer.GetUSec(false);
 
 		// Iterate all entities with transform and plane component
 		gDrawSpriteCount = 0;
@@ -716,6 +537,15 @@ class EntityComponentSystem: public IApp
 			cmd, float2(8.0f, 40.0f), eastl::string().sprintf("GPU %f ms", (float)pGpuProfiler->mCumulativeTime * 1000.0f).c_str(),
 			&uiTextDesc);
 
+		gAppUI.DrawText(
+			cmd, float2(8.0f, 65.0f),
+			eastl::string()
+				.sprintf(
+					"MoveSystem %f ms, AvoidanceSystem %f ms", gMoveSystemTimer.GetUSecAverage() / 1000.0f,
+					gAvoidanceSystemTimer.GetUSecAverage() / 1000.0f)
+				.c_str(),
+			&uiTextDesc);
+
 		cmdDrawProfiler(cmd, mSettings.mWidth, mSettings.mHeight);
 
     gAppUI.Gui(pGuiWindow);
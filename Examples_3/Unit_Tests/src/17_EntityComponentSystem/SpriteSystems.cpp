@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "SpriteSystems.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "../../../../Common_3/OS/Interfaces/ILogManager.h"
+#include "../../../../Common_3/OS/Core/ThreadSystem.h"
+
+#include "../../../../Common_3/OS/Interfaces/IMemoryManager.h"
+
+// Cells per axis of the avoidance grid, for when the distances are tiny compared to the world
+#define AVOIDANCE_GRID_MAX_CELLS 1024
+
+static float RandomFloat01() { return (float)rand() / (float)RAND_MAX; }
+static float RandomFloat(float from, float to) { return RandomFloat01() * (to - from) + from; }
+
+void MoveComponent::Initialize(float minSpeed, float maxSpeed)
+{
+	// random angle
+	float angle = RandomFloat01() * 3.1415926f * 2;
+	// random movement speed between given min & max
+	float speed = RandomFloat(minSpeed, maxSpeed);
+	// velocity x & y components
+	velx = cosf(angle) * speed;
+	vely = sinf(angle) * speed;
+}
+
+void SystemRunner::Initialize(ThreadSystem* threadSystem, uint32_t chunk)
+{
+	pThreadSystem = threadSystem;
+	chunkSize = chunk;
+}
+
+static void systemChunkTask(void* pUser, uintptr_t chunk)
+{
+	SystemRunner*  pRunner = (SystemRunner*)pUser;
+	const uint32_t begin = (uint32_t)chunk * pRunner->chunkSize;
+	const uint32_t end = pRunner->count - begin < pRunner->chunkSize ? pRunner->count : begin + pRunner->chunkSize;
+	pRunner->pFunc(pRunner->pSystem, begin, end);
+}
+
+void SystemRunner::Run(SystemChunkFunc func, void* system, uint32_t elementCount)
+{
+	const uint32_t chunkCount = (elementCount + chunkSize - 1) / chunkSize;
+	if (pThreadSystem && chunkCount > 1)
+	{
+		pFunc = func;
+		pSystem = system;
+		count = elementCount;
+		addThreadSystemRangeTask(pThreadSystem, systemChunkTask, this, chunkCount);
+		waitThreadSystemIdle(pThreadSystem);
+	}
+	else
+	{
+		func(system, 0, elementCount);
+	}
+}
+
+void MoveSystem::Update(entt::Registry<EntityID>& registry, EntityID worldBoundsEntity, float dt, SystemRunner* pRunner)
+{
+	ASSERT(registry.size<MoveComponent>() == registry.size<PositionComponent>());
+
+	pRegistry = &registry;
+	bounds = registry.get<WorldBoundsComponent>(worldBoundsEntity);
+	deltaTime = dt;
+	pRunner->Run(&MoveSystem::UpdateChunk, this, (uint32_t)registry.size<PositionComponent>());
+}
+
+void MoveSystem::UpdateChunk(void* pSystem, uint32_t begin, uint32_t end)
+{
+	MoveSystem*                 pThis = (MoveSystem*)pSystem;
+	const WorldBoundsComponent& bounds = pThis->bounds;
+	const float                 deltaTime = pThis->deltaTime;
+	PositionComponent*          positions = pThis->pRegistry->raw<PositionComponent>();
+	MoveComponent*              moves = pThis->pRegistry->raw<MoveComponent>();
+
+	// go through the objects of the chunk
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		PositionComponent& position = positions[i];
+		MoveComponent&     move = moves[i];
+
+		// update position based on movement velocity & delta time
+		position.x += move.velx * deltaTime;
+		position.y += move.vely * deltaTime;
+
+		// check against world bounds; put back onto bounds and mirror the velocity component to "bounce" back
+		if (position.x < bounds.xMin)
+		{
+			move.velx = -move.velx;
+			position.x = bounds.xMin;
+		}
+		if (position.x > bounds.xMax)
+		{
+			move.velx = -move.velx;
+			position.x = bounds.xMax;
+		}
+		if (position.y < bounds.yMin)
+		{
+			move.vely = -move.vely;
+			position.y = bounds.yMin;
+		}
+		if (position.y > bounds.yMax)
+		{
+			move.vely = -move.vely;
+			position.y = bounds.yMax;
+		}
+	}
+}
+
+// Cell of a coordinate, positions outside the grid go to the border cells
+static inline uint32_t gridCell(float value, float minValue, float invCellSize, uint32_t cellCount)
+{
+	const float cell = (value - minValue) * invCellSize;
+	if (!(cell > 0.0f))
+		return 0;
+	return cell < (float)cellCount ? (uint32_t)cell : cellCount - 1;
+}
+
+void AvoidanceSystem::AddAvoidThisObjectToSystem(uint32_t id, float distance)
+{
+	avoidList.emplace_back(id);
+	avoidDistanceList.emplace_back(distance * distance);
+}
+
+void AvoidanceSystem::ResolveCollision(PositionComponent& pos, MoveComponent& move, float deltaTime)
+{
+	// flip velocity
+	move.velx = -move.velx;
+	move.vely = -move.vely;
+
+	// move us out of collision, by moving just a tiny bit more than we'd normally move during a frame
+	pos.x += move.velx * deltaTime * 1.1f;
+	pos.y += move.vely * deltaTime * 1.1f;
+}
+
+void AvoidanceSystem::BuildGrid(const WorldBoundsComponent& bounds)
+{
+	const uint32_t avoidCount = (uint32_t)avoidList.size();
+	float          maxDistanceSq = 0.0f;
+	for (uint32_t i = 0; i < avoidCount; ++i)
+		maxDistanceSq = avoidDistanceList[i] > maxDistanceSq ? avoidDistanceList[i] : maxDistanceSq;
+
+	// A sprite closer to an avoider than its distance is at most one cell away from it in either direction
+	const float width = bounds.xMax - bounds.xMin;
+	const float height = bounds.yMax - bounds.yMin;
+	float       cellSize = sqrtf(maxDistanceSq);
+	if (cellSize * AVOIDANCE_GRID_MAX_CELLS < width)
+		cellSize = width / AVOIDANCE_GRID_MAX_CELLS;
+	if (cellSize * AVOIDANCE_GRID_MAX_CELLS < height)
+		cellSize = height / AVOIDANCE_GRID_MAX_CELLS;
+	if (!(cellSize > 0.0f))
+		cellSize = 1.0f;
+
+	gridMinX = bounds.xMin;
+	gridMinY = bounds.yMin;
+	invCellSize = 1.0f / cellSize;
+	cellCountX = (uint32_t)(width * invCellSize) + 1;
+	cellCountY = (uint32_t)(height * invCellSize) + 1;
+	cellCountX = cellCountX < AVOIDANCE_GRID_MAX_CELLS ? cellCountX : AVOIDANCE_GRID_MAX_CELLS;
+	cellCountY = cellCountY < AVOIDANCE_GRID_MAX_CELLS ? cellCountY : AVOIDANCE_GRID_MAX_CELLS;
+
+	// Counting sort of the avoiders by cell, each cell keeps them in the order of avoidList
+	const uint32_t cellCount = cellCountX * cellCountY;
+	cellStarts.assign(cellCount + 1, 0);
+	cellAvoiders.resize(avoidCount);
+	avoidSprites.resize(avoidCount);
+	for (uint32_t i = 0; i < avoidCount; ++i)
+	{
+		const PositionComponent& position = pRegistry->get<PositionComponent>(avoidList[i]);
+		const uint32_t           cell = gridCell(position.y, gridMinY, invCellSize, cellCountY) * cellCountX +
+							  gridCell(position.x, gridMinX, invCellSize, cellCountX);
+		++cellStarts[cell + 1];
+	}
+	for (uint32_t cell = 0; cell < cellCount; ++cell)
+		cellStarts[cell + 1] += cellStarts[cell];
+	for (uint32_t i = 0; i < avoidCount; ++i)
+	{
+		const PositionComponent& position = pRegistry->get<PositionComponent>(avoidList[i]);
+		const uint32_t           cell = gridCell(position.y, gridMinY, invCellSize, cellCountY) * cellCountX +
+							  gridCell(position.x, gridMinX, invCellSize, cellCountX);
+		cellAvoiders[cellStarts[cell]++] = { position.x, position.y, avoidDistanceList[i], i };
+		avoidSprites[i] = pRegistry->get<SpriteComponent>(avoidList[i]);
+	}
+	// The fill moved every start to the next cell
+	for (uint32_t cell = cellCount; cell > 0; --cell)
+		cellStarts[cell] = cellStarts[cell - 1];
+	cellStarts[0] = 0;
+}
+
+void AvoidanceSystem::Update(entt::Registry<EntityID>& registry, EntityID worldBoundsEntity, float dt, SystemRunner* pRunner)
+{
+	ASSERT(registry.size<MoveComponent>() == registry.size<PositionComponent>());
+	ASSERT(registry.size<SpriteComponent>() == registry.size<PositionComponent>());
+
+	pRegistry = &registry;
+	deltaTime = dt;
+	BuildGrid(registry.get<WorldBoundsComponent>(worldBoundsEntity));
+	pRunner->Run(&AvoidanceSystem::UpdateChunk, this, (uint32_t)registry.size<PositionComponent>());
+}
+
+void AvoidanceSystem::UpdateChunk(void* pSystem, uint32_t begin, uint32_t end)
+{
+	AvoidanceSystem*   pThis = (AvoidanceSystem*)pSystem;
+	const uint32_t     cellCountX = pThis->cellCountX;
+	const uint32_t     cellCountY = pThis->cellCountY;
+	const uint32_t*    cellStarts = pThis->cellStarts.data();
+	const Avoider*     cellAvoiders = pThis->cellAvoiders.data();
+	PositionComponent* positions = pThis->pRegistry->raw<PositionComponent>();
+	MoveComponent*     moves = pThis->pRegistry->raw<MoveComponent>();
+	SpriteComponent*   sprites = pThis->pRegistry->raw<SpriteComponent>();
+
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		PositionComponent& position = positions[i];
+		const uint32_t     cellX = gridCell(position.x, pThis->gridMinX, pThis->invCellSize, cellCountX);
+		const uint32_t     cellY = gridCell(position.y, pThis->gridMinY, pThis->invCellSize, cellCountY);
+		const uint32_t     lastX = cellX + 1 < cellCountX ? cellX + 1 : cellX;
+		const uint32_t     lastY = cellY + 1 < cellCountY ? cellY + 1 : cellY;
+
+		// check each thing to avoid around us, is our position closer to it than the avoid distance?
+		uint32_t hitCount = 0;
+		uint32_t lastHit = 0;
+		for (uint32_t y = cellY > 0 ? cellY - 1 : 0; y <= lastY; ++y)
+		{
+			for (uint32_t x = cellX > 0 ? cellX - 1 : 0; x <= lastX; ++x)
+			{
+				const uint32_t cell = y * cellCountX + x;
+				for (uint32_t a = cellStarts[cell]; a < cellStarts[cell + 1]; ++a)
+				{
+					const Avoider& avoider = cellAvoiders[a];
+					const float    dx = position.x - avoider.x;
+					const float    dy = position.y - avoider.y;
+					if (dx * dx + dy * dy < avoider.distanceSq)
+					{
+						lastHit = hitCount == 0 || avoider.index > lastHit ? avoider.index : lastHit;
+						++hitCount;
+					}
+				}
+			}
+		}
+
+		if (!hitCount)
+			continue;
+
+		// resolve every collision like they were found one after the other
+		for (uint32_t hit = 0; hit < hitCount; ++hit)
+			ResolveCollision(position, moves[i], pThis->deltaTime);
+
+		// also make our sprite take the color of the last thing we bumped into
+		const SpriteComponent& avoidSprite = pThis->avoidSprites[lastHit];
+		SpriteComponent&       mySprite = sprites[i];
+		mySprite.colorR = avoidSprite.colorR;
+		mySprite.colorG = avoidSprite.colorG;
+		mySprite.colorB = avoidSprite.colorB;
+	}
+}
+
+EntityID createSprites(
+	entt::Registry<EntityID>& registry, AvoidanceSystem* pAvoidance, const WorldBoundsComponent& bounds, uint32_t spriteCount,
+	uint32_t avoidCount)
+{
+	EntityID worldBoundsEntity = registry.create();
+	registry.assign<WorldBoundsComponent>(worldBoundsEntity) = bounds;
+
+	for (uint32_t i = 0; i < spriteCount; i++)
+	{
+		EntityID entity = registry.create();
+		float    x = RandomFloat(bounds.xMin, bounds.xMax);
+		float    y = RandomFloat(bounds.yMin, bounds.yMax);
+		registry.assign<PositionComponent>(entity, x, y);
+
+		SpriteComponent& sprite = registry.assign<SpriteComponent>(entity);
+		sprite.colorR = 1.0f;
+		sprite.colorG = 1.0f;
+		sprite.colorB = 1.0f;
+		sprite.spriteIndex = rand() % 5;
+		sprite.scale = 1.0f;
+
+		// Move component
+		MoveComponent& move = registry.assign<MoveComponent>(entity);
+		move.Initialize(0.7f, 1.0f);
+	}
+
+	for (uint32_t i = 0; i < avoidCount; ++i)
+	{
+		EntityID entity = registry.create();
+		float    x = RandomFloat(bounds.xMin, bounds.xMax) * 0.2f;
+		float    y = RandomFloat(bounds.yMin, bounds.yMax) * 0.2f;
+		registry.assign<PositionComponent>(entity, x, y);
+
+		SpriteComponent& sprite = registry.assign<SpriteComponent>(entity);
+		sprite.colorR = RandomFloat(0.5f, 1.0f);
+		sprite.colorG = RandomFloat(0.5f, 1.0f);
+		sprite.colorB = RandomFloat(0.5f, 1.0f);
+		sprite.spriteIndex = 5;
+		sprite.scale = 2.0f;
+
+		// Move component
+		MoveComponent& move = registry.assign<MoveComponent>(entity);
+		move.Initialize(0.3f, 0.6f);
+
+		// add to avoidance this as "Avoid This" object
+		pAvoidance->AddAvoidThisObjectToSystem(entity, 1.3f);
+	}
+
+	// The systems index the pools of a sprite's components with the same index
+	registry.sort<SpriteComponent, PositionComponent>();
+	registry.sort<MoveComponent, PositionComponent>();
+
+	return worldBoundsEntity;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Components and systems of the 17_EntityComponentSystem sprites, shared with the headless benchmarks.
+// Based on: https://github.com/aras-p/dod-playground
+//
+// Every sprite has a PositionComponent, SpriteComponent and MoveComponent, and the three pools are kept in the same
+// order, so sprite i is element i of every raw() array. The systems walk those arrays in chunks, which a SystemRunner
+// spreads over a ThreadSystem.
+
+#pragma once
+
+#include "../../../../Common_3/ThirdParty/OpenSource/EASTL/vector.h"
+
+// entt: https://github.com/skypjack/entt
+#include "../../../../Common_3/ThirdParty/OpenSource/entt/entt.hpp"
+
+struct ThreadSystem;
+
+using EntityID = uint32_t;
+
+// 2D position: just x,y coordinates
+struct PositionComponent
+{
+	float x, y;
+};
+
+// Sprite: color, sprite index (in the sprite atlas), and scale for rendering it
+struct SpriteComponent
+{
+	float colorR, colorG, colorB;
+	int   spriteIndex;
+	float scale;
+};
+
+// World bounds for our "game" logic: x,y minimum & maximum values
+struct WorldBoundsComponent
+{
+	float xMin, xMax, yMin, yMax;
+};
+
+// Move around with constant velocity. When reached world bounds, reflect back from them.
+struct MoveComponent
+{
+	float velx, vely;
+
+	void Initialize(float minSpeed, float maxSpeed);
+};
+
+typedef void (*SystemChunkFunc)(void* pSystem, uint32_t begin, uint32_t end);
+
+// Runs a system over [0, count) in chunks of chunkSize elements, as tasks on pThreadSystem if given
+struct SystemRunner
+{
+	ThreadSystem* pThreadSystem;
+	uint32_t      chunkSize;
+	// Of the current Run
+	SystemChunkFunc pFunc;
+	void*           pSystem;
+	uint32_t        count;
+
+	void Initialize(ThreadSystem* pThreadSystem = NULL, uint32_t chunkSize = 4096);
+
+	// Calls func(pSystem, begin, end) for every chunk and returns once all of them are done. Chunks run concurrently, so
+	// func may only write to the elements of its chunk
+	void Run(SystemChunkFunc func, void* pSystem, uint32_t count);
+};
+
+struct MoveSystem
+{
+	entt::Registry<EntityID>* pRegistry;
+	WorldBoundsComponent      bounds;
+	float                     deltaTime;
+
+	void Update(entt::Registry<EntityID>& registry, EntityID worldBoundsEntity, float deltaTime, SystemRunner* pRunner);
+
+	static void UpdateChunk(void* pSystem, uint32_t begin, uint32_t end);
+};
+
+// Sprites closer to an "avoid this" sprite than its distance bounce back and take its color.
+// The avoiders are put in a grid with cells at least as large as the largest distance every update, so a sprite only
+// checks the avoiders of the 3x3 cells around it. Collisions are found for the positions at the start of the update.
+struct AvoidanceSystem
+{
+	struct Avoider
+	{
+		float    x, y;
+		float    distanceSq;
+		uint32_t index;    // Into avoidList
+	};
+
+	eastl::vector<float>    avoidDistanceList;
+	eastl::vector<uint32_t> avoidList;
+
+	// Grid of the current update, the avoiders of cell c are cellAvoiders[cellStarts[c], cellStarts[c + 1])
+	entt::Registry<EntityID>*      pRegistry;
+	float                          deltaTime;
+	float                          gridMinX, gridMinY;
+	float                          invCellSize;
+	uint32_t                       cellCountX, cellCountY;
+	eastl::vector<uint32_t>        cellStarts;
+	eastl::vector<Avoider>         cellAvoiders;
+	eastl::vector<SpriteComponent> avoidSprites;    // Colors at the start of the update, by avoidList index
+
+	void AddAvoidThisObjectToSystem(uint32_t id, float distance);
+
+	void Update(entt::Registry<EntityID>& registry, EntityID worldBoundsEntity, float deltaTime, SystemRunner* pRunner);
+
+	static void ResolveCollision(PositionComponent& pos, MoveComponent& move, float deltaTime);
+
+	private:
+	void BuildGrid(const WorldBoundsComponent& bounds);
+
+	static void UpdateChunk(void* pSystem, uint32_t begin, uint32_t end);
+};
+
+// Creates the world bounds entity, spriteCount sprites in bounds and avoidCount "avoid this" sprites after them, which are
+// added to pAvoidance. Returns the world bounds entity
+EntityID createSprites(
+	entt::Registry<EntityID>& registry, AvoidanceSystem* pAvoidance, const WorldBoundsComponent& bounds, uint32_t spriteCount,
+	uint32_t avoidCount);
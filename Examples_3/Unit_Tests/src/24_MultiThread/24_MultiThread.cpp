@@ -169,6 +169,10 @@ Rig gStickFigureRigs[kMaxNumRigs];
 // SkeletonBatcher
 SkeletonBatcher gSkeletonBatcher;
 
+// Throttles the updates of the rigs far from the camera when enabled through the UI
+AnimationLODScheduler gAnimationLODScheduler;
+bool                  gEnableAnimationLOD = false;
+
 // Filenames
 const char* gStickFigureName = "stickFigure/skeleton.ozz";
 const char* gWalkClipName = "stickFigure/animations/walk.ozz";
@@ -219,6 +223,7 @@ struct UIData
 	struct SampleControlData
 	{
 		unsigned int* mNumberOfRigs = &gNumRigs;
+		bool*         mEnableAnimationLOD = &gEnableAnimationLOD;
 	};
 	SampleControlData mSampleControl;
 
@@ -230,6 +235,15 @@ struct UIData
 };
 UIData gUIData;
 
+// Hands the rigs to the LOD scheduler or back to full rate updates
+void EnableAnimationLODCallback()
+{
+	for (unsigned int i = 0; i < kMaxNumRigs; i++)
+	{
+		gStickFigureAnimObjects[i].SetLODScheduler(gEnableAnimationLOD ? &gAnimationLODScheduler : NULL);
+	}
+}
+
 //--------------------------------------------------------------------------------------------
 // APP CODE
 //--------------------------------------------------------------------------------------------
@@ -452,6 +466,19 @@ class MultiThread: public IApp
 			gStickFigureAnimObjects[i].SetRootTransform(mat4::translation(offset));
 		}
 
+		// ANIMATION LOD
+		//
+		// Full rate close to the camera, every 2nd frame interpolated further away and every 4th frame without
+		// interpolation at the back of the crowd. The updates of a throttled level are spread over its frames
+		AnimationLODDesc animationLODDesc{};
+		animationLODDesc.mNumLevels = 3;
+		animationLODDesc.mLevels[1].mMinDistance = 20.0f;
+		animationLODDesc.mLevels[1].mUpdateInterval = 2;
+		animationLODDesc.mLevels[2].mMinDistance = 35.0f;
+		animationLODDesc.mLevels[2].mUpdateInterval = 4;
+		animationLODDesc.mLevels[2].mInterpolate = false;
+		gAnimationLODScheduler.Initialize(animationLODDesc);
+
 		/************************************************************************/
 
 		finishResourceLoading();
@@ -530,6 +557,13 @@ class MultiThread: public IApp
 				SliderUintWidget("Number of Rigs", gUIData.mSampleControl.mNumberOfRigs, uintValMin, uintValMax, sliderStepSizeUint));
 			CollapsingSampleControlWidgets.AddSubWidget(SeparatorWidget());
 
+			// EnableAnimationLOD - Checkbox
+			CheckboxWidget CheckboxEnableAnimationLOD("Enable Animation LOD", gUIData.mSampleControl.mEnableAnimationLOD);
+			CheckboxEnableAnimationLOD.pOnEdited = EnableAnimationLODCallback;
+
+			CollapsingSampleControlWidgets.AddSubWidget(CheckboxEnableAnimationLOD);
+			CollapsingSampleControlWidgets.AddSubWidget(SeparatorWidget());
+
 			// GENERAL SETTINGS
 			//
 			CollapsingHeaderWidget CollapsingGeneralSettingsWidgets("General Settings");
@@ -750,6 +784,10 @@ class MultiThread: public IApp
 		/************************************************************************/
 		gAnimationUpdateTimer.Reset();
 
+		// The LOD levels of the rigs are picked during their update, on the worker threads when threading is enabled
+		if (gEnableAnimationLOD)
+			gAnimationLODScheduler.Update(pCameraController->getViewPosition());
+
 		// Update the animated objects amd pose the rigs based on the animated object's updated values for this frame
 
 		// Threading
@@ -30,8 +30,6 @@
 *
 *********************************************************************************************************/
 
-#define MAX_NUM_BONES 1024
-
 // Interfaces
 #include "../../../../Common_3/OS/Interfaces/ICameraController.h"
 #include "../../../../Common_3/OS/Interfaces/IApp.h"
@@ -68,6 +66,9 @@
 #include "../../../../Common_3/Tools/AssetPipeline/AssetPipeline.h"
 #endif
 
+// Ring buffer, includes the memory manager
+#include "../../../../Common_3/OS/Core/RingBuffer.h"
+
 // Memory
 #include "../../../../Common_3/OS/Interfaces/IMemoryManager.h"
 
@@ -141,19 +142,20 @@ struct Vertex
 	uint4  mBoneIndices;
 };
 
-struct UniformDataBones
-{
-	mat4 mBoneMatrix[MAX_NUM_BONES];
-};
-
 Buffer*          pVertexBuffer = NULL;
 Buffer*          pIndexBuffer = NULL;
 uint             gIndexCount = 0;
-Buffer*          pBoneOffsetBuffer = NULL;
-Buffer*          pUniformBufferBones[gImageCount] = { NULL };
-UniformDataBones gUniformDataBones;
 Texture*         pTextureDiffuse = NULL;
 
+// Skinning matrices (joint world matrix * bone offset matrix) as 3x4 matrices, written every frame straight into
+// a persistently mapped ring buffer that holds the palettes of all frames in flight
+GPURingBuffer*      pBoneRingBuffer = NULL;
+GPURingBufferOffset gBonePaletteOffset = {};
+uint64_t            gBonePaletteSize = 0;
+eastl::vector<mat4> gBoneOffsetMatrices;
+// Only used by APIs that do not keep uniform buffers mapped
+eastl::vector<vec4> gBonePaletteStaging;
+
 struct UniformBlockPlane
 {
 	mat4 mProjectView;
@@ -249,7 +251,8 @@ class Skinning: public IApp
 		ProcessAssetsSettings animationSettings = {};
 		animationSettings.quiet = false;
 		animationSettings.force = false;
-		animationSettings.minLastModifiedTime = 0;
+		animationSettings.skipOptimization = false;
+		animationSettings.optimizationTolerance = 0.0f;
 		AssetPipeline::ProcessAnimations(
 			FileSystem::FixPath("fbx", FSR_Animation).c_str(), FileSystem::FixPath("", FSR_Animation).c_str(), &animationSettings);
 #endif
@@ -467,7 +470,7 @@ class Skinning: public IApp
 
 		eastl::vector<Vertex> vertices;
 		eastl::vector<uint>   indices;
-		eastl::vector<mat4>   boneOffsetMatrices(gStickFigureRig.GetNumJoints(), mat4::identity());
+		gBoneOffsetMatrices.resize(gStickFigureRig.GetNumJoints(), mat4::identity());
 		for (uint i = 0; i < (uint)model.mMeshArray.size(); ++i)
 		{
 			AssimpImporter::Mesh* mesh = &model.mMeshArray[i];
@@ -507,7 +510,7 @@ class Skinning: public IApp
 				{
                     int jointIndex = gStickFigureRig.FindJoint(mesh->mBones[j].mName.c_str());
                     if (jointIndex >= 0)
-                        boneOffsetMatrices[jointIndex] = mesh->mBones[j].mOffsetMatrix * inverse(localToWorldMat);
+                        gBoneOffsetMatrices[jointIndex] = mesh->mBones[j].mOffsetMatrix * inverse(localToWorldMat);
 				}
 			}
 
@@ -539,25 +542,9 @@ class Skinning: public IApp
 		indexBufferDesc.ppBuffer = &pIndexBuffer;
 		addResource(&indexBufferDesc);
 
-		BufferLoadDesc boneOffsetBufferDesc = {};
-		boneOffsetBufferDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		boneOffsetBufferDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
-		boneOffsetBufferDesc.mDesc.mSize = sizeof(mat4) * gStickFigureRig.GetNumJoints();
-		boneOffsetBufferDesc.pData = boneOffsetMatrices.data();
-		boneOffsetBufferDesc.ppBuffer = &pBoneOffsetBuffer;
-		addResource(&boneOffsetBufferDesc);
-
-		BufferLoadDesc boneBufferDesc = {};
-		boneBufferDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		boneBufferDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
-		boneBufferDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
-		boneBufferDesc.mDesc.mSize = sizeof(mat4) * gStickFigureRig.GetNumJoints();
-		boneBufferDesc.pData = NULL;
-		for (int i = 0; i < gImageCount; ++i)
-		{
-			boneBufferDesc.ppBuffer = &pUniformBufferBones[i];
-			addResource(&boneBufferDesc);
-		}
+		// One palette per frame in flight, plus one as the ring does not fill up to its last byte
+		gBonePaletteSize = round_up((uint32_t)(3 * sizeof(vec4) * gStickFigureRig.GetNumJoints()), (uint32_t)pRenderer->pActiveGpuSettings->mUniformBufferAlignment);
+		addUniformGPURingBuffer(pRenderer, (uint32_t)gBonePaletteSize * (gImageCount + 1), &pBoneRingBuffer);
 
 		TextureLoadDesc diffuseTextureDesc = {};
 		diffuseTextureDesc.mRoot = FSR_Textures;
@@ -717,9 +704,9 @@ class Skinning: public IApp
 
 		removeResource(pVertexBuffer);
 		removeResource(pIndexBuffer);
-		for (int i = 0; i < gImageCount; ++i)
-			removeResource(pUniformBufferBones[i]);
-		removeResource(pBoneOffsetBuffer);
+		removeGPURingBuffer(pBoneRingBuffer);
+		gBoneOffsetMatrices.set_capacity(0);
+		gBonePaletteStaging.set_capacity(0);
 		removeResource(pTextureDiffuse);
 
 		removeResource(pJointVertexBuffer);
@@ -945,9 +932,6 @@ class Skinning: public IApp
 		// Update uniforms that will be shared between all skeletons
 		gSkeletonBatcher.SetSharedUniforms(projViewMat, lightPos, lightColor);
 
-		for (uint i = 0; i < gStickFigureRig.GetNumJoints(); ++i)
-			gUniformDataBones.mBoneMatrix[i] = gStickFigureRig.GetJointWorldMat(i);
-
 		/************************************************************************/
 		// Plane
 		/************************************************************************/
@@ -997,8 +981,21 @@ class Skinning: public IApp
 		BufferUpdateDesc planeViewProjCbv = { pPlaneUniformBuffer[gFrameIndex], &gUniformDataPlane };
 		updateResource(&planeViewProjCbv);
 
-		BufferUpdateDesc boneBufferUpdateDesc = { pUniformBufferBones[gFrameIndex], &gUniformDataBones };
-		updateResource(&boneBufferUpdateDesc);
+		// Write the skinning palette in place, the frame that last used this part of the ring has completed
+		gBonePaletteOffset = getGPURingBufferOffset(pBoneRingBuffer, (uint32_t)gBonePaletteSize);
+		if (gBonePaletteOffset.pBuffer->pCpuMappedAddress)
+		{
+			vec4* pPalette = (vec4*)((uint8_t*)gBonePaletteOffset.pBuffer->pCpuMappedAddress + gBonePaletteOffset.mOffset);
+			gStickFigureRig.WriteSkinningPalette(gBoneOffsetMatrices.data(), pPalette);
+		}
+		else
+		{
+			gBonePaletteStaging.resize(3 * gStickFigureRig.GetNumJoints());
+			gStickFigureRig.WriteSkinningPalette(gBoneOffsetMatrices.data(), gBonePaletteStaging.data());
+			BufferUpdateDesc boneBufferUpdateDesc = { gBonePaletteOffset.pBuffer, gBonePaletteStaging.data(), 0, gBonePaletteOffset.mOffset,
+													  sizeof(vec4) * gBonePaletteStaging.size() };
+			updateResource(&boneBufferUpdateDesc);
+		}
 
 		// Acquire the main render target from the swapchain
 		RenderTarget* pRenderTarget = pSwapChain->ppSwapchainRenderTargets[gFrameIndex];
@@ -1055,16 +1052,16 @@ class Skinning: public IApp
 		{
 			cmdBeginDebugMarker(cmd, 1, 0, 1, "Draw Skinned Mesh");
 			cmdBindPipeline(cmd, pPipelineSkinning);
-			DescriptorData params[4] = {};
+			DescriptorData params[3] = {};
 			params[0].pName = "uniformBlock";
 			params[0].ppBuffers = &pPlaneUniformBuffer[gFrameIndex];
 			params[1].pName = "boneMatrices";
-			params[1].ppBuffers = &pUniformBufferBones[gFrameIndex];
-			params[2].pName = "boneOffsetMatrices";
-			params[2].ppBuffers = &pBoneOffsetBuffer;
-			params[3].pName = "DiffuseTexture";
-			params[3].ppTextures = &pTextureDiffuse;
-			cmdBindDescriptors(cmd, pDescriptorBinder, pRootSignatureSkinning, 4, params);
+			params[1].ppBuffers = &gBonePaletteOffset.pBuffer;
+			params[1].pOffsets = &gBonePaletteOffset.mOffset;
+			params[1].pSizes = &gBonePaletteSize;
+			params[2].pName = "DiffuseTexture";
+			params[2].ppTextures = &pTextureDiffuse;
+			cmdBindDescriptors(cmd, pDescriptorBinder, pRootSignatureSkinning, 3, params);
 			cmdBindVertexBuffer(cmd, 1, &pVertexBuffer, NULL);
 			cmdBindIndexBuffer(cmd, pIndexBuffer, NULL);
 			cmdDrawIndexed(cmd, gIndexCount, 0, 0);
@@ -28,14 +28,10 @@ cbuffer uniformBlock : register(b0)
 	float4x4 modelMatrix;
 };
 
+// Skinning matrices of the instance, the three top rows of each matrix
 cbuffer boneMatrices : register(b1)
 {
-	float4x4 boneMatrix[MAX_NUM_BONES];
-};
-
-cbuffer boneOffsetMatrices : register(b2)
-{
-	float4x4 boneOffsetMatrix[MAX_NUM_BONES];
+	float4 boneRows[MAX_NUM_BONES * 3];
 };
 
 struct VSInput
@@ -57,12 +53,22 @@ VSOutput main(VSInput input)
 {
     VSOutput result;
 	
-	float4x4 boneTransform = mul(boneMatrix[input.BoneIndices[0]], boneOffsetMatrix[input.BoneIndices[0]]) * input.BoneWeights[0];
-	boneTransform += mul(boneMatrix[input.BoneIndices[1]], boneOffsetMatrix[input.BoneIndices[1]]) * input.BoneWeights[1];
-	boneTransform += mul(boneMatrix[input.BoneIndices[2]], boneOffsetMatrix[input.BoneIndices[2]]) * input.BoneWeights[2];
-	boneTransform += mul(boneMatrix[input.BoneIndices[3]], boneOffsetMatrix[input.BoneIndices[3]]) * input.BoneWeights[3];
-	
-	result.Position = mul(boneTransform, float4(input.Position, 1.0f));
+	uint4 boneIndices = input.BoneIndices * 3;
+	float4 row0 = boneRows[boneIndices[0]] * input.BoneWeights[0];
+	float4 row1 = boneRows[boneIndices[0] + 1] * input.BoneWeights[0];
+	float4 row2 = boneRows[boneIndices[0] + 2] * input.BoneWeights[0];
+	row0 += boneRows[boneIndices[1]] * input.BoneWeights[1];
+	row1 += boneRows[boneIndices[1] + 1] * input.BoneWeights[1];
+	row2 += boneRows[boneIndices[1] + 2] * input.BoneWeights[1];
+	row0 += boneRows[boneIndices[2]] * input.BoneWeights[2];
+	row1 += boneRows[boneIndices[2] + 1] * input.BoneWeights[2];
+	row2 += boneRows[boneIndices[2] + 2] * input.BoneWeights[2];
+	row0 += boneRows[boneIndices[3]] * input.BoneWeights[3];
+	row1 += boneRows[boneIndices[3] + 1] * input.BoneWeights[3];
+	row2 += boneRows[boneIndices[3] + 2] * input.BoneWeights[3];
+
+	float4 position = float4(input.Position, 1.0f);
+	result.Position = float4(dot(row0, position), dot(row1, position), dot(row2, position), dot(input.BoneWeights, float4(1.0f, 1.0f, 1.0f, 1.0f)));
 	result.Position = mul(modelMatrix, result.Position);
 	result.Position = mul(vpMatrix, result.Position);
 	result.Normal = normalize(mul(modelMatrix, float4(input.Normal, 0.0f)).xyz);
@@ -12,18 +12,13 @@ struct Vertex_Shader
     };
     constant Uniforms_uniformBlock & uniformBlock;
 	
+	// Skinning matrices of the instance, the three top rows of each matrix
 	struct Uniforms_boneMatrices
 	{
-		float4x4 boneMatrix[MAX_NUM_BONES];
+		float4 boneRows[MAX_NUM_BONES * 3];
 	};
 	constant Uniforms_boneMatrices & boneMatrices;
 	
-	struct Uniforms_boneOffsetMatrices
-	{
-		float4x4 boneOffsetMatrix[MAX_NUM_BONES];
-	};
-	constant Uniforms_boneOffsetMatrices & boneOffsetMatrices;
-	
     struct VSInput
     {
         float3 Position [[attribute(0)]];
@@ -44,12 +39,22 @@ struct Vertex_Shader
     {
 		VSOutput result;
 		
-		float4x4 boneTransform = (boneMatrices.boneMatrix[input.BoneIndices[0]] * boneOffsetMatrices.boneOffsetMatrix[input.BoneIndices[0]]) * input.BoneWeights[0];
-		boneTransform += (boneMatrices.boneMatrix[input.BoneIndices[1]] * boneOffsetMatrices.boneOffsetMatrix[input.BoneIndices[1]]) * input.BoneWeights[1];
-		boneTransform += (boneMatrices.boneMatrix[input.BoneIndices[2]] * boneOffsetMatrices.boneOffsetMatrix[input.BoneIndices[2]]) * input.BoneWeights[2];
-		boneTransform += (boneMatrices.boneMatrix[input.BoneIndices[3]] * boneOffsetMatrices.boneOffsetMatrix[input.BoneIndices[3]]) * input.BoneWeights[3];
-		
-		result.Position = boneTransform * float4(input.Position, 1.0f);
+		uint4 boneIndices = input.BoneIndices * 3;
+		float4 row0 = boneMatrices.boneRows[boneIndices[0]] * input.BoneWeights[0];
+		float4 row1 = boneMatrices.boneRows[boneIndices[0] + 1] * input.BoneWeights[0];
+		float4 row2 = boneMatrices.boneRows[boneIndices[0] + 2] * input.BoneWeights[0];
+		row0 += boneMatrices.boneRows[boneIndices[1]] * input.BoneWeights[1];
+		row1 += boneMatrices.boneRows[boneIndices[1] + 1] * input.BoneWeights[1];
+		row2 += boneMatrices.boneRows[boneIndices[1] + 2] * input.BoneWeights[1];
+		row0 += boneMatrices.boneRows[boneIndices[2]] * input.BoneWeights[2];
+		row1 += boneMatrices.boneRows[boneIndices[2] + 1] * input.BoneWeights[2];
+		row2 += boneMatrices.boneRows[boneIndices[2] + 2] * input.BoneWeights[2];
+		row0 += boneMatrices.boneRows[boneIndices[3]] * input.BoneWeights[3];
+		row1 += boneMatrices.boneRows[boneIndices[3] + 1] * input.BoneWeights[3];
+		row2 += boneMatrices.boneRows[boneIndices[3] + 2] * input.BoneWeights[3];
+
+		float4 position = float4(input.Position, 1.0f);
+		result.Position = float4(dot(row0, position), dot(row1, position), dot(row2, position), dot(input.BoneWeights, float4(1.0f)));
 		result.Position = uniformBlock.modelMatrix * result.Position;
 		result.Position = uniformBlock.vpMatrix * result.Position;
 		result.Normal = normalize((uniformBlock.modelMatrix * float4(input.Normal, 0.0f)).xyz);
@@ -59,24 +64,21 @@ struct Vertex_Shader
     };
 
     Vertex_Shader(constant Uniforms_uniformBlock & uniformBlock,
-				  constant Uniforms_boneMatrices & boneMatrices,
-				  constant Uniforms_boneOffsetMatrices & boneOffsetMatrices) :
+				  constant Uniforms_boneMatrices & boneMatrices) :
 	uniformBlock(uniformBlock),
-	boneMatrices(boneMatrices),
-	boneOffsetMatrices(boneOffsetMatrices){}
+	boneMatrices(boneMatrices){}
 };
 
 
 vertex Vertex_Shader::VSOutput stageMain(Vertex_Shader::VSInput input [[stage_in]],
 constant     Vertex_Shader::Uniforms_uniformBlock & uniformBlock [[buffer(1)]],
-constant     Vertex_Shader::Uniforms_boneMatrices & boneMatrices [[buffer(2)]],
-constant     Vertex_Shader::Uniforms_boneOffsetMatrices & boneOffsetMatrices [[buffer(3)]]) {
+constant     Vertex_Shader::Uniforms_boneMatrices & boneMatrices [[buffer(2)]]) {
     Vertex_Shader::VSInput input0;
     input0.Position = input.Position;
     input0.Normal = input.Normal;
 	input0.UV = input.UV;
 	input0.BoneWeights = input.BoneWeights;
 	input0.BoneIndices = input.BoneIndices;
-    Vertex_Shader main(uniformBlock, boneMatrices, boneOffsetMatrices);
+    Vertex_Shader main(uniformBlock, boneMatrices);
         return main.main(input0);
 }
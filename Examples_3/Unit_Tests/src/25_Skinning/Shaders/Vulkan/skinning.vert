@@ -43,24 +43,30 @@ layout (std140, set=3, binding=0) uniform uniformBlock
 	mat4 modelMatrix;
 };
 
+// Skinning matrices of the instance, the three top rows of each matrix
 layout(std140, set = 0, binding = 1) uniform boneMatrices
 {
-	 mat4 boneMatrix[MAX_NUM_BONES];
-};
-
-layout(std140, set = 0, binding = 2) uniform boneOffsetMatrices
-{
-	mat4 boneOffsetMatrix[MAX_NUM_BONES];
+	vec4 boneRows[MAX_NUM_BONES * 3];
 };
 
 void main ()
 {
-	mat4 boneTransform = boneMatrix[iBoneIndices[0]] * boneOffsetMatrix[iBoneIndices[0]] * iBoneWeights[0];
-	boneTransform += boneMatrix[iBoneIndices[1]] * boneOffsetMatrix[iBoneIndices[1]] * iBoneWeights[1];
-	boneTransform += boneMatrix[iBoneIndices[2]] * boneOffsetMatrix[iBoneIndices[2]] * iBoneWeights[2];
-	boneTransform += boneMatrix[iBoneIndices[3]] * boneOffsetMatrix[iBoneIndices[3]] * iBoneWeights[3];
+	uvec4 boneIndices = iBoneIndices * 3;
+	vec4 row0 = boneRows[boneIndices[0]] * iBoneWeights[0];
+	vec4 row1 = boneRows[boneIndices[0] + 1] * iBoneWeights[0];
+	vec4 row2 = boneRows[boneIndices[0] + 2] * iBoneWeights[0];
+	row0 += boneRows[boneIndices[1]] * iBoneWeights[1];
+	row1 += boneRows[boneIndices[1] + 1] * iBoneWeights[1];
+	row2 += boneRows[boneIndices[1] + 2] * iBoneWeights[1];
+	row0 += boneRows[boneIndices[2]] * iBoneWeights[2];
+	row1 += boneRows[boneIndices[2] + 1] * iBoneWeights[2];
+	row2 += boneRows[boneIndices[2] + 2] * iBoneWeights[2];
+	row0 += boneRows[boneIndices[3]] * iBoneWeights[3];
+	row1 += boneRows[boneIndices[3] + 1] * iBoneWeights[3];
+	row2 += boneRows[boneIndices[3] + 2] * iBoneWeights[3];
 
-	gl_Position = boneTransform * vec4(iPosition, 1.0f);
+	vec4 position = vec4(iPosition, 1.0f);
+	gl_Position = vec4(dot(row0, position), dot(row1, position), dot(row2, position), dot(iBoneWeights, vec4(1.0f)));
 	gl_Position = modelMatrix * gl_Position;
 	gl_Position = vpMatrix * gl_Position;
 	oNormal = normalize((modelMatrix * vec4(iNormal, 0.0f)).xyz);
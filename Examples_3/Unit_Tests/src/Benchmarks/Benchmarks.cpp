@@ -0,0 +1,2184 @@
+/*
+ * Copyright (c) 2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Headless CPU benchmarks for the core engine primitives.
+// Covers the ThreadSystem, File reads, LogManager contention, conf_malloc churn, vectormath kernels,
+// ozz sampling / blending / local to model, AnimatedObject (with and without LOD) vs AnimationSystem updates, whose poses
+// are checked against each other,
+// the Visibility Buffer cluster builders, checked against a scalar reference, and culling, occlusion culling and sorting,
+// which are also checked against brute force,
+// the DepthSorter against the per-frame sort of 15_Transparency it replaced, the texture streaming residency updates, whose
+// state transitions are checked frame by frame with simulated uploads, and the sprite systems of 17_EntityComponentSystem
+// serial and threaded, with the avoidance grid checked against every sprite testing every avoider.
+// Both find the collisions for the positions at the start of the update, so that check covers the grid but not the change
+// from the sample before, which moved a sprite on each hit before testing it against the next avoider.
+// Usage: Benchmarks [--iterations N] [--warmup N] [--filter group] [--json results.json] [--compare baseline.json] [--threshold T]
+
+#include "../../../../Common_3/OS/Interfaces/IOperatingSystem.h"
+#include "../../../../Common_3/OS/Interfaces/IFileSystem.h"
+#include "../../../../Common_3/OS/Interfaces/ILogManager.h"
+#include "../../../../Common_3/OS/Core/Atomics.h"
+#include "../../../../Common_3/OS/Core/ThreadSystem.h"
+#include "../../../../Common_3/OS/Core/DepthSort.h"
+#include "../../../../Common_3/Renderer/TextureStreaming.h"
+
+#include "../../../../Common_3/ThirdParty/OpenSource/EASTL/sort.h"
+
+#include "../../../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/runtime/animation.h"
+#include "../../../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/runtime/skeleton.h"
+#include "../../../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/runtime/sampling_job.h"
+#include "../../../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/runtime/blending_job.h"
+#include "../../../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/runtime/local_to_model_job.h"
+#include "../../../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/offline/raw_skeleton.h"
+#include "../../../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/offline/raw_animation.h"
+#include "../../../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/offline/skeleton_builder.h"
+#include "../../../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/offline/animation_builder.h"
+#include "../../../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/base/memory/allocator.h"
+#include "../../../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/base/io/archive.h"
+#include "../../../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/base/io/stream.h"
+
+#include "../../../../Middleware_3/Animation/AnimatedObject.h"
+#include "../../../../Middleware_3/Animation/AnimationSystem.h"
+
+#include "../../../Visibility_Buffer/src/Geometry.h"
+
+#include "../17_EntityComponentSystem/SpriteSystems.h"
+
+#include "../../../Common/Benchmark.h"
+
+#include <cstdio>
+
+#include "../../../../Common_3/OS/Interfaces/IMemoryManager.h"
+
+const char* pszBases[FSR_Count] = {
+	"",    // FSR_BinShaders
+	"",    // FSR_SrcShaders
+	"",    // FSR_Textures
+	"",    // FSR_Meshes
+	"",    // FSR_Builtin_Fonts
+	"",    // FSR_GpuConfig
+	"",    // FSR_Animation
+	"",    // FSR_OtherFiles
+	"",    // FSR_MIDDLEWARE_TEXT
+	"",    // FSR_MIDDLEWARE_UI
+};
+
+const char* gApplicationName = NULL;
+
+// Set by the benchmarks that also check their results, so a wrong result fails the run like a regression
+static bool gChecksFailed = false;
+
+// Deterministic inputs so results are comparable between runs
+static uint32_t gRandomState = 0x12345678;
+static uint32_t randomUint()
+{
+	gRandomState = gRandomState * 1664525u + 1013904223u;
+	return gRandomState >> 8;
+}
+static float randomFloat(float minValue, float maxValue) { return minValue + (maxValue - minValue) * (randomUint() / 16777216.0f); }
+
+static BenchmarkDesc makeDesc(const BenchmarkOptions* pOptions, const char* pGroup, const char* pName, BenchmarkFunc pFunc, void* pUserData)
+{
+	BenchmarkDesc desc = {};
+	desc.pGroup = pGroup;
+	desc.pName = pName;
+	desc.pFunc = pFunc;
+	desc.pUserData = pUserData;
+	desc.mIterations = pOptions->mIterations;
+	desc.mWarmupIterations = pOptions->mWarmupIterations;
+	return desc;
+}
+
+static void addResult(const BenchmarkDesc* pDesc, eastl::vector<BenchmarkResult>& results)
+{
+	BenchmarkResult result;
+	runBenchmark(pDesc, &result);
+	results.push_back(result);
+}
+
+/************************************************************************/
+// ThreadSystem
+/************************************************************************/
+enum
+{
+	THREAD_TASK_COUNT = 4096,
+	LOG_TASK_COUNT = 16,
+	LOG_MESSAGES_PER_TASK = 64,
+};
+
+typedef struct ThreadBenchmarkData
+{
+	ThreadSystem*   pThreadSystem;
+	tfrg_atomic64_t mCounter;
+} ThreadBenchmarkData;
+
+static void counterTask(void* pUser, uintptr_t)
+{
+	ThreadBenchmarkData* pData = (ThreadBenchmarkData*)pUser;
+	tfrg_atomic64_add_relaxed(&pData->mCounter, 1);
+}
+
+static void singleTasksFunc(void* pUserData)
+{
+	ThreadBenchmarkData* pData = (ThreadBenchmarkData*)pUserData;
+	for (uint32_t i = 0; i < THREAD_TASK_COUNT; ++i)
+		addThreadSystemTask(pData->pThreadSystem, counterTask, pData, i);
+	waitThreadSystemIdle(pData->pThreadSystem);
+}
+
+static void rangeTaskFunc(void* pUserData)
+{
+	ThreadBenchmarkData* pData = (ThreadBenchmarkData*)pUserData;
+	addThreadSystemRangeTask(pData->pThreadSystem, counterTask, pData, THREAD_TASK_COUNT);
+	waitThreadSystemIdle(pData->pThreadSystem);
+}
+
+// Time from queuing a single task until the system is idle again
+static void roundTripFunc(void* pUserData)
+{
+	ThreadBenchmarkData* pData = (ThreadBenchmarkData*)pUserData;
+	addThreadSystemTask(pData->pThreadSystem, counterTask, pData);
+	waitThreadSystemIdle(pData->pThreadSystem);
+}
+
+static void logTask(void*, uintptr_t index)
+{
+	for (uint32_t i = 0; i < LOG_MESSAGES_PER_TASK; ++i)
+		LOGF(LogLevel::eINFO, "Benchmark log message %u from task %u", i, (uint32_t)index);
+}
+
+static void logContentionFunc(void* pUserData)
+{
+	ThreadBenchmarkData* pData = (ThreadBenchmarkData*)pUserData;
+	addThreadSystemRangeTask(pData->pThreadSystem, logTask, pData, LOG_TASK_COUNT);
+	waitThreadSystemIdle(pData->pThreadSystem);
+}
+
+static void benchmarkThreadSystem(const BenchmarkOptions* pOptions, eastl::vector<BenchmarkResult>& results)
+{
+	ThreadBenchmarkData data = {};
+	initThreadSystem(&data.pThreadSystem);
+
+	if (isBenchmarkGroupEnabled(pOptions, "thread"))
+	{
+		BenchmarkDesc desc = makeDesc(pOptions, "thread", "single tasks", singleTasksFunc, &data);
+		desc.mItemsPerIteration = THREAD_TASK_COUNT;
+		addResult(&desc, results);
+
+		desc = makeDesc(pOptions, "thread", "range task", rangeTaskFunc, &data);
+		desc.mItemsPerIteration = THREAD_TASK_COUNT;
+		addResult(&desc, results);
+
+		desc = makeDesc(pOptions, "thread", "round trip latency", roundTripFunc, &data);
+		desc.mIterations = pOptions->mIterations * 100;
+		desc.mItemsPerIteration = 1;
+		addResult(&desc, results);
+	}
+
+	if (isBenchmarkGroupEnabled(pOptions, "log"))
+	{
+		// Quiet mode keeps the console out of the measurement, messages still go through the lock and to the log file
+		const bool quiet = LogManager::IsQuiet();
+		LogManager::SetQuiet(true);
+		BenchmarkDesc desc = makeDesc(pOptions, "log", "Write contention", logContentionFunc, &data);
+		desc.mItemsPerIteration = LOG_TASK_COUNT * LOG_MESSAGES_PER_TASK;
+		addResult(&desc, results);
+		LogManager::SetQuiet(quiet);
+	}
+
+	shutdownThreadSystem(data.pThreadSystem);
+}
+
+/************************************************************************/
+// File
+/************************************************************************/
+typedef struct FileBenchmarkData
+{
+	eastl::string       mPath;
+	eastl::vector<char> mBuffer;
+	uint32_t            mChunkSize;
+} FileBenchmarkData;
+
+static void fileReadFunc(void* pUserData)
+{
+	FileBenchmarkData* pData = (FileBenchmarkData*)pUserData;
+	File               file;
+	file.Open(pData->mPath, FM_ReadBinary, FSR_Absolute);
+	const unsigned size = file.GetSize();
+	for (unsigned offset = 0; offset < size; offset += pData->mChunkSize)
+		file.Read(pData->mBuffer.data(), min(pData->mChunkSize, size - offset));
+	file.Close();
+}
+
+static void benchmarkFile(const BenchmarkOptions* pOptions, eastl::vector<BenchmarkResult>& results)
+{
+	if (!isBenchmarkGroupEnabled(pOptions, "file"))
+		return;
+
+	const uint32_t fileSize = 32 * 1024 * 1024;
+
+	FileBenchmarkData data;
+	data.mPath = FileSystem::GetCurrentDir() + "BenchmarkFileRead.bin";
+	data.mBuffer.resize(fileSize);
+	for (uint32_t i = 0; i < fileSize; ++i)
+		data.mBuffer[i] = (char)randomUint();
+
+	File file;
+	if (!file.Open(data.mPath, FM_WriteBinary, FSR_Absolute))
+	{
+		LOGF(LogLevel::eERROR, "Failed to create \"%s\". Skipping file benchmarks", data.mPath.c_str());
+		return;
+	}
+	file.Write(data.mBuffer.data(), fileSize);
+	file.Close();
+
+	// The file was just written so these measure reads from the OS file cache
+	const uint32_t chunkSizes[] = { 4 * 1024, 64 * 1024, fileSize };
+	const char*    chunkNames[] = { "read 4KB chunks", "read 64KB chunks", "read whole file" };
+	for (uint32_t i = 0; i < sizeof(chunkSizes) / sizeof(chunkSizes[0]); ++i)
+	{
+		data.mChunkSize = chunkSizes[i];
+		BenchmarkDesc desc = makeDesc(pOptions, "file", chunkNames[i], fileReadFunc, &data);
+		desc.mBytesPerIteration = fileSize;
+		addResult(&desc, results);
+	}
+
+	FileSystem::Delete(data.mPath);
+}
+
+/************************************************************************/
+// conf_malloc
+/************************************************************************/
+enum
+{
+	MEMORY_SLOT_COUNT = 1024,
+	MEMORY_OPERATION_COUNT = 16384,
+};
+
+typedef struct MemoryBenchmarkData
+{
+	void*    pSlots[MEMORY_SLOT_COUNT];
+	uint32_t mOperations[MEMORY_OPERATION_COUNT];
+	uint32_t mSizes[MEMORY_OPERATION_COUNT];
+} MemoryBenchmarkData;
+
+static void memoryChurnFunc(void* pUserData)
+{
+	MemoryBenchmarkData* pData = (MemoryBenchmarkData*)pUserData;
+	for (uint32_t i = 0; i < MEMORY_OPERATION_COUNT; ++i)
+	{
+		void*& pSlot = pData->pSlots[pData->mOperations[i]];
+		conf_free(pSlot);
+		pSlot = conf_malloc(pData->mSizes[i]);
+	}
+	for (uint32_t i = 0; i < MEMORY_SLOT_COUNT; ++i)
+	{
+		conf_free(pData->pSlots[i]);
+		pData->pSlots[i] = NULL;
+	}
+}
+
+static void benchmarkMemory(const BenchmarkOptions* pOptions, eastl::vector<BenchmarkResult>& results)
+{
+	if (!isBenchmarkGroupEnabled(pOptions, "memory"))
+		return;
+
+	MemoryBenchmarkData* pData = (MemoryBenchmarkData*)conf_calloc(1, sizeof(MemoryBenchmarkData));
+
+	const uint32_t maxSizes[] = { 256, 64 * 1024 };
+	const char*    names[] = { "churn 16B-256B", "churn 16B-64KB" };
+	for (uint32_t i = 0; i < sizeof(maxSizes) / sizeof(maxSizes[0]); ++i)
+	{
+		for (uint32_t j = 0; j < MEMORY_OPERATION_COUNT; ++j)
+		{
+			pData->mOperations[j] = randomUint() % MEMORY_SLOT_COUNT;
+			pData->mSizes[j] = 16 + randomUint() % (maxSizes[i] - 16);
+		}
+
+		BenchmarkDesc desc = makeDesc(pOptions, "memory", names[i], memoryChurnFunc, pData);
+		desc.mItemsPerIteration = MEMORY_OPERATION_COUNT;
+		addResult(&desc, results);
+	}
+
+	conf_free(pData);
+}
+
+/************************************************************************/
+// Math
+/************************************************************************/
+enum
+{
+	MATH_ELEMENT_COUNT = 4096,
+};
+
+typedef struct MathBenchmarkData
+{
+	eastl::vector<mat4> mMatricesA;
+	eastl::vector<mat4> mMatricesB;
+	eastl::vector<mat4> mMatricesOut;
+	eastl::vector<vec4> mVectors;
+	eastl::vector<vec4> mVectorsOut;
+	eastl::vector<Quat> mQuatsA;
+	eastl::vector<Quat> mQuatsB;
+	eastl::vector<Quat> mQuatsOut;
+} MathBenchmarkData;
+
+static void mat4MultiplyFunc(void* pUserData)
+{
+	MathBenchmarkData* pData = (MathBenchmarkData*)pUserData;
+	for (uint32_t i = 0; i < MATH_ELEMENT_COUNT; ++i)
+		pData->mMatricesOut[i] = pData->mMatricesA[i] * pData->mMatricesB[i];
+}
+
+static void mat4InverseFunc(void* pUserData)
+{
+	MathBenchmarkData* pData = (MathBenchmarkData*)pUserData;
+	for (uint32_t i = 0; i < MATH_ELEMENT_COUNT; ++i)
+		pData->mMatricesOut[i] = inverse(pData->mMatricesA[i]);
+}
+
+static void mat4TransformFunc(void* pUserData)
+{
+	MathBenchmarkData* pData = (MathBenchmarkData*)pUserData;
+	for (uint32_t i = 0; i < MATH_ELEMENT_COUNT; ++i)
+		pData->mVectorsOut[i] = pData->mMatricesA[i] * pData->mVectors[i];
+}
+
+static void quatMultiplyFunc(void* pUserData)
+{
+	MathBenchmarkData* pData = (MathBenchmarkData*)pUserData;
+	for (uint32_t i = 0; i < MATH_ELEMENT_COUNT; ++i)
+		pData->mQuatsOut[i] = pData->mQuatsA[i] * pData->mQuatsB[i];
+}
+
+static void quatSlerpFunc(void* pUserData)
+{
+	MathBenchmarkData* pData = (MathBenchmarkData*)pUserData;
+	for (uint32_t i = 0; i < MATH_ELEMENT_COUNT; ++i)
+		pData->mQuatsOut[i] = slerp(0.35f, pData->mQuatsA[i], pData->mQuatsB[i]);
+}
+
+static void quatToMat4Func(void* pUserData)
+{
+	MathBenchmarkData* pData = (MathBenchmarkData*)pUserData;
+	for (uint32_t i = 0; i < MATH_ELEMENT_COUNT; ++i)
+		pData->mMatricesOut[i] = mat4(pData->mQuatsA[i], pData->mVectors[i].getXYZ());
+}
+
+static Quat randomQuat() { return normalize(Quat(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), 1.0f)); }
+
+static void benchmarkMath(const BenchmarkOptions* pOptions, eastl::vector<BenchmarkResult>& results)
+{
+	if (!isBenchmarkGroupEnabled(pOptions, "math"))
+		return;
+
+	MathBenchmarkData data;
+	data.mMatricesA.resize(MATH_ELEMENT_COUNT);
+	data.mMatricesB.resize(MATH_ELEMENT_COUNT);
+	data.mMatricesOut.resize(MATH_ELEMENT_COUNT);
+	data.mVectors.resize(MATH_ELEMENT_COUNT);
+	data.mVectorsOut.resize(MATH_ELEMENT_COUNT);
+	data.mQuatsA.resize(MATH_ELEMENT_COUNT);
+	data.mQuatsB.resize(MATH_ELEMENT_COUNT);
+	data.mQuatsOut.resize(MATH_ELEMENT_COUNT);
+	for (uint32_t i = 0; i < MATH_ELEMENT_COUNT; ++i)
+	{
+		data.mVectors[i] = vec4(randomFloat(-10.0f, 10.0f), randomFloat(-10.0f, 10.0f), randomFloat(-10.0f, 10.0f), 1.0f);
+		data.mQuatsA[i] = randomQuat();
+		data.mQuatsB[i] = randomQuat();
+		data.mMatricesA[i] = mat4(data.mQuatsA[i], data.mVectors[i].getXYZ()) * mat4::scale(vec3(randomFloat(0.5f, 2.0f)));
+		data.mMatricesB[i] = mat4(data.mQuatsB[i], -data.mVectors[i].getXYZ());
+	}
+
+	struct
+	{
+		const char*   pName;
+		BenchmarkFunc pFunc;
+	} kernels[] = {
+		{ "mat4 multiply", mat4MultiplyFunc }, { "mat4 inverse", mat4InverseFunc }, { "mat4 * vec4", mat4TransformFunc },
+		{ "quat multiply", quatMultiplyFunc }, { "quat slerp", quatSlerpFunc },      { "quat to mat4", quatToMat4Func },
+	};
+
+	for (uint32_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i)
+	{
+		BenchmarkDesc desc = makeDesc(pOptions, "math", kernels[i].pName, kernels[i].pFunc, &data);
+		desc.mIterations = pOptions->mIterations * 10;
+		desc.mItemsPerIteration = MATH_ELEMENT_COUNT;
+		addResult(&desc, results);
+	}
+}
+
+/************************************************************************/
+// ozz animation
+/************************************************************************/
+enum
+{
+	OZZ_JOINT_COUNT = 128,
+	OZZ_KEY_COUNT = 60,
+};
+
+typedef struct AnimationBenchmarkData
+{
+	ozz::animation::Skeleton       mSkeleton;
+	ozz::animation::Animation      mAnimations[2];
+	ozz::animation::SamplingCache* pCaches[2];
+	ozz::Range<SoaTransform>       mLocalTrans[2];
+	ozz::Range<SoaTransform>       mBlendedTrans;
+	ozz::Range<Matrix4>            mModelMats;
+	float                          mRatio;
+} AnimationBenchmarkData;
+
+static void samplingFunc(void* pUserData)
+{
+	AnimationBenchmarkData* pData = (AnimationBenchmarkData*)pUserData;
+	// Advance like a 60Hz playback of a 2s clip so the cache is exercised the way it is at runtime
+	pData->mRatio = fmodf(pData->mRatio + 1.0f / 120.0f, 1.0f);
+
+	ozz::animation::SamplingJob samplingJob;
+	samplingJob.animation = &pData->mAnimations[0];
+	samplingJob.cache = pData->pCaches[0];
+	samplingJob.ratio = pData->mRatio;
+	samplingJob.output = pData->mLocalTrans[0];
+	samplingJob.Run();
+}
+
+static void blendingFunc(void* pUserData)
+{
+	AnimationBenchmarkData* pData = (AnimationBenchmarkData*)pUserData;
+
+	ozz::animation::BlendingJob::Layer layers[2];
+	layers[0].transform = pData->mLocalTrans[0];
+	layers[0].weight = 0.7f;
+	layers[1].transform = pData->mLocalTrans[1];
+	layers[1].weight = 0.3f;
+
+	ozz::animation::BlendingJob blendJob;
+	blendJob.layers = layers;
+	blendJob.bind_pose = pData->mSkeleton.bind_pose();
+	blendJob.output = pData->mBlendedTrans;
+	blendJob.Run();
+}
+
+static void localToModelFunc(void* pUserData)
+{
+	AnimationBenchmarkData* pData = (AnimationBenchmarkData*)pUserData;
+
+	ozz::animation::LocalToModelJob ltmJob;
+	ltmJob.skeleton = &pData->mSkeleton;
+	ltmJob.input = pData->mBlendedTrans;
+	ltmJob.output = pData->mModelMats;
+	ltmJob.Run();
+}
+
+static bool buildAnimationData(AnimationBenchmarkData* pData)
+{
+	// Humanoid-like hierarchy: a root with several chains of joints
+	const uint32_t chainCount = 8;
+	const uint32_t chainLength = (OZZ_JOINT_COUNT - 1) / chainCount;
+
+	ozz::animation::offline::RawSkeleton rawSkeleton;
+	ozz::animation::offline::RawSkeleton::Joint root;
+	root.name = "root";
+	root.transform = AffineTransform::identity();
+	rawSkeleton.roots.push_back(root);
+
+	uint32_t jointIndex = 1;
+	rawSkeleton.roots[0].children.reserve(chainCount);
+	for (uint32_t i = 0; i < chainCount; ++i)
+	{
+		ozz::animation::offline::RawSkeleton::Joint::Children* pChildren = &rawSkeleton.roots[0].children;
+		for (uint32_t j = 0; j < chainLength; ++j, ++jointIndex)
+		{
+			ozz::animation::offline::RawSkeleton::Joint joint;
+			char                                        name[32];
+			sprintf(name, "joint%u", jointIndex);
+			joint.name = name;
+			joint.transform.translation = vec3(0.0f, 0.1f, 0.0f);
+			joint.transform.rotation = randomQuat();
+			joint.transform.scale = vec3(1.0f);
+			pChildren->reserve(1);
+			pChildren->push_back(joint);
+			pChildren = &pChildren->back().children;
+		}
+	}
+
+	if (!rawSkeleton.Validate() || !ozz::animation::offline::SkeletonBuilder::Build(rawSkeleton, &pData->mSkeleton))
+		return false;
+
+	const uint32_t numJoints = (uint32_t)pData->mSkeleton.num_joints();
+	for (uint32_t a = 0; a < 2; ++a)
+	{
+		ozz::animation::offline::RawAnimation rawAnimation;
+		rawAnimation.duration = 2.0f;
+		rawAnimation.tracks.resize(numJoints);
+		for (uint32_t i = 0; i < numJoints; ++i)
+		{
+			ozz::animation::offline::RawAnimation::JointTrack* track = &rawAnimation.tracks[i];
+			track->translations.resize(OZZ_KEY_COUNT);
+			track->rotations.resize(OZZ_KEY_COUNT);
+			track->scales.resize(1);
+			for (uint32_t k = 0; k < OZZ_KEY_COUNT; ++k)
+			{
+				const float time = rawAnimation.duration * k / (OZZ_KEY_COUNT - 1);
+				track->translations[k] = { time, vec3(randomFloat(-0.1f, 0.1f), 0.1f, randomFloat(-0.1f, 0.1f)) };
+				track->rotations[k] = { time, randomQuat() };
+			}
+			track->scales[0] = { 0.0f, vec3(1.0f) };
+		}
+
+		if (!rawAnimation.Validate() || !ozz::animation::offline::AnimationBuilder::Build(rawAnimation, &pData->mAnimations[a]))
+			return false;
+	}
+
+	ozz::memory::Allocator* allocator = ozz::memory::default_allocator();
+	for (uint32_t a = 0; a < 2; ++a)
+	{
+		pData->pCaches[a] = allocator->New<ozz::animation::SamplingCache>(numJoints);
+		pData->mLocalTrans[a] = allocator->AllocateRange<SoaTransform>(pData->mSkeleton.num_soa_joints());
+	}
+	pData->mBlendedTrans = allocator->AllocateRange<SoaTransform>(pData->mSkeleton.num_soa_joints());
+	pData->mModelMats = allocator->AllocateRange<Matrix4>(numJoints);
+	pData->mRatio = 0.0f;
+
+	// Prime the second layer and the blended pose so blending and local to model have valid input
+	ozz::animation::SamplingJob samplingJob;
+	samplingJob.animation = &pData->mAnimations[1];
+	samplingJob.cache = pData->pCaches[1];
+	samplingJob.ratio = 0.5f;
+	samplingJob.output = pData->mLocalTrans[1];
+	samplingJob.Run();
+	samplingFunc(pData);
+	blendingFunc(pData);
+
+	return true;
+}
+
+static void destroyAnimationData(AnimationBenchmarkData* pData)
+{
+	ozz::memory::Allocator* allocator = ozz::memory::default_allocator();
+	for (uint32_t a = 0; a < 2; ++a)
+	{
+		allocator->Delete(pData->pCaches[a]);
+		allocator->Deallocate(pData->mLocalTrans[a]);
+		pData->mAnimations[a].Deallocate();
+	}
+	allocator->Deallocate(pData->mBlendedTrans);
+	allocator->Deallocate(pData->mModelMats);
+	pData->mSkeleton.Deallocate();
+}
+
+static void benchmarkAnimation(const BenchmarkOptions* pOptions, eastl::vector<BenchmarkResult>& results)
+{
+	if (!isBenchmarkGroupEnabled(pOptions, "ozz"))
+		return;
+
+	AnimationBenchmarkData data = {};
+	if (!buildAnimationData(&data))
+	{
+		LOGF(LogLevel::eERROR, "Failed to build the benchmark skeleton or animation. Skipping ozz benchmarks");
+		destroyAnimationData(&data);
+		return;
+	}
+
+	eastl::string input;
+	input.sprintf("%d joints", data.mSkeleton.num_joints());
+
+	struct
+	{
+		const char*   pName;
+		BenchmarkFunc pFunc;
+	} jobs[] = {
+		{ "SamplingJob", samplingFunc },
+		{ "BlendingJob 2 layers", blendingFunc },
+		{ "LocalToModelJob", localToModelFunc },
+	};
+
+	for (uint32_t i = 0; i < sizeof(jobs) / sizeof(jobs[0]); ++i)
+	{
+		BenchmarkDesc desc = makeDesc(pOptions, "ozz", jobs[i].pName, jobs[i].pFunc, &data);
+		desc.pInput = input.c_str();
+		desc.mIterations = pOptions->mIterations * 100;
+		desc.mItemsPerIteration = data.mSkeleton.num_joints();
+		addResult(&desc, results);
+	}
+
+	destroyAnimationData(&data);
+}
+
+/************************************************************************/
+// AnimatedObject vs AnimationSystem
+/************************************************************************/
+enum
+{
+	ANIMATED_INSTANCE_COUNT = 10240,
+	ANIMATED_OBJECT_GRAIN_SIZE = 32,
+	// Instances are lined up over this distance from the camera, a third in each LOD level
+	ANIMATED_LOD_RANGE = 60,
+};
+
+typedef struct AnimatedObjectTaskData
+{
+	AnimatedObject* pObjects;
+	uint32_t        mCount;
+} AnimatedObjectTaskData;
+
+typedef struct AnimationSystemBenchmarkData
+{
+	ThreadSystem*                         pThreadSystem;
+	Clip                                  mClip;
+	Rig*                                  pRigs;
+	ClipController*                       pClipControllers;
+	Animation*                            pAnimations;
+	AnimatedObject*                       pAnimatedObjects;
+	// Same instances sampling through a cache pool and a clip with shared sampling
+	Clip                                  mSharedClip;
+	SamplingCachePool                     mSamplingCachePool;
+	Animation*                            pPooledAnimations;
+	AnimatedObject*                       pPooledObjects;
+	eastl::vector<AnimatedObjectTaskData> mTasks;
+	AnimationSystem                       mAnimationSystem;
+	AnimationSystem                       mThreadedAnimationSystem;
+	AnimationLODScheduler                 mLODScheduler;
+} AnimationSystemBenchmarkData;
+
+static const float gAnimationBenchmarkDt = 1.0f / 60.0f;
+
+static void animatedObjectTask(void* pUser, uintptr_t index)
+{
+	AnimatedObjectTaskData* pTask = (AnimatedObjectTaskData*)pUser + index;
+	for (uint32_t i = 0; i < pTask->mCount; ++i)
+	{
+		pTask->pObjects[i].Update(gAnimationBenchmarkDt);
+		pTask->pObjects[i].PoseRig();
+	}
+}
+
+static void animatedObjectSerialFunc(void* pUserData)
+{
+	AnimationSystemBenchmarkData* pData = (AnimationSystemBenchmarkData*)pUserData;
+	for (uint32_t i = 0; i < ANIMATED_INSTANCE_COUNT; ++i)
+	{
+		pData->pAnimatedObjects[i].Update(gAnimationBenchmarkDt);
+		pData->pAnimatedObjects[i].PoseRig();
+	}
+}
+
+static void pooledObjectSerialFunc(void* pUserData)
+{
+	AnimationSystemBenchmarkData* pData = (AnimationSystemBenchmarkData*)pUserData;
+	for (uint32_t i = 0; i < ANIMATED_INSTANCE_COUNT; ++i)
+	{
+		pData->pPooledObjects[i].Update(gAnimationBenchmarkDt);
+		pData->pPooledObjects[i].PoseRig();
+	}
+}
+
+static void animatedObjectLODFunc(void* pUserData)
+{
+	AnimationSystemBenchmarkData* pData = (AnimationSystemBenchmarkData*)pUserData;
+	pData->mLODScheduler.Update(vec3(0.0f));
+	animatedObjectSerialFunc(pUserData);
+}
+
+// Same split as 24_MultiThread
+static void animatedObjectThreadedFunc(void* pUserData)
+{
+	AnimationSystemBenchmarkData* pData = (AnimationSystemBenchmarkData*)pUserData;
+	addThreadSystemRangeTask(pData->pThreadSystem, animatedObjectTask, pData->mTasks.data(), pData->mTasks.size());
+	waitThreadSystemIdle(pData->pThreadSystem);
+}
+
+// The objects pick their LOD level and phase on the worker threads
+static void animatedObjectLODThreadedFunc(void* pUserData)
+{
+	AnimationSystemBenchmarkData* pData = (AnimationSystemBenchmarkData*)pUserData;
+	pData->mLODScheduler.Update(vec3(0.0f));
+	animatedObjectThreadedFunc(pUserData);
+}
+
+static void animationSystemSerialFunc(void* pUserData)
+{
+	AnimationSystemBenchmarkData* pData = (AnimationSystemBenchmarkData*)pUserData;
+	pData->mAnimationSystem.Update(gAnimationBenchmarkDt);
+}
+
+static void animationSystemThreadedFunc(void* pUserData)
+{
+	AnimationSystemBenchmarkData* pData = (AnimationSystemBenchmarkData*)pUserData;
+	pData->mThreadedAnimationSystem.Update(gAnimationBenchmarkDt);
+}
+
+// Every ANIMATION_CHECK_STRIDE-th instance is compared, the AnimatedObjects and the AnimationSystems pose the same rigs
+enum
+{
+	ANIMATION_CHECK_STRIDE = 64,
+	ANIMATION_CHECK_FRAMES = 3,
+};
+
+// Returns the number of joints whose model space matrix the AnimationSystem posed differently than the AnimatedObject did
+// in pReference. Both start from the same time ratios and advance by the same frames
+static uint32_t checkAnimationSystemPoses(AnimationSystemBenchmarkData* pData, AnimationSystem* pSystem, const Matrix4* pReference)
+{
+	for (uint32_t frame = 0; frame < ANIMATION_CHECK_FRAMES; ++frame)
+		pSystem->Update(gAnimationBenchmarkDt);
+
+	const float    tolerance = 1e-4f;
+	const uint32_t jointCount = pData->pRigs[0].GetNumJoints();
+	uint32_t       mismatchCount = 0;
+	for (uint32_t i = 0; i < ANIMATED_INSTANCE_COUNT; i += ANIMATION_CHECK_STRIDE)
+	{
+		const ozz::Range<Matrix4> joints = pData->pRigs[i].GetJointModelMats();
+		for (uint32_t j = 0; j < jointCount; ++j, ++pReference)
+		{
+			float maxDiff = 0.0f;
+			for (uint32_t c = 0; c < 4; ++c)
+				maxDiff = max(maxDiff, (float)maxElem(absPerElem(joints[j][c] - (*pReference)[c])));
+			if (maxDiff > tolerance)
+				++mismatchCount;
+		}
+	}
+	return mismatchCount;
+}
+
+template <typename T>
+static T* allocateObjects(uint32_t count)
+{
+	T* pObjects = (T*)conf_calloc(count, sizeof(T));
+	for (uint32_t i = 0; i < count; ++i)
+		conf_placement_new<T>(&pObjects[i]);
+	return pObjects;
+}
+
+template <typename T>
+static void freeObjects(T* pObjects, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+		pObjects[i].~T();
+	conf_free(pObjects);
+}
+
+template <typename T>
+static bool saveOzzObject(const eastl::string& path, const T& object)
+{
+	ozz::io::File file(path.c_str(), "wb");
+	if (!file.opened())
+		return false;
+	ozz::io::OArchive archive(&file);
+	archive << object;
+	return true;
+}
+
+static void benchmarkAnimationSystem(const BenchmarkOptions* pOptions, eastl::vector<BenchmarkResult>& results)
+{
+	if (!isBenchmarkGroupEnabled(pOptions, "animsystem"))
+		return;
+
+	// Rig and Clip load from ozz archives, so the synthetic skeleton and clip go through temporary files
+	AnimationBenchmarkData source = {};
+	const eastl::string    skeletonPath = FileSystem::GetCurrentDir() + "BenchmarkSkeleton.ozz";
+	const eastl::string    clipPath = FileSystem::GetCurrentDir() + "BenchmarkClip.ozz";
+	const bool             saved = buildAnimationData(&source) && saveOzzObject(skeletonPath, source.mSkeleton) &&
+						   saveOzzObject(clipPath, source.mAnimations[0]);
+	destroyAnimationData(&source);
+	if (!saved)
+	{
+		LOGF(LogLevel::eERROR, "Failed to create the benchmark skeleton or clip. Skipping animsystem benchmarks");
+		return;
+	}
+
+	const uint32_t                count = ANIMATED_INSTANCE_COUNT;
+	AnimationSystemBenchmarkData* pData = conf_new<AnimationSystemBenchmarkData>();
+	initThreadSystem(&pData->pThreadSystem);
+	pData->pRigs = allocateObjects<Rig>(count);
+	pData->pClipControllers = allocateObjects<ClipController>(count);
+	pData->pAnimations = allocateObjects<Animation>(count);
+	pData->pAnimatedObjects = allocateObjects<AnimatedObject>(count);
+	pData->pPooledAnimations = allocateObjects<Animation>(count);
+	pData->pPooledObjects = allocateObjects<AnimatedObject>(count);
+
+	pData->mClip.Initialize(clipPath.c_str(), NULL);
+	pData->mSharedClip.Initialize(clipPath.c_str(), NULL);
+	pData->mSharedClip.EnableSharedSampling();
+	pData->mAnimationSystem.Initialize();
+	pData->mThreadedAnimationSystem.Initialize(pData->pThreadSystem);
+
+	// Full rate, every 2nd frame interpolated, every 4th frame without interpolation nor bones
+	AnimationLODDesc lodDesc = {};
+	lodDesc.mNumLevels = 3;
+	lodDesc.mLevels[1].mMinDistance = ANIMATED_LOD_RANGE / 3.0f;
+	lodDesc.mLevels[1].mUpdateInterval = 2;
+	lodDesc.mLevels[2].mMinDistance = ANIMATED_LOD_RANGE * 2.0f / 3.0f;
+	lodDesc.mLevels[2].mUpdateInterval = 4;
+	lodDesc.mLevels[2].mInterpolate = false;
+	lodDesc.mLevels[2].mUpdateBones = false;
+	pData->mLODScheduler.Initialize(lodDesc);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Rig* pRig = &pData->pRigs[i];
+		pRig->Initialize(skeletonPath.c_str());
+
+		// Spread the instances over the clip so they do not all hit the same keyframes
+		const float timeRatio = (float)i / count;
+		pData->pClipControllers[i].Initialize(pData->mClip.GetDuration());
+		pData->pClipControllers[i].SetTimeRatio(timeRatio);
+
+		AnimationDesc animationDesc = {};
+		animationDesc.mRig = pRig;
+		animationDesc.mNumLayers = 1;
+		animationDesc.mLayerProperties[0].mClip = &pData->mClip;
+		animationDesc.mLayerProperties[0].mClipController = &pData->pClipControllers[i];
+		pData->pAnimations[i].Initialize(animationDesc);
+		pData->pAnimatedObjects[i].Initialize(pRig, &pData->pAnimations[i]);
+		pData->pAnimatedObjects[i].SetRootTransform(mat4::translation(vec3(0.0f, 0.0f, (float)ANIMATED_LOD_RANGE * i / count)));
+
+		if (i == 0)
+			pData->mSamplingCachePool.Initialize(pRig->GetNumJoints());
+		animationDesc.mLayerProperties[0].mClip = &pData->mSharedClip;
+		animationDesc.mSamplingCachePool = &pData->mSamplingCachePool;
+		pData->pPooledAnimations[i].Initialize(animationDesc);
+		pData->pPooledObjects[i].Initialize(pRig, &pData->pPooledAnimations[i]);
+
+		AnimationInstanceDesc instanceDesc = {};
+		instanceDesc.mRig = pRig;
+		instanceDesc.mNumLayers = 1;
+		instanceDesc.mLayers[0].mClip = &pData->mClip;
+		instanceDesc.mTimeRatio = timeRatio;
+		pData->mAnimationSystem.AddInstance(instanceDesc);
+		pData->mThreadedAnimationSystem.AddInstance(instanceDesc);
+	}
+
+	for (uint32_t i = 0; i < count; i += ANIMATED_OBJECT_GRAIN_SIZE)
+	{
+		AnimatedObjectTaskData task = { &pData->pAnimatedObjects[i], min((uint32_t)ANIMATED_OBJECT_GRAIN_SIZE, count - i) };
+		pData->mTasks.push_back(task);
+	}
+
+	// The AnimationSystems sample through per task caches instead of the caches of the Animations
+	const uint32_t          jointCount = pData->pRigs[0].GetNumJoints();
+	eastl::vector<Matrix4> referencePoses;
+	for (uint32_t frame = 0; frame < ANIMATION_CHECK_FRAMES; ++frame)
+		animatedObjectSerialFunc(pData);
+	for (uint32_t i = 0; i < count; i += ANIMATION_CHECK_STRIDE)
+	{
+		const ozz::Range<Matrix4> joints = pData->pRigs[i].GetJointModelMats();
+		referencePoses.insert(referencePoses.end(), joints.begin, joints.begin + jointCount);
+	}
+	const uint32_t poseMismatchCount = checkAnimationSystemPoses(pData, &pData->mAnimationSystem, referencePoses.data()) +
+									   checkAnimationSystemPoses(pData, &pData->mThreadedAnimationSystem, referencePoses.data());
+	if (poseMismatchCount)
+	{
+		LOGF(LogLevel::eERROR, "AnimationSystem posed %u joints differently than AnimatedObject", poseMismatchCount);
+		gChecksFailed = true;
+	}
+
+	eastl::string input;
+	input.sprintf("%u rigs x %u joints", count, jointCount);
+
+	struct
+	{
+		const char*   pName;
+		BenchmarkFunc pFunc;
+		bool          mLOD;
+	} updates[] = {
+		{ "AnimatedObject serial", animatedObjectSerialFunc, false },
+		{ "AnimatedObject threaded", animatedObjectThreadedFunc, false },
+		{ "AnimatedObject pooled shared serial", pooledObjectSerialFunc, false },
+		{ "AnimationSystem serial", animationSystemSerialFunc, false },
+		{ "AnimationSystem threaded", animationSystemThreadedFunc, false },
+		{ "AnimatedObject LOD serial", animatedObjectLODFunc, true },
+		{ "AnimatedObject LOD threaded", animatedObjectLODThreadedFunc, true },
+	};
+
+	for (uint32_t i = 0; i < sizeof(updates) / sizeof(updates[0]); ++i)
+	{
+		for (uint32_t j = 0; j < count; ++j)
+			pData->pAnimatedObjects[j].SetLODScheduler(updates[i].mLOD ? &pData->mLODScheduler : NULL);
+
+		BenchmarkDesc desc = makeDesc(pOptions, "animsystem", updates[i].pName, updates[i].pFunc, pData);
+		desc.pInput = input.c_str();
+		desc.mItemsPerIteration = count;
+		addResult(&desc, results);
+	}
+
+	pData->mThreadedAnimationSystem.Destroy();
+	pData->mAnimationSystem.Destroy();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		pData->pAnimatedObjects[i].Destroy();
+		pData->pAnimations[i].Destroy();
+		pData->pPooledObjects[i].Destroy();
+		pData->pPooledAnimations[i].Destroy();
+		pData->pRigs[i].Destroy();
+	}
+	pData->mSamplingCachePool.Destroy();
+	pData->mSharedClip.Destroy();
+	pData->mClip.Destroy();
+
+	freeObjects(pData->pPooledObjects, count);
+	freeObjects(pData->pPooledAnimations, count);
+	freeObjects(pData->pAnimatedObjects, count);
+	freeObjects(pData->pAnimations, count);
+	freeObjects(pData->pClipControllers, count);
+	freeObjects(pData->pRigs, count);
+	shutdownThreadSystem(pData->pThreadSystem);
+	conf_delete(pData);
+
+	FileSystem::Delete(skeletonPath);
+	FileSystem::Delete(clipPath);
+}
+
+/************************************************************************/
+// Clusters
+/************************************************************************/
+typedef struct ClusterBenchmarkData
+{
+	Scene           mScene;
+	MeshIn          mMesh;
+	Material        mMaterial;
+	ThreadSystem*   pThreadSystem;
+	ClusterCullView mViews[2];
+	uint8_t*        pVisibility;
+	uint32_t        mCulledCounts[CLUSTER_CULL_REASON_COUNT];
+	vec4            mDepthPlane;
+	ClusterCompact* pSortedClusters;
+	uint32_t        mSortedClusterCount;
+	uint64_t*       pSortScratch;
+	OcclusionBuffer mOcclusionBuffer;
+	SceneVertexPos* pOccluders;    // The walls, then the occluders of the scene
+	bool*           pOccluderTwoSided;
+	uint32_t        mWallCount;
+	uint32_t        mOccluderCount;
+	uint8_t*        pUnoccludedVisibility;
+} ClusterBenchmarkData;
+
+static void createClustersFunc(void* pUserData)
+{
+	ClusterBenchmarkData* pData = (ClusterBenchmarkData*)pUserData;
+	createClusters(false, &pData->mScene, &pData->mMesh);
+	destroyClusters(&pData->mScene, &pData->mMesh);
+}
+
+static void createSceneClustersFunc(void* pUserData)
+{
+	ClusterBenchmarkData* pData = (ClusterBenchmarkData*)pUserData;
+	createSceneClusters(&pData->mScene, CLUSTER_MODE_SEQUENTIAL, pData->pThreadSystem);
+	destroyClusters(&pData->mScene, &pData->mMesh);
+}
+
+// Every iteration reorders the triangles the previous one produced, which costs the same as the original order
+static void createMeshletsFunc(void* pUserData)
+{
+	ClusterBenchmarkData* pData = (ClusterBenchmarkData*)pUserData;
+	createSceneClusters(&pData->mScene, CLUSTER_MODE_MESHLET, pData->pThreadSystem);
+	destroyClusters(&pData->mScene, &pData->mMesh);
+}
+
+static void cullClusterGroupsFunc(void* pUserData)
+{
+	ClusterBenchmarkData* pData = (ClusterBenchmarkData*)pUserData;
+	cullClusterGroups(
+		pData->mScene.clusterGroups, pData->mScene.numClusterGroups, pData->mViews, 2, pData->pVisibility, pData->mCulledCounts);
+}
+
+static void renderOcclusionBufferFunc(void* pUserData)
+{
+	ClusterBenchmarkData* pData = (ClusterBenchmarkData*)pUserData;
+	renderOcclusionBuffer(
+		&pData->mOcclusionBuffer, pData->mOcclusionBuffer.mvp, pData->pOccluders, pData->pOccluderTwoSided, pData->mOccluderCount);
+}
+
+static void sortSceneClustersFunc(void* pUserData)
+{
+	ClusterBenchmarkData* pData = (ClusterBenchmarkData*)pUserData;
+	sortSceneClusters(
+		&pData->mScene, pData->pVisibility, &pData->mDepthPlane, pData->pSortedClusters, &pData->mSortedClusterCount,
+		pData->pSortScratch, NULL);
+}
+
+// mat4::lookAt looks down -z while the projection matrices look down +z, so it is pointed away from the target
+static mat4 lookTowards(const vec3& eye, const vec3& target, const vec3& up)
+{
+	return mat4::lookAt(Point3(eye), Point3(eye * 2.0f - target), up);
+}
+
+// Culls a cluster the way it reads on paper: it is outside a frustum when all 8 corners of its bounds are outside the same
+// clip plane, and facing away when the normalized direction to the eye is inside its cone. Corners and eyes closer to the
+// boundaries than tolerance are treated as outside for a negative tolerance and as inside for a positive one
+static bool cullClusterBruteForce(const Cluster* cluster, const mat4* pMvps, const vec3* pEyes, float tolerance, bool* pOutside)
+{
+	bool outsideAll = true;
+	bool culled = true;
+	for (uint32_t view = 0; view < 2; ++view)
+	{
+		uint32_t outsideMask = 0x3f;
+		for (uint32_t corner = 0; corner < 8; ++corner)
+		{
+			const vec4 position(
+				(corner & 1) ? cluster->aabbMax.x : cluster->aabbMin.x, (corner & 2) ? cluster->aabbMax.y : cluster->aabbMin.y,
+				(corner & 4) ? cluster->aabbMax.z : cluster->aabbMin.z, 1.0f);
+			const vec4  clip = pMvps[view] * position;
+			const float x = clip.getX(), y = clip.getY(), z = clip.getZ(), w = clip.getW();
+			const float t = tolerance * (fabsf(w) + 1.0f);
+			outsideMask &= (x < -w - t ? 0x1 : 0) | (x > w + t ? 0x2 : 0) | (y < -w - t ? 0x4 : 0) | (y > w + t ? 0x8 : 0) |
+						   (z < -t ? 0x10 : 0) | (z > w + t ? 0x20 : 0);
+		}
+
+		const vec3 toEye = normalize(pEyes[view] - f3Tov3(cluster->coneCenter));
+		const bool backFacing = cluster->valid && dot(toEye, f3Tov3(cluster->coneAxis)) >= cluster->coneAngleCosine + tolerance;
+		outsideAll = outsideAll && outsideMask != 0;
+		culled = culled && (outsideMask != 0 || backFacing);
+	}
+
+	*pOutside = outsideAll;
+	return culled;
+}
+
+// Returns the number of clusters cullClusterGroups decided differently than brute force for. Clusters that touch a frustum
+// plane or a cone within rounding errors are accepted either way
+static uint32_t checkClusterCulling(ClusterBenchmarkData* pData, const mat4* pMvps, const vec3* pEyes)
+{
+	for (uint32_t i = 0; i < 2; ++i)
+		setClusterCullView(&pData->mViews[i], pMvps[i], pEyes[i], NULL);
+	cullClusterGroups(
+		pData->mScene.clusterGroups, pData->mScene.numClusterGroups, pData->mViews, 2, pData->pVisibility, pData->mCulledCounts);
+
+	const float tolerance = 1e-4f;
+	uint32_t    minOutsideCount = 0, maxOutsideCount = 0;
+	uint32_t    minCulledCount = 0, maxCulledCount = 0;
+	uint32_t    mismatchCount = 0;
+	for (uint32_t i = 0; i < pData->mMesh.clusterCount; ++i)
+	{
+		const Cluster* cluster = &pData->mMesh.clusters[i];
+		bool           surelyOutside = false;
+		bool           maybeOutside = false;
+		const bool     surelyCulled = cullClusterBruteForce(cluster, pMvps, pEyes, tolerance, &surelyOutside);
+		const bool     maybeCulled = cullClusterBruteForce(cluster, pMvps, pEyes, -tolerance, &maybeOutside);
+		minOutsideCount += surelyOutside;
+		maxOutsideCount += maybeOutside;
+		minCulledCount += surelyCulled;
+		maxCulledCount += maybeCulled;
+
+		const bool visible = (pData->pVisibility[i / 4] >> (i % 4)) & 1;
+		if ((visible && surelyCulled) || (!visible && !maybeCulled))
+			++mismatchCount;
+	}
+
+	const uint32_t outsideCount = pData->mCulledCounts[CLUSTER_CULL_FRUSTUM];
+	const uint32_t culledCount = outsideCount + pData->mCulledCounts[CLUSTER_CULL_BACKFACE];
+	if (outsideCount < minOutsideCount || outsideCount > maxOutsideCount || culledCount < minCulledCount || culledCount > maxCulledCount)
+		++mismatchCount;
+
+	return mismatchCount;
+}
+
+// Returns whether the segment from a to b crosses one of the triangles, edges included. Single sided triangles only count
+// when a is on their front side, counter clockwise seen from a
+static bool segmentHitsTriangles(
+	const vec3& a, const vec3& b, const SceneVertexPos* pTriangles, const bool* pTwoSided, uint32_t triangleCount)
+{
+	const float tolerance = 1e-4f;
+	const vec3  direction = b - a;
+	for (uint32_t i = 0; i < triangleCount; ++i)
+	{
+		const vec3  v0(pTriangles[i * 3].x, pTriangles[i * 3].y, pTriangles[i * 3].z);
+		const vec3  edge1 = vec3(pTriangles[i * 3 + 1].x, pTriangles[i * 3 + 1].y, pTriangles[i * 3 + 1].z) - v0;
+		const vec3  edge2 = vec3(pTriangles[i * 3 + 2].x, pTriangles[i * 3 + 2].y, pTriangles[i * 3 + 2].z) - v0;
+		if (!pTwoSided[i] && dot(cross(edge1, edge2), a - v0) <= 0.0f)
+			continue;
+
+		const vec3  p = cross(direction, edge2);
+		const float determinant = dot(edge1, p);
+		if (fabsf(determinant) < 1e-12f)
+			continue;
+
+		const vec3  s = a - v0;
+		const vec3  q = cross(s, edge1);
+		const float u = dot(s, p) / determinant;
+		const float v = dot(direction, q) / determinant;
+		const float t = dot(edge2, q) / determinant;
+		if (u >= -tolerance && v >= -tolerance && u + v <= 1.0f + tolerance && t > 0.0f && t < 1.0f)
+			return true;
+	}
+	return false;
+}
+
+// Returns the number of clusters cullClusterGroups hid behind the walls although a point on the surface of their bounds
+// inside the frustum can be seen from the eye, or that were culled for another reason only with occlusion culling
+static uint32_t checkOcclusionCulling(ClusterBenchmarkData* pData, const mat4& mvp, const vec3& eye, uint32_t* pOccludedCount)
+{
+	const Scene& scene = pData->mScene;
+	ClusterCullView view;
+	setClusterCullView(&view, mvp, eye, NULL);
+	cullClusterGroups(scene.clusterGroups, scene.numClusterGroups, &view, 1, pData->pUnoccludedVisibility, pData->mCulledCounts);
+
+	renderOcclusionBuffer(&pData->mOcclusionBuffer, mvp, pData->pOccluders, pData->pOccluderTwoSided, pData->mWallCount);
+	setClusterCullView(&view, mvp, eye, &pData->mOcclusionBuffer);
+	cullClusterGroups(scene.clusterGroups, scene.numClusterGroups, &view, 1, pData->pVisibility, pData->mCulledCounts);
+
+	uint32_t mismatchCount = 0;
+	uint32_t occludedCount = 0;
+	for (uint32_t i = 0; i < pData->mMesh.clusterCount; ++i)
+	{
+		const bool unoccluded = (pData->pUnoccludedVisibility[i / 4] >> (i % 4)) & 1;
+		const bool visible = (pData->pVisibility[i / 4] >> (i % 4)) & 1;
+		if (visible && !unoccluded)
+			++mismatchCount;
+		if (visible || !unoccluded)
+			continue;
+		++occludedCount;
+
+		// 5x5 points on every face of the bounds
+		const Cluster* cluster = &pData->mMesh.clusters[i];
+		const vec3     aabbMin = f3Tov3(cluster->aabbMin);
+		const vec3     extent = f3Tov3(cluster->aabbMax) - aabbMin;
+		bool           seen = false;
+		for (uint32_t face = 0; face < 6 && !seen; ++face)
+		{
+			const uint32_t axis = face / 2;
+			for (uint32_t sample = 0; sample < 25 && !seen; ++sample)
+			{
+				vec3 offset;
+				offset[axis] = (face & 1) ? 1.0f : 0.0f;
+				offset[(axis + 1) % 3] = (sample % 5) * 0.25f;
+				offset[(axis + 2) % 3] = (sample / 5) * 0.25f;
+				const vec3  point = aabbMin + mulPerElem(extent, offset);
+				const vec4  clip = mvp * vec4(point, 1.0f);
+				const float w = clip.getW();
+				const bool  inside = fabsf(clip.getX()) <= w && fabsf(clip.getY()) <= w && clip.getZ() >= 0.0f && clip.getZ() <= w;
+				seen = inside && !segmentHitsTriangles(eye, point, pData->pOccluders, pData->pOccluderTwoSided, pData->mWallCount);
+			}
+		}
+		if (seen)
+			++mismatchCount;
+	}
+
+	if (occludedCount != pData->mCulledCounts[CLUSTER_CULL_OCCLUSION])
+		++mismatchCount;
+
+	*pOccludedCount += occludedCount;
+	return mismatchCount;
+}
+
+static float clusterDepth(const vec4& depthPlane, const Cluster* cluster)
+{
+	return dot(depthPlane, vec4((f3Tov3(cluster->aabbMin) + f3Tov3(cluster->aabbMax)) * 0.5f, 1.0f));
+}
+
+// Returns the number of problems with the clusters sortSceneClusters wrote: every visible cluster has to be there once and
+// their depths can only decrease by what is lost to the 16 bit quantization
+static uint32_t checkClusterSorting(ClusterBenchmarkData* pData)
+{
+	sortSceneClustersFunc(pData);
+
+	const MeshIn* mesh = &pData->mMesh;
+	float         minDepth = INFINITY;
+	float         maxDepth = -INFINITY;
+	uint32_t      visibleCount = 0;
+	for (uint32_t i = 0; i < mesh->clusterCount; ++i)
+	{
+		if (!((pData->pVisibility[i / 4] >> (i % 4)) & 1))
+			continue;
+		const float depth = clusterDepth(pData->mDepthPlane, &mesh->clusters[i]);
+		minDepth = min(minDepth, depth);
+		maxDepth = max(maxDepth, depth);
+		++visibleCount;
+	}
+
+	uint32_t problemCount = pData->mSortedClusterCount == visibleCount ? 0 : 1;
+	eastl::vector<bool> seen(mesh->clusterCount, false);
+	float               previousDepth = -INFINITY;
+	const float         tolerance = (maxDepth - minDepth) / 65535.0f + 1e-3f;
+	for (uint32_t i = 0; i < pData->mSortedClusterCount; ++i)
+	{
+		// The triangles of a cluster start at a multiple of the cluster size
+		const uint32_t index = pData->pSortedClusters[i].clusterStart / CLUSTER_SIZE;
+		if (index >= mesh->clusterCount || seen[index] || !((pData->pVisibility[index / 4] >> (index % 4)) & 1))
+		{
+			++problemCount;
+			continue;
+		}
+		seen[index] = true;
+
+		const float depth = clusterDepth(pData->mDepthPlane, &mesh->clusters[index]);
+		if (depth < previousDepth - tolerance)
+			++problemCount;
+		previousDepth = max(previousDepth, depth);
+	}
+
+	return problemCount;
+}
+
+// Bounds and cone of a cluster one triangle at a time, the way createClusters computed them before it went four at a time.
+// Degenerate triangles are left out of the cone like computeCluster does
+static void computeClusterScalar(bool twoSided, const Scene* pScene, const MeshIn* mesh, const ClusterCompact* compact, Cluster* cluster)
+{
+	const uint32_t* indices = pScene->indices + mesh->startIndex + compact->clusterStart * 3;
+	vec3            aabbMin = vec3(INFINITY, INFINITY, INFINITY);
+	vec3            aabbMax = -aabbMin;
+	vec3            coneAxis = vec3(0, 0, 0);
+	for (uint32_t triangleIndex = 0; triangleIndex < compact->triangleCount; ++triangleIndex)
+	{
+		vec3 vtx[3];
+		for (uint32_t j = 0; j < 3; ++j)
+		{
+			const SceneVertexPos& pos = pScene->positions[indices[triangleIndex * 3 + j]];
+			vtx[j] = vec3(pos.x, pos.y, pos.z);
+			aabbMin = minPerElem(aabbMin, vtx[j]);
+			aabbMax = maxPerElem(aabbMax, vtx[j]);
+		}
+
+		const vec3 triangleNormal = cross(vtx[1] - vtx[0], vtx[2] - vtx[0]);
+		if (lengthSqr(triangleNormal) > 0.0f)
+			coneAxis = coneAxis - normalize(triangleNormal);
+	}
+
+	float      coneOpening = 1;
+	bool       validCluster = !twoSided;
+	const vec3 center = (aabbMin + aabbMax) * 0.5f;
+	if (coneAxis == vec3(0, 0, 0))
+		validCluster = false;
+	else
+		coneAxis = normalize(coneAxis);
+
+	float t = -INFINITY;
+	for (uint32_t triangleIndex = 0; validCluster && triangleIndex < compact->triangleCount; ++triangleIndex)
+	{
+		vec3 vtx[3];
+		for (uint32_t j = 0; j < 3; ++j)
+		{
+			const SceneVertexPos& pos = pScene->positions[indices[triangleIndex * 3 + j]];
+			vtx[j] = vec3(pos.x, pos.y, pos.z);
+		}
+
+		const vec3 triangleNormal = cross(vtx[1] - vtx[0], vtx[2] - vtx[0]);
+		if (lengthSqr(triangleNormal) <= 0.0f)
+			continue;
+
+		const vec3  unitNormal = normalize(triangleNormal);
+		const float directionalPart = dot(coneAxis, -unitNormal);
+		if (directionalPart <= 0.0f)
+		{
+			validCluster = false;
+			break;
+		}
+
+		t = max(t, dot(center - vtx[0], unitNormal) / -directionalPart);
+		coneOpening = min(coneOpening, directionalPart);
+	}
+
+	cluster->aabbMin = v3ToF3(aabbMin);
+	cluster->aabbMax = v3ToF3(aabbMax);
+	cluster->coneAngleCosine = sqrtf(1 - coneOpening * coneOpening);
+	cluster->coneCenter = v3ToF3(validCluster ? center + coneAxis * t : center);
+	cluster->coneAxis = v3ToF3(coneAxis);
+	if (validCluster && length(f3Tov3(cluster->coneCenter) - center) > 16 * length(aabbMax - aabbMin))
+		validCluster = false;
+	cluster->valid = validCluster;
+}
+
+// Returns the number of clusters whose bounds or cone differ from computeClusterScalar. The SIMD version sums the normals
+// in another order, so the cones only match within a tolerance. The cosine is compared squared, it is the square root of
+// a value close to 0 for narrow cones
+static uint32_t checkClusterBounds(ClusterBenchmarkData* pData)
+{
+	const MeshIn*  mesh = &pData->mMesh;
+	const float    tolerance = 1e-4f;
+	uint32_t       mismatchCount = 0;
+	for (uint32_t i = 0; i < mesh->clusterCount; ++i)
+	{
+		const Cluster* cluster = &mesh->clusters[i];
+		Cluster        reference;
+		computeClusterScalar(pData->mMaterial.twoSided, &pData->mScene, mesh, &mesh->clusterCompacts[i], &reference);
+
+		bool match = memcmp(&cluster->aabbMin, &reference.aabbMin, sizeof(float3)) == 0 &&
+					 memcmp(&cluster->aabbMax, &reference.aabbMax, sizeof(float3)) == 0 && cluster->valid == reference.valid;
+		if (match && reference.valid)
+		{
+			const float size = length(f3Tov3(reference.aabbMax) - f3Tov3(reference.aabbMin));
+			const float cosineSqr = cluster->coneAngleCosine * cluster->coneAngleCosine;
+			const float referenceCosineSqr = reference.coneAngleCosine * reference.coneAngleCosine;
+			match = length(f3Tov3(cluster->coneAxis) - f3Tov3(reference.coneAxis)) <= tolerance &&
+					length(f3Tov3(cluster->coneCenter) - f3Tov3(reference.coneCenter)) <= tolerance * size &&
+					fabsf(cosineSqr - referenceCosineSqr) <= tolerance;
+		}
+		if (!match)
+			++mismatchCount;
+	}
+	return mismatchCount;
+}
+
+static void benchmarkClusters(const BenchmarkOptions* pOptions, eastl::vector<BenchmarkResult>& results)
+{
+	if (!isBenchmarkGroupEnabled(pOptions, "clusters"))
+		return;
+
+	// Displaced grid so the clusters have varying cone axes like real geometry
+	const uint32_t gridSize = 512;
+	ClusterBenchmarkData* pData = conf_new<ClusterBenchmarkData>();
+	pData->mScene = {};
+	pData->mScene.totalVertices = (gridSize + 1) * (gridSize + 1);
+	pData->mScene.totalTriangles = gridSize * gridSize * 2;
+	pData->mScene.positions = (SceneVertexPos*)conf_malloc(pData->mScene.totalVertices * sizeof(SceneVertexPos));
+	for (uint32_t y = 0; y <= gridSize; ++y)
+	{
+		for (uint32_t x = 0; x <= gridSize; ++x)
+		{
+			SceneVertexPos& pos = pData->mScene.positions[y * (gridSize + 1) + x];
+			pos.x = (float)x;
+			pos.y = sinf(x * 0.05f) * cosf(y * 0.05f) * 8.0f + randomFloat(-0.1f, 0.1f);
+			pos.z = (float)y;
+		}
+	}
+
+	pData->mScene.indices = (uint32_t*)conf_malloc(pData->mScene.totalTriangles * 3 * sizeof(uint32_t));
+	uint32_t* pIndices = pData->mScene.indices;
+	for (uint32_t y = 0; y < gridSize; ++y)
+	{
+		for (uint32_t x = 0; x < gridSize; ++x)
+		{
+			const uint32_t i0 = y * (gridSize + 1) + x;
+			const uint32_t i1 = i0 + 1;
+			const uint32_t i2 = i0 + gridSize + 1;
+			const uint32_t i3 = i2 + 1;
+			*pIndices++ = i0;
+			*pIndices++ = i2;
+			*pIndices++ = i1;
+			*pIndices++ = i1;
+			*pIndices++ = i2;
+			*pIndices++ = i3;
+		}
+	}
+
+	pData->mMesh = {};
+	pData->mMesh.startIndex = 0;
+	pData->mMesh.indexCount = pData->mScene.totalTriangles * 3;
+	pData->mMesh.vertexCount = pData->mScene.totalVertices;
+
+	pData->mMaterial = {};
+	pData->mScene.numMeshes = 1;
+	pData->mScene.numMaterials = 1;
+	pData->mScene.meshes = &pData->mMesh;
+	pData->mScene.materials = &pData->mMaterial;
+	initThreadSystem(&pData->pThreadSystem);
+
+	eastl::string input;
+	input.sprintf("%u triangles", pData->mMesh.indexCount / 3);
+
+	BenchmarkDesc desc = makeDesc(pOptions, "clusters", "createClusters", createClustersFunc, pData);
+	desc.pInput = input.c_str();
+	desc.mItemsPerIteration = pData->mMesh.indexCount / 3;
+	addResult(&desc, results);
+
+	desc = makeDesc(pOptions, "clusters", "createSceneClusters", createSceneClustersFunc, pData);
+	desc.pInput = input.c_str();
+	desc.mItemsPerIteration = pData->mMesh.indexCount / 3;
+	addResult(&desc, results);
+
+	desc = makeDesc(pOptions, "clusters", "createSceneClusters meshlets", createMeshletsFunc, pData);
+	desc.pInput = input.c_str();
+	desc.mItemsPerIteration = pData->mMesh.indexCount / 3;
+	addResult(&desc, results);
+
+	createSceneClusters(&pData->mScene, CLUSTER_MODE_MESHLET, pData->pThreadSystem);
+	uint32_t boundsMismatchCount = checkClusterBounds(pData);
+	destroyClusters(&pData->mScene, &pData->mMesh);
+	createSceneClusters(&pData->mScene, CLUSTER_MODE_SEQUENTIAL, pData->pThreadSystem);
+	boundsMismatchCount += checkClusterBounds(pData);
+	if (boundsMismatchCount)
+	{
+		LOGF(LogLevel::eERROR, "computeCluster disagrees with the scalar reference for %u clusters", boundsMismatchCount);
+		gChecksFailed = true;
+	}
+	createClusterCullGroups(&pData->mScene);
+	pData->pVisibility = (uint8_t*)conf_malloc(pData->mScene.numClusterGroups);
+	pData->pSortedClusters = (ClusterCompact*)conf_malloc(pData->mScene.numClusterGroups * 4 * sizeof(ClusterCompact));
+	pData->pSortScratch = (uint64_t*)conf_malloc(pData->mScene.numClusterGroups * 8 * sizeof(uint64_t));
+	pData->pUnoccludedVisibility = (uint8_t*)conf_malloc(pData->mScene.numClusterGroups);
+
+	// Walls across the grid, low enough to see over them from some of the cameras, followed by the largest triangles of the
+	// grid the way the Visibility Buffer picks its occluders. The walls face +z and every other one is single sided, so
+	// cameras behind it have to see through it
+	const uint32_t wallCount = 4;
+	createSceneOccluders(&pData->mScene, 16384);
+	pData->mWallCount = wallCount * 2;
+	pData->mOccluderCount = pData->mWallCount + pData->mScene.numOccluders;
+	pData->pOccluders = (SceneVertexPos*)conf_malloc(pData->mOccluderCount * 3 * sizeof(SceneVertexPos));
+	pData->pOccluderTwoSided = (bool*)conf_malloc(pData->mOccluderCount * sizeof(bool));
+	for (uint32_t i = 0; i < wallCount; ++i)
+	{
+		pData->pOccluderTwoSided[i * 2] = (i & 1) == 0;
+		pData->pOccluderTwoSided[i * 2 + 1] = (i & 1) == 0;
+
+		const float          z = (i + 0.5f) * gridSize / wallCount;
+		const SceneVertexPos corners[4] = { { 32.0f, -16.0f, z }, { 480.0f, -16.0f, z }, { 32.0f, 40.0f, z }, { 480.0f, 40.0f, z } };
+		SceneVertexPos*      pWall = pData->pOccluders + i * 6;
+		pWall[0] = corners[0];
+		pWall[1] = corners[1];
+		pWall[2] = corners[2];
+		pWall[3] = corners[2];
+		pWall[4] = corners[1];
+		pWall[5] = corners[3];
+	}
+	memcpy(
+		pData->pOccluders + pData->mWallCount * 3, pData->mScene.occluders, pData->mScene.numOccluders * 3 * sizeof(SceneVertexPos));
+	memcpy(pData->pOccluderTwoSided + pData->mWallCount, pData->mScene.occluderTwoSided, pData->mScene.numOccluders * sizeof(bool));
+	createOcclusionBuffer(&pData->mOcclusionBuffer, 256, 144);
+
+	// Cameras looking at the grid from random places and a light covering part of it, so clusters get culled for each reason
+	const mat4 cameraProj = mat4::perspective(1.5707963f, 9.0f / 16.0f, 1.0f, 400.0f);
+	const mat4 lightProj = mat4::orthographic(-128.0f, 128.0f, -128.0f, 128.0f, -512.0f, 512.0f);
+	mat4       mvps[2];
+	vec3       eyes[2];
+	uint32_t   checkedCount = 0;
+	uint32_t   mismatchCount = 0;
+	uint32_t   sortProblemCount = 0;
+	uint32_t   occlusionMismatchCount = 0;
+	uint32_t   occludedCount = 0;
+	for (uint32_t i = 0; i < 64; ++i)
+	{
+		eyes[0] = vec3(randomFloat(-64.0f, gridSize + 64.0f), randomFloat(-16.0f, 128.0f), randomFloat(-64.0f, gridSize + 64.0f));
+		const vec3 target(randomFloat(0.0f, (float)gridSize), 0.0f, randomFloat(0.0f, (float)gridSize));
+		mvps[0] = cameraProj * lookTowards(eyes[0], target, vec3(0.0f, 1.0f, 0.0f));
+
+		eyes[1] = target + normalize(vec3(randomFloat(-1.0f, 1.0f), 1.0f, randomFloat(-1.0f, 1.0f))) * 256.0f;
+		mvps[1] = lightProj * lookTowards(eyes[1], target, vec3(0.0f, 0.0f, 1.0f));
+
+		occlusionMismatchCount += checkOcclusionCulling(pData, mvps[0], eyes[0], &occludedCount);
+		mismatchCount += checkClusterCulling(pData, mvps, eyes);
+		pData->mDepthPlane = mvps[0].getRow(3);
+		sortProblemCount += checkClusterSorting(pData);
+		checkedCount += pData->mMesh.clusterCount;
+	}
+
+	// Right behind the single sided second wall, looking through its back at the two sided third one
+	const float wallSpacing = (float)gridSize / wallCount;
+	eyes[0] = vec3(gridSize * 0.5f, 8.0f, wallSpacing * 1.5f - 8.0f);
+	mvps[0] = cameraProj * lookTowards(eyes[0], vec3(gridSize * 0.5f, 0.0f, (float)gridSize), vec3(0.0f, 1.0f, 0.0f));
+	occlusionMismatchCount += checkOcclusionCulling(pData, mvps[0], eyes[0], &occludedCount);
+
+	if (mismatchCount)
+	{
+		LOGF(LogLevel::eERROR, "cullClusterGroups disagrees with brute force culling %u times in %u clusters", mismatchCount, checkedCount);
+		gChecksFailed = true;
+	}
+	if (occlusionMismatchCount || !occludedCount)
+	{
+		LOGF(
+			LogLevel::eERROR, "Occlusion culling hid %u visible clusters or counted them wrong, %u clusters occluded in total",
+			occlusionMismatchCount, occludedCount);
+		gChecksFailed = true;
+	}
+	if (sortProblemCount)
+	{
+		LOGF(LogLevel::eERROR, "sortSceneClusters wrote %u clusters out of order or not culled correctly", sortProblemCount);
+		gChecksFailed = true;
+	}
+
+	eastl::string cullInput;
+	cullInput.sprintf(
+		"%u clusters, 2 views, %u outside, %u facing away", pData->mMesh.clusterCount, pData->mCulledCounts[CLUSTER_CULL_FRUSTUM],
+		pData->mCulledCounts[CLUSTER_CULL_BACKFACE]);
+	desc = makeDesc(pOptions, "clusters", "cullClusterGroups", cullClusterGroupsFunc, pData);
+	desc.pInput = cullInput.c_str();
+	desc.mItemsPerIteration = pData->mMesh.clusterCount;
+	addResult(&desc, results);
+
+	// A camera low in front of the first wall with every occluder, against both views
+	eyes[0] = vec3(gridSize * 0.5f, 8.0f, -32.0f);
+	mvps[0] = cameraProj * lookTowards(eyes[0], vec3(gridSize * 0.5f, 0.0f, (float)gridSize), vec3(0.0f, 1.0f, 0.0f));
+	pData->mOcclusionBuffer.mvp = mvps[0];
+	renderOcclusionBufferFunc(pData);
+	eastl::string occlusionInput;
+	occlusionInput.sprintf(
+		"%u triangles, %ux%u texels", pData->mOccluderCount, pData->mOcclusionBuffer.width, pData->mOcclusionBuffer.height);
+	desc = makeDesc(pOptions, "clusters", "renderOcclusionBuffer", renderOcclusionBufferFunc, pData);
+	desc.pInput = occlusionInput.c_str();
+	desc.mItemsPerIteration = pData->mOccluderCount;
+	addResult(&desc, results);
+
+	setClusterCullView(&pData->mViews[0], mvps[0], eyes[0], &pData->mOcclusionBuffer);
+	cullClusterGroupsFunc(pData);
+	eastl::string occlusionCullInput;
+	occlusionCullInput.sprintf(
+		"%u clusters, 2 views, %u outside, %u facing away, %u occluded", pData->mMesh.clusterCount,
+		pData->mCulledCounts[CLUSTER_CULL_FRUSTUM], pData->mCulledCounts[CLUSTER_CULL_BACKFACE],
+		pData->mCulledCounts[CLUSTER_CULL_OCCLUSION]);
+	desc = makeDesc(pOptions, "clusters", "cullClusterGroups occlusion", cullClusterGroupsFunc, pData);
+	desc.pInput = occlusionCullInput.c_str();
+	desc.mItemsPerIteration = pData->mMesh.clusterCount;
+	addResult(&desc, results);
+
+	eastl::string sortInput;
+	sortInput.sprintf("%u of %u clusters", pData->mSortedClusterCount, pData->mMesh.clusterCount);
+	desc = makeDesc(pOptions, "clusters", "sortSceneClusters", sortSceneClustersFunc, pData);
+	desc.pInput = sortInput.c_str();
+	desc.mItemsPerIteration = pData->mSortedClusterCount;
+	addResult(&desc, results);
+
+	destroyOcclusionBuffer(&pData->mOcclusionBuffer);
+	conf_free(pData->pOccluderTwoSided);
+	conf_free(pData->pOccluders);
+	destroySceneOccluders(&pData->mScene);
+	conf_free(pData->pUnoccludedVisibility);
+	conf_free(pData->pSortScratch);
+	conf_free(pData->pSortedClusters);
+	conf_free(pData->pVisibility);
+	destroyClusterCullGroups(&pData->mScene);
+	destroyClusters(&pData->mScene, &pData->mMesh);
+
+	shutdownThreadSystem(pData->pThreadSystem);
+	conf_free(pData->mScene.positions);
+	conf_free(pData->mScene.indices);
+	conf_delete(pData);
+}
+
+/************************************************************************/
+// DepthSorter
+/************************************************************************/
+enum
+{
+	SORT_PARTICLE_COUNT = 128 * 1024,
+	SORT_CHECK_FRAMES = 32,
+};
+
+typedef struct DepthSortBenchmarkData
+{
+	eastl::vector<vec3>  mPositions;
+	eastl::vector<vec3>  mVelocities;
+	eastl::vector<float> mDistances;
+	vec3                 mCameraPosition;
+	float                mSpeed;
+	DepthSorter*         pSorter;
+	uint32_t             mCount;
+} DepthSortBenchmarkData;
+
+// Moves the particles a frame further, so every iteration sorts slightly different distances like a running particle system
+static void moveParticles(DepthSortBenchmarkData* pData)
+{
+	const float step = pData->mSpeed / 60.0f;
+	for (uint32_t i = 0; i < pData->mCount; ++i)
+	{
+		pData->mPositions[i] += pData->mVelocities[i] * step;
+		pData->mDistances[i] = (float)distSqr(Point3(pData->mCameraPosition), Point3(pData->mPositions[i]));
+	}
+}
+
+static bool furtherFirst(const float2& a, const float2& b) { return a.getX() > b.getX(); }
+
+// What 15_Transparency did every frame: a new array of distance and index pairs sorted with a comparison sort
+static void quickSortFunc(void* pUserData)
+{
+	DepthSortBenchmarkData* pData = (DepthSortBenchmarkData*)pUserData;
+	moveParticles(pData);
+
+	eastl::vector<float2> sortedArray;
+	for (uint32_t i = 0; i < pData->mCount; ++i)
+		sortedArray.push_back({ pData->mDistances[i], (float)i });
+	eastl::quick_sort(sortedArray.begin(), sortedArray.end(), furtherFirst);
+}
+
+static void sortDepthsFunc(void* pUserData)
+{
+	DepthSortBenchmarkData* pData = (DepthSortBenchmarkData*)pUserData;
+	moveParticles(pData);
+	sortDepths(pData->pSorter, pData->mDistances.data(), pData->mCount);
+}
+
+static void sortDepthsScratchFunc(void* pUserData)
+{
+	DepthSortBenchmarkData* pData = (DepthSortBenchmarkData*)pUserData;
+	moveParticles(pData);
+	resetDepthSorter(pData->pSorter);
+	sortDepths(pData->pSorter, pData->mDistances.data(), pData->mCount);
+}
+
+static bool lessKeyThenIndex(const eastl::pair<float, uint32_t>& a, const eastl::pair<float, uint32_t>& b)
+{
+	return a.first < b.first || (a.first == b.first && a.second < b.second);
+}
+
+// Returns the number of items sortDepths put somewhere else than a full sort of the keys and indices would
+static uint32_t checkDepthSort(DepthSortBenchmarkData* pData)
+{
+	const uint32_t* pOrder = sortDepths(pData->pSorter, pData->mDistances.data(), pData->mCount);
+
+	eastl::vector<eastl::pair<float, uint32_t> > expected(pData->mCount);
+	for (uint32_t i = 0; i < pData->mCount; ++i)
+		expected[i] = eastl::make_pair(pData->mDistances[i], i);
+	eastl::sort(expected.begin(), expected.end(), lessKeyThenIndex);
+
+	uint32_t problemCount = 0;
+	for (uint32_t i = 0; i < pData->mCount; ++i)
+		problemCount += pOrder[i] != expected[i].second;
+	return problemCount;
+}
+
+static void benchmarkDepthSort(const BenchmarkOptions* pOptions, eastl::vector<BenchmarkResult>& results)
+{
+	if (!isBenchmarkGroupEnabled(pOptions, "sort"))
+		return;
+
+	// A cloud of particles in front of the camera, with duplicate distances among them
+	DepthSortBenchmarkData* pData = conf_new<DepthSortBenchmarkData>();
+	pData->mPositions.resize(SORT_PARTICLE_COUNT);
+	pData->mVelocities.resize(SORT_PARTICLE_COUNT);
+	pData->mDistances.resize(SORT_PARTICLE_COUNT);
+	pData->mCameraPosition = vec3(0.0f, 0.0f, -64.0f);
+	for (uint32_t i = 0; i < SORT_PARTICLE_COUNT; ++i)
+	{
+		pData->mPositions[i] = i % 64 ? vec3(randomFloat(-32.0f, 32.0f), randomFloat(-32.0f, 32.0f), randomFloat(-32.0f, 32.0f))
+									  : vec3(0.0f, 0.0f, 0.0f);
+		pData->mVelocities[i] = vec3(randomFloat(-1.0f, 1.0f), randomFloat(0.0f, 2.0f), randomFloat(-1.0f, 1.0f));
+	}
+	addDepthSorter(&pData->pSorter);
+
+	// Frames of slow particles, some of which die and are replaced by the last one while new ones are spawned the way
+	// 15_Transparency removes and adds them, then frames of fast particles the insertion sort gives up on
+	uint32_t problemCount = 0;
+	uint32_t incrementalCount = 0;
+	pData->mCount = SORT_PARTICLE_COUNT / 2;
+	for (uint32_t frame = 0; frame < SORT_CHECK_FRAMES; ++frame)
+	{
+		for (uint32_t i = 0; i < 64; ++i)
+		{
+			const uint32_t dead = randomUint() % pData->mCount;
+			--pData->mCount;
+			pData->mPositions[dead] = pData->mPositions[pData->mCount];
+			pData->mVelocities[dead] = pData->mVelocities[pData->mCount];
+		}
+		pData->mCount += 128;
+
+		pData->mSpeed = frame < SORT_CHECK_FRAMES / 2 ? 0.01f : 4.0f;
+		moveParticles(pData);
+		problemCount += checkDepthSort(pData);
+		incrementalCount += pData->pSorter->mLastSortIncremental;
+	}
+	resetDepthSorter(pData->pSorter);
+	problemCount += checkDepthSort(pData);
+
+	if (problemCount || !incrementalCount || incrementalCount == SORT_CHECK_FRAMES)
+	{
+		LOGF(
+			LogLevel::eERROR, "sortDepths put %u items out of order, %u of %u frames were fixed up incrementally", problemCount,
+			incrementalCount, SORT_CHECK_FRAMES);
+		gChecksFailed = true;
+	}
+
+	// The slow particles move about their distance to the next particle every frame, the fast ones a lot more
+	pData->mCount = SORT_PARTICLE_COUNT;
+	eastl::string input;
+	input.sprintf("%u particles", pData->mCount);
+	eastl::string slowInput;
+	slowInput.sprintf("%u slow particles", pData->mCount);
+
+	typedef struct DepthSortBenchmark
+	{
+		const char*   pName;
+		BenchmarkFunc pFunc;
+		float         mSpeed;
+	} DepthSortBenchmark;
+	const DepthSortBenchmark benchmarks[] = {
+		{ "quick_sort per frame", quickSortFunc, 1.0f },
+		{ "sortDepths", sortDepthsFunc, 0.01f },
+		{ "sortDepths", sortDepthsFunc, 1.0f },
+		{ "sortDepths from scratch", sortDepthsScratchFunc, 1.0f },
+	};
+	for (uint32_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i)
+	{
+		pData->mSpeed = benchmarks[i].mSpeed;
+		resetDepthSorter(pData->pSorter);
+		sortDepths(pData->pSorter, pData->mDistances.data(), pData->mCount);
+
+		BenchmarkDesc desc = makeDesc(pOptions, "sort", benchmarks[i].pName, benchmarks[i].pFunc, pData);
+		desc.pInput = benchmarks[i].mSpeed < 1.0f ? slowInput.c_str() : input.c_str();
+		desc.mItemsPerIteration = pData->mCount;
+		addResult(&desc, results);
+	}
+
+	removeDepthSorter(pData->pSorter);
+	conf_delete(pData);
+}
+
+/************************************************************************/
+// Entity Component System
+/************************************************************************/
+enum
+{
+	ECS_SPRITES_PER_AVOIDER = 500,
+	ECS_CHECK_FRAMES = 16,
+	ECS_MAX_BRUTE_FORCE_SPRITES = 100 * 1000,
+};
+
+// 17_EntityComponentSystem runs the systems at 3 times the frame time
+static const float gEcsBenchmarkDt = 3.0f / 60.0f;
+
+typedef struct EcsWorld
+{
+	entt::Registry<EntityID> mRegistry;
+	MoveSystem               mMoveSystem;
+	AvoidanceSystem          mAvoidanceSystem;
+	EntityID                 mWorldBoundsEntity;
+	uint32_t                 mSpriteCount;
+} EcsWorld;
+
+typedef struct EcsBenchmarkData
+{
+	EcsWorld*                         pWorld;
+	SystemRunner*                     pRunner;
+	eastl::vector<PositionComponent> mAvoidPositions;
+	eastl::vector<SpriteComponent>   mAvoidSprites;
+} EcsBenchmarkData;
+
+// The sprites of 17_EntityComponentSystem, in a world that grows with the count so they are as dense as in the sample
+static EcsWorld* createEcsWorld(uint32_t spriteCount)
+{
+	EcsWorld*            pWorld = conf_new<EcsWorld>();
+	const float          scale = sqrtf(spriteCount / 10000.0f);
+	WorldBoundsComponent bounds = { -80.0f * scale, 80.0f * scale, -50.0f * scale, 50.0f * scale };
+	srand(1);
+	pWorld->mWorldBoundsEntity =
+		createSprites(pWorld->mRegistry, &pWorld->mAvoidanceSystem, bounds, spriteCount, spriteCount / ECS_SPRITES_PER_AVOIDER);
+	pWorld->mSpriteCount = (uint32_t)pWorld->mRegistry.size<PositionComponent>();
+	return pWorld;
+}
+
+// Every sprite tests every avoider, looking the components up in the registry like 17_EntityComponentSystem did.
+// Collisions are found for the positions at the start of the update like AvoidanceSystem does, so the results match. The
+// sample used to move a sprite on each hit before testing the next avoider, which this does not reproduce
+static void avoidBruteForce(EcsBenchmarkData* pData)
+{
+	entt::Registry<EntityID>& registry = pData->pWorld->mRegistry;
+	AvoidanceSystem&          avoidance = pData->pWorld->mAvoidanceSystem;
+	const uint32_t            avoidCount = (uint32_t)avoidance.avoidList.size();
+	pData->mAvoidPositions.resize(avoidCount);
+	pData->mAvoidSprites.resize(avoidCount);
+	for (uint32_t ia = 0; ia < avoidCount; ++ia)
+	{
+		pData->mAvoidPositions[ia] = registry.get<PositionComponent>(avoidance.avoidList[ia]);
+		pData->mAvoidSprites[ia] = registry.get<SpriteComponent>(avoidance.avoidList[ia]);
+	}
+
+	entt::View<EntityID, PositionComponent> view = registry.view<PositionComponent>();
+	for (EntityID entity : view)
+	{
+		PositionComponent& position = view.get(entity);
+		uint32_t           hitCount = 0;
+		uint32_t           lastHit = 0;
+		for (uint32_t ia = 0; ia < avoidCount; ++ia)
+		{
+			const float dx = position.x - pData->mAvoidPositions[ia].x;
+			const float dy = position.y - pData->mAvoidPositions[ia].y;
+			if (dx * dx + dy * dy < avoidance.avoidDistanceList[ia])
+			{
+				lastHit = ia;
+				++hitCount;
+			}
+		}
+
+		if (!hitCount)
+			continue;
+
+		MoveComponent& move = registry.get<MoveComponent>(entity);
+		for (uint32_t hit = 0; hit < hitCount; ++hit)
+			AvoidanceSystem::ResolveCollision(position, move, gEcsBenchmarkDt);
+
+		SpriteComponent& mySprite = registry.get<SpriteComponent>(entity);
+		mySprite.colorR = pData->mAvoidSprites[lastHit].colorR;
+		mySprite.colorG = pData->mAvoidSprites[lastHit].colorG;
+		mySprite.colorB = pData->mAvoidSprites[lastHit].colorB;
+	}
+}
+
+static void moveSystemFunc(void* pUserData)
+{
+	EcsBenchmarkData* pData = (EcsBenchmarkData*)pUserData;
+	pData->pWorld->mMoveSystem.Update(pData->pWorld->mRegistry, pData->pWorld->mWorldBoundsEntity, gEcsBenchmarkDt, pData->pRunner);
+}
+
+static void avoidanceSystemFunc(void* pUserData)
+{
+	EcsBenchmarkData* pData = (EcsBenchmarkData*)pUserData;
+	pData->pWorld->mAvoidanceSystem.Update(
+		pData->pWorld->mRegistry, pData->pWorld->mWorldBoundsEntity, gEcsBenchmarkDt, pData->pRunner);
+}
+
+static void avoidBruteForceFunc(void* pUserData) { avoidBruteForce((EcsBenchmarkData*)pUserData); }
+
+// Returns the number of sprites that differ between the worlds, or are not at the same index in every pool
+static uint32_t compareEcsWorlds(EcsWorld* pWorld, EcsWorld* pExpected)
+{
+	entt::Registry<EntityID>& registry = pWorld->mRegistry;
+	entt::Registry<EntityID>& expected = pExpected->mRegistry;
+	const PositionComponent*  positions = registry.raw<PositionComponent>();
+	const MoveComponent*      moves = registry.raw<MoveComponent>();
+	const SpriteComponent*    sprites = registry.raw<SpriteComponent>();
+	uint32_t                  problemCount = 0;
+	for (uint32_t i = 0; i < pWorld->mSpriteCount; ++i)
+	{
+		const EntityID entity = registry.data<PositionComponent>()[i];
+		if (registry.data<MoveComponent>()[i] != entity || registry.data<SpriteComponent>()[i] != entity)
+		{
+			++problemCount;
+			continue;
+		}
+
+		const PositionComponent& expectedPosition = expected.get<PositionComponent>(entity);
+		const MoveComponent&     expectedMove = expected.get<MoveComponent>(entity);
+		const SpriteComponent&   expectedSprite = expected.get<SpriteComponent>(entity);
+		problemCount += positions[i].x != expectedPosition.x || positions[i].y != expectedPosition.y ||
+						moves[i].velx != expectedMove.velx || moves[i].vely != expectedMove.vely ||
+						sprites[i].colorR != expectedSprite.colorR || sprites[i].colorG != expectedSprite.colorG ||
+						sprites[i].colorB != expectedSprite.colorB;
+	}
+	return problemCount;
+}
+
+static void benchmarkEntityComponentSystem(const BenchmarkOptions* pOptions, eastl::vector<BenchmarkResult>& results)
+{
+	if (!isBenchmarkGroupEnabled(pOptions, "ecs"))
+		return;
+
+	ThreadSystem* pThreadSystem = NULL;
+	initThreadSystem(&pThreadSystem);
+	SystemRunner serialRunner = {};
+	serialRunner.Initialize();
+	SystemRunner threadedRunner = {};
+	threadedRunner.Initialize(pThreadSystem);
+
+	// The sample's count, then 100 times as many
+	const uint32_t spriteCounts[] = { 10 * 1000, 100 * 1000, 1000 * 1000 };
+	for (uint32_t c = 0; c < sizeof(spriteCounts) / sizeof(spriteCounts[0]); ++c)
+	{
+		EcsBenchmarkData data = {};
+		data.pWorld = createEcsWorld(spriteCounts[c]);
+		const bool bruteForce = spriteCounts[c] <= ECS_MAX_BRUTE_FORCE_SPRITES;
+
+		// Frames of the threaded systems against the serial ones with the brute force avoidance on a copy of the world
+		if (bruteForce)
+		{
+			EcsBenchmarkData expected = {};
+			expected.pWorld = createEcsWorld(spriteCounts[c]);
+			expected.pRunner = &serialRunner;
+			data.pRunner = &threadedRunner;
+
+			uint32_t problemCount = 0;
+			for (uint32_t frame = 0; frame < ECS_CHECK_FRAMES; ++frame)
+			{
+				moveSystemFunc(&data);
+				avoidanceSystemFunc(&data);
+				moveSystemFunc(&expected);
+				avoidBruteForce(&expected);
+				problemCount += compareEcsWorlds(data.pWorld, expected.pWorld);
+			}
+
+			if (problemCount)
+			{
+				LOGF(
+					LogLevel::eERROR, "The avoidance grid got %u sprites of %u frames different than testing every avoider",
+					problemCount, ECS_CHECK_FRAMES);
+				gChecksFailed = true;
+			}
+			conf_delete(expected.pWorld);
+		}
+
+		eastl::string input;
+		input.sprintf("%u sprites, %u avoiders", data.pWorld->mSpriteCount, (uint32_t)data.pWorld->mAvoidanceSystem.avoidList.size());
+
+		typedef struct EcsBenchmark
+		{
+			const char*   pName;
+			BenchmarkFunc pFunc;
+			SystemRunner* pRunner;
+		} EcsBenchmark;
+		const EcsBenchmark benchmarks[] = {
+			{ "MoveSystem", moveSystemFunc, &serialRunner },
+			{ "MoveSystem threaded", moveSystemFunc, &threadedRunner },
+			{ "avoidance every avoider", avoidBruteForceFunc, &serialRunner },
+			{ "AvoidanceSystem", avoidanceSystemFunc, &serialRunner },
+			{ "AvoidanceSystem threaded", avoidanceSystemFunc, &threadedRunner },
+		};
+		for (uint32_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i)
+		{
+			if (benchmarks[i].pFunc == avoidBruteForceFunc && !bruteForce)
+				continue;
+
+			data.pRunner = benchmarks[i].pRunner;
+			BenchmarkDesc desc = makeDesc(pOptions, "ecs", benchmarks[i].pName, benchmarks[i].pFunc, &data);
+			desc.pInput = input.c_str();
+			desc.mItemsPerIteration = data.pWorld->mSpriteCount;
+			addResult(&desc, results);
+		}
+
+		conf_delete(data.pWorld);
+	}
+
+	shutdownThreadSystem(pThreadSystem);
+}
+
+/************************************************************************/
+// Texture streaming
+/************************************************************************/
+enum
+{
+	STREAMING_TEXTURE_COUNT = 4096,
+	// Updates until an upload is done and completeStreamingResidencyRequest is called, like a copy queue frames behind
+	STREAMING_UPLOAD_LATENCY = 2,
+};
+
+typedef struct StreamingBenchmarkData
+{
+	eastl::vector<StreamingResidency>  mResidencies;
+	eastl::vector<StreamingResidency*> mOrder;
+	eastl::vector<StreamingResidency*> mRequests;
+	eastl::vector<uint32_t>            mUploadFrames;    // Frame the upload of the request of each texture is done
+	TextureStreamingDesc               mDesc;
+	uint32_t                           mFrame;
+	uint64_t                           mResidentSize;
+} StreamingBenchmarkData;
+
+// A square RGBA8 texture with a full mip chain
+static void initStreamingTexture(StreamingResidency* pResidency, uint32_t size)
+{
+	uint64_t mipSizes[MAX_STREAMING_MIPS] = {};
+	uint32_t mipCount = 0;
+	for (uint32_t mipSize = size; mipSize; mipSize >>= 1, ++mipCount)
+	{
+		if (mipCount < MAX_STREAMING_MIPS)
+			mipSizes[mipCount] = (uint64_t)mipSize * mipSize * 4;
+	}
+	initStreamingResidency(pResidency, size, size, mipCount, mipSizes);
+}
+
+static void initStreamingData(StreamingBenchmarkData* pData, const uint32_t* pSizes, uint32_t count)
+{
+	pData->mResidencies.resize(count);
+	pData->mOrder.resize(count);
+	pData->mRequests.resize(count);
+	pData->mUploadFrames.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+		initStreamingTexture(&pData->mResidencies[i], pSizes[i]);
+	pData->mDesc = {};
+	pData->mFrame = 0;
+	pData->mResidentSize = 0;
+}
+
+// What updateTextureStreaming does every frame, with uploads that are done STREAMING_UPLOAD_LATENCY updates later
+static void updateStreamingFrame(StreamingBenchmarkData* pData)
+{
+	++pData->mFrame;
+	const uint32_t count = (uint32_t)pData->mResidencies.size();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		StreamingResidency* pResidency = &pData->mResidencies[i];
+		if (pResidency->mPending && pData->mUploadFrames[i] <= pData->mFrame)
+		{
+			pData->mResidentSize -= getStreamingResidencySize(pResidency, pResidency->mResidentMip);
+			pData->mResidentSize += getStreamingResidencySize(pResidency, pResidency->mPendingMip);
+			completeStreamingResidencyRequest(pResidency);
+		}
+		pData->mOrder[i] = pResidency;
+	}
+
+	const uint32_t requestCount = updateStreamingResidency(&pData->mDesc, pData->mOrder.data(), count, pData->mRequests.data());
+	for (uint32_t i = 0; i < requestCount; ++i)
+		pData->mUploadFrames[pData->mRequests[i] - pData->mResidencies.data()] = pData->mFrame + STREAMING_UPLOAD_LATENCY;
+}
+
+// Textures seen from a moving camera: every frame some of them come closer or move away
+static void streamingUpdateFunc(void* pUserData)
+{
+	StreamingBenchmarkData* pData = (StreamingBenchmarkData*)pUserData;
+	for (uint32_t i = 0; i < 64; ++i)
+		pData->mResidencies[randomUint() % pData->mResidencies.size()].mScreenSize = randomFloat(0.0f, 2048.0f);
+	updateStreamingFrame(pData);
+}
+
+static const char* gStreamingStateNames[] = { "mip tail", "streaming in", "resident", "evicting" };
+
+// Frames of two 1024x1024 textures, one request per update. Texture 0 is requested and streamed in, then texture 1
+// becomes more important and the budget only fits one of them, so texture 0 is evicted before texture 1 streams in.
+// Last both are evicted down to their mip tails
+typedef struct StreamingCheckStep
+{
+	float                 mScreenSizes[2];
+	// The budget fits the mips of one texture from this mip on
+	uint32_t              mBudgetMip;
+	StreamingTextureState mStates[2];
+	uint32_t              mMipCounts[2];
+} StreamingCheckStep;
+
+// Returns the number of steps any texture was in another state or had another number of mips resident than expected, or
+// the resident mips did not fit the budget with no request in flight
+static uint32_t checkStreamingResidency()
+{
+	const StreamingTextureState tail = STREAMING_TEXTURE_STATE_MIP_TAIL;
+	const StreamingTextureState in = STREAMING_TEXTURE_STATE_STREAMING_IN;
+	const StreamingTextureState resident = STREAMING_TEXTURE_STATE_RESIDENT;
+	const StreamingTextureState evicting = STREAMING_TEXTURE_STATE_EVICTING;
+	// 11 mips, the mip tail is the 7 mips from 64x64 down
+	const StreamingCheckStep steps[] = {
+		{ { 0.0f, 0.0f }, 0, { tail, tail }, { 7, 7 } },
+		{ { 1024.0f, 0.0f }, 0, { in, tail }, { 7, 7 } },
+		{ { 1024.0f, 0.0f }, 0, { in, tail }, { 7, 7 } },
+		{ { 1024.0f, 0.0f }, 0, { resident, tail }, { 11, 7 } },
+		{ { 256.0f, 1024.0f }, 0, { evicting, tail }, { 11, 7 } },
+		{ { 256.0f, 1024.0f }, 0, { evicting, in }, { 11, 7 } },
+		{ { 256.0f, 1024.0f }, 0, { tail, in }, { 7, 7 } },
+		{ { 256.0f, 1024.0f }, 0, { tail, resident }, { 7, 11 } },
+		{ { 256.0f, 1024.0f }, 2, { tail, evicting }, { 7, 11 } },
+		{ { 256.0f, 1024.0f }, 2, { tail, evicting }, { 7, 11 } },
+		{ { 256.0f, 1024.0f }, 2, { tail, resident }, { 7, 9 } },
+		{ { 0.0f, 0.0f }, 2, { tail, evicting }, { 7, 9 } },
+		{ { 0.0f, 0.0f }, 2, { tail, evicting }, { 7, 9 } },
+		{ { 0.0f, 0.0f }, 2, { tail, tail }, { 7, 7 } },
+	};
+
+	StreamingBenchmarkData data;
+	const uint32_t         sizes[] = { 1024, 1024 };
+	initStreamingData(&data, sizes, 2);
+	data.mDesc.mMaxRequestsPerUpdate = 1;
+
+	uint32_t problemCount = 0;
+	for (uint32_t s = 0; s < sizeof(steps) / sizeof(steps[0]); ++s)
+	{
+		const StreamingCheckStep* pStep = &steps[s];
+		data.mDesc.mMemoryBudget = getStreamingResidencySize(&data.mResidencies[0], pStep->mBudgetMip);
+		// The first step checks the textures as they are initialized
+		if (s)
+		{
+			for (uint32_t i = 0; i < 2; ++i)
+				data.mResidencies[i].mScreenSize = pStep->mScreenSizes[i];
+			updateStreamingFrame(&data);
+		}
+
+		// Evicted mips only stop counting once their upload is done
+		const bool settled = !data.mResidencies[0].mPending && !data.mResidencies[1].mPending;
+		bool       problem = settled && data.mResidentSize > data.mDesc.mMemoryBudget;
+		if (problem)
+			LOGF(LogLevel::eERROR, "Streaming step %u: %llu resident bytes do not fit the budget", s, (unsigned long long)data.mResidentSize);
+		for (uint32_t i = 0; i < 2; ++i)
+		{
+			const StreamingResidency* pResidency = &data.mResidencies[i];
+			if (pResidency->mState != pStep->mStates[i] || getStreamingResidencyMipCount(pResidency) != pStep->mMipCounts[i])
+			{
+				LOGF(
+					LogLevel::eERROR, "Streaming step %u: texture %u is %s with %u mips instead of %s with %u mips", s, i,
+					gStreamingStateNames[pResidency->mState], getStreamingResidencyMipCount(pResidency),
+					gStreamingStateNames[pStep->mStates[i]], pStep->mMipCounts[i]);
+				problem = true;
+			}
+		}
+		problemCount += problem;
+	}
+	return problemCount;
+}
+
+static void benchmarkTextureStreaming(const BenchmarkOptions* pOptions, eastl::vector<BenchmarkResult>& results)
+{
+	if (!isBenchmarkGroupEnabled(pOptions, "streaming"))
+		return;
+
+	const uint32_t problemCount = checkStreamingResidency();
+	if (problemCount)
+	{
+		LOGF(LogLevel::eERROR, "Texture streaming residency was wrong in %u steps", problemCount);
+		gChecksFailed = true;
+	}
+
+	// Textures from 256x256 to 4096x4096 with a budget for about a quarter of their mips
+	eastl::vector<uint32_t> sizes(STREAMING_TEXTURE_COUNT);
+	for (uint32_t i = 0; i < STREAMING_TEXTURE_COUNT; ++i)
+		sizes[i] = 256u << (randomUint() % 5);
+	StreamingBenchmarkData* pData = conf_new<StreamingBenchmarkData>();
+	initStreamingData(pData, sizes.data(), STREAMING_TEXTURE_COUNT);
+	for (uint32_t i = 0; i < STREAMING_TEXTURE_COUNT; ++i)
+	{
+		pData->mResidencies[i].mScreenSize = randomFloat(0.0f, 2048.0f);
+		pData->mDesc.mMemoryBudget += getStreamingResidencySize(&pData->mResidencies[i], 0) / 4;
+	}
+	pData->mDesc.mMaxRequestsPerUpdate = 64;
+
+	eastl::string input;
+	input.sprintf("%u textures", STREAMING_TEXTURE_COUNT);
+	BenchmarkDesc desc = makeDesc(pOptions, "streaming", "updateStreamingResidency", streamingUpdateFunc, pData);
+	desc.pInput = input.c_str();
+	desc.mItemsPerIteration = STREAMING_TEXTURE_COUNT;
+	addResult(&desc, results);
+
+	conf_delete(pData);
+}
+
+void PrintHelp()
+{
+	printf("Benchmarks\n");
+	printf("Usage: Benchmarks [flags]\n");
+	printBenchmarkOptionsHelp();
+	printf("Groups: thread, log, file, memory, math, ozz, animsystem, clusters, sort, ecs, streaming\n");
+	printf("Other:\n");
+	printf("\t-h or -help: Print usage information.\n");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 0)
+		gApplicationName = argv[0];
+
+	BenchmarkOptions options;
+	initBenchmarkOptions(&options, "Benchmarks.json", 20);
+	for (int j = 1; j < argc; ++j)
+	{
+		eastl::string arg = argv[j];
+		arg.make_lower();
+		if (arg == "-h" || arg == "-help")
+		{
+			PrintHelp();
+			return 0;
+		}
+
+		if (!parseBenchmarkOption(&options, argc, argv, &j))
+			printf("WARNING: Unrecognized argument: %s\n", argv[j]);
+	}
+
+	eastl::vector<BenchmarkResult> results;
+	benchmarkThreadSystem(&options, results);
+	benchmarkFile(&options, results);
+	benchmarkMemory(&options, results);
+	benchmarkMath(&options, results);
+	benchmarkAnimation(&options, results);
+	benchmarkAnimationSystem(&options, results);
+	benchmarkClusters(&options, results);
+	benchmarkDepthSort(&options, results);
+	benchmarkEntityComponentSystem(&options, results);
+	benchmarkTextureStreaming(&options, results);
+
+	if (results.empty())
+	{
+		printf("ERROR: No benchmark matched the filter \"%s\".\n", options.mFilter.c_str());
+		return 1;
+	}
+
+	const int result = finishBenchmarks(results, "Benchmarks", &options);
+	return gChecksFailed ? 1 : result;
+}
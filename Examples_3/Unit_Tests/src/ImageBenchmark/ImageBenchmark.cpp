@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Headless image loading benchmark.
+// Loads every image of a corpus directory through all registered Image loaders and measures
+// loadImage / loadFromMemory throughput as well as GenerateMipMaps and Convert.
+// Usage: ImageBenchmark "corpus/directory/" [--iterations N] [--warmup N] [--filter ext] [--json results.json] [--compare baseline.json]
+
+#include "../../../../Common_3/OS/Image/Image.h"
+#include "../../../../Common_3/OS/Interfaces/IFileSystem.h"
+#include "../../../../Common_3/OS/Interfaces/ILogManager.h"
+#include "../../../Common/Benchmark.h"
+
+#include <cstdio>
+
+#include "../../../../Common_3/OS/Interfaces/IMemoryManager.h"
+
+const char* pszBases[FSR_Count] = {
+	"",    // FSR_BinShaders
+	"",    // FSR_SrcShaders
+	"",    // FSR_Textures
+	"",    // FSR_Meshes
+	"",    // FSR_Builtin_Fonts
+	"",    // FSR_GpuConfig
+	"",    // FSR_Animation
+	"",    // FSR_OtherFiles
+	"",    // FSR_MIDDLEWARE_TEXT
+	"",    // FSR_MIDDLEWARE_UI
+};
+
+const char* gApplicationName = NULL;
+
+// Extensions with a registered loader in Image.cpp
+static const char* gImageExtensions[] = { "dds", "pvr", "png", "jpg", "jpeg", "tga", "bmp", "gif", "psd", "hdr", "exr" };
+
+typedef struct ImageBenchmarkData
+{
+	eastl::string         mPath;
+	eastl::string         mExtension;
+	eastl::vector<char>   mFileData;
+	Image                 mSource;
+	/// Pre-made copies for the destructive operations so the copy is not measured
+	eastl::vector<Image*> mCopies;
+	uint32_t              mCopyIndex;
+} ImageBenchmarkData;
+
+static void loadImageFunc(void* pUserData)
+{
+	ImageBenchmarkData* pData = (ImageBenchmarkData*)pUserData;
+	Image image;
+	image.loadImage(pData->mPath.c_str(), false, NULL, NULL, FSR_Absolute);
+	image.Destroy();
+}
+
+static void loadFromMemoryFunc(void* pUserData)
+{
+	ImageBenchmarkData* pData = (ImageBenchmarkData*)pUserData;
+	Image image;
+	eastl::string extension = "." + pData->mExtension;
+	image.loadFromMemory(pData->mFileData.data(), (uint32_t)pData->mFileData.size(), false, extension.c_str());
+	image.Destroy();
+}
+
+static void generateMipMapsFunc(void* pUserData)
+{
+	ImageBenchmarkData* pData = (ImageBenchmarkData*)pUserData;
+	pData->mCopies[pData->mCopyIndex++]->GenerateMipMaps();
+}
+
+static void convertFunc(void* pUserData)
+{
+	ImageBenchmarkData* pData = (ImageBenchmarkData*)pUserData;
+	pData->mCopies[pData->mCopyIndex++]->Convert(ImageFormat::RGBA32F);
+}
+
+static void createCopies(ImageBenchmarkData* pData, uint32_t count)
+{
+	pData->mCopies.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+		pData->mCopies[i] = conf_new<Image, const Image&>(pData->mSource);
+	pData->mCopyIndex = 0;
+}
+
+static void destroyCopies(ImageBenchmarkData* pData)
+{
+	for (Image* pImage : pData->mCopies)
+	{
+		pImage->Destroy();
+		conf_delete(pImage);
+	}
+	pData->mCopies.clear();
+}
+
+static bool readFile(const eastl::string& path, eastl::vector<char>& data)
+{
+	File file;
+	if (!file.Open(path, FM_ReadBinary, FSR_Absolute))
+		return false;
+	data.resize(file.GetSize());
+	file.Read(data.data(), (unsigned)data.size());
+	file.Close();
+	return true;
+}
+
+static void benchmarkImage(
+	const eastl::string& path, const eastl::string& extension, const BenchmarkOptions* pOptions, eastl::vector<BenchmarkResult>& results)
+{
+	ImageBenchmarkData data;
+	data.mPath = path;
+	data.mExtension = extension;
+	data.mCopyIndex = 0;
+	if (!readFile(path, data.mFileData))
+	{
+		LOGF(LogLevel::eERROR, "Failed to read \"%s\"", path.c_str());
+		return;
+	}
+
+	eastl::string dotExtension = "." + extension;
+	if (!data.mSource.loadFromMemory(data.mFileData.data(), (uint32_t)data.mFileData.size(), false, dotExtension.c_str()))
+	{
+		LOGF(LogLevel::eWARNING, "No loader could decode \"%s\"", path.c_str());
+		return;
+	}
+
+	const eastl::string fileName = FileSystem::GetFileNameAndExtension(path);
+	const uint64_t      fileSize = data.mFileData.size();
+	const uint64_t      decodedSize = (uint64_t)data.mSource.GetMipMappedSize(0, data.mSource.GetMipMapCount()) * data.mSource.GetArrayCount();
+
+	BenchmarkDesc desc = {};
+	desc.pGroup = extension.c_str();
+	desc.pInput = fileName.c_str();
+	desc.pUserData = &data;
+	desc.mIterations = pOptions->mIterations;
+	desc.mWarmupIterations = pOptions->mWarmupIterations;
+
+	BenchmarkResult result;
+
+	// Throughput of the loaders is reported in source bytes
+	desc.pName = "loadImage";
+	desc.pFunc = loadImageFunc;
+	desc.mBytesPerIteration = fileSize;
+	runBenchmark(&desc, &result);
+	results.push_back(result);
+
+	desc.pName = "loadFromMemory";
+	desc.pFunc = loadFromMemoryFunc;
+	runBenchmark(&desc, &result);
+	results.push_back(result);
+
+	// Mip generation and conversion only support uncompressed formats
+	if (ImageFormat::IsPlainFormat(data.mSource.getFormat()))
+	{
+		desc.mBytesPerIteration = decodedSize;
+
+		if (data.mSource.GetMipMapCount() <= 1)
+		{
+			createCopies(&data, pOptions->mWarmupIterations + pOptions->mIterations);
+			desc.pName = "GenerateMipMaps";
+			desc.pFunc = generateMipMapsFunc;
+			runBenchmark(&desc, &result);
+			results.push_back(result);
+			destroyCopies(&data);
+		}
+
+		if (data.mSource.getFormat() != ImageFormat::RGBA32F)
+		{
+			createCopies(&data, pOptions->mWarmupIterations + pOptions->mIterations);
+			desc.pName = "Convert";
+			desc.pFunc = convertFunc;
+			runBenchmark(&desc, &result);
+			results.push_back(result);
+			destroyCopies(&data);
+		}
+	}
+
+	data.mSource.Destroy();
+}
+
+void PrintHelp()
+{
+	printf("ImageBenchmark\n");
+	printf("Usage: ImageBenchmark \"corpus/directory/\" [flags]\n");
+	printBenchmarkOptionsHelp();
+	printf("Other:\n");
+	printf("\t-h or -help: Print usage information.\n");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 0)
+		gApplicationName = argv[0];
+
+	if (argc < 2)
+	{
+		PrintHelp();
+		return 1;
+	}
+
+	eastl::string arg = argv[1];
+	arg.make_lower();
+	if (arg == "-h" || arg == "-help")
+	{
+		PrintHelp();
+		return 0;
+	}
+
+	eastl::string corpusDir = FileSystem::AddTrailingSlash(argv[1]);
+	BenchmarkOptions options;
+	initBenchmarkOptions(&options, "ImageBenchmark.json", 10);
+	for (int j = 2; j < argc; ++j)
+	{
+		if (!parseBenchmarkOption(&options, argc, argv, &j))
+			printf("WARNING: Unrecognized argument: %s\n", argv[j]);
+	}
+
+	if (!FileSystem::DirExists(corpusDir))
+	{
+		printf("ERROR: Corpus directory \"%s\" does not exist.\n", corpusDir.c_str());
+		return 1;
+	}
+
+	eastl::vector<BenchmarkResult> results;
+	for (const char* pExtension : gImageExtensions)
+	{
+		if (!isBenchmarkGroupEnabled(&options, pExtension))
+			continue;
+
+		eastl::vector<eastl::string> files;
+		FileSystem::GetFilesWithExtension(corpusDir, eastl::string(".") + pExtension, files);
+		for (const eastl::string& file : files)
+			benchmarkImage(file, pExtension, &options, results);
+	}
+
+	if (results.empty())
+	{
+		printf("ERROR: No images found in \"%s\".\n", corpusDir.c_str());
+		return 1;
+	}
+
+	return finishBenchmarks(results, "ImageBenchmark", &options);
+}
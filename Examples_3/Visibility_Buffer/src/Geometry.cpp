@@ -25,6 +25,8 @@
 #include "Geometry.h"
 
 #include "../../../Common_3/ThirdParty/OpenSource/EASTL/unordered_set.h"
+#include "../../../Common_3/ThirdParty/OpenSource/EASTL/algorithm.h"
+#include "../../../Common_3/ThirdParty/OpenSource/EASTL/sort.h"
 
 #include "../../../Common_3/ThirdParty/OpenSource/assimp/4.1.0/include/assimp/cimport.h"
 #include "../../../Common_3/ThirdParty/OpenSource/assimp/4.1.0/include/assimp/scene.h"
@@ -32,8 +34,10 @@
 #include "../../../Common_3/OS/Interfaces/IFileSystem.h"
 #include "../../../Common_3/OS/Interfaces/ILogManager.h"
 #include "../../../Common_3/OS/Core/Compiler.h"
+#include "../../../Common_3/OS/Core/ThreadSystem.h"
 
 #include "../../../Common_3/Tools/AssimpImporter/AssimpImporter.h"
+#include "../../../Common_3/Tools/AssetPipeline/BinaryMesh.h"
 #include "../../../Common_3/OS/Interfaces/IMemoryManager.h"
 
 #ifdef ORBIS
@@ -992,6 +996,51 @@ static inline uint encodeDir(const float3& n)
 }
 #endif
 
+#if defined(METAL)
+// Once we have read all the geometry from the original asset, expand indices into vertices so the models are compatible with Metal implementation.
+static void expandIndices(Scene* scene)
+{
+	Scene originalScene = *scene;
+
+	// Index count is stored in the vertex count member when reading the mesh on Metal.
+	uint32_t expandedVertices = 0;
+	for (uint32_t i = 0; i < scene->numMeshes; i++)
+		expandedVertices += originalScene.meshes[i].vertexCount;
+
+	scene->totalTriangles = 0;
+	scene->totalVertices = 0;
+	scene->positions = (SceneVertexPos*)conf_malloc(expandedVertices * sizeof(SceneVertexPos));
+	scene->texCoords = (SceneVertexTexCoord*)conf_malloc(expandedVertices * sizeof(SceneVertexTexCoord));
+	scene->normals = (SceneVertexNormal*)conf_malloc(expandedVertices * sizeof(SceneVertexNormal));
+	scene->tangents = (SceneVertexTangent*)conf_malloc(expandedVertices * sizeof(SceneVertexTangent));
+
+	uint32_t originalIdx = 0;
+	for (uint32_t i = 0; i < scene->numMeshes; i++)
+	{
+		scene->meshes[i].startVertex = scene->totalVertices;
+
+		uint32_t idxCount = originalScene.meshes[i].vertexCount;
+		for (uint32_t j = 0; j < idxCount; j++)
+		{
+			uint32_t idx = originalScene.indices[originalIdx++];
+			scene->positions[scene->totalVertices + j] = originalScene.positions[idx];
+			scene->texCoords[scene->totalVertices + j] = originalScene.texCoords[idx];
+			scene->normals[scene->totalVertices + j] = originalScene.normals[idx];
+			scene->tangents[scene->totalVertices + j] = originalScene.tangents[idx];
+		}
+		scene->meshes[i].vertexCount = idxCount;
+		scene->meshes[i].triangleCount = scene->meshes[i].vertexCount / 3;
+		scene->totalTriangles += scene->meshes[i].triangleCount;
+		scene->totalVertices += scene->meshes[i].vertexCount;
+	}
+
+	conf_free(originalScene.positions);
+	conf_free(originalScene.texCoords);
+	conf_free(originalScene.normals);
+	conf_free(originalScene.tangents);
+}
+#endif
+
 // Loads a scene using ASSIMP and returns a Scene object with scene information
 Scene* loadScene(const char* fileName, float scale, float offsetX, float offsetY, float offsetZ)
 {
@@ -1078,12 +1127,14 @@ Scene* loadScene(const char* fileName, float scale, float offsetX, float offsetY
 
 	scene->meshes = (MeshIn*)conf_calloc(scene->numMeshes, sizeof(MeshIn));
 
-	scene->indices = indices;
-	scene->positions = positions;
+	scene->indices = (uint32_t*)conf_malloc(indices.size() * sizeof(uint32_t));
+	memcpy(scene->indices, indices.data(), indices.size() * sizeof(uint32_t));
+	scene->positions = (SceneVertexPos*)conf_malloc(positions.size() * sizeof(SceneVertexPos));
+	memcpy(scene->positions, positions.data(), positions.size() * sizeof(SceneVertexPos));
 
-	scene->texCoords = eastl::vector<SceneVertexTexCoord>(scene->totalVertices, SceneVertexTexCoord{ 0 });
-	scene->normals = eastl::vector<SceneVertexNormal>(scene->totalVertices, SceneVertexNormal{ 0 });
-	scene->tangents = eastl::vector<SceneVertexTangent>(scene->totalVertices, SceneVertexTangent{ 0 });
+	scene->texCoords = (SceneVertexTexCoord*)conf_calloc(scene->totalVertices, sizeof(SceneVertexTexCoord));
+	scene->normals = (SceneVertexNormal*)conf_calloc(scene->totalVertices, sizeof(SceneVertexNormal));
+	scene->tangents = (SceneVertexTangent*)conf_calloc(scene->totalVertices, sizeof(SceneVertexTangent));
 
 	for (uint32_t v = 0; v < scene->totalVertices; v++)
 	{
@@ -1148,36 +1199,7 @@ Scene* loadScene(const char* fileName, float scale, float offsetX, float offsetY
 	SetMaterials(scene);
 
 #ifdef METAL
-	// Once we have read all the geometry from the original asset, expand indices into vertices so the models are compatible with Metal implementation.
-	Scene originalScene = *scene;
-
-	scene->totalTriangles = 0;
-	scene->totalVertices = 0;
-	scene->positions.clear();
-	scene->texCoords.clear();
-	scene->normals.clear();
-	scene->tangents.clear();
-
-	uint32_t originalIdx = 0;
-	for (uint32_t i = 0; i < scene->numMeshes; i++)
-	{
-		scene->meshes[i].startVertex = (uint32_t)scene->positions.size();
-
-		uint32_t idxCount =
-			originalScene.meshes[i].vertexCount;    // Index count is stored in the vertex count member when reading the mesh on Metal.
-		for (uint32_t j = 0; j < idxCount; j++)
-		{
-			uint32_t idx = originalScene.indices[originalIdx++];
-			scene->positions.push_back(originalScene.positions[idx]);
-			scene->texCoords.push_back(originalScene.texCoords[idx]);
-			scene->normals.push_back(originalScene.normals[idx]);
-			scene->tangents.push_back(originalScene.tangents[idx]);
-		}
-		scene->meshes[i].vertexCount = (uint32_t)scene->positions.size() - scene->meshes[i].startVertex;
-		scene->meshes[i].triangleCount = scene->meshes[i].vertexCount / 3;
-		scene->totalTriangles += scene->meshes[i].triangleCount;
-		scene->totalVertices += scene->meshes[i].vertexCount;
-	}
+	expandIndices(scene);
 #endif
 
 #else
@@ -1202,18 +1224,18 @@ Scene* loadScene(const char* fileName, float scale, float offsetX, float offsetY
 	scene->totalTriangles = scene->totalTriangles / 3;
 
 	scene->meshes = (MeshIn*)conf_calloc(scene->numMeshes, sizeof(MeshIn));
-	scene->indices = eastl::vector<uint32>(scene->totalTriangles * 3, uint32_t(0));
-	scene->positions = eastl::vector<SceneVertexPos>(scene->totalVertices, SceneVertexPos{ 0 });
-	scene->texCoords = eastl::vector<SceneVertexTexCoord>(scene->totalVertices, SceneVertexTexCoord{ 0 });
-	scene->normals = eastl::vector<SceneVertexNormal>(scene->totalVertices, SceneVertexNormal{ 0 });
-	scene->tangents = eastl::vector<SceneVertexTangent>(scene->totalVertices, SceneVertexTangent{ 0 });
+	scene->indices = (uint32_t*)conf_calloc(scene->totalTriangles * 3, sizeof(uint32_t));
+	scene->positions = (SceneVertexPos*)conf_calloc(scene->totalVertices, sizeof(SceneVertexPos));
+	scene->texCoords = (SceneVertexTexCoord*)conf_calloc(scene->totalVertices, sizeof(SceneVertexTexCoord));
+	scene->normals = (SceneVertexNormal*)conf_calloc(scene->totalVertices, sizeof(SceneVertexNormal));
+	scene->tangents = (SceneVertexTangent*)conf_calloc(scene->totalVertices, sizeof(SceneVertexTangent));
 
 	eastl::vector<float2> texcoords(scene->totalVertices);
 	eastl::vector<float3> normals(scene->totalVertices);
 	eastl::vector<float3> tangents(scene->totalVertices);
 
-	assimpScene.Read(scene->indices.data(), sizeof(uint32_t) * scene->totalTriangles * 3);
-	assimpScene.Read(scene->positions.data(), sizeof(float3) * scene->totalVertices);
+	assimpScene.Read(scene->indices, sizeof(uint32_t) * scene->totalTriangles * 3);
+	assimpScene.Read(scene->positions, sizeof(float3) * scene->totalVertices);
 	assimpScene.Read(texcoords.data(), sizeof(float2) * scene->totalVertices);
 	assimpScene.Read(normals.data(), sizeof(float3) * scene->totalVertices);
 	assimpScene.Read(tangents.data(), sizeof(float3) * scene->totalVertices);
@@ -1513,40 +1535,112 @@ Scene* loadScene(const char* fileName, float scale, float offsetX, float offsetY
 	assimpScene.Close();
 
 #ifdef METAL
-	// Once we have read all the geometry from the original asset, expand indices into vertices so the models are compatible with Metal implementation.
-	Scene originalScene = *scene;
+	expandIndices(scene);
+#endif
 
-	scene->totalTriangles = 0;
-	scene->totalVertices = 0;
-	scene->positions.clear();
-	scene->texCoords.clear();
-	scene->normals.clear();
-	scene->tangents.clear();
+#endif
+	return scene;
+}
 
-	uint32_t originalIdx = 0;
-	for (uint32_t i = 0; i < scene->numMeshes; i++)
-	{
-		scene->meshes[i].startVertex = (uint32_t)scene->positions.size();
+// The arrays of a baked scene are used in place, so they have to be laid out like the ones of the scene
+static_assert(sizeof(SceneVertexPos) == 3 * sizeof(float), "Baked positions are 3 floats");
+static_assert(sizeof(ClusterCompact) == sizeof(BinaryMeshClusterCompact), "ClusterCompact does not match the baked clusters");
+static_assert(sizeof(Cluster) == sizeof(BinaryMeshCluster), "Cluster does not match the baked clusters");
+static_assert(offsetof(Cluster, valid) == offsetof(BinaryMeshCluster, mValid), "Cluster does not match the baked clusters");
 
-		uint32_t idxCount =
-			originalScene.meshes[i].vertexCount;    // Index count is stored in the vertex count member when reading the mesh on Metal.
-		for (uint32_t j = 0; j < idxCount; j++)
-		{
-			uint32_t idx = originalScene.indices[originalIdx++];
-			scene->positions.push_back(originalScene.positions[idx]);
-			scene->texCoords.push_back(originalScene.texCoords[idx]);
-			scene->normals.push_back(originalScene.normals[idx]);
-			scene->tangents.push_back(originalScene.tangents[idx]);
-		}
-		scene->meshes[i].vertexCount = (uint32_t)scene->positions.size() - scene->meshes[i].startVertex;
-		scene->meshes[i].triangleCount = scene->meshes[i].vertexCount / 3;
-		scene->totalTriangles += scene->meshes[i].triangleCount;
-		scene->totalVertices += scene->meshes[i].vertexCount;
+// Maps a scene baked by the processmeshes command of the asset pipeline. The vertices, indices and clusters are used
+// straight from the mapping, only the meshes and materials are set up. Returns NULL if there is no baked scene or it was
+// baked with other settings, the scene then has to be loaded with loadScene.
+Scene* loadBakedScene(const char* fileName, float scale, float offsetX, float offsetY, float offsetZ)
+{
+#if defined(METAL)
+	// Metal draws non indexed vertices and builds its clusters on those
+	return NULL;
+#else
+	size_t   size = 0;
+	uint8_t* pData = (uint8_t*)map_file(fileName, &size);
+	if (!pData)
+		return NULL;
+
+	const BinaryMeshHeader* pHeader = (const BinaryMeshHeader*)pData;
+	const char*             reason = NULL;
+	if (size < sizeof(BinaryMeshHeader) || pHeader->mMagic != BINARY_MESH_MAGIC || pHeader->mVersion != BINARY_MESH_VERSION ||
+		pHeader->mFileSize != size)
+		reason = "unknown format";
+	else if (
+		pHeader->mScale != scale || pHeader->mOffset[0] != offsetX || pHeader->mOffset[1] != offsetY || pHeader->mOffset[2] != offsetZ)
+		reason = "baked with another scale or offset";
+	else if (pHeader->mClusterSize != CLUSTER_SIZE)
+		reason = "baked with another cluster size";
+
+	if (reason)
+	{
+		LOGF(LogLevel::eWARNING, "Ignoring baked scene %s, %s.", fileName, reason);
+		unmap_file(pData, size);
+		return NULL;
 	}
-#endif
 
+	Scene* scene = (Scene*)conf_calloc(1, sizeof(Scene));
+	scene->bakedData = pData;
+	scene->bakedDataSize = size;
+	scene->numMeshes = pHeader->mNumMeshes;
+	scene->totalVertices = pHeader->mNumVertices;
+	scene->totalTriangles = pHeader->mNumIndices / 3;
+
+	scene->positions = (SceneVertexPos*)(pData + pHeader->mPositionsOffset);
+#if defined(__linux__)
+	scene->texCoords = (SceneVertexTexCoord*)(pData + pHeader->mTexCoordsOffset);
+	scene->normals = (SceneVertexNormal*)(pData + pHeader->mNormalsOffset);
+	scene->tangents = (SceneVertexTangent*)(pData + pHeader->mTangentsOffset);
+#else
+	scene->texCoords = (SceneVertexTexCoord*)(pData + pHeader->mPackedTexCoordsOffset);
+	scene->normals = (SceneVertexNormal*)(pData + pHeader->mPackedNormalsOffset);
+	scene->tangents = (SceneVertexTangent*)(pData + pHeader->mPackedTangentsOffset);
 #endif
+	scene->indices = (uint32_t*)(pData + pHeader->mIndicesOffset);
+
+	const BinaryMeshInfo* pMeshInfos = (const BinaryMeshInfo*)(pData + pHeader->mMeshesOffset);
+	ClusterCompact*       pClusterCompacts = (ClusterCompact*)(pData + pHeader->mClusterCompactsOffset);
+	Cluster*              pClusters = (Cluster*)(pData + pHeader->mClustersOffset);
+
+	scene->meshes = (MeshIn*)conf_calloc(scene->numMeshes, sizeof(MeshIn));
+	for (uint32_t i = 0; i < scene->numMeshes; ++i)
+	{
+		const BinaryMeshInfo& info = pMeshInfos[i];
+		MeshIn&               batch = scene->meshes[i];
+		batch.materialId = i;
+		batch.startIndex = info.mStartIndex;
+		batch.indexCount = info.mIndexCount;
+		batch.vertexCount = info.mVertexCount;
+		batch.minBBox = float3(info.mMin[0], info.mMin[1], info.mMin[2]);
+		batch.maxBBox = float3(info.mMax[0], info.mMax[1], info.mMax[2]);
+		batch.clusterCount = info.mClusterCount;
+		batch.clusterCompacts = pClusterCompacts + info.mClusterStart;
+		batch.clusters = pClusters + info.mClusterStart;
+	}
+
+	// Like loadScene, the materials are the ones set up for each mesh of San Miguel, not the ones stored in the file
+	scene->numMaterials = scene->numMeshes;
+	scene->materials = (Material*)conf_calloc(scene->numMaterials, sizeof(Material));
+	scene->textures = (char**)conf_calloc(scene->numMaterials, sizeof(char*));
+	scene->normalMaps = (char**)conf_calloc(scene->numMaterials, sizeof(char*));
+	scene->specularMaps = (char**)conf_calloc(scene->numMaterials, sizeof(char*));
+
+	SetMaterials(scene);
+
+	// The clusters were baked as if every material was one sided. The mapping is private, so this only copies the pages touched
+	for (uint32_t i = 0; i < scene->numMeshes; ++i)
+	{
+		MeshIn& batch = scene->meshes[i];
+		if (!scene->materials[batch.materialId].twoSided)
+			continue;
+
+		for (uint32_t j = 0; j < batch.clusterCount; ++j)
+			batch.clusters[j].valid = false;
+	}
+
 	return scene;
+#endif
 }
 
 void removeScene(Scene* scene)
@@ -1572,11 +1666,18 @@ void removeScene(Scene* scene)
 		}
 	}
 
-	scene->positions.~vector();
-	scene->texCoords.~vector();
-	scene->normals.~vector();
-	scene->tangents.~vector();
-	scene->indices.~vector();
+	if (scene->bakedData)
+	{
+		unmap_file(scene->bakedData, scene->bakedDataSize);
+	}
+	else
+	{
+		conf_free(scene->positions);
+		conf_free(scene->texCoords);
+		conf_free(scene->normals);
+		conf_free(scene->tangents);
+		conf_free(scene->indices);
+	}
 
 	conf_free(scene->textures);
 	conf_free(scene->normalMaps);
@@ -1594,10 +1695,6 @@ void createAABB(const Scene* pScene, MeshIn* mesh)
 	vec4 aabbMax = -aabbMin;
 
 #ifndef METAL
-	uint32_t triangleCount = mesh->indexCount / 3;
-
-	uint32_t totalSize = (uint32_t)pScene->indices.size();
-
 	for (uint t = 0; t < mesh->indexCount; ++t)
 	{
 		vec4 currentVertex;
@@ -1706,6 +1803,401 @@ void loadModel(const eastl::string& FileName, Buffer*& pVertexBuffer, uint& vert
 	addResource(&ibPosDesc, true);
 }
 
+// Returns a in the lanes where mask is set, b in the others
+static inline Vector4 selectPerElem(const Vector4Int mask, const Vector4& a, const Vector4& b)
+{
+	return orPerElem(andPerElem(a, mask), andPerElem(b, Not(mask)));
+}
+
+#if !defined(METAL)
+
+// Computes the bounds and backface culling cone of a cluster, four triangles at a time
+static void computeCluster(bool twoSided, const Scene* pScene, const MeshIn* mesh, const ClusterCompact* compact, Cluster* cluster)
+{
+	const uint32_t  triangleCount = compact->triangleCount;
+	const uint32_t  groupCount = (triangleCount + 3) / 4;
+	const uint32_t* indices = pScene->indices + mesh->startIndex + compact->clusterStart * 3;
+
+	// First vertex and normal of every triangle, kept for the second pass. Lanes without a normal are degenerate
+	// triangles or padding and are left out of the cone
+	SoaFloat3  firstVertices[(CLUSTER_SIZE + 3) / 4];
+	SoaFloat3  normals[(CLUSTER_SIZE + 3) / 4];
+	Vector4Int normalMasks[(CLUSTER_SIZE + 3) / 4];
+
+	Vector4   aabbMin = Vector4(INFINITY);
+	Vector4   aabbMax = Vector4(-INFINITY);
+	SoaFloat3 normalSum = SoaFloat3::zero();
+
+	for (uint32_t group = 0; group < groupCount; ++group)
+	{
+		Vector4 vertices[3][4];
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			// The last group is padded with the last triangle, which leaves the bounds as they are
+			const uint32_t triangleIndex = min(group * 4 + lane, triangleCount - 1);
+			for (uint32_t j = 0; j < 3; ++j)
+			{
+				const SceneVertexPos& pos = pScene->positions[indices[triangleIndex * 3 + j]];
+				vertices[j][lane] = Vector4(pos.x, pos.y, pos.z, 0.0f);
+				aabbMin = minPerElem(aabbMin, vertices[j][lane]);
+				aabbMax = maxPerElem(aabbMax, vertices[j][lane]);
+			}
+		}
+
+		SoaFloat3 triangle[3];
+		for (uint32_t j = 0; j < 3; ++j)
+		{
+			Vector4 soa[4];
+			transpose4x4(vertices[j], soa);
+			triangle[j] = SoaFloat3::Load(soa[0], soa[1], soa[2]);
+		}
+
+		const SoaFloat3 normal = CrossProduct(triangle[1] - triangle[0], triangle[2] - triangle[0]);
+		const Vector4   lengthSqr = Dot(normal, normal);
+		const Vector4   invLength = divPerElem(Vector4::one(), sqrtPerElem(maxPerElem(lengthSqr, Vector4(FLT_MIN))));
+		const Vector4   laneIndex = Vector4(0.0f, 1.0f, 2.0f, 3.0f);
+		const Vector4Int mask =
+			And(cmpGt(lengthSqr, Vector4::zero()), cmpGt(Vector4((float)(triangleCount - group * 4)), laneIndex));
+		const SoaFloat3 unitNormal = normal * andPerElem(invLength, mask);
+
+		firstVertices[group] = triangle[0];
+		normals[group] = unitNormal;
+		normalMasks[group] = mask;
+		normalSum = normalSum + unitNormal;
+	}
+
+	// This is the cosine of the cone opening angle - 1 means it's 0°, we're minimizing this value (at 0, it would mean
+	// the cone is 90° open)
+	float coneOpening = 1;
+	// dont cull two sided meshes
+	bool validCluster = !twoSided;
+
+	const vec3 center = ((aabbMin + aabbMax) * 0.5f).getXYZ();
+	vec3       coneAxis = -vec3(sum(normalSum.x), sum(normalSum.y), sum(normalSum.z));
+	// if the axis is 0 then we have a invalid cluster
+	if (coneAxis == vec3(0, 0, 0))
+		validCluster = false;
+	else
+		coneAxis = normalize(coneAxis);
+
+	float t = -INFINITY;
+
+	// cant find a cluster for 2 sided objects
+	if (validCluster)
+	{
+		const SoaFloat3 axis = SoaFloat3::Load(Vector4(coneAxis.getX()), Vector4(coneAxis.getY()), Vector4(coneAxis.getZ()));
+		const SoaFloat3 centers = SoaFloat3::Load(Vector4(center.getX()), Vector4(center.getY()), Vector4(center.getZ()));
+		Vector4         tMax = Vector4(-INFINITY);
+		Vector4         directionalMin = Vector4::one();
+
+		// We need a second pass to find the intersection of the line center + t * coneAxis with the plane defined by each triangle
+		for (uint32_t group = 0; group < groupCount; ++group)
+		{
+			const Vector4Int mask = normalMasks[group];
+			const Vector4    directionalPart = selectPerElem(mask, -Dot(axis, normals[group]), Vector4::one());
+
+			if (MoveMask(cmpLe(directionalPart, Vector4::zero())))
+			{
+				// No solution for this cluster - at least two triangles are facing each other
+				validCluster = false;
+				break;
+			}
+
+			// We need to intersect the plane with our cone ray which is center + t * coneAxis, and find the max
+			// t along the cone ray (which points into the empty space) See: https://en.wikipedia.org/wiki/Line%E2%80%93plane_intersection
+			const Vector4 td = divPerElem(Dot(centers - firstVertices[group], normals[group]), -directionalPart);
+
+			tMax = maxPerElem(tMax, selectPerElem(mask, td, Vector4(-INFINITY)));
+			directionalMin = minPerElem(directionalMin, directionalPart);
+		}
+
+		t = maxElem(tMax);
+		coneOpening = minElem(directionalMin);
+	}
+
+	cluster->aabbMin = v3ToF3(aabbMin.getXYZ());
+	cluster->aabbMax = v3ToF3(aabbMax.getXYZ());
+
+	cluster->coneAngleCosine = sqrtf(1 - coneOpening * coneOpening);
+	cluster->coneCenter = v3ToF3(validCluster ? center + coneAxis * t : center);
+	cluster->coneAxis = v3ToF3(coneAxis);
+
+	//#if AMD_GEOMETRY_FX_ENABLE_CLUSTER_CENTER_SAFETY_CHECK
+	// If distance of coneCenter to the bounding box center is more than 16x the bounding box extent, the cluster is also invalid
+	// This is mostly a safety measure - if triangles are nearly parallel to coneAxis, t may become very large and unstable
+	if (validCluster)
+	{
+		const float aabbSize = length(aabbMax - aabbMin);
+		const float coneCenterToCenterDistance = length(f3Tov3(cluster->coneCenter) - center);
+
+		if (coneCenterToCenterDistance > (16 * aabbSize))
+			validCluster = false;
+	}
+	//#endif
+
+	cluster->valid = validCluster;
+}
+
+// Splits the triangles of a mesh into clusters of CLUSTER_SIZE consecutive triangles, the clusters are filled by computeCluster
+static void partitionClusters(MeshIn* mesh)
+{
+	const uint32_t triangleCount = mesh->indexCount / 3;
+
+	mesh->clusterCount = (triangleCount + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+	mesh->clusterCompacts = (ClusterCompact*)conf_calloc(mesh->clusterCount, sizeof(ClusterCompact));
+	mesh->clusters = (Cluster*)conf_calloc(mesh->clusterCount, sizeof(Cluster));
+
+	for (uint32_t i = 0; i < mesh->clusterCount; ++i)
+	{
+		mesh->clusterCompacts[i].clusterStart = i * CLUSTER_SIZE;
+		mesh->clusterCompacts[i].triangleCount = min<uint32_t>(CLUSTER_SIZE, triangleCount - i * CLUSTER_SIZE);
+	}
+}
+
+// Spreads the 10 low bits of v so there are two zero bits between them, for 3D Morton codes
+static inline uint32_t spreadBits10(uint32_t v)
+{
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// Splits the triangles of a mesh into meshlets. A meshlet grows over the triangles sharing a vertex with it, taking the
+// one that adds the fewest vertices, faces the most like the meshlet so far and is closest to its center. The next
+// meshlet starts next to the previous one, from the triangle with the fewest unassigned neighbours, so the meshlets
+// fill the mesh from its borders and leave few holes behind. When nothing connected is left, the meshlet continues with
+// a triangle close to it in Morton order. The triangles are reordered so every meshlet is a consecutive range of the mesh
+static void partitionMeshlets(Scene* pScene, MeshIn* mesh)
+{
+	// Score of a triangle that adds a vertex and of one a meshlet radius away from the center, relative to one facing the
+	// opposite way of the meshlet (2)
+	const float newVertexCost = 0.5f;
+	const float distanceCost = 1.0f;
+	// Triangles around the last one in Morton order searched when nothing connected is left
+	const uint32_t searchWindow = 128;
+
+	const uint32_t triangleCount = mesh->indexCount / 3;
+	uint32_t*      indices = pScene->indices + mesh->startIndex;
+
+	uint32_t firstVertex = UINT32_MAX;
+	uint32_t lastVertex = 0;
+	for (uint32_t i = 0; i < mesh->indexCount; ++i)
+	{
+		firstVertex = min(firstVertex, indices[i]);
+		lastVertex = max(lastVertex, indices[i]);
+	}
+	const uint32_t vertexCount = triangleCount ? lastVertex - firstVertex + 1 : 0;
+
+	// Triangles using each vertex
+	eastl::vector<uint32_t> vertexTriangleOffsets(vertexCount + 1, 0);
+	eastl::vector<uint32_t> vertexTriangles(mesh->indexCount);
+	for (uint32_t i = 0; i < mesh->indexCount; ++i)
+		++vertexTriangleOffsets[indices[i] - firstVertex + 1];
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		vertexTriangleOffsets[v + 1] += vertexTriangleOffsets[v];
+	// Unassigned triangles using each vertex
+	eastl::vector<uint32_t> vertexLiveTriangles(vertexCount, 0);
+	for (uint32_t i = 0; i < mesh->indexCount; ++i)
+	{
+		const uint32_t vertex = indices[i] - firstVertex;
+		vertexTriangles[vertexTriangleOffsets[vertex] + vertexLiveTriangles[vertex]++] = i / 3;
+	}
+
+	eastl::vector<float3> triangleNormals(triangleCount);
+	eastl::vector<float3> triangleCenters(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; ++i)
+	{
+		const vec3 v0 = makeVec3(pScene->positions[indices[i * 3]]);
+		const vec3 v1 = makeVec3(pScene->positions[indices[i * 3 + 1]]);
+		const vec3 v2 = makeVec3(pScene->positions[indices[i * 3 + 2]]);
+		vec3       normal = cross(v1 - v0, v2 - v0);
+		if (!(normal == vec3(0, 0, 0)))
+			normal = normalize(normal);
+		triangleNormals[i] = v3ToF3(normal);
+		triangleCenters[i] = v3ToF3((v0 + v1 + v2) / 3.0f);
+	}
+
+	// Triangles sorted by the Morton code of their center in the bounds of the mesh
+	vec3 centersMin = vec3(INFINITY, INFINITY, INFINITY);
+	vec3 centersMax = -centersMin;
+	for (uint32_t i = 0; i < triangleCount; ++i)
+	{
+		centersMin = minPerElem(centersMin, f3Tov3(triangleCenters[i]));
+		centersMax = maxPerElem(centersMax, f3Tov3(triangleCenters[i]));
+	}
+	const vec3 mortonScale = divPerElem(vec3(1023.0f), maxPerElem(centersMax - centersMin, vec3(FLT_MIN)));
+
+	eastl::vector<uint64_t> mortonKeys(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; ++i)
+	{
+		const vec3     cell = mulPerElem(f3Tov3(triangleCenters[i]) - centersMin, mortonScale);
+		const uint32_t code = spreadBits10((uint32_t)cell.getX()) | (spreadBits10((uint32_t)cell.getY()) << 1) |
+							  (spreadBits10((uint32_t)cell.getZ()) << 2);
+		mortonKeys[i] = ((uint64_t)code << 32) | i;
+	}
+	eastl::sort(mortonKeys.begin(), mortonKeys.end());
+
+	eastl::vector<uint32_t> mortonOrder(triangleCount);
+	eastl::vector<uint32_t> mortonRank(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; ++i)
+	{
+		mortonOrder[i] = (uint32_t)mortonKeys[i];
+		mortonRank[mortonOrder[i]] = i;
+	}
+
+	eastl::vector<ClusterCompact> compacts;
+	eastl::vector<uint32_t>       order;
+	eastl::vector<uint32_t>       candidates;
+	eastl::vector<uint8_t>        assigned(triangleCount, 0);
+	// Meshlet that last used each vertex, and that each triangle was last made a candidate of
+	eastl::vector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX);
+	eastl::vector<uint32_t> candidateMeshlet(triangleCount, UINT32_MAX);
+	order.reserve(triangleCount);
+
+	uint32_t nextSeed = 0;
+	uint32_t last = UINT32_MAX;
+	while (order.size() < triangleCount)
+	{
+		const uint32_t meshletIndex = (uint32_t)compacts.size();
+		ClusterCompact compact = { 0, (uint32_t)order.size() };
+		vec3           normalSum = vec3(0, 0, 0);
+		vec3           boundsMin = vec3(INFINITY, INFINITY, INFINITY);
+		vec3           boundsMax = -boundsMin;
+
+		// Start from the candidate of the previous meshlet with the fewest unassigned neighbours
+		uint32_t best = UINT32_MAX;
+		uint32_t bestLive = UINT32_MAX;
+		for (uint32_t i = 0; i < (uint32_t)candidates.size(); ++i)
+		{
+			const uint32_t candidate = candidates[i];
+			if (assigned[candidate])
+				continue;
+
+			uint32_t live = 0;
+			for (uint32_t j = 0; j < 3; ++j)
+				live += vertexLiveTriangles[indices[candidate * 3 + j] - firstVertex];
+			if (live < bestLive)
+			{
+				bestLive = live;
+				best = candidate;
+			}
+		}
+		candidates.clear();
+
+		while (compact.triangleCount < CLUSTER_SIZE && order.size() < triangleCount)
+		{
+			if (compact.triangleCount)
+			{
+				const vec3  axis = normalSum == vec3(0, 0, 0) ? normalSum : normalize(normalSum);
+				const vec3  center = (boundsMin + boundsMax) * 0.5f;
+				const float invRadius = 2.0f / max((float)length(boundsMax - boundsMin), FLT_MIN);
+
+				float bestScore = FLT_MAX;
+				for (uint32_t i = 0; i < (uint32_t)candidates.size();)
+				{
+					const uint32_t candidate = candidates[i];
+					if (assigned[candidate])
+					{
+						candidates[i] = candidates.back();
+						candidates.pop_back();
+						continue;
+					}
+
+					uint32_t newVertices = 0;
+					for (uint32_t j = 0; j < 3; ++j)
+						newVertices += vertexMeshlet[indices[candidate * 3 + j] - firstVertex] != meshletIndex;
+
+					const float score = newVertices * newVertexCost + (1.0f - dot(f3Tov3(triangleNormals[candidate]), axis)) +
+										length(f3Tov3(triangleCenters[candidate]) - center) * invRadius * distanceCost;
+					if (score < bestScore)
+					{
+						bestScore = score;
+						best = candidate;
+					}
+					++i;
+				}
+			}
+
+			// Nothing connected is left. A meshlet that is half full ends here, a smaller one continues with the triangle
+			// closest to it among the neighbours of the last one in Morton order, so meshes made of many small pieces do
+			// not end up with tiny clusters
+			if (best == UINT32_MAX && compact.triangleCount)
+			{
+				if (compact.triangleCount >= CLUSTER_SIZE / 2)
+					break;
+
+				const vec3     center = (boundsMin + boundsMax) * 0.5f;
+				const uint32_t rank = mortonRank[last];
+				const uint32_t searchEnd = min(rank + searchWindow + 1, triangleCount);
+				float          bestDistance = FLT_MAX;
+				for (uint32_t i = rank > searchWindow ? rank - searchWindow : 0; i < searchEnd; ++i)
+				{
+					const uint32_t triangle = mortonOrder[i];
+					const float    distance = lengthSqr(f3Tov3(triangleCenters[triangle]) - center);
+					if (!assigned[triangle] && distance < bestDistance)
+					{
+						bestDistance = distance;
+						best = triangle;
+					}
+				}
+			}
+
+			// Otherwise start over from the first unassigned triangle in Morton order
+			if (best == UINT32_MAX)
+			{
+				while (assigned[mortonOrder[nextSeed]])
+					++nextSeed;
+				best = mortonOrder[nextSeed];
+			}
+
+			assigned[best] = 1;
+			order.push_back(best);
+			last = best;
+			normalSum += f3Tov3(triangleNormals[best]);
+			++compact.triangleCount;
+
+			for (uint32_t j = 0; j < 3; ++j)
+			{
+				const uint32_t vertex = indices[best * 3 + j] - firstVertex;
+				const vec3     position = makeVec3(pScene->positions[indices[best * 3 + j]]);
+				boundsMin = minPerElem(boundsMin, position);
+				boundsMax = maxPerElem(boundsMax, position);
+				vertexMeshlet[vertex] = meshletIndex;
+				--vertexLiveTriangles[vertex];
+				for (uint32_t k = vertexTriangleOffsets[vertex]; k < vertexTriangleOffsets[vertex + 1]; ++k)
+				{
+					const uint32_t triangle = vertexTriangles[k];
+					if (!assigned[triangle] && candidateMeshlet[triangle] != meshletIndex)
+					{
+						candidateMeshlet[triangle] = meshletIndex;
+						candidates.push_back(triangle);
+					}
+				}
+			}
+
+			best = UINT32_MAX;
+		}
+
+		compacts.push_back(compact);
+	}
+
+	eastl::vector<uint32_t> sourceIndices(indices, indices + mesh->indexCount);
+	for (uint32_t i = 0; i < triangleCount; ++i)
+	{
+		for (uint32_t j = 0; j < 3; ++j)
+			indices[i * 3 + j] = sourceIndices[order[i] * 3 + j];
+	}
+
+	mesh->clusterCount = (uint32_t)compacts.size();
+	mesh->clusterCompacts = (ClusterCompact*)conf_malloc(mesh->clusterCount * sizeof(ClusterCompact));
+	mesh->clusters = (Cluster*)conf_calloc(mesh->clusterCount, sizeof(Cluster));
+	memcpy(mesh->clusterCompacts, compacts.data(), mesh->clusterCount * sizeof(ClusterCompact));
+}
+#endif
+
 // Compute an array of clusters from the mesh vertices. Clusters are sub batches of the original mesh limited in number
 // for more efficient CPU / GPU culling. CPU culling operates per cluster, while GPU culling operates per triangle for
 // all the clusters that passed the CPU test.
@@ -1844,137 +2336,706 @@ void createClusters(bool twoSided, const Scene* pScene, MeshIn* mesh)
 		mesh->clusters[i].valid = validCluster;
 	}
 #else
-	// 12 KiB stack space
-	struct Triangle
+	partitionClusters(mesh);
+	for (uint32_t i = 0; i < mesh->clusterCount; ++i)
+		computeCluster(twoSided, pScene, mesh, mesh->clusterCompacts + i, mesh->clusters + i);
+#endif
+}
+
+// Clusters are computed in chunks spanning the meshes, so a few large meshes do not end up on a single thread
+#define CLUSTER_CHUNK_SIZE 64
+
+typedef struct ClusterTaskData
+{
+	Scene*      pScene;
+	ClusterMode mMode;
+	uint32_t*   pMeshClusterStarts;    // First cluster of every mesh in the clusters of the scene, followed by their count
+	uint32_t    mClusterCount;
+} ClusterTaskData;
+
+static void partitionClustersTask(void* pUserData, uintptr_t meshIndex)
+{
+	ClusterTaskData* pData = (ClusterTaskData*)pUserData;
+	MeshIn*          mesh = pData->pScene->meshes + meshIndex;
+#if defined(METAL)
+	createClusters(pData->pScene->materials[mesh->materialId].twoSided, pData->pScene, mesh);
+#else
+	if (pData->mMode == CLUSTER_MODE_MESHLET)
+		partitionMeshlets(pData->pScene, mesh);
+	else
+		partitionClusters(mesh);
+#endif
+}
+
+#if !defined(METAL)
+static void computeClustersTask(void* pUserData, uintptr_t chunkIndex)
+{
+	ClusterTaskData* pData = (ClusterTaskData*)pUserData;
+	const Scene*     pScene = pData->pScene;
+	const uint32_t   chunkStart = (uint32_t)chunkIndex * CLUSTER_CHUNK_SIZE;
+	const uint32_t   chunkEnd = min<uint32_t>(chunkStart + CLUSTER_CHUNK_SIZE, pData->mClusterCount);
+
+	// Last mesh starting at or before the chunk
+	const uint32_t* pMeshStart =
+		eastl::upper_bound(pData->pMeshClusterStarts, pData->pMeshClusterStarts + pScene->numMeshes, chunkStart) - 1;
+	uint32_t meshIndex = (uint32_t)(pMeshStart - pData->pMeshClusterStarts);
+
+	for (uint32_t i = chunkStart; i < chunkEnd; ++i)
 	{
-		vec3 vtx[3];
-	};
+		while (i >= pData->pMeshClusterStarts[meshIndex + 1])
+			++meshIndex;
 
-	Triangle triangleCache[CLUSTER_SIZE * 3];
+		const MeshIn*  mesh = pScene->meshes + meshIndex;
+		const uint32_t clusterIndex = i - pData->pMeshClusterStarts[meshIndex];
+		computeCluster(
+			pScene->materials[mesh->materialId].twoSided, pScene, mesh, mesh->clusterCompacts + clusterIndex, mesh->clusters + clusterIndex);
+	}
+}
+#endif
 
-	const int triangleCount = mesh->indexCount / 3;
-	const int clusterCount = (triangleCount + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+void createSceneClusters(Scene* pScene, ClusterMode mode, ThreadSystem* pThreadSystem)
+{
+	ClusterTaskData data = { pScene, mode, NULL, 0 };
 
-	mesh->clusterCount = clusterCount;
-	mesh->clusterCompacts = (ClusterCompact*)conf_calloc(mesh->clusterCount, sizeof(ClusterCompact));
-	mesh->clusters = (Cluster*)conf_calloc(mesh->clusterCount, sizeof(Cluster));
+	// Split the meshes into clusters. On Metal this computes them as well
+	if (pThreadSystem)
+	{
+		addThreadSystemRangeTask(pThreadSystem, partitionClustersTask, &data, pScene->numMeshes);
+		waitThreadSystemIdle(pThreadSystem);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < pScene->numMeshes; ++i)
+			partitionClustersTask(&data, i);
+	}
 
-	for (int i = 0; i < clusterCount; ++i)
+#if !defined(METAL)
+	data.pMeshClusterStarts = (uint32_t*)conf_malloc((pScene->numMeshes + 1) * sizeof(uint32_t));
+	for (uint32_t i = 0; i < pScene->numMeshes; ++i)
 	{
-		const int clusterStart = i * CLUSTER_SIZE;
-		const int clusterEnd = min(clusterStart + CLUSTER_SIZE, triangleCount);
+		data.pMeshClusterStarts[i] = data.mClusterCount;
+		data.mClusterCount += pScene->meshes[i].clusterCount;
+	}
+	data.pMeshClusterStarts[pScene->numMeshes] = data.mClusterCount;
 
-		const int clusterTriangleCount = clusterEnd - clusterStart;
+	// Every cluster is written by one task only, so the result does not depend on the number of threads
+	const uint32_t chunkCount = (data.mClusterCount + CLUSTER_CHUNK_SIZE - 1) / CLUSTER_CHUNK_SIZE;
+	if (pThreadSystem)
+	{
+		addThreadSystemRangeTask(pThreadSystem, computeClustersTask, &data, chunkCount);
+		waitThreadSystemIdle(pThreadSystem);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < chunkCount; ++i)
+			computeClustersTask(&data, i);
+	}
 
-		// Load all triangles into our local cache
-		for (int triangleIndex = clusterStart; triangleIndex < clusterEnd; ++triangleIndex)
+	conf_free(data.pMeshClusterStarts);
+#endif
+}
+
+void destroyClusters(const Scene* pScene, MeshIn* pMesh)
+{
+	// Clusters of a baked scene are part of its mapping
+	if (pScene->bakedData)
+		return;
+
+	// Destroy clusters
+	conf_free(pMesh->clusters);
+	conf_free(pMesh->clusterCompacts);
+}
+
+void createClusterCullGroups(Scene* pScene)
+{
+	pScene->numClusterGroups = 0;
+	for (uint32_t i = 0; i < pScene->numMeshes; ++i)
+	{
+		pScene->meshes[i].clusterGroupStart = pScene->numClusterGroups;
+		pScene->numClusterGroups += (pScene->meshes[i].clusterCount + 3) / 4;
+	}
+
+	pScene->clusterGroups =
+		(ClusterCullGroup*)conf_memalign(alignof(ClusterCullGroup), pScene->numClusterGroups * sizeof(ClusterCullGroup));
+
+	for (uint32_t i = 0; i < pScene->numMeshes; ++i)
+	{
+		const MeshIn* mesh = pScene->meshes + i;
+		for (uint32_t j = 0; j < mesh->clusterCount; j += 4)
 		{
-			triangleCache[triangleIndex - clusterStart].vtx[0] =
-				makeVec3(pScene->positions[pScene->indices[mesh->startIndex + triangleIndex * 3]]);
-			triangleCache[triangleIndex - clusterStart].vtx[1] =
-				makeVec3(pScene->positions[pScene->indices[mesh->startIndex + triangleIndex * 3 + 1]]);
-			triangleCache[triangleIndex - clusterStart].vtx[2] =
-				makeVec3(pScene->positions[pScene->indices[mesh->startIndex + triangleIndex * 3 + 2]]);
+			float data[13][4];
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				const Cluster* cluster = mesh->clusters + min(j + lane, mesh->clusterCount - 1);
+				data[0][lane] = cluster->aabbMin.x;
+				data[1][lane] = cluster->aabbMin.y;
+				data[2][lane] = cluster->aabbMin.z;
+				data[3][lane] = cluster->aabbMax.x;
+				data[4][lane] = cluster->aabbMax.y;
+				data[5][lane] = cluster->aabbMax.z;
+				data[6][lane] = cluster->coneCenter.x;
+				data[7][lane] = cluster->coneCenter.y;
+				data[8][lane] = cluster->coneCenter.z;
+				data[9][lane] = cluster->coneAxis.x;
+				data[10][lane] = cluster->coneAxis.y;
+				data[11][lane] = cluster->coneAxis.z;
+				data[12][lane] = cluster->valid ? cluster->coneAngleCosine : INFINITY;
+			}
+
+			ClusterCullGroup* group = pScene->clusterGroups + mesh->clusterGroupStart + j / 4;
+			group->aabbMinX = Vector4(data[0][0], data[0][1], data[0][2], data[0][3]);
+			group->aabbMinY = Vector4(data[1][0], data[1][1], data[1][2], data[1][3]);
+			group->aabbMinZ = Vector4(data[2][0], data[2][1], data[2][2], data[2][3]);
+			group->aabbMaxX = Vector4(data[3][0], data[3][1], data[3][2], data[3][3]);
+			group->aabbMaxY = Vector4(data[4][0], data[4][1], data[4][2], data[4][3]);
+			group->aabbMaxZ = Vector4(data[5][0], data[5][1], data[5][2], data[5][3]);
+			group->coneCenterX = Vector4(data[6][0], data[6][1], data[6][2], data[6][3]);
+			group->coneCenterY = Vector4(data[7][0], data[7][1], data[7][2], data[7][3]);
+			group->coneCenterZ = Vector4(data[8][0], data[8][1], data[8][2], data[8][3]);
+			group->coneAxisX = Vector4(data[9][0], data[9][1], data[9][2], data[9][3]);
+			group->coneAxisY = Vector4(data[10][0], data[10][1], data[10][2], data[10][3]);
+			group->coneAxisZ = Vector4(data[11][0], data[11][1], data[11][2], data[11][3]);
+			group->coneAngleCosine = Vector4(data[12][0], data[12][1], data[12][2], data[12][3]);
+			group->clusterCount = min(mesh->clusterCount - j, 4u);
 		}
+	}
+}
 
-		vec3 aabbMin = vec3(INFINITY, INFINITY, INFINITY);
-		vec3 aabbMax = -aabbMin;
+void destroyClusterCullGroups(Scene* pScene)
+{
+	conf_free(pScene->clusterGroups);
+	pScene->clusterGroups = NULL;
+	pScene->numClusterGroups = 0;
+}
 
-		vec3 coneAxis = vec3(0, 0, 0);
+void createSceneOccluders(Scene* pScene, uint32_t maxTriangles)
+{
+	// Twice the squared area of every candidate in the upper half, positive floats sort like their bits, and the first
+	// entry of the triangle in the indices, or in the vertices on Metal, in the lower half
+	eastl::vector<uint64_t> candidates;
+	for (uint32_t i = 0; i < pScene->numMeshes; ++i)
+	{
+		const MeshIn* mesh = pScene->meshes + i;
+		if (pScene->materials[mesh->materialId].alphaTested)
+			continue;
 
-		for (int triangleIndex = 0; triangleIndex < clusterTriangleCount; ++triangleIndex)
+#if defined(METAL)
+		const uint32_t first = mesh->startVertex;
+		const uint32_t triangleCount = mesh->triangleCount;
+#else
+		const uint32_t first = mesh->startIndex;
+		const uint32_t triangleCount = mesh->indexCount / 3;
+#endif
+		for (uint32_t t = 0; t < triangleCount; ++t)
 		{
-			const auto& triangle = triangleCache[triangleIndex];
-			for (int j = 0; j < 3; ++j)
+			vec3 vertices[3];
+			for (uint32_t j = 0; j < 3; ++j)
 			{
-				aabbMin = minPerElem(aabbMin, triangle.vtx[j]);
-				aabbMax = maxPerElem(aabbMax, triangle.vtx[j]);
+#if defined(METAL)
+				vertices[j] = makeVec3(pScene->positions[first + t * 3 + j]);
+#else
+				vertices[j] = makeVec3(pScene->positions[pScene->indices[first + t * 3 + j]]);
+#endif
 			}
 
-			vec3 triangleNormal = cross(triangle.vtx[1] - triangle.vtx[0], triangle.vtx[2] - triangle.vtx[0]);
+			const float area = lengthSqr(cross(vertices[1] - vertices[0], vertices[2] - vertices[0]));
+			if (!(area > 0.0f))
+				continue;
 
-			if (!(triangleNormal == vec3(0, 0, 0)))
-				triangleNormal = normalize(triangleNormal);
+			uint32_t areaBits;
+			memcpy(&areaBits, &area, sizeof(areaBits));
+			candidates.push_back(((uint64_t)areaBits << 32) | (first + t * 3));
+		}
+	}
 
-			//coneAxis = DirectX::XMVectorAdd(coneAxis, DirectX::XMVectorNegate(triangleNormal));
-			coneAxis = coneAxis - triangleNormal;
+	if (candidates.size() > maxTriangles)
+	{
+		eastl::nth_element(candidates.begin(), candidates.begin() + maxTriangles, candidates.end(), eastl::greater<uint64_t>());
+		candidates.resize(maxTriangles);
+	}
+	// Back in the order of the scene, which walks the vertices in order
+	eastl::sort(candidates.begin(), candidates.end(), [](uint64_t a, uint64_t b) { return (a & 0xffffffff) < (b & 0xffffffff); });
+
+	// First entry of every mesh with triangles in the upper half and its index in the lower half, in the same order, so the
+	// mesh of each occluder is the last one starting at or before it
+	eastl::vector<uint64_t> meshStarts;
+	for (uint32_t i = 0; i < pScene->numMeshes; ++i)
+	{
+#if defined(METAL)
+		if (pScene->meshes[i].triangleCount)
+			meshStarts.push_back(((uint64_t)pScene->meshes[i].startVertex << 32) | i);
+#else
+		if (pScene->meshes[i].indexCount)
+			meshStarts.push_back(((uint64_t)pScene->meshes[i].startIndex << 32) | i);
+#endif
+	}
+	eastl::sort(meshStarts.begin(), meshStarts.end());
+
+	pScene->numOccluders = (uint32_t)candidates.size();
+	pScene->occluders = (SceneVertexPos*)conf_malloc(pScene->numOccluders * 3 * sizeof(SceneVertexPos));
+	pScene->occluderTwoSided = (bool*)conf_malloc(pScene->numOccluders * sizeof(bool));
+	uint32_t meshSlot = 0;
+	for (uint32_t i = 0; i < pScene->numOccluders; ++i)
+	{
+		const uint32_t first = (uint32_t)(candidates[i] & 0xffffffff);
+		while (meshSlot + 1 < (uint32_t)meshStarts.size() && (meshStarts[meshSlot + 1] >> 32) <= first)
+			++meshSlot;
+		const uint32_t materialId = pScene->meshes[meshStarts[meshSlot] & 0xffffffff].materialId;
+		pScene->occluderTwoSided[i] = pScene->materials[materialId].twoSided;
+
+		for (uint32_t j = 0; j < 3; ++j)
+		{
+#if defined(METAL)
+			pScene->occluders[i * 3 + j] = pScene->positions[first + j];
+#else
+			pScene->occluders[i * 3 + j] = pScene->positions[pScene->indices[first + j]];
+#endif
 		}
+	}
+}
 
-		// This is the cosine of the cone opening angle - 1 means it's 0?,
-		// we're minimizing this value (at 0, it would mean the cone is 90?
-		// open)
-		float coneOpening = 1;
-		// dont cull two sided meshes
-		bool validCluster = !twoSided;
+void destroySceneOccluders(Scene* pScene)
+{
+	conf_free(pScene->occluders);
+	conf_free(pScene->occluderTwoSided);
+	pScene->occluders = NULL;
+	pScene->occluderTwoSided = NULL;
+	pScene->numOccluders = 0;
+}
 
-		const vec3 center = (aabbMin + aabbMax) / 2;
-		// if the axis is 0 then we have a invalid cluster
-		if (coneAxis == vec3(0, 0, 0))
-			validCluster = false;
+void createOcclusionBuffer(OcclusionBuffer* pBuffer, uint32_t width, uint32_t height)
+{
+	*pBuffer = {};
+	pBuffer->width = (width + 3) & ~3u;
+	pBuffer->height = height;
 
-		coneAxis = normalize(coneAxis);
+	uint32_t levelWidth = pBuffer->width;
+	uint32_t levelHeight = pBuffer->height;
+	while (pBuffer->levelCount < OCCLUSION_BUFFER_MAX_LEVELS)
+	{
+		pBuffer->levelWidths[pBuffer->levelCount] = levelWidth;
+		pBuffer->levelHeights[pBuffer->levelCount] = levelHeight;
+		pBuffer->levels[pBuffer->levelCount] = (float*)conf_malloc(levelWidth * levelHeight * sizeof(float));
+		++pBuffer->levelCount;
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+		levelWidth = max(1u, (levelWidth + 1) / 2);
+		levelHeight = max(1u, (levelHeight + 1) / 2);
+	}
+}
 
-		float t = -INFINITY;
+void destroyOcclusionBuffer(OcclusionBuffer* pBuffer)
+{
+	for (uint32_t i = 0; i < pBuffer->levelCount; ++i)
+		conf_free(pBuffer->levels[i]);
+	*pBuffer = {};
+}
 
-		// cant find a cluster for 2 sided objects
-		if (validCluster)
+// Writes the triangle to the texels it covers completely, four texels of a row at a time. Only a complete cover makes the
+// texel hide what is behind it, and the depth written is the farthest of the triangle over the texel, so a texel never
+// ends up closer than the occluders in it. x and y are in texels, z is z / w
+static void rasterizeOccluder(OcclusionBuffer* pBuffer, const float* x, const float* y, const float* z, bool twoSided)
+{
+	// Twice the signed area. A triangle smaller than a texel can not cover one
+	const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (fabsf(area) < 1.0f)
+		return;
+	// The triangle filter culls the triangles whose clip space determinant is positive. With y pointing down in the buffer
+	// those have a negative area here
+	if (!twoSided && area < 0.0f)
+		return;
+
+	// Ordered so the edge functions are positive inside
+	const uint32_t i1 = area > 0.0f ? 1 : 2;
+	const uint32_t i2 = area > 0.0f ? 2 : 1;
+	const float    vx[3] = { x[0], x[i1], x[i2] };
+	const float    vy[3] = { y[0], y[i1], y[i2] };
+
+	const int startX = max(0, (int)ceilf(min(min(vx[0], vx[1]), vx[2])));
+	const int endX = min((int)pBuffer->width - 1, (int)floorf(max(max(vx[0], vx[1]), vx[2])) - 1);
+	const int startY = max(0, (int)ceilf(min(min(vy[0], vy[1]), vy[2])));
+	const int endY = min((int)pBuffer->height - 1, (int)floorf(max(max(vy[0], vy[1]), vy[2])) - 1);
+	if (startX > endX || startY > endY)
+		return;
+
+	// e = a * x + b * y + c, evaluated at the texel centers. A texel is inside an edge when its center is at least half the
+	// change of e over a texel inside
+	float a[3], b[3], c[3];
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		const uint32_t j = (i + 1) % 3;
+		a[i] = vy[i] - vy[j];
+		b[i] = vx[j] - vx[i];
+		c[i] = -a[i] * vx[i] - b[i] * vy[i] - 0.5f * (fabsf(a[i]) + fabsf(b[i]));
+	}
+
+	// z / w is linear in screen space, the farthest depth over a texel is half its change further than at the center
+	const float dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+	const float dzdy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+	const float dzc = z[0] - dzdx * x[0] - dzdy * y[0] + 0.5f * (fabsf(dzdx) + fabsf(dzdy));
+
+	const Vector4 laneOffsets(0.5f, 1.5f, 2.5f, 3.5f);
+	const int     alignedStartX = startX & ~3;
+	for (int row = startY; row <= endY; ++row)
+	{
+		const float centerY = row + 0.5f;
+		float*      pRow = pBuffer->levels[0] + row * pBuffer->width;
+		for (int column = alignedStartX; column <= endX; column += 4)
 		{
-			// We nee a second pass to find the intersection of the line center + t * coneAxis with the plane defined by each triangle
-			for (int triangleIndex = 0; triangleIndex < clusterTriangleCount; ++triangleIndex)
+			const Vector4    centerX = Vector4((float)column) + laneOffsets;
+			const Vector4Int inside =
+				And(And(cmpGe(centerX * a[0] + Vector4(b[0] * centerY + c[0]), Vector4(0.0f)),
+						cmpGe(centerX * a[1] + Vector4(b[1] * centerY + c[1]), Vector4(0.0f))),
+					cmpGe(centerX * a[2] + Vector4(b[2] * centerY + c[2]), Vector4(0.0f)));
+			if (!MoveMask(inside))
+				continue;
+
+			const Vector4 depth = centerX * dzdx + Vector4(dzdy * centerY + dzc);
+			const Vector4 current(pRow[column], pRow[column + 1], pRow[column + 2], pRow[column + 3]);
+			storePtrU(selectPerElem(inside, minPerElem(current, depth), current), pRow + column);
+		}
+	}
+}
+
+void renderOcclusionBuffer(
+	OcclusionBuffer* pBuffer, const mat4& mvp, const SceneVertexPos* pTriangles, const bool* pTwoSided, uint32_t triangleCount)
+{
+	pBuffer->mvp = mvp;
+
+	float* pDepth = pBuffer->levels[0];
+	for (uint32_t i = 0; i < pBuffer->width * pBuffer->height; ++i)
+		pDepth[i] = 1.0f;
+
+	const float halfWidth = 0.5f * pBuffer->width;
+	const float halfHeight = 0.5f * pBuffer->height;
+	for (uint32_t i = 0; i < triangleCount; ++i)
+	{
+		float x[3], y[3], z[3];
+		bool  inFront = true;
+		for (uint32_t j = 0; j < 3 && inFront; ++j)
+		{
+			const SceneVertexPos& pos = pTriangles[i * 3 + j];
+			const vec4            clip = mvp * vec4(pos.x, pos.y, pos.z, 1.0f);
+			// There is no clipping, a triangle has to be in front of the near plane as a whole
+			inFront = clip.getZ() >= 0.0f && clip.getW() > 0.0f;
+			const float invW = 1.0f / clip.getW();
+			x[j] = (clip.getX() * invW + 1.0f) * halfWidth;
+			y[j] = (1.0f - clip.getY() * invW) * halfHeight;
+			z[j] = clip.getZ() * invW;
+		}
+
+		if (inFront)
+			rasterizeOccluder(pBuffer, x, y, z, !pTwoSided || pTwoSided[i]);
+	}
+
+	// Texels on the odd edge of a level only have the texels of the level below they cover
+	for (uint32_t level = 1; level < pBuffer->levelCount; ++level)
+	{
+		const float*   pSource = pBuffer->levels[level - 1];
+		float*         pTarget = pBuffer->levels[level];
+		const uint32_t sourceWidth = pBuffer->levelWidths[level - 1];
+		const uint32_t sourceHeight = pBuffer->levelHeights[level - 1];
+		for (uint32_t row = 0; row < pBuffer->levelHeights[level]; ++row)
+		{
+			const float* pRow0 = pSource + (row * 2) * sourceWidth;
+			const float* pRow1 = pSource + min(row * 2 + 1, sourceHeight - 1) * sourceWidth;
+			for (uint32_t column = 0; column < pBuffer->levelWidths[level]; ++column)
 			{
-				const Triangle& triangle = triangleCache[triangleIndex];
-				// Compute the triangle plane from the three vertices
+				const uint32_t column0 = column * 2;
+				const uint32_t column1 = min(column * 2 + 1, sourceWidth - 1);
+				pTarget[row * pBuffer->levelWidths[level] + column] =
+					max(max(pRow0[column0], pRow0[column1]), max(pRow1[column0], pRow1[column1]));
+			}
+		}
+	}
+}
 
-				const vec3 triangleNormal = normalize(cross(triangle.vtx[1] - triangle.vtx[0], triangle.vtx[2] - triangle.vtx[0]));
+// Returns the lanes of the group whose bounds are behind the occluders. The screen rectangle of the bounds is tested on the
+// level of the pyramid where it spans at most 2x2 texels, against the closest depth of its corners. Bounds that cross the
+// near plane or are outside the buffer are never occluded
+static Vector4Int occludedClusters(const OcclusionBuffer* pBuffer, const ClusterCullGroup& group)
+{
+	const vec4 row0 = pBuffer->mvp.getRow(0);
+	const vec4 row1 = pBuffer->mvp.getRow(1);
+	const vec4 row2 = pBuffer->mvp.getRow(2);
+	const vec4 row3 = pBuffer->mvp.getRow(3);
+
+	Vector4    minX(INFINITY), maxX(-INFINITY), minY(INFINITY), maxY(-INFINITY), minDepth(INFINITY);
+	Vector4Int crossesNear = vector4int::all_false();
+	for (uint32_t corner = 0; corner < 8; ++corner)
+	{
+		const Vector4& x = (corner & 1) ? group.aabbMaxX : group.aabbMinX;
+		const Vector4& y = (corner & 2) ? group.aabbMaxY : group.aabbMinY;
+		const Vector4& z = (corner & 4) ? group.aabbMaxZ : group.aabbMinZ;
+		const Vector4  clipX = x * row0.getX() + y * row0.getY() + z * row0.getZ() + Vector4(row0.getW());
+		const Vector4  clipY = x * row1.getX() + y * row1.getY() + z * row1.getZ() + Vector4(row1.getW());
+		const Vector4  clipZ = x * row2.getX() + y * row2.getY() + z * row2.getZ() + Vector4(row2.getW());
+		const Vector4  clipW = x * row3.getX() + y * row3.getY() + z * row3.getZ() + Vector4(row3.getW());
+		crossesNear = Or(crossesNear, Or(cmpLt(clipZ, Vector4(0.0f)), cmpLe(clipW, Vector4(0.0f))));
+
+		const Vector4 invW = divPerElem(Vector4(1.0f), clipW);
+		const Vector4 screenX = mulPerElem(clipX, invW);
+		const Vector4 screenY = mulPerElem(clipY, invW);
+		minX = minPerElem(minX, screenX);
+		maxX = maxPerElem(maxX, screenX);
+		minY = minPerElem(minY, screenY);
+		maxY = maxPerElem(maxY, screenY);
+		minDepth = minPerElem(minDepth, mulPerElem(clipZ, invW));
+	}
 
-				const float directionalPart = dot(coneAxis, -triangleNormal);
+	const float halfWidth = 0.5f * pBuffer->width;
+	const float halfHeight = 0.5f * pBuffer->height;
+	const int   nearMask = MoveMask(crossesNear);
+	bool        occluded[4] = {};
+	for (uint32_t lane = 0; lane < group.clusterCount; ++lane)
+	{
+		if ((nearMask >> lane) & 1)
+			continue;
+
+		// Texels the rectangle touches, the top row of the buffer is at the top of the view
+		const float left = (minX.getElem(lane) + 1.0f) * halfWidth;
+		const float right = (maxX.getElem(lane) + 1.0f) * halfWidth;
+		const float top = (1.0f - maxY.getElem(lane)) * halfHeight;
+		const float bottom = (1.0f - minY.getElem(lane)) * halfHeight;
+		if (!(right >= 0.0f && bottom >= 0.0f && left < (float)pBuffer->width && top < (float)pBuffer->height))
+			continue;
+
+		// The parts outside the buffer are outside the frustum as well
+		uint32_t startX = (uint32_t)max(left, 0.0f), endX = (uint32_t)min(right, (float)(pBuffer->width - 1));
+		uint32_t startY = (uint32_t)max(top, 0.0f), endY = (uint32_t)min(bottom, (float)(pBuffer->height - 1));
+		uint32_t level = 0;
+		while (level + 1 < pBuffer->levelCount && (endX - startX > 1 || endY - startY > 1))
+		{
+			startX >>= 1;
+			endX >>= 1;
+			startY >>= 1;
+			endY >>= 1;
+			++level;
+		}
 
-				if (directionalPart <= 0)    //AMD BUG?: changed to <= 0 because directionalPart is used to divide a quantity
-				{
-					// No solution for this cluster - at least two triangles are facing each other
-					validCluster = false;
-					break;
-				}
+		const float*   pLevel = pBuffer->levels[level];
+		const uint32_t levelWidth = pBuffer->levelWidths[level];
+		const float    farthest = max(
+			   max(pLevel[startY * levelWidth + startX], pLevel[startY * levelWidth + endX]),
+			   max(pLevel[endY * levelWidth + startX], pLevel[endY * levelWidth + endX]));
+		occluded[lane] = minDepth.getElem(lane) > farthest;
+	}
 
-				// We need to intersect the plane with our cone ray which is center + t * coneAxis, and find the max
-				// t along the cone ray (which points into the empty space) See: https://en.wikipedia.org/wiki/Line%E2%80%93plane_intersection
-				const float td = dot(center - triangle.vtx[0], triangleNormal) / -directionalPart;
+	return vector4int::Load(occluded[0], occluded[1], occluded[2], occluded[3]);
+}
 
-				t = max(t, td);
+// Gribb and Hartmann, with the clip space of the projection matrices of the Sony math library: -w <= x, y <= w and
+// 0 <= z <= w. The planes are not normalized, culling only needs the sign of the distance
+void setClusterCullView(ClusterCullView* pView, const mat4& mvp, const vec3& eye, const OcclusionBuffer* pOcclusionBuffer)
+{
+	const vec4 row0 = mvp.getRow(0);
+	const vec4 row1 = mvp.getRow(1);
+	const vec4 row2 = mvp.getRow(2);
+	const vec4 row3 = mvp.getRow(3);
+	pView->planes[0] = row3 + row0;
+	pView->planes[1] = row3 - row0;
+	pView->planes[2] = row3 + row1;
+	pView->planes[3] = row3 - row1;
+	pView->planes[4] = row2;
+	pView->planes[5] = row3 - row2;
+	pView->eye = eye;
+	pView->pOcclusionBuffer = pOcclusionBuffer;
+}
 
-				coneOpening = min(coneOpening, directionalPart);
+static inline uint32_t laneCount(int mask) { return ((mask >> 0) & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1); }
+
+// A cluster is culled when, for every view, its bounds are outside the frustum, the eye is inside its cone, where it
+// sees only the back of its triangles, or the bounds are behind the occluders of the view.
+// The bounds are outside when the corner furthest along the normal of a plane is behind it. Instead of normalizing the
+// direction to the eye for the cone test, the cosine is scaled by its length
+void cullClusterGroups(
+	const ClusterCullGroup* pGroups, uint32_t groupCount, const ClusterCullView* pViews, uint32_t viewCount,
+	uint8_t* pVisibility, uint32_t* pCulledCounts)
+{
+	uint32_t frustumCulledCount = 0;
+	uint32_t facingAwayCount = 0;
+	uint32_t culledCount = 0;
+	for (uint32_t i = 0; i < groupCount; ++i)
+	{
+		const ClusterCullGroup& group = pGroups[i];
+		const SoaFloat3         center = SoaFloat3::Load(group.coneCenterX, group.coneCenterY, group.coneCenterZ);
+		const SoaFloat3         axis = SoaFloat3::Load(group.coneAxisX, group.coneAxisY, group.coneAxisZ);
+
+		const int  laneMask = (1 << group.clusterCount) - 1;
+		Vector4Int frustumCulled = vector4int::all_true();
+		Vector4Int facingAway = vector4int::all_true();
+		Vector4Int culled = vector4int::all_true();
+		for (uint32_t view = 0; view < viewCount; ++view)
+		{
+			const ClusterCullView& cullView = pViews[view];
+
+			Vector4Int outside = vector4int::all_false();
+			for (uint32_t p = 0; p < 6; ++p)
+			{
+				const vec4&   plane = cullView.planes[p];
+				const Vector4 x = plane.getX() > 0.0f ? group.aabbMaxX : group.aabbMinX;
+				const Vector4 y = plane.getY() > 0.0f ? group.aabbMaxY : group.aabbMinY;
+				const Vector4 z = plane.getZ() > 0.0f ? group.aabbMaxZ : group.aabbMinZ;
+				const Vector4 distance = x * plane.getX() + y * plane.getY() + z * plane.getZ() + Vector4(plane.getW());
+				outside = Or(outside, cmpLt(distance, Vector4(0.0f)));
 			}
+
+			const SoaFloat3 toEye = SoaFloat3::Load(
+										Vector4(cullView.eye.getX()), Vector4(cullView.eye.getY()), Vector4(cullView.eye.getZ())) -
+									center;
+			const Vector4    eyeDistance = sqrtPerElem(Dot(toEye, toEye));
+			const Vector4Int backFacing = cmpGe(Dot(toEye, axis), mulPerElem(group.coneAngleCosine, eyeDistance));
+
+			// Occlusion is only worth testing for the clusters that are left
+			Vector4Int hidden = Or(outside, backFacing);
+			if (cullView.pOcclusionBuffer && (MoveMask(hidden) & laneMask) != laneMask)
+				hidden = Or(hidden, occludedClusters(cullView.pOcclusionBuffer, group));
+
+			frustumCulled = And(frustumCulled, outside);
+			facingAway = And(facingAway, Or(outside, backFacing));
+			culled = And(culled, hidden);
 		}
 
-		mesh->clusters[i].aabbMax = v3ToF3(aabbMax);
-		mesh->clusters[i].aabbMin = v3ToF3(aabbMin);
+		const int culledMask = MoveMask(culled) & laneMask;
+		pVisibility[i] = (uint8_t)(~culledMask & laneMask);
+		frustumCulledCount += laneCount(MoveMask(frustumCulled) & laneMask);
+		facingAwayCount += laneCount(MoveMask(facingAway) & laneMask);
+		culledCount += laneCount(culledMask);
+	}
 
-		mesh->clusters[i].coneAngleCosine = sqrtf(1 - coneOpening * coneOpening);
-		mesh->clusters[i].coneCenter = v3ToF3(center + coneAxis * t);
-		mesh->clusters[i].coneAxis = v3ToF3(coneAxis);
+	pCulledCounts[CLUSTER_CULL_FRUSTUM] = frustumCulledCount;
+	pCulledCounts[CLUSTER_CULL_BACKFACE] = facingAwayCount - frustumCulledCount;
+	pCulledCounts[CLUSTER_CULL_OCCLUSION] = culledCount - facingAwayCount;
+}
 
-		mesh->clusterCompacts[i].triangleCount = clusterTriangleCount;
-		mesh->clusterCompacts[i].clusterStart = clusterStart;
+// Least significant digit radix sort of the 16 bit keys in the upper half of the items, 8 bits per pass. It is stable, so
+// clusters at the same depth keep the order of the mesh
+static void radixSortClusters(uint64_t* pItems, uint64_t* pTemp, uint32_t count)
+{
+	for (uint32_t shift = 32; shift < 48; shift += 8)
+	{
+		uint32_t offsets[256] = {};
+		for (uint32_t i = 0; i < count; ++i)
+			++offsets[(pItems[i] >> shift) & 0xff];
 
-		//#if AMD_GEOMETRY_FX_ENABLE_CLUSTER_CENTER_SAFETY_CHECK
-		// If distance of coneCenter to the bounding box center is more than 16x the bounding box extent, the cluster is also invalid
-		// This is mostly a safety measure - if triangles are nearly parallel to coneAxis, t may become very large and unstable
-		const float aabbSize = length(aabbMax - aabbMin);
-		const float coneCenterToCenterDistance = length(f3Tov3(mesh->clusters[i].coneCenter) - center);
+		uint32_t sum = 0;
+		for (uint32_t bucket = 0; bucket < 256; ++bucket)
+		{
+			const uint32_t bucketSize = offsets[bucket];
+			offsets[bucket] = sum;
+			sum += bucketSize;
+		}
 
-		if (coneCenterToCenterDistance > (16 * aabbSize))
-			validCluster = false;
+		for (uint32_t i = 0; i < count; ++i)
+			pTemp[offsets[(pItems[i] >> shift) & 0xff]++] = pItems[i];
 
-		mesh->clusters[i].valid = validCluster;
+		eastl::swap(pItems, pTemp);
 	}
-#endif
 }
 
-void destroyClusters(MeshIn* pMesh)
+// The scratch of a mesh is two arrays of 4 items per cluster group, the visible clusters and the temporary of the sort.
+// An item is the index of the cluster in the lower half and its depth in the upper half, as a float until the depth range
+// of the mesh is known and quantized to 16 bits over it after
+static uint32_t sortMeshClusters(
+	const Scene* pScene, const MeshIn* mesh, const uint8_t* pVisibility, const vec4* pDepthPlane, ClusterCompact* pSorted,
+	uint64_t* pScratch)
 {
-	// Destroy clusters
-	conf_free(pMesh->clusters);
-	conf_free(pMesh->clusterCompacts);
+	const ClusterCullGroup* pGroups = pScene->clusterGroups + mesh->clusterGroupStart;
+	const uint32_t          groupCount = (mesh->clusterCount + 3) / 4;
+
+	uint32_t count = 0;
+	float    minDepth = INFINITY;
+	float    maxDepth = -INFINITY;
+	for (uint32_t i = 0; i < groupCount; ++i)
+	{
+		const ClusterCullGroup& group = pGroups[i];
+		const uint32_t          visibility = pVisibility ? pVisibility[mesh->clusterGroupStart + i] : (1u << group.clusterCount) - 1;
+		if (!visibility)
+			continue;
+
+		if (!pDepthPlane)
+		{
+			for (uint32_t lane = 0; lane < group.clusterCount; ++lane)
+			{
+				if ((visibility >> lane) & 1)
+					pSorted[count++] = mesh->clusterCompacts[i * 4 + lane];
+			}
+			continue;
+		}
+
+		const vec4&   plane = *pDepthPlane;
+		const Vector4 depth = (group.aabbMinX + group.aabbMaxX) * (0.5f * plane.getX()) +
+							  (group.aabbMinY + group.aabbMaxY) * (0.5f * plane.getY()) +
+							  (group.aabbMinZ + group.aabbMaxZ) * (0.5f * plane.getZ()) + Vector4(plane.getW());
+		for (uint32_t lane = 0; lane < group.clusterCount; ++lane)
+		{
+			if (!((visibility >> lane) & 1))
+				continue;
+
+			const float laneDepth = depth.getElem(lane);
+			uint32_t    depthBits;
+			memcpy(&depthBits, &laneDepth, sizeof(depthBits));
+			minDepth = min(minDepth, laneDepth);
+			maxDepth = max(maxDepth, laneDepth);
+			pScratch[count++] = ((uint64_t)depthBits << 32) | (i * 4 + lane);
+		}
+	}
+
+	if (!pDepthPlane)
+		return count;
+
+	const float scale = maxDepth > minDepth ? 65535.0f / (maxDepth - minDepth) : 0.0f;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint32_t depthBits = (uint32_t)(pScratch[i] >> 32);
+		float          depth;
+		memcpy(&depth, &depthBits, sizeof(depth));
+		const uint32_t key = min((uint32_t)((depth - minDepth) * scale), 65535u);
+		pScratch[i] = ((uint64_t)key << 32) | (pScratch[i] & 0xffffffff);
+	}
+
+	radixSortClusters(pScratch, pScratch + groupCount * 4, count);
+
+	for (uint32_t i = 0; i < count; ++i)
+		pSorted[i] = mesh->clusterCompacts[pScratch[i] & 0xffffffff];
+
+	return count;
+}
+
+typedef struct ClusterSortTaskData
+{
+	const Scene*    pScene;
+	const uint8_t*  pVisibility;
+	const vec4*     pDepthPlane;
+	ClusterCompact* pSorted;
+	uint32_t*       pSortedCounts;
+	uint64_t*       pScratch;
+} ClusterSortTaskData;
+
+static void sortClustersTask(void* pUserData, uintptr_t meshIndex)
+{
+	ClusterSortTaskData* pData = (ClusterSortTaskData*)pUserData;
+	const MeshIn*        mesh = pData->pScene->meshes + meshIndex;
+	pData->pSortedCounts[meshIndex] = sortMeshClusters(
+		pData->pScene, mesh, pData->pVisibility, pData->pDepthPlane, pData->pSorted + mesh->clusterGroupStart * 4,
+		pData->pScratch + mesh->clusterGroupStart * 8);
+}
+
+void sortSceneClusters(
+	const Scene* pScene, const uint8_t* pVisibility, const vec4* pDepthPlane, ClusterCompact* pSorted, uint32_t* pSortedCounts,
+	uint64_t* pScratch, ThreadSystem* pThreadSystem)
+{
+	ClusterSortTaskData data = { pScene, pVisibility, pDepthPlane, pSorted, pSortedCounts, pScratch };
+	if (pThreadSystem && pScene->numMeshes > 1)
+	{
+		addThreadSystemRangeTask(pThreadSystem, sortClustersTask, &data, pScene->numMeshes);
+		waitThreadSystemIdle(pThreadSystem);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < pScene->numMeshes; ++i)
+			sortClustersTask(&data, i);
+	}
 }
 
 #if defined(METAL)
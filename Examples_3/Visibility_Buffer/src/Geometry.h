@@ -40,6 +40,11 @@
 
 #define MAX_PATH 260
 
+struct ThreadSystem;
+
+// Mip levels of an OcclusionBuffer, enough for 2048 x 2048 texels
+#define OCCLUSION_BUFFER_MAX_LEVELS 12
+
 // Type definitions
 
 typedef struct SceneVertexPos
@@ -87,6 +92,16 @@ typedef struct ClusterCompact
 	uint32_t clusterStart;
 } ClusterCompact;
 
+// How createSceneClusters splits the triangles of a mesh into clusters
+typedef enum ClusterMode
+{
+	// Every CLUSTER_SIZE consecutive triangles form a cluster, in the order of the mesh
+	CLUSTER_MODE_SEQUENTIAL = 0,
+	// Triangles are reordered into connected groups of up to CLUSTER_SIZE triangles facing similar directions, which gives
+	// tighter bounds and cones than the order of the mesh. Not available on Metal, where the mesh is not indexed
+	CLUSTER_MODE_MESHLET,
+} ClusterMode;
+
 typedef struct Cluster
 {
 	float3 aabbMin, aabbMax;
@@ -96,6 +111,49 @@ typedef struct Cluster
 	bool   valid;
 } Cluster;
 
+// Bounds and cones of 4 consecutive clusters of a mesh, laid out for SIMD culling. Clusters that can not be culled by their
+// cone have an infinite cosine so they are never culled as back facing. The lanes past the last cluster of a mesh are
+// ignored, clusterCount tells how many are used
+typedef struct ClusterCullGroup
+{
+	Vector4  aabbMinX, aabbMinY, aabbMinZ;
+	Vector4  aabbMaxX, aabbMaxY, aabbMaxZ;
+	Vector4  coneCenterX, coneCenterY, coneCenterZ;
+	Vector4  coneAxisX, coneAxisY, coneAxisZ;
+	Vector4  coneAngleCosine;
+	uint32_t clusterCount;
+} ClusterCullGroup;
+
+// Depth of the occluders of a scene from one view, rasterized on the CPU at a low resolution, and a pyramid where every texel
+// holds the farthest depth of the 2x2 texels under it. Depths are z / w of the clip space, the far plane is at 1 and texels
+// the occluders do not fully cover keep it. Row 0 is at the top of the view
+typedef struct OcclusionBuffer
+{
+	uint32_t width, height;    // The width is a multiple of 4
+	uint32_t levelCount;
+	uint32_t levelWidths[OCCLUSION_BUFFER_MAX_LEVELS];
+	uint32_t levelHeights[OCCLUSION_BUFFER_MAX_LEVELS];
+	float*   levels[OCCLUSION_BUFFER_MAX_LEVELS];
+	mat4     mvp;    // Matrix of the view the occluders were rasterized from
+} OcclusionBuffer;
+
+// A view the clusters are culled against, in the object space of the clusters. The frustum planes point inwards, a point p
+// is inside when dot(plane.xyz, p) + plane.w >= 0
+typedef struct ClusterCullView
+{
+	vec4                   planes[6];
+	vec3                   eye;
+	const OcclusionBuffer* pOcclusionBuffer;    // Occluders rendered from the view, can be NULL
+} ClusterCullView;
+
+typedef enum ClusterCullReason
+{
+	CLUSTER_CULL_FRUSTUM = 0,    // Outside the frustum of every view
+	CLUSTER_CULL_BACKFACE,       // Facing away from, or outside the frustum of, every view
+	CLUSTER_CULL_OCCLUSION,      // Hidden behind the occluders of, facing away from or outside the frustum of every view
+	CLUSTER_CULL_REASON_COUNT,
+} ClusterCullReason;
+
 typedef struct AABoundingBox
 {
 	float4 Center;     // Center of the box.
@@ -121,6 +179,7 @@ typedef struct MeshIn
 	uint32_t        clusterCount;
 	ClusterCompact* clusterCompacts;
 	Cluster*        clusters;
+	uint32_t        clusterGroupStart;    // First group of the mesh in Scene::clusterGroups
 	uint32_t        materialId;
 
 	AABoundingBox AABB;
@@ -138,21 +197,35 @@ typedef struct Material
 
 typedef struct Scene
 {
-	uint32_t                           numMeshes;
-	uint32_t                           numMaterials;
-	uint32_t                           totalTriangles;
-	uint32_t                           totalVertices;
-	MeshIn*                            meshes;
-	Material*                          materials;
-	eastl::vector<SceneVertexPos>      positions;
-	eastl::vector<SceneVertexTexCoord> texCoords;
-	eastl::vector<SceneVertexNormal>   normals;
-	eastl::vector<SceneVertexTangent>  tangents;
-	char**                             textures;
-	char**                             normalMaps;
-	char**                             specularMaps;
-
-	eastl::vector<uint32_t> indices;
+	uint32_t             numMeshes;
+	uint32_t             numMaterials;
+	uint32_t             totalTriangles;
+	uint32_t             totalVertices;
+	MeshIn*              meshes;
+	Material*            materials;
+	SceneVertexPos*      positions;
+	SceneVertexTexCoord* texCoords;
+	SceneVertexNormal*   normals;
+	SceneVertexTangent*  tangents;
+	char**               textures;
+	char**               normalMaps;
+	char**               specularMaps;
+
+	uint32_t* indices;
+
+	// Cluster bounds and cones of every mesh from createClusterCullGroups
+	ClusterCullGroup* clusterGroups;
+	uint32_t          numClusterGroups;
+
+	// Largest opaque triangles of the scene from createSceneOccluders, 3 vertices per triangle, and whether the material
+	// of each one is two sided
+	SceneVertexPos* occluders;
+	bool*           occluderTwoSided;
+	uint32_t        numOccluders;
+
+	// Mapped file of a scene from loadBakedScene. The vertices, indices and clusters point into it instead of being allocated
+	void*  bakedData;
+	size_t bakedDataSize;
 } Scene;
 
 typedef struct FilterBatchData
@@ -188,10 +261,44 @@ typedef struct FilterBatchChunk
 // Exposed functions
 
 Scene* loadScene(const char* fileName, float scale, float offsetX, float offsetY, float offsetZ);
+Scene* loadBakedScene(const char* fileName, float scale, float offsetX, float offsetY, float offsetZ);
 void   removeScene(Scene* scene);
 void   createAABB(const Scene* pScene, MeshIn* mesh);
 void   createClusters(bool twoSided, const Scene* pScene, MeshIn* mesh);
-void   destroyClusters(MeshIn* mesh);
+// Creates the clusters of every mesh of the scene, spread over the threads of pThreadSystem when it is not NULL.
+// CLUSTER_MODE_MESHLET reorders the indices of the scene, so it has to run before they are uploaded
+void   createSceneClusters(Scene* pScene, ClusterMode mode, ThreadSystem* pThreadSystem);
+void   destroyClusters(const Scene* pScene, MeshIn* mesh);
+// Gathers the bounds and cones of the clusters of every mesh into groups of 4 for cullClusterGroups
+void   createClusterCullGroups(Scene* pScene);
+void   destroyClusterCullGroups(Scene* pScene);
+// Picks up to maxTriangles of the largest triangles of the meshes that are not alpha tested as occluders
+void   createSceneOccluders(Scene* pScene, uint32_t maxTriangles);
+void   destroySceneOccluders(Scene* pScene);
+// The width is rounded up to a multiple of 4
+void   createOcclusionBuffer(OcclusionBuffer* pBuffer, uint32_t width, uint32_t height);
+void   destroyOcclusionBuffer(OcclusionBuffer* pBuffer);
+// Rasterizes triangleCount triangles, 3 vertices each, into the buffer and builds its pyramid. Triangles that cross the near
+// plane are left out, and so are the back faces of the triangles pTwoSided marks as single sided, the way the triangle filter
+// culls them on the GPU. pTwoSided can be NULL when every triangle is two sided
+void   renderOcclusionBuffer(
+	OcclusionBuffer* pBuffer, const mat4& mvp, const SceneVertexPos* pTriangles, const bool* pTwoSided, uint32_t triangleCount);
+// Extracts the frustum planes of a view from its model view projection matrix. The eye is in object space as well and the
+// occlusion buffer, when there is one, has to be rendered with the same matrix
+void   setClusterCullView(ClusterCullView* pView, const mat4& mvp, const vec3& eye, const OcclusionBuffer* pOcclusionBuffer);
+// Tests the clusters in groupCount groups against the views. Bit i of pVisibility[g] is set when cluster i of group g may
+// be visible from any view and has to be filtered. The number of clusters culled for every ClusterCullReason is written to
+// pCulledCounts
+void   cullClusterGroups(
+	const ClusterCullGroup* pGroups, uint32_t groupCount, const ClusterCullView* pViews, uint32_t viewCount,
+	uint8_t* pVisibility, uint32_t* pCulledCounts);
+// Writes the clusters of every mesh that are set in pVisibility, or all of them when it is NULL, to pSorted from
+// clusterGroupStart * 4 on and their number to pSortedCounts. With a depth plane they are ordered by increasing distance of
+// their center to it, otherwise they keep the order of the mesh. pScratch has to hold numClusterGroups * 8 entries.
+// The meshes are spread over the threads of pThreadSystem when it is not NULL
+void   sortSceneClusters(
+	const Scene* pScene, const uint8_t* pVisibility, const vec4* pDepthPlane, ClusterCompact* pSorted, uint32_t* pSortedCounts,
+	uint64_t* pScratch, ThreadSystem* pThreadSystem);
 
 void loadModel(const eastl::string& FileName, Buffer*& pVertexBuffer, uint& vertexCount, Buffer*& IndexBuffer, uint& indexCount);
 
@@ -269,6 +269,18 @@ typedef struct AppSettings
 	// Cluster culling increases CPU time and does not provide enough benefit in terms of culling results to keep it enabled by default
 	bool mClusterCulling = false;
 	
+	// Also culls the clusters hidden behind the largest triangles of the scene, rasterized on the CPU from every view at a low
+	// resolution. Only used together with cluster culling
+	bool mOcclusionCulling = true;
+	
+	// Orders the clusters of every mesh front to back before they are filtered, so the filtered triangles are drawn front
+	// to back as well and early depth testing rejects more of the occluded pixels
+	bool mSortClusters = true;
+	
+	// How the meshes are split into clusters when the scene is loaded. Meshlets cull better but take longer to build,
+	// a baked scene always comes with sequential clusters
+	ClusterMode mClusterMode = CLUSTER_MODE_SEQUENTIAL;
+	
 	// TODO: there is an issue that prevents to launch this in async mode by default. The problem is that the renderer needs to be notified
 	// of when a frame starts, so that it updates the internal frameIdx (which is needed for handling the multiple frames in-flight for
 	// descriptor binding) . The problem is that the renderer assumes that acquireNextImage image is always called at the begining of the
@@ -349,6 +361,8 @@ typedef struct AppSettings
 // Constants
 /************************************************************************/
 const char* gSceneName = "SanMiguel.obj";
+// Written by "AssetPipelineCmd processmeshes" with --scale 50 --offset -20 0 0, used instead of gSceneName when present
+const char* gBakedSceneName = "SanMiguel.obj.mesh";
 const char* gSunName = "sun.obj";
 
 // Number of in-flight buffers
@@ -398,7 +412,7 @@ struct PerFrameData
 	
 	// These are just used for statistical information
 	uint32_t gTotalClusters = 0;
-	uint32_t gCulledClusters = 0;
+	uint32_t gCulledClusters[CLUSTER_CULL_REASON_COUNT] = {};
 	uint32_t gDrawCount[gNumGeomSets];
 };
 
@@ -712,9 +726,58 @@ bool                        gResolutionChange = false;
 /************************************************************************/
 class VisibilityBuffer* pVisibilityBuffer = NULL;
 /************************************************************************/
-// Culling intrinsic data
+// Cluster culling data
 /************************************************************************/
-const uint32_t pdep_lut[8] = { 0x0, 0x1, 0x4, 0x5, 0x10, 0x11, 0x14, 0x15 };
+// Cluster groups culled by one task
+const uint32_t gClusterCullChunkSize = 256;
+// Triangles picked as occluders and the resolution they are rasterized at for occlusion culling
+const uint32_t gOccluderTriangleCount = 16384;
+const uint32_t gOcclusionBufferWidth = 256;
+const uint32_t gOcclusionBufferHeight = 144;
+
+typedef struct ClusterCullTaskData
+{
+	const ClusterCullGroup* pGroups;
+	uint32_t                mGroupCount;
+	const ClusterCullView*  pViews;
+	uint8_t*                pVisibility;
+	uint32_t*               pCulledCounts;    // CLUSTER_CULL_REASON_COUNT per chunk, summed once every task is done
+} ClusterCullTaskData;
+
+static void cullClustersTask(void* pUserData, uintptr_t chunkIndex)
+{
+	ClusterCullTaskData* pData = (ClusterCullTaskData*)pUserData;
+	const uint32_t       start = (uint32_t)chunkIndex * gClusterCullChunkSize;
+	const uint32_t       count = min(gClusterCullChunkSize, pData->mGroupCount - start);
+	cullClusterGroups(
+		pData->pGroups + start, count, pData->pViews, gNumViews, pData->pVisibility + start,
+		pData->pCulledCounts + chunkIndex * CLUSTER_CULL_REASON_COUNT);
+}
+
+// Visible clusters of every group of Scene::clusterGroups, and the number culled per chunk, written by cullClusters
+uint8_t*  pClusterVisibility = NULL;
+uint32_t* pClusterCulledCounts = NULL;
+// Clusters of every mesh left after culling, in the order they are filtered, from MeshIn::clusterGroupStart * 4 on
+ClusterCompact* pSortedClusters = NULL;
+uint32_t*       pSortedClusterCounts = NULL;
+uint64_t*       pClusterSortScratch = NULL;
+// Occluders of the scene rendered from every view by cullClusters
+OcclusionBuffer gOcclusionBuffers[gNumViews];
+
+typedef struct OcclusionTaskData
+{
+	const Scene*     pScene;
+	const mat4*      pMvps;
+	OcclusionBuffer* pBuffers;
+} OcclusionTaskData;
+
+static void renderOcclusionBufferTask(void* pUserData, uintptr_t view)
+{
+	OcclusionTaskData* pData = (OcclusionTaskData*)pUserData;
+	renderOcclusionBuffer(
+		&pData->pBuffers[view], pData->pMvps[view], pData->pScene->occluders, pData->pScene->occluderTwoSided,
+		pData->pScene->numOccluders);
+}
 /************************************************************************/
 // App implementation
 /************************************************************************/
@@ -989,14 +1052,44 @@ public:
 		addThreadSystemTask(pThreadSystem, memberTaskFunc0<VisibilityBuffer, &VisibilityBuffer::LoadSkybox>, this);
 		
 		/************************************************************************/
-		// Load the scene using the SceneLoader class, which uses Assimp
+		// Map the baked scene, or load the scene using the SceneLoader class, which uses Assimp
 		/************************************************************************/
 		HiresTimer      sceneLoadTimer;
-		eastl::string sceneFullPath = FileSystem::FixPath(gSceneName, FSRoot::FSR_Meshes);
-		pScene = loadScene(sceneFullPath.c_str(), 50.0f, -20.0f, 0.0f, 0.0f);
-		if (!pScene)
-			return false;
-		LOGF(LogLevel::eINFO, "Load assimp scene : %f ms", sceneLoadTimer.GetUSec(true) / 1000.0f);
+		eastl::string bakedScenePath = FileSystem::FixPath(gBakedSceneName, FSRoot::FSR_Meshes);
+		pScene = loadBakedScene(bakedScenePath.c_str(), 50.0f, -20.0f, 0.0f, 0.0f);
+		if (pScene)
+		{
+			LOGF(LogLevel::eINFO, "Map baked scene : %f ms", sceneLoadTimer.GetUSec(true) / 1000.0f);
+		}
+		else
+		{
+			eastl::string sceneFullPath = FileSystem::FixPath(gSceneName, FSRoot::FSR_Meshes);
+			pScene = loadScene(sceneFullPath.c_str(), 50.0f, -20.0f, 0.0f, 0.0f);
+			if (!pScene)
+				return false;
+			LOGF(LogLevel::eINFO, "Load assimp scene : %f ms", sceneLoadTimer.GetUSec(true) / 1000.0f);
+		}
+		/************************************************************************/
+		// Cluster creation
+		/************************************************************************/
+		// A baked scene comes with its clusters. Meshlets reorder the indices, so this runs before they are uploaded
+		if (!pScene->bakedData)
+		{
+			HiresTimer clusterTimer;
+			createSceneClusters(pScene, gAppSettings.mClusterMode, pThreadSystem);
+			LOGF(LogLevel::eINFO, "Load clusters : %f ms", clusterTimer.GetUSec(true) / 1000.0f);
+		}
+		createClusterCullGroups(pScene);
+		pClusterVisibility = (uint8_t*)conf_malloc(pScene->numClusterGroups);
+		pClusterCulledCounts = (uint32_t*)conf_malloc(
+			((pScene->numClusterGroups + gClusterCullChunkSize - 1) / gClusterCullChunkSize) * CLUSTER_CULL_REASON_COUNT *
+			sizeof(uint32_t));
+		pSortedClusters = (ClusterCompact*)conf_malloc(pScene->numClusterGroups * 4 * sizeof(ClusterCompact));
+		pSortedClusterCounts = (uint32_t*)conf_malloc(pScene->numMeshes * sizeof(uint32_t));
+		pClusterSortScratch = (uint64_t*)conf_malloc(pScene->numClusterGroups * 8 * sizeof(uint64_t));
+		createSceneOccluders(pScene, gOccluderTriangleCount);
+		for (uint32_t i = 0; i < gNumViews; ++i)
+			createOcclusionBuffer(&gOcclusionBuffers[i], gOcclusionBufferWidth, gOcclusionBufferHeight);
 		/************************************************************************/
 		// IA buffers
 		/************************************************************************/
@@ -1011,7 +1104,7 @@ public:
 		ibDesc.mDesc.mElementCount = pScene->totalTriangles * 3;
 		ibDesc.mDesc.mStructStride = sizeof(uint32_t);
 		ibDesc.mDesc.mSize = ibDesc.mDesc.mElementCount * ibDesc.mDesc.mStructStride;
-		ibDesc.pData = pScene->indices.data();
+		ibDesc.pData = pScene->indices;
 		ibDesc.ppBuffer = &pIndexBufferAll;
 		ibDesc.mDesc.pDebugName = L"Non-filtered Index Buffer Desc";
 		addResource(&ibDesc, true);
@@ -1046,7 +1139,7 @@ public:
 		vbPosDesc.mDesc.mElementCount = pScene->totalVertices;
 		vbPosDesc.mDesc.mStructStride = sizeof(SceneVertexPos);
 		vbPosDesc.mDesc.mSize = vbPosDesc.mDesc.mElementCount * vbPosDesc.mDesc.mStructStride;
-		vbPosDesc.pData = pScene->positions.data();
+		vbPosDesc.pData = pScene->positions;
 		vbPosDesc.ppBuffer = &pVertexBufferPosition;
 		vbPosDesc.mDesc.pDebugName = L"Vertex Position Buffer Desc";
 		addResource(&vbPosDesc, true);
@@ -1059,7 +1152,7 @@ public:
 		vbTexCoordDesc.mDesc.mElementCount = pScene->totalVertices * (sizeof(SceneVertexTexCoord) / sizeof(uint32_t));
 		vbTexCoordDesc.mDesc.mStructStride = sizeof(uint32_t);
 		vbTexCoordDesc.mDesc.mSize = vbTexCoordDesc.mDesc.mElementCount * vbTexCoordDesc.mDesc.mStructStride;
-		vbTexCoordDesc.pData = pScene->texCoords.data();
+		vbTexCoordDesc.pData = pScene->texCoords;
 		vbTexCoordDesc.ppBuffer = &pVertexBufferTexCoord;
 		vbTexCoordDesc.mDesc.pDebugName = L"Vertex TexCoord Buffer Desc";
 		addResource(&vbTexCoordDesc, true);
@@ -1072,7 +1165,7 @@ public:
 		vbNormalDesc.mDesc.mElementCount = pScene->totalVertices * (sizeof(SceneVertexNormal) / sizeof(uint32_t));
 		vbNormalDesc.mDesc.mStructStride = sizeof(uint32_t);
 		vbNormalDesc.mDesc.mSize = vbNormalDesc.mDesc.mElementCount * vbNormalDesc.mDesc.mStructStride;
-		vbNormalDesc.pData = pScene->normals.data();
+		vbNormalDesc.pData = pScene->normals;
 		vbNormalDesc.ppBuffer = &pVertexBufferNormal;
 		vbNormalDesc.mDesc.pDebugName = L"Vertex Normal Buffer Desc";
 		addResource(&vbNormalDesc, true);
@@ -1085,7 +1178,7 @@ public:
 		vbTangentDesc.mDesc.mElementCount = pScene->totalVertices * (sizeof(SceneVertexTangent) / sizeof(uint32_t));
 		vbTangentDesc.mDesc.mStructStride = sizeof(uint32_t);
 		vbTangentDesc.mDesc.mSize = vbTangentDesc.mDesc.mElementCount * vbTangentDesc.mDesc.mStructStride;
-		vbTangentDesc.pData = pScene->tangents.data();
+		vbTangentDesc.pData = pScene->tangents;
 		vbTangentDesc.ppBuffer = &pVertexBufferTangent;
 		vbTangentDesc.mDesc.pDebugName = L"Vertex Tangent Buffer Desc";
 		addResource(&vbTangentDesc, true);
@@ -1110,17 +1203,6 @@ public:
 		TextureLoadTaskData specularData{ gSpecularMaps.data(), (const char**)pScene->specularMaps, desc };
 		addThreadSystemRangeTask(pThreadSystem, loadTexturesTask, &specularData, pScene->numMaterials);
 		
-		// Cluster creation
-		/************************************************************************/
-		HiresTimer clusterTimer;
-		// Calculate clusters
-		for (uint32_t i = 0; i < pScene->numMeshes; ++i)
-		{
-			MeshIn*   mesh = pScene->meshes + i;
-			Material* material = pScene->materials + mesh->materialId;
-			createClusters(material->twoSided, pScene, mesh);
-		}
-		LOGF(LogLevel::eINFO, "Load clusters : %f ms", clusterTimer.GetUSec(true) / 1000.0f);
 		/************************************************************************/
 		// Setup root signatures
 		/************************************************************************/
@@ -1467,6 +1549,12 @@ public:
 		CheckboxWidget cluster("Cluster Culling", &gAppSettings.mClusterCulling);
 		pGuiWindow->AddWidget(cluster);
 		
+		CheckboxWidget occlusion("Occlusion Culling", &gAppSettings.mOcclusionCulling);
+		pGuiWindow->AddWidget(occlusion);
+		
+		CheckboxWidget sortClusters("Sort Clusters Front To Back", &gAppSettings.mSortClusters);
+		pGuiWindow->AddWidget(sortClusters);
+		
 		CheckboxWidget asyncCompute("Async Compute", &gAppSettings.mAsyncCompute);
 		pGuiWindow->AddWidget(asyncCompute);
 		
@@ -1649,9 +1737,18 @@ public:
 		removeResource(pSkyboxVertexBuffer);
 		
 		// Destroy clusters
+		conf_free(pClusterVisibility);
+		conf_free(pClusterCulledCounts);
+		conf_free(pSortedClusters);
+		conf_free(pSortedClusterCounts);
+		conf_free(pClusterSortScratch);
+		for (uint32_t i = 0; i < gNumViews; ++i)
+			destroyOcclusionBuffer(&gOcclusionBuffers[i]);
+		destroySceneOccluders(pScene);
+		destroyClusterCullGroups(pScene);
 		for (uint32_t i = 0; i < pScene->numMeshes; ++i)
 		{
-			destroyClusters(&pScene->meshes[i]);
+			destroyClusters(pScene, &pScene->meshes[i]);
 		}
 		// Remove Textures
 		for (uint32_t i = 0; i < pScene->numMaterials; ++i)
@@ -4641,130 +4738,60 @@ public:
 	}
 #endif
 	
-	// Determines if the cluster can be safely culled performing quick cone-based test on the CPU.
-	// Since the triangle filtering kernel operates with 2 views in the same pass, this method must
-	// only cull those clusters that are not visible from ANY of the views (camera and shadow views).
-	bool cullCluster(const Cluster* cluster, vec3 eyes[gNumViews])
+	// Culls the clusters that are outside the frustum, facing away or hidden behind the occluders on the CPU, four clusters
+	// at a time and spread over the thread system. Since the triangle filtering kernel operates with 2 views in the same
+	// pass, this method must only cull those clusters that are not visible from ANY of the views (camera and shadow views).
+	// Every task writes its own range of pClusterVisibility, so the result does not depend on the number of threads.
+	void cullClusters(uint32_t frameIdx)
 	{
-		// Invalid clusters can't be safely culled using the cone based test
-		if (cluster->valid)
+		PerFrameData* currentFrame = &gPerFrame[frameIdx];
+		mat4          mvps[gNumViews];
+		for (uint32_t i = 0; i < gNumViews; ++i)
+			mvps[i] = currentFrame->gPerFrameUniformData.transform[i].mvp;
+		
+		// Every view rasterizes its occluders on its own thread
+		if (gAppSettings.mOcclusionCulling)
 		{
-			uint visibility = 0;
-			for (uint32_t i = 0; i < gNumViews; i++)
-			{
-				// We move camera position into object space
-				vec3 testVec = normalize(eyes[i] - f3Tov3(cluster->coneCenter));
-				
-				// Check if we are inside the cone
-				if (dot(testVec, f3Tov3(cluster->coneAxis)) < cluster->coneAngleCosine)
-					visibility |= (1 << i);
-			}
-			return (visibility == 0);
+			OcclusionTaskData occlusionData = { pScene, mvps, gOcclusionBuffers };
+			addThreadSystemRangeTask(pThreadSystem, renderOcclusionBufferTask, &occlusionData, gNumViews);
+			waitThreadSystemIdle(pThreadSystem);
 		}
-		return false;
-	}
-	
-	static inline int genClipMask(__m128 v)
-	{
-		//this checks a vertex against the 6 planes, and stores if they are inside
-		// or outside of the plane
-		
-		//w contains the w component of the vector in all 4 slots
-		const __m128 w0 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
-		const __m128 w1 = _mm_shuffle_ps(v, _mm_setzero_ps(), _MM_SHUFFLE(3, 3, 3, 3));
-		
-		//subtract the vector from w, and store in a
-		const __m128 a = _mm_sub_ps(w0, v);
-		//add the vector to w, and store in b
-		const __m128 b = _mm_add_ps(w1, v);
-		
-		//compare if a and b are less than zero,
-		// and store the result in fmaska, and fmaskk
-		const __m128 fmaska = _mm_cmplt_ps(a, _mm_setzero_ps());
-		const __m128 fmaskb = _mm_cmplt_ps(b, _mm_setzero_ps());
-		
-		//convert those masks to integers, and spread the bits using pdep
-		//const int maska = _pdep_u32(_mm_movemask_ps(fmaska), 0x55);
-		//const int maskb = _pdep_u32(_mm_movemask_ps(fmaskb), 0xAA);
-		const int maska = pdep_lut[(_mm_movemask_ps(fmaska) & 0x7)];
-		const int maskb = pdep_lut[(_mm_movemask_ps(fmaskb) & 0x7)] << 1;
-		
-		//or the masks together and and the together with all bits set to 1
-		// NOTE only the bits 0x3f are actually used
-		return (maska | maskb) & 0x3f;
-	}
-	
-	//static inline uint32_t genClipMask(float4 f)
-	//{
-	//  uint32_t result = 0;
-	//
-	//  //X
-	//  if (f.x <= f.w)  result |=  0x1;
-	//  if (f.x >= -f.w) result |=  0x2;
-	//
-	//  //Y
-	//  if (f.y <= f.w)  result |=  0x4;
-	//  if (f.y >= -f.w) result |=  0x8;
-	//
-	//  //Z
-	//  if (f.z <= f.w)  result |= 0x10;
-	//  if (f.z >= 0)   result |= 0x20;
-	//  return result;
-	//}
-	
-	void sortClusters(Cluster** clusters, uint32_t len)
-	{
-		struct StackItem
-		{
-			Cluster** a;
-			uint32_t  l;
-		};
-		StackItem stack[512];
-		int       stackidx = 0;
 		
-		Cluster** current_a = clusters;
-		uint32_t  current_l = len;
+		ClusterCullView views[gNumViews];
+		for (uint32_t i = 0; i < gNumViews; ++i)
+			setClusterCullView(
+				&views[i], mvps[i], currentFrame->gEyeObjectSpace[i], gAppSettings.mOcclusionCulling ? &gOcclusionBuffers[i] : NULL);
 		
-		for (;;)
+		ClusterCullTaskData data = { pScene->clusterGroups, pScene->numClusterGroups, views, pClusterVisibility,
+									 pClusterCulledCounts };
+		const uint32_t      chunkCount = (pScene->numClusterGroups + gClusterCullChunkSize - 1) / gClusterCullChunkSize;
+		if (chunkCount > 1)
 		{
-			Cluster* pivot = current_a[current_l / 2];
-			
-			int i, j;
-			for (i = 0, j = current_l - 1;; ++i, --j)
-			{
-				while (current_a[i]->distanceFromCamera < pivot->distanceFromCamera)
-					i++;
-				while (current_a[j]->distanceFromCamera > pivot->distanceFromCamera)
-					j--;
-				
-				if (i >= j)
-					break;
-				
-				Cluster* temp = current_a[i];
-				current_a[i] = current_a[j];
-				current_a[j] = temp;
-			}
-			
-			if (i > 1)
-			{
-				stack[stackidx].a = current_a;
-				stack[stackidx++].l = i;
-			}
-			if (current_l - i > 1)
-			{
-				stack[stackidx].a = current_a + i;
-				stack[stackidx++].l = current_l - i;
-			}
-			
-			if (stackidx == 0)
-				break;
-			
-			--stackidx;
-			current_a = stack[stackidx].a;
-			current_l = stack[stackidx].l;
+			addThreadSystemRangeTask(pThreadSystem, cullClustersTask, &data, chunkCount);
+			waitThreadSystemIdle(pThreadSystem);
+		}
+		else if (chunkCount)
+		{
+			cullClustersTask(&data, 0);
+		}
+		
+		for (uint32_t i = 0; i < chunkCount; ++i)
+		{
+			for (uint32_t reason = 0; reason < CLUSTER_CULL_REASON_COUNT; ++reason)
+				currentFrame->gCulledClusters[reason] += pClusterCulledCounts[i * CLUSTER_CULL_REASON_COUNT + reason];
 		}
 	}
 	
+	// Gathers the clusters that survived culling into pSortedClusters, ordered front to back from the camera when sorting is
+	// enabled. The depth of a cluster is the w of its center in clip space, which is its distance along the view direction
+	void sortClusters(uint32_t frameIdx, bool culled)
+	{
+		const vec4 depthPlane = gPerFrame[frameIdx].gPerFrameUniformData.transform[VIEW_CAMERA].mvp.getRow(3);
+		sortSceneClusters(
+			pScene, culled ? pClusterVisibility : NULL, gAppSettings.mSortClusters ? &depthPlane : NULL, pSortedClusters,
+			pSortedClusterCounts, pClusterSortScratch, pThreadSystem);
+	}
+	
 	// This function decides how to do the triangle filtering pass, depending on the flags (hold, filter triangles)
 	// - filterTriangles: enables / disables triangle filtering at all. Disabling filtering makes the CPU to set the buffer states to render the whole scene.
 	// - hold: bypasses any triangle filtering step. This is useful to inspect the filtered geometry from another viewpoint.
@@ -4774,7 +4801,7 @@ public:
 		cmdBeginGpuTimestampQuery(cmd, pGpuProfiler, "Triangle Filtering Pass", true);
 		
 		gPerFrame[frameIdx].gTotalClusters = 0;
-		gPerFrame[frameIdx].gCulledClusters = 0;
+		memset(gPerFrame[frameIdx].gCulledClusters, 0, sizeof(gPerFrame[frameIdx].gCulledClusters));
 		
 #if defined(METAL)
 		/************************************************************************/
@@ -4815,27 +4842,22 @@ public:
 		filterParams[5].ppBuffers = &pFilteredIndexBuffer[frameIdx][VIEW_SHADOW];
 		cmdBindDescriptors(cmd, pDescriptorBinder, pRootSignatureTriangleFiltering, 6, filterParams);
 		
-		// Iterate mesh clusters and perform cluster culling
+		// Perform CPU-based cluster culling before adding the clusters for GPU filtering
+		cullClusters(frameIdx);
+		sortClusters(frameIdx, true);
+		
+		// Iterate mesh clusters
 		uint32_t batchBufferOffset = 0;
 		for (uint32_t i = 0; i < pScene->numMeshes; i++)
 		{
-			const MeshIn*   mesh = pScene->meshes + i;
-			const Material* material = pScene->materials + mesh->materialId;
+			const MeshIn*         mesh = pScene->meshes + i;
+			const Material*       material = pScene->materials + mesh->materialId;
+			const ClusterCompact* clusters = pSortedClusters + mesh->clusterGroupStart * 4;
 			gPerFrame[frameIdx].gTotalClusters += mesh->clusterCount;
-			for (uint32_t j = 0; j < mesh->clusterCount; j++)
+			for (uint32_t j = 0; j < pSortedClusterCounts[i]; j++)
 			{
-				const Cluster*        cluster = mesh->clusters + j;
-				const ClusterCompact* pClusterCompact = &mesh->clusterCompacts[j];
-				
-				// Perform CPU-based cluster culling before adding the cluster for GPU filtering
-				if (cullCluster(cluster, gPerFrame[frameIdx].gEyeObjectSpace))
-				{
-					gPerFrame[frameIdx].gCulledClusters++;
-					continue;
-				}
-				
 				// The cluster was not culled: add cluster to the cluster batch chunk for the GPU filtering step
-				addClusterToBatchChunk(pClusterCompact, mesh, i, material->twoSided, pFilterBatchChunk[frameIdx]);
+				addClusterToBatchChunk(&clusters[j], mesh, i, material->twoSided, pFilterBatchChunk[frameIdx]);
 				
 				// Check if we filled the whole batch of clusters
 				if (pFilterBatchChunk[frameIdx]->currentBatchCount >= BATCH_COUNT)
@@ -4921,161 +4943,24 @@ public:
 		filterParams[5].pName = "uniforms";
 		filterParams[5].ppBuffers = &pPerFrameUniformBuffers[frameIdx];
 		cmdBindDescriptors(cmd, pDescriptorBinder, pRootSignatureTriangleFiltering, 6, filterParams);
-#if 0
-#define SORT_CLUSTERS 1
 		
-#if SORT_CLUSTERS
-		uint32_t maxClusterCount = 0;
-		for (uint32_t i = 0; i < pScene->numMeshes; ++i)
-		{
-			Mesh* drawBatch = &pScene->meshes[i];
-			maxClusterCount = max(maxClusterCount, drawBatch->clusterCount);
-		}
-		Cluster** temporaryClusters = (Cluster**)conf_malloc(sizeof(Cluster) * maxClusterCount);
-#endif
+		if (gAppSettings.mClusterCulling)
+			cullClusters(frameIdx);
+		sortClusters(frameIdx, gAppSettings.mClusterCulling);
 		
 		for (uint32_t i = 0; i < pScene->numMeshes; ++i)
 		{
-			Mesh* drawBatch = &pScene->meshes[i];
-			FilterBatchChunk* batchChunk = pFilterBatchChunk[frameIdx][currentSmallBatchChunk];
-			
-#if SORT_CLUSTERS
-			uint32_t temporaryClusterCount = 0;
-			
-			//Cull clusters
-			for (uint32_t j = 0; j < drawBatch->clusterCount; ++j)
-			{
-				++gPerFrame[frameIdx].gTotalClusters;
-				Cluster* clusterInfo = &drawBatch->clusters[j];
-				
-				// Run cluster culling
-				{
-					//Calculate distance from the camera
-					vec4 p0 = vec4((f3Tov3(clusterInfo->aabbMin) + f3Tov3(clusterInfo->aabbMax)) * .5f, 1.0f);
-					mat4 vm = gPerFrame[frameIdx].gPerFrameUniformData.transform[VIEW_CAMERA].vp;
-					
-#if defined(VECTORMATH_MODE_SCALAR) && 0
-					float z =
-					vm.getCol0().getZ() * p0.getX() +
-					vm.getCol1().getZ() * p0.getY() +
-					vm.getCol2().getZ() * p0.getZ() +
-					vm.getCol3().getZ() * p0.getW();
-					float w =
-					vm.getCol0().getW() * p0.getX() +
-					vm.getCol1().getW() * p0.getY() +
-					vm.getCol2().getW() * p0.getZ() +
-					vm.getCol3().getW() * p0.getW();
-					clusterInfo->distanceFromCamera = z / w;
-#else
-					p0 = vm * p0;
-					clusterInfo->distanceFromCamera = p0.getZ() / p0.getW();
-#endif
-					
-					if (std::isnan(clusterInfo->distanceFromCamera))
-						clusterInfo->distanceFromCamera = 0;
-					
-					temporaryClusters[temporaryClusterCount++] = clusterInfo;
-					
-				}
-			}
-			
-			//Sort the clusters
-			sortClusters(temporaryClusters, temporaryClusterCount);
-			
-			//Add clusters to batch chunk
-			for (uint32_t j = 0; j < temporaryClusterCount; ++j)
+			MeshIn*               drawBatch = &pScene->meshes[i];
+			FilterBatchChunk*     batchChunk = pFilterBatchChunk[frameIdx][currentSmallBatchChunk];
+			const ClusterCompact* clusters = pSortedClusters + drawBatch->clusterGroupStart * 4;
+			gPerFrame[frameIdx].gTotalClusters += drawBatch->clusterCount;
+			for (uint32_t j = 0; j < pSortedClusterCounts[i]; ++j)
 			{
-				addClusterToBatchChunk(
-									   temporaryClusters[j],
-									   batchStart,
-									   accumDrawCount,
-									   accumNumTrianglesAtStartOfBatch,
-									   i,
-									   batchChunk);
-				accumNumTriangles += temporaryClusters[j]->triangleCount;
-				
-				// check to see if we filled the batch
-				if (batchChunk->currentBatchCount >= BATCH_COUNT)
-				{
-					++accumDrawCount;
-					
-					// run the triangle filtering and switch to the next small batch chunk
-					filterTriangles(cmd, frameIdx, batchChunk);
-					currentSmallBatchChunk = (currentSmallBatchChunk + 1) % gSmallBatchChunkCount;
-					batchChunk = pFilterBatchChunk[frameIdx][currentSmallBatchChunk];
-					
-					batchStart = 0;
-					accumNumTrianglesAtStartOfBatch = accumNumTriangles;
-				}
-			}
-#else
-			//Cull clusters
-			for (uint32_t j = 0; j < drawBatch->clusterCount; ++j)
-			{
-				++gPerFrame[frameIdx].gTotalClusters;
-				Cluster* clusterInfo = &drawBatch->clusters[j];
-				
-				// Run cluster culling
-				{
-					addClusterToBatchChunk(
-										   clusterInfo,
-										   batchStart,
-										   accumDrawCount,
-										   accumNumTrianglesAtStartOfBatch,
-										   i,
-										   batchChunk);
-					accumNumTriangles += clusterInfo->triangleCount;
-				}
-				
-				// check to see if we filled the batch
-				if (batchChunk->currentBatchCount >= BATCH_COUNT)
-				{
-					++accumDrawCount;
-					
-					// run the triangle filtering and switch to the next small batch chunk
-					filterTriangles(cmd, frameIdx, batchChunk);
-					currentSmallBatchChunk = (currentSmallBatchChunk + 1) % gSmallBatchChunkCount;
-					batchChunk = pFilterBatchChunk[frameIdx][currentSmallBatchChunk];
-					
-					batchStart = 0;
-					accumNumTrianglesAtStartOfBatch = accumNumTriangles;
-				}
-				
-			}
-#endif
-			
-			// end of that mash, set it up so we can add the next mesh to this culling batch
-			if (batchChunk->currentBatchCount > 0)
-			{
-				FilterBatchChunk* batchChunk2 = pFilterBatchChunk[frameIdx][currentSmallBatchChunk];
-				++accumDrawCount;
-				
-				batchStart = batchChunk2->currentBatchCount;
-				accumNumTrianglesAtStartOfBatch = accumNumTriangles;
-			}
-			
-		}
-#if SORT_CLUSTERS
-		conf_free(temporaryClusters);
-#endif
-		
-#else
-		for (uint32_t i = 0; i < pScene->numMeshes; ++i)
-		{
-			MeshIn*           drawBatch = &pScene->meshes[i];
-			FilterBatchChunk* batchChunk = pFilterBatchChunk[frameIdx][currentSmallBatchChunk];
-			for (uint32_t j = 0; j < drawBatch->clusterCount; ++j)
-			{
-				++gPerFrame[frameIdx].gTotalClusters;
-				const ClusterCompact* clusterCompactInfo = &drawBatch->clusterCompacts[j];
-				// Run cluster culling
-				if (!gAppSettings.mClusterCulling || !cullCluster(&drawBatch->clusters[j], gPerFrame[frameIdx].gEyeObjectSpace))
-				{
-					// cluster culling passed or is turned off
-					// We will now add the cluster to the batch to be triangle filtered
-					addClusterToBatchChunk(clusterCompactInfo, batchStart, accumDrawCount, accumNumTrianglesAtStartOfBatch, i, batchChunk);
-					accumNumTriangles += clusterCompactInfo->triangleCount;
-				}
+				// The cluster passed culling or culling is turned off
+				// We will now add the cluster to the batch to be triangle filtered
+				const ClusterCompact* clusterCompactInfo = &clusters[j];
+				addClusterToBatchChunk(clusterCompactInfo, batchStart, accumDrawCount, accumNumTrianglesAtStartOfBatch, i, batchChunk);
+				accumNumTriangles += clusterCompactInfo->triangleCount;
 				
 				// check to see if we filled the batch
 				if (batchChunk->currentBatchCount >= BATCH_COUNT)
@@ -5102,7 +4987,6 @@ public:
 				accumNumTrianglesAtStartOfBatch = accumNumTriangles;
 			}
 		}
-#endif
 		
 		gPerFrame[frameIdx].gDrawCount[GEOMSET_OPAQUE] = accumDrawCount;
 		gPerFrame[frameIdx].gDrawCount[GEOMSET_ALPHATESTED] = accumDrawCount;
@@ -5674,6 +5558,17 @@ public:
 			gAppUI.DrawText(
 				cmd, float2(8.0f, 15.0f), eastl::string().sprintf("CPU %f ms", gTimer.GetUSecAverage() / 1000.0f).c_str(), &gFrameTimeDraw);
 
+			const PerFrameData* currentFrame = &gPerFrame[frameIdx];
+			gAppUI.DrawText(
+				cmd, float2(250.0f, 15.0f),
+				eastl::string()
+					.sprintf(
+						"Clusters %u, culled %u outside, %u facing away, %u occluded", currentFrame->gTotalClusters,
+						currentFrame->gCulledClusters[CLUSTER_CULL_FRUSTUM], currentFrame->gCulledClusters[CLUSTER_CULL_BACKFACE],
+						currentFrame->gCulledClusters[CLUSTER_CULL_OCCLUSION])
+					.c_str(),
+				&gFrameTimeDraw);
+
 #if 1
 			// NOTE: Realtime GPU Profiling is not supported on Metal.
 			if (gAppSettings.mAsyncCompute)
@@ -39,14 +39,125 @@ void AnimatedObject::Destroy()
 {
 	ozz::memory::Allocator* allocator = ozz::memory::default_allocator();
 	allocator->Deallocate(mLocalTrans);
+	allocator->Deallocate(mSampledTrans[0]);
+	allocator->Deallocate(mSampledTrans[1]);
 }
 
 bool AnimatedObject::Update(float dt)
 {
+	if (mLODScheduler)
+		return UpdateLOD(dt);
+
 	// sample the current animation to get mLocalTrans
 	if (!mAnimation->Sample(dt, mLocalTrans))
 		return false;
 
+	return LocalToModel();
+}
+
+void AnimatedObject::SetLODScheduler(AnimationLODScheduler* scheduler)
+{
+	mLODScheduler = scheduler;
+	mHasSample = false;
+	mAccumulatedDt = 0.f;
+
+	// Allocates the buffers of the interpolated samples the first time
+	if (mLODScheduler && !mSampledTrans[0].begin)
+	{
+		ozz::memory::Allocator* allocator = ozz::memory::default_allocator();
+		mSampledTrans[0] = allocator->AllocateRange<SoaTransform>(mRig->GetNumSoaJoints());
+		mSampledTrans[1] = allocator->AllocateRange<SoaTransform>(mRig->GetNumSoaJoints());
+	}
+
+	// Back to full detail
+	if (!mLODScheduler)
+	{
+		mRig->SetUpdateBones(true);
+		mAnimation->SetMaxSampledClips(MAX_NUM_CLIPS);
+	}
+}
+
+bool AnimatedObject::UpdateLOD(float dt)
+{
+	// Pick the level from the distance to the camera
+	const float        distance = length(mRootTransform.getTranslation() - mLODScheduler->GetCameraPosition());
+	const unsigned int level = mLODScheduler->GetLevel(distance, mHasSample ? mLODLevel : 0);
+	if (level != mLODLevel || !mHasSample)
+	{
+		const AnimationLODLevel& lod = mLODScheduler->GetLevelDesc(level);
+		mLODLevel = level;
+		mLODPhase = mLODScheduler->AssignPhase(level);
+		mRig->SetUpdateBones(lod.mUpdateBones);
+		mAnimation->SetMaxSampledClips(lod.mMaxClips);
+
+		// Sample right away so interpolation never starts from another level's stale pose
+		mHasSample = false;
+	}
+
+	const AnimationLODLevel& lod = mLODScheduler->GetLevelDesc(mLODLevel);
+	const bool               interpolate = lod.mInterpolate && lod.mUpdateInterval > 1;
+
+	mAccumulatedDt += dt;
+
+	if (!mHasSample || mLODScheduler->IsUpdateFrame(mLODLevel, mLODPhase))
+	{
+		// Sample with the time of all the frames since the last sample so the clips keep their speed
+		const float sampleDt = mAccumulatedDt;
+		mAccumulatedDt = 0.f;
+		mFramesSinceSample = 0;
+
+		if (!interpolate)
+		{
+			mHasSample = true;
+			if (!mAnimation->Sample(sampleDt, mLocalTrans))
+				return false;
+			return LocalToModel();
+		}
+
+		mLastSample ^= 1;
+		if (!mAnimation->Sample(sampleDt, mSampledTrans[mLastSample]))
+			return false;
+
+		// Nothing to interpolate from yet
+		if (!mHasSample)
+		{
+			for (unsigned int i = 0; i < mRig->GetNumSoaJoints(); i++)
+				mSampledTrans[mLastSample ^ 1][i] = mSampledTrans[mLastSample][i];
+			mHasSample = true;
+		}
+	}
+	else if (!interpolate)
+	{
+		// The rig keeps its last pose, Rig::Pose only redoes the world matricies if the root moved
+		return true;
+	}
+	else
+	{
+		mFramesSinceSample++;
+	}
+
+	// Blend from the previous sample to the last one, reaching it right before the next sample is taken.
+	// Runs a delay of one update interval behind the animation in exchange for smooth motion
+	const float alpha = min((mFramesSinceSample + 1.f) / lod.mUpdateInterval, 1.f);
+
+	ozz::animation::BlendingJob::Layer layers[2];
+	layers[0].transform = mSampledTrans[mLastSample ^ 1];
+	layers[0].weight = 1.f - alpha;
+	layers[1].transform = mSampledTrans[mLastSample];
+	layers[1].weight = alpha;
+
+	ozz::animation::BlendingJob blendJob;
+	blendJob.layers = ozz::Range<const ozz::animation::BlendingJob::Layer>(layers, 2);
+	blendJob.bind_pose = mRig->GetSkeleton()->bind_pose();
+	blendJob.output = mLocalTrans;
+	if (!blendJob.Run())
+		return false;
+
+	return LocalToModel();
+}
+
+bool AnimatedObject::LocalToModel()
+{
 	// Local to model job
 
 	// Setup local-to-model conversion job.
@@ -31,6 +31,7 @@
 
 #include "Rig.h"
 #include "Animation.h"
+#include "AnimationLOD.h"
 
 // Responsible for coordinating the posing of a Rig by an Animation
 class AnimatedObject
@@ -45,6 +46,12 @@ class AnimatedObject
 	// To be called every frame of the main application, handles sampling and updating the current animation
 	bool Update(float dt);
 
+	// Throttle the updates of this object based on its distance to the camera, nullptr to always update at full rate
+	void SetLODScheduler(AnimationLODScheduler* scheduler);
+
+	// Get the LOD level used by the last Update
+	inline unsigned int GetLODLevel() { return mLODLevel; };
+
 	// Update mRigs world matricies
 	inline void PoseRig() { mRig->Pose(mRootTransform); };
 
@@ -61,6 +68,12 @@ class AnimatedObject
 	inline Rig* GetRig() { return mRig; };
 
 	private:
+	// Update driven by mLODScheduler
+	bool UpdateLOD(float dt);
+
+	// Converts mLocalTrans to the model matricies of mRig
+	bool LocalToModel();
+
 	// The Rig the AnimatedObject will be posing
 	Rig* mRig;
 
@@ -72,4 +85,26 @@ class AnimatedObject
 
 	// Transform to apply to entire rig
 	Matrix4 mRootTransform = Matrix4::identity();
+
+	// Scheduler deciding the LOD level and update frames, nullptr when not throttled
+	AnimationLODScheduler* mLODScheduler = nullptr;
+
+	// The two last sampled local transforms when interpolating between throttled updates
+	ozz::Range<SoaTransform> mSampledTrans[2];
+
+	// Index in mSampledTrans of the last sample
+	unsigned int mLastSample = 0;
+
+	// Whether a sample was taken since the LOD level changed
+	bool mHasSample = false;
+
+	// Current LOD level and the frame offset of its updates
+	unsigned int mLODLevel = 0;
+	unsigned int mLODPhase = 0;
+
+	// Time that went by since the last sample
+	float mAccumulatedDt = 0.f;
+
+	// Number of frames since the last sample
+	unsigned int mFramesSinceSample = 0;
 };
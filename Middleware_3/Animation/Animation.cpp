@@ -29,6 +29,7 @@ void Animation::Initialize(AnimationDesc animationDesc)
 	mRig = animationDesc.mRig;
 	mNumClips = min(animationDesc.mNumLayers, MAX_NUM_CLIPS);
 	mBlendType = animationDesc.mBlendType;
+	pSamplingCachePool = animationDesc.mSamplingCachePool;
 
 	ozz::memory::Allocator* allocator = ozz::memory::default_allocator();
 
@@ -51,7 +52,14 @@ void Animation::Initialize(AnimationDesc animationDesc)
 			mLongestClipIndex = i;
 		}
 
-		// Prepare input and output of clip sampling
+		// Prepare input and output of clip sampling, leased from the pool while sampling if there is one
+		pClipCacheEntries[i] = nullptr;
+		if (pSamplingCachePool)
+		{
+			mClipLocalTrans[i] = ozz::Range<SoaTransform>();
+			mClipSamplingCaches[i] = nullptr;
+			continue;
+		}
 
 		// Allocates sampler runtime buffers.
 		mClipLocalTrans[i] = allocator->AllocateRange<SoaTransform>(mRig->GetNumSoaJoints());
@@ -93,11 +101,36 @@ bool Animation::Sample(float dt, ozz::Range<SoaTransform>& localTrans)
 		mClipControllers[i]->Update(dt);
 
 		// Early out if this layers weight makes it irrelevant during blending.
-		if (mClipControllers[i]->GetWeight() != 0.f)
+		mClipSampled[i] = mClipControllers[i]->GetWeight() != 0.f;
+
+		// When limited, only the mMaxSampledClips clips with the highest weights are sampled
+		if (mClipSampled[i] && mMaxSampledClips < mNumClips)
 		{
+			unsigned int rank = 0;
+			for (unsigned int j = 0; j < mNumClips; j++)
+			{
+				const float weight = mClipControllers[j]->GetWeight();
+				if (weight > mClipControllers[i]->GetWeight() || (weight == mClipControllers[i]->GetWeight() && j < i))
+					rank++;
+			}
+			mClipSampled[i] = rank < mMaxSampledClips;
+		}
+
+		if (mClipSampled[i])
+		{
+			if (pSamplingCachePool)
+			{
+				pClipCacheEntries[i] = pSamplingCachePool->Acquire();
+				mClipSamplingCaches[i] = pClipCacheEntries[i]->pCache;
+				mClipLocalTrans[i] = ozz::Range<SoaTransform>(pClipCacheEntries[i]->mLocalTrans.begin, mRig->GetNumSoaJoints());
+			}
+
 			//if (!mClips[i]->Sample(mClipControllers[i]->GetTimeRatio()))
 			if (!mClips[i]->Sample(mClipSamplingCaches[i], mClipLocalTrans[i], mClipControllers[i]->GetTimeRatio()))
+			{
+				ReleaseCacheEntries();
 				return false;
+			}
 		}
 	}
 
@@ -105,7 +138,30 @@ bool Animation::Sample(float dt, ozz::Range<SoaTransform>& localTrans)
 	mTimeRatio = mClipControllers[mLongestClipIndex]->GetTimeRatio();
 
 	//blend these samples together
-	return Blend(localTrans);
+	const bool blended = Blend(localTrans);
+
+	// The sampled poses are not needed anymore once blended
+	ReleaseCacheEntries();
+
+	return blended;
+}
+
+void Animation::ReleaseCacheEntries()
+{
+	if (!pSamplingCachePool)
+		return;
+
+	// Released in reverse order so the next animation leases the same cache for the same layer. Consecutive
+	// animations playing the same clips then keep moving the cache forward instead of seeking it again
+	for (unsigned int i = mNumClips; i-- > 0;)
+	{
+		if (pClipCacheEntries[i])
+			pSamplingCachePool->Release(pClipCacheEntries[i]);
+
+		pClipCacheEntries[i] = nullptr;
+		mClipSamplingCaches[i] = nullptr;
+		mClipLocalTrans[i] = ozz::Range<SoaTransform>();
+	}
 }
 
 void Animation::UpdateBlendParameters()
@@ -184,13 +240,17 @@ void Animation::UpdateBlendParameters()
 
 bool Animation::Blend(ozz::Range<SoaTransform>& localTrans)
 {
+	// Clips that were not sampled have no pose to blend, pooled ones do not even have a buffer.
+	// Their weight is 0 so any valid pose does
+	const ozz::Range<const SoaTransform> bindPose = mRig->GetSkeleton()->bind_pose();
+
 	unsigned int additiveIndex = 0;
 	for (unsigned int i = 0; i < mNumClips; i++)
 	{
 		if (mClipControllers[i]->IsAdditive())
 		{
-			mAdditiveLayers[additiveIndex].transform = mClipLocalTrans[i];
-			mAdditiveLayers[additiveIndex].weight = mClipControllers[i]->GetWeight();
+			mAdditiveLayers[additiveIndex].transform = mClipSampled[i] ? mClipLocalTrans[i] : bindPose;
+			mAdditiveLayers[additiveIndex].weight = mClipSampled[i] ? mClipControllers[i]->GetWeight() : 0.f;
 
 			if (mClipMasks[i])
 				mAdditiveLayers[additiveIndex].joint_weights = mClipMasks[i]->GetJointWeights();
@@ -201,8 +261,8 @@ bool Animation::Blend(ozz::Range<SoaTransform>& localTrans)
 		}
 		else
 		{
-			mLayers[i].transform = mClipLocalTrans[i];
-			mLayers[i].weight = mClipControllers[i]->GetWeight();
+			mLayers[i].transform = mClipSampled[i] ? mClipLocalTrans[i] : bindPose;
+			mLayers[i].weight = mClipSampled[i] ? mClipControllers[i]->GetWeight() : 0.f;
 
 			if (mClipMasks[i])
 				mLayers[i].joint_weights = mClipMasks[i]->GetJointWeights();
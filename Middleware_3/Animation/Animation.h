@@ -34,6 +34,7 @@
 #include "Clip.h"
 #include "ClipMask.h"
 #include "ClipController.h"
+#include "SamplingCachePool.h"
 
 // Maximum number of clips that can make up one animation
 const unsigned int MAX_NUM_CLIPS = 10;
@@ -63,6 +64,9 @@ struct AnimationDesc
 	unsigned int  mNumLayers;
 	LayerProperty mLayerProperties[MAX_NUM_CLIPS];
 	BlendType     mBlendType = BlendType::EQUAL;
+	// When set, the sampling caches and sampled clip poses are leased from this pool while sampling
+	// instead of being allocated for every clip of this animation
+	SamplingCachePool* mSamplingCachePool = nullptr;
 };
 
 // Allows for blending and sampling of loaded clips
@@ -99,6 +103,12 @@ class Animation
 	// Gets the address of mThreshold so it can be edited externally
 	inline float* GetThresholdPtr() { return &mThreshold; };
 
+	// Limit the number of clips sampled and blended, only the clips with the highest weights are kept
+	inline void SetMaxSampledClips(unsigned int maxClips) { mMaxSampledClips = maxClips; };
+
+	// Get the number of clips that make up the animation
+	inline unsigned int GetNumClips() { return mNumClips; };
+
 	private:
 	// Sets the various blend parameters based on the type of blend set
 	void UpdateBlendParameters();
@@ -106,6 +116,9 @@ class Animation
 	// Blend the sampled clips together based on their blend parameters
 	bool Blend(ozz::Range<SoaTransform>& localTrans);
 
+	// Return the entries leased from the sampling cache pool by Sample
+	void ReleaseCacheEntries();
+
 	// Pointer to the rig that this animation corresponds to
 	Rig* mRig;
 
@@ -118,9 +131,18 @@ class Animation
 	// Array of clip masks that can alter per joint weights of clips
 	ClipMask* mClipMasks[MAX_NUM_CLIPS];
 
+	// Whether each clip was sampled by the last Sample call and takes part in the blend
+	bool mClipSampled[MAX_NUM_CLIPS];
+
 	// Sampling cache that will be given as input when each clip is sampled
 	ozz::animation::SamplingCache* mClipSamplingCaches[MAX_NUM_CLIPS];
 
+	// Pool the sampling caches and local transforms are leased from, if any
+	SamplingCachePool* pSamplingCachePool = nullptr;
+
+	// Entries leased from pSamplingCachePool during a Sample call
+	SamplingCacheEntry* pClipCacheEntries[MAX_NUM_CLIPS];
+
 	// The buffer of local transforms that will be updated as output when each clip is sampled
 	ozz::Range<SoaTransform> mClipLocalTrans[MAX_NUM_CLIPS];
 
@@ -134,6 +156,9 @@ class Animation
 	// Number of clips that are additive
 	unsigned int mNumAdditiveClips = 0;
 
+	// Maximum number of clips sampled each Sample call, used to reduce the cost of distant animations
+	unsigned int mMaxSampledClips = MAX_NUM_CLIPS;
+
 	// Index in mClips that gives the longest clip
 	unsigned int mLongestClipIndex = 0;
 
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "AnimationLOD.h"
+
+void AnimationLODScheduler::Initialize(const AnimationLODDesc& desc)
+{
+	ASSERT(desc.mNumLevels > 0);
+
+	mNumLevels = min(desc.mNumLevels, MAX_ANIMATION_LODS);
+	for (unsigned int i = 0; i < mNumLevels; i++)
+	{
+		mLevels[i] = desc.mLevels[i];
+		mLevels[i].mUpdateInterval = max(mLevels[i].mUpdateInterval, 1u);
+		mLevels[i].mMaxClips = max(mLevels[i].mMaxClips, 1u);
+		tfrg_atomic64_store_relaxed(&mNextPhase[i], 0);
+	}
+
+	mHysteresis = clamp(desc.mHysteresis, 0.f, 1.f);
+	mFrameIndex = 0;
+}
+
+void AnimationLODScheduler::Update(const Vector3& cameraPosition)
+{
+	mCameraPosition = cameraPosition;
+	mFrameIndex++;
+}
+
+unsigned int AnimationLODScheduler::GetLevel(float distance, unsigned int currentLevel) const
+{
+	// The thresholds of the levels up to the current one are moved closer, so leaving a level takes more than
+	// entering it
+	unsigned int level = 0;
+	while (level + 1 < mNumLevels)
+	{
+		const float scale = level + 1 <= currentLevel ? 1.f - mHysteresis : 1.f;
+		if (distance < mLevels[level + 1].mMinDistance * scale)
+			break;
+		level++;
+	}
+	return level;
+}
+
+unsigned int AnimationLODScheduler::AssignPhase(unsigned int level)
+{
+	return (unsigned int)(tfrg_atomic64_add_relaxed(&mNextPhase[level], 1) % mLevels[level].mUpdateInterval);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+#include "../../Common_3/OS/Math/MathTypes.h"
+#include "../../Common_3/OS/Core/Atomics.h"
+
+#include "Animation.h"
+
+// Maximum number of LOD levels of an AnimationLODScheduler
+const unsigned int MAX_ANIMATION_LODS = 4;
+
+// How an AnimatedObject is updated once it is at least mMinDistance away from the camera
+struct AnimationLODLevel
+{
+	// Distance to the camera from which this level is used
+	float        mMinDistance = 0.f;
+	// The animation is sampled every mUpdateInterval frames
+	unsigned int mUpdateInterval = 1;
+	// Maximum number of clips sampled, the clips with the highest weights are kept
+	unsigned int mMaxClips = MAX_NUM_CLIPS;
+	// Blend from the previous to the last sampled pose on the frames in between samples,
+	// otherwise the rig keeps the last sampled pose until the next sample
+	bool         mInterpolate = true;
+	// Update the bone matrices and joint scales of the rig
+	bool         mUpdateBones = true;
+};
+
+// User will have to predefine to pass into AnimationLODScheduler's Initialize function
+struct AnimationLODDesc
+{
+	// Levels sorted by increasing mMinDistance, the first level should start at 0
+	unsigned int      mNumLevels;
+	AnimationLODLevel mLevels[MAX_ANIMATION_LODS];
+	// An object only goes back to a finer level once it is closer than (1 - mHysteresis) * mMinDistance of its level,
+	// so objects around a threshold do not switch levels every frame
+	float             mHysteresis = 0.1f;
+};
+
+// Shared by all the AnimatedObjects of a scene to decide how often and how detailed each of them is updated.
+// Objects select a level from their distance to the camera. Throttled objects of a level are given
+// different frames to update on, so with an interval of 4 a quarter of them is sampled every frame
+// instead of all of them every 4th frame. The objects can be updated from several threads at once.
+class AnimationLODScheduler
+{
+	public:
+	// Set up the scheduler with the LOD levels
+	void Initialize(const AnimationLODDesc& desc);
+
+	// To be called every frame of the main application, before the AnimatedObjects are updated
+	void Update(const Vector3& cameraPosition);
+
+	// Gets the level used at distance from the camera by an object currently at currentLevel
+	unsigned int GetLevel(float distance, unsigned int currentLevel) const;
+
+	// Gets the frame offset for an object entering level, handed out in turn so updates spread over the interval.
+	// Thread safe
+	unsigned int AssignPhase(unsigned int level);
+
+	// Whether an object of level with phase samples its animation this frame
+	inline bool IsUpdateFrame(unsigned int level, unsigned int phase) const
+	{
+		return (mFrameIndex + phase) % mLevels[level].mUpdateInterval == 0;
+	};
+
+	// Gets the properties of level
+	inline const AnimationLODLevel& GetLevelDesc(unsigned int level) const { return mLevels[level]; };
+
+	// Gets the camera position given to the last Update
+	inline const Vector3& GetCameraPosition() const { return mCameraPosition; };
+
+	private:
+	// LOD levels sorted by increasing distance
+	AnimationLODLevel mLevels[MAX_ANIMATION_LODS];
+
+	// Number of LOD levels
+	unsigned int mNumLevels = 0;
+
+	// Fraction of mMinDistance an object has to come closer to go back to a finer level
+	float mHysteresis = 0.f;
+
+	// Number of phases handed out for each level, objects entering a level from several threads take turns
+	tfrg_atomic64_t mNextPhase[MAX_ANIMATION_LODS] = {};
+
+	// Number of Update calls
+	uint64_t mFrameIndex = 0;
+
+	// Position the distances of the objects are measured from
+	Vector3 mCameraPosition = Vector3(0.f);
+};
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#include "AnimationSystem.h"
+
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/sort.h"
+#include "../../Common_3/OS/Core/ThreadSystem.h"
+
+void AnimationSystem::Initialize(ThreadSystem* threadSystem, unsigned int grainSize)
+{
+	pThreadSystem = threadSystem;
+	mGrainSize = max(grainSize, 1u);
+	mUpdateOrderDirty = true;
+	mFailed = 0;
+}
+
+void AnimationSystem::Destroy()
+{
+	ozz::memory::Allocator* allocator = ozz::memory::default_allocator();
+
+	for (unsigned int i = 0; i < (unsigned int)mTaskCaches.size(); i++)
+		allocator->Delete(mTaskCaches[i]);
+	allocator->Deallocate(mScratch);
+
+	mRigs.set_capacity(0);
+	mRootTransforms.set_capacity(0);
+	mFirstLayers.set_capacity(0);
+	mNumLayers.set_capacity(0);
+	mLoop.set_capacity(0);
+	mPlay.set_capacity(0);
+	mLayerClips.set_capacity(0);
+	mLayerMasks.set_capacity(0);
+	mLayerInstances.set_capacity(0);
+	mLayerAdditive.set_capacity(0);
+	mLayerWeights.set_capacity(0);
+	mLayerSpeeds.set_capacity(0);
+	mLayerInvDurations.set_capacity(0);
+	mLayerTimeRatios.set_capacity(0);
+	mUpdateOrder.set_capacity(0);
+	mTaskCaches.set_capacity(0);
+
+	mScratchStride = 0;
+	mScratchTaskCount = 0;
+	mTaskCacheNumJoints = 0;
+	mMaxNumLayers = 0;
+	mMaxNumSoaJoints = 0;
+	mMaxNumJoints = 0;
+	mUpdateOrderDirty = true;
+}
+
+unsigned int AnimationSystem::AddInstance(const AnimationInstanceDesc& desc)
+{
+	ASSERT(desc.mRig && desc.mNumLayers > 0);
+
+	const unsigned int instance = (unsigned int)mRigs.size();
+	const unsigned int numLayers = min(desc.mNumLayers, MAX_NUM_CLIPS);
+
+	mRigs.push_back(desc.mRig);
+	mRootTransforms.push_back(desc.mRootTransform);
+	mFirstLayers.push_back((uint32_t)mLayerClips.size());
+	mNumLayers.push_back(numLayers);
+	mLoop.push_back(desc.mLoop ? 1 : 0);
+	mPlay.push_back(1);
+
+	for (unsigned int i = 0; i < numLayers; i++)
+	{
+		const AnimationLayerDesc& layer = desc.mLayers[i];
+		mLayerClips.push_back(layer.mClip);
+		mLayerMasks.push_back(layer.mClipMask);
+		mLayerInstances.push_back(instance);
+		mLayerAdditive.push_back(layer.mAdditive ? 1 : 0);
+		mLayerWeights.push_back(layer.mWeight);
+		mLayerSpeeds.push_back(layer.mPlaybackSpeed);
+		mLayerInvDurations.push_back(1.f / layer.mClip->GetDuration());
+		mLayerTimeRatios.push_back(desc.mTimeRatio);
+	}
+
+	mMaxNumLayers = max(mMaxNumLayers, numLayers);
+	mMaxNumSoaJoints = max(mMaxNumSoaJoints, desc.mRig->GetNumSoaJoints());
+	mMaxNumJoints = max(mMaxNumJoints, desc.mRig->GetNumJoints());
+	mUpdateOrderDirty = true;
+
+	return instance;
+}
+
+void AnimationSystem::PrepareUpdate()
+{
+	const unsigned int numInstances = GetNumInstances();
+
+	// Consecutive instances sampling the same clips reuse the animation keyframes that are already in cache
+	mUpdateOrder.resize(numInstances);
+	for (unsigned int i = 0; i < numInstances; i++)
+		mUpdateOrder[i] = i;
+
+	const eastl::vector<Clip*>&    layerClips = mLayerClips;
+	const eastl::vector<uint32_t>& firstLayers = mFirstLayers;
+	const eastl::vector<Rig*>&     rigs = mRigs;
+	eastl::sort(mUpdateOrder.begin(), mUpdateOrder.end(), [&](uint32_t a, uint32_t b) {
+		const Clip* clipA = layerClips[firstLayers[a]];
+		const Clip* clipB = layerClips[firstLayers[b]];
+		if (clipA != clipB)
+			return clipA < clipB;
+		if (rigs[a]->GetNumSoaJoints() != rigs[b]->GetNumSoaJoints())
+			return rigs[a]->GetNumSoaJoints() < rigs[b]->GetNumSoaJoints();
+		return a < b;
+	});
+
+	// Scratch for every task so they never share output buffers
+	const unsigned int taskCount = (numInstances + mGrainSize - 1) / mGrainSize;
+	const unsigned int stride = (mMaxNumLayers + 1) * mMaxNumSoaJoints;
+	if (taskCount != mScratchTaskCount || stride != mScratchStride)
+	{
+		ozz::memory::Allocator* allocator = ozz::memory::default_allocator();
+		allocator->Deallocate(mScratch);
+		mScratch = allocator->AllocateRange<SoaTransform>(taskCount * stride);
+		mScratchTaskCount = taskCount;
+		mScratchStride = stride;
+	}
+
+	// A cache per task and layer instead of per instance. Consecutive instances play the same clip so the
+	// cache stays warm, and thousands of instances do not each drag their own cache through memory.
+	// Rigs with more joints can share the soa joint count of the old largest one, so the stride alone does not tell
+	// whether the caches are still large enough
+	const unsigned int cacheCount = taskCount * mMaxNumLayers;
+	if (cacheCount != (unsigned int)mTaskCaches.size() || mMaxNumJoints != mTaskCacheNumJoints)
+	{
+		ozz::memory::Allocator* allocator = ozz::memory::default_allocator();
+		for (unsigned int i = 0; i < (unsigned int)mTaskCaches.size(); i++)
+			allocator->Delete(mTaskCaches[i]);
+		mTaskCaches.resize(cacheCount);
+		for (unsigned int i = 0; i < cacheCount; i++)
+			mTaskCaches[i] = allocator->New<ozz::animation::SamplingCache>(mMaxNumJoints);
+		mTaskCacheNumJoints = mMaxNumJoints;
+	}
+
+	mUpdateOrderDirty = false;
+}
+
+void AnimationSystem::UpdateClocks(float dt)
+{
+	// Same time update as ClipController::Update, done for all layers in one flat loop
+	const unsigned int numLayers = (unsigned int)mLayerTimeRatios.size();
+	for (unsigned int i = 0; i < numLayers; i++)
+	{
+		const uint32_t instance = mLayerInstances[i];
+		const float    time = mLayerTimeRatios[i] + (mPlay[instance] ? dt * mLayerSpeeds[i] * mLayerInvDurations[i] : 0.f);
+
+		// Wraps in the unit interval [0:1], even for negative values, or clamps if not looping
+		mLayerTimeRatios[i] = mLoop[instance] ? time - floorf(time) : clamp(time, 0.f, 1.f);
+	}
+}
+
+bool AnimationSystem::UpdateInstances(unsigned int task, unsigned int first, unsigned int count)
+{
+	ozz::animation::BlendingJob::Layer layers[MAX_NUM_CLIPS];
+	ozz::animation::BlendingJob::Layer additiveLayers[MAX_NUM_CLIPS];
+	SoaTransform*                      pScratch = mScratch.begin + task * mScratchStride;
+	ozz::animation::SamplingCache**    ppCaches = &mTaskCaches[task * mMaxNumLayers];
+
+	for (unsigned int i = first; i < first + count; i++)
+	{
+		const uint32_t instance = mUpdateOrder[i];
+		Rig*           rig = mRigs[instance];
+		const uint32_t numSoaJoints = rig->GetNumSoaJoints();
+		const uint32_t firstLayer = mFirstLayers[instance];
+		const uint32_t numLayers = mNumLayers[instance];
+
+		ozz::Range<SoaTransform> blended(pScratch + mMaxNumLayers * mMaxNumSoaJoints, numSoaJoints);
+
+		// A single full weight layer does not need blending, sample straight into the pose
+		if (numLayers == 1 && !mLayerAdditive[firstLayer] && mLayerWeights[firstLayer] == 1.f && !mLayerMasks[firstLayer])
+		{
+			if (!mLayerClips[firstLayer]->Sample(ppCaches[0], blended, mLayerTimeRatios[firstLayer]))
+				return false;
+		}
+		else
+		{
+			unsigned int numBlendLayers = 0;
+			unsigned int numAdditiveLayers = 0;
+			for (unsigned int l = 0; l < numLayers; l++)
+			{
+				const uint32_t layer = firstLayer + l;
+
+				// Early out if this layers weight makes it irrelevant during blending.
+				if (mLayerWeights[layer] == 0.f)
+					continue;
+
+				ozz::Range<SoaTransform> layerTrans(pScratch + l * mMaxNumSoaJoints, numSoaJoints);
+				if (!mLayerClips[layer]->Sample(ppCaches[l], layerTrans, mLayerTimeRatios[layer]))
+					return false;
+
+				ozz::animation::BlendingJob::Layer& blendLayer =
+					mLayerAdditive[layer] ? additiveLayers[numAdditiveLayers++] : layers[numBlendLayers++];
+				blendLayer.transform = layerTrans;
+				blendLayer.weight = mLayerWeights[layer];
+				if (mLayerMasks[layer])
+					blendLayer.joint_weights = mLayerMasks[layer]->GetJointWeights();
+				else
+					blendLayer.joint_weights = ozz::Range<const Vector4>();
+			}
+
+			ozz::animation::BlendingJob blendJob;
+			blendJob.layers = ozz::Range<const ozz::animation::BlendingJob::Layer>(layers, numBlendLayers);
+			blendJob.additive_layers = ozz::Range<const ozz::animation::BlendingJob::Layer>(additiveLayers, numAdditiveLayers);
+			blendJob.bind_pose = rig->GetSkeleton()->bind_pose();
+			blendJob.output = blended;
+			if (!blendJob.Run())
+				return false;
+		}
+
+		ozz::animation::LocalToModelJob ltmJob;
+		ltmJob.skeleton = rig->GetSkeleton();
+		ltmJob.input = blended;
+		ltmJob.output = rig->GetJointModelMats();
+		if (!ltmJob.Run())
+			return false;
+
+		rig->Pose(mRootTransforms[instance]);
+	}
+
+	return true;
+}
+
+void AnimationSystem::UpdateTask(void* pData, uintptr_t task)
+{
+	AnimationSystem*   system = (AnimationSystem*)pData;
+	const unsigned int first = (unsigned int)task * system->mGrainSize;
+	const unsigned int count = min(system->mGrainSize, system->GetNumInstances() - first);
+
+	if (!system->UpdateInstances((unsigned int)task, first, count))
+		tfrg_atomic32_store_relaxed(&system->mFailed, 1);
+}
+
+bool AnimationSystem::Update(float dt)
+{
+	if (mRigs.empty())
+		return true;
+
+	if (mUpdateOrderDirty)
+		PrepareUpdate();
+
+	UpdateClocks(dt);
+
+	mFailed = 0;
+	if (pThreadSystem && mScratchTaskCount > 1)
+	{
+		addThreadSystemRangeTask(pThreadSystem, &AnimationSystem::UpdateTask, this, mScratchTaskCount);
+		waitThreadSystemIdle(pThreadSystem);
+	}
+	else
+	{
+		for (unsigned int i = 0; i < mScratchTaskCount; i++)
+			UpdateTask(this, i);
+	}
+
+	return tfrg_atomic32_load_relaxed(&mFailed) == 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+#include "../../Common_3/OS/Math/MathTypes.h"
+#include "../../Common_3/OS/Core/Atomics.h"
+
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/vector.h"
+
+#include "../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/runtime/blending_job.h"
+#include "../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/runtime/local_to_model_job.h"
+#include "../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/runtime/sampling_job.h"
+
+#include "Rig.h"
+#include "Clip.h"
+#include "ClipMask.h"
+#include "Animation.h"
+
+struct ThreadSystem;
+
+// Properties of one clip layer of an instance
+struct AnimationLayerDesc
+{
+	Clip*     mClip;
+	ClipMask* mClipMask = nullptr;
+	float     mWeight = 1.0f;
+	float     mPlaybackSpeed = 1.0f;
+	bool      mAdditive = false;
+};
+
+// User will have to predefine to pass into AnimationSystem's AddInstance function
+struct AnimationInstanceDesc
+{
+	// The Rig the instance poses. Every instance needs its own Rig as the rig stores the posed matrices
+	Rig*               mRig;
+	unsigned int       mNumLayers;
+	AnimationLayerDesc mLayers[MAX_NUM_CLIPS];
+	Matrix4            mRootTransform = Matrix4::identity();
+	// Initial time ratio [0,1] of all layers
+	float              mTimeRatio = 0.f;
+	bool               mLoop = true;
+};
+
+// Updates large numbers of animated rigs in one batched pass.
+// Instead of every AnimatedObject running its own sampling, blending and local to model jobs, all the
+// instance and layer state is stored in flat arrays and instances are processed in an order grouped by
+// clip and skeleton size, so the same animation data stays in cache while it is sampled by consecutive
+// instances. Sample, blend, local to model and Rig::Pose run as one pass split in tasks over a ThreadSystem.
+class AnimationSystem
+{
+	public:
+	// Set up the system. Updates are run on pThreadSystem if given, grainSize instances per task
+	void Initialize(ThreadSystem* pThreadSystem = nullptr, unsigned int grainSize = 64);
+
+	// Must be called to clean up the system if it has been initialized
+	void Destroy();
+
+	// Adds an instance and returns its index
+	unsigned int AddInstance(const AnimationInstanceDesc& desc);
+
+	// Advances all clocks by dt and poses every instance's rig
+	bool Update(float dt);
+
+	// Set the root transform of the instance
+	inline void SetRootTransform(unsigned int instance, const Matrix4& rootTransform) { mRootTransforms[instance] = rootTransform; };
+
+	// Set the blend weight of one layer of the instance
+	inline void SetLayerWeight(unsigned int instance, unsigned int layer, float weight)
+	{
+		mLayerWeights[mFirstLayers[instance] + layer] = weight;
+	};
+
+	// Set the playback speed of one layer of the instance
+	inline void SetLayerPlaybackSpeed(unsigned int instance, unsigned int layer, float speed)
+	{
+		mLayerSpeeds[mFirstLayers[instance] + layer] = speed;
+	};
+
+	// Hard set the time ratio [0,1] of one layer of the instance
+	inline void SetLayerTimeRatio(unsigned int instance, unsigned int layer, float timeRatio)
+	{
+		mLayerTimeRatios[mFirstLayers[instance] + layer] = timeRatio;
+	};
+
+	// Get the time ratio [0,1] of one layer of the instance
+	inline float GetLayerTimeRatio(unsigned int instance, unsigned int layer) { return mLayerTimeRatios[mFirstLayers[instance] + layer]; };
+
+	// Pause or resume all layers of the instance
+	inline void SetPlay(unsigned int instance, bool play) { mPlay[instance] = play ? 1 : 0; };
+
+	// Get the rig of the instance
+	inline Rig* GetRig(unsigned int instance) { return mRigs[instance]; };
+
+	// Get the number of instances
+	inline unsigned int GetNumInstances() { return (unsigned int)mRigs.size(); };
+
+	private:
+	// Builds the grouped update order and the per task scratch buffers
+	void PrepareUpdate();
+
+	// Advances the time ratio of every layer
+	void UpdateClocks(float dt);
+
+	// Sample, blend, local to model and pose the instances mUpdateOrder[first, first + count)
+	bool UpdateInstances(unsigned int task, unsigned int first, unsigned int count);
+
+	static void UpdateTask(void* pData, uintptr_t task);
+
+	ThreadSystem* pThreadSystem;
+	unsigned int  mGrainSize;
+
+	// Per instance data
+	eastl::vector<Rig*>     mRigs;
+	eastl::vector<Matrix4>  mRootTransforms;
+	eastl::vector<uint32_t> mFirstLayers;
+	eastl::vector<uint32_t> mNumLayers;
+	eastl::vector<uint8_t>  mLoop;
+	eastl::vector<uint8_t>  mPlay;
+
+	// Per layer data, the layers of an instance are contiguous
+	eastl::vector<Clip*>                          mLayerClips;
+	eastl::vector<ClipMask*>                      mLayerMasks;
+	eastl::vector<uint32_t>                       mLayerInstances;
+	eastl::vector<uint8_t>                        mLayerAdditive;
+	eastl::vector<float>                          mLayerWeights;
+	eastl::vector<float>                          mLayerSpeeds;
+	eastl::vector<float>                          mLayerInvDurations;
+	eastl::vector<float>                          mLayerTimeRatios;
+
+	// Instance indices grouped by clip and skeleton size
+	eastl::vector<uint32_t> mUpdateOrder;
+	bool                    mUpdateOrderDirty = true;
+
+	// Sampled layers and blended pose of each task: (max layers + 1) * max soa joints transforms
+	ozz::Range<SoaTransform>                      mScratch;
+	// Sampling caches of each task: max layers caches of mTaskCacheNumJoints joints
+	eastl::vector<ozz::animation::SamplingCache*> mTaskCaches;
+	unsigned int             mScratchStride = 0;
+	unsigned int             mScratchTaskCount = 0;
+	unsigned int             mTaskCacheNumJoints = 0;
+	unsigned int             mMaxNumLayers = 0;
+	unsigned int             mMaxNumSoaJoints = 0;
+	unsigned int             mMaxNumJoints = 0;
+
+	// Set by tasks when any job failed during the update
+	tfrg_atomic32_t mFailed;
+};
@@ -24,12 +24,56 @@
 
 #include "Clip.h"
 
+#include "../../Common_3/OS/Interfaces/IThread.h"
+#include "../../Common_3/OS/Interfaces/IMemoryManager.h"
+
+// Pose of the clip at one interval, shared by every rig sampling it there
+struct ClipSharedPose
+{
+	Mutex                    mMutex;
+	int                      mFrame = -1;
+	ozz::Range<SoaTransform> mLocalTrans;
+};
+
 void Clip::Initialize(const char* animationFile, Rig* rig) { LoadClip(animationFile); }
 
-void Clip::Destroy() { mAnimation.Deallocate(); }
+void Clip::Destroy()
+{
+	ozz::memory::Allocator* allocator = ozz::memory::default_allocator();
+
+	for (unsigned int i = 0; i < mNumSharedPoses; i++)
+	{
+		allocator->Deallocate(pSharedPoses[i].mLocalTrans);
+		pSharedPoses[i].~ClipSharedPose();
+	}
+	conf_free(pSharedPoses);
+	pSharedPoses = nullptr;
+	mNumSharedPoses = 0;
+
+	mAnimation.Deallocate();
+}
+
+void Clip::EnableSharedSampling(float sampleRate, unsigned int numSlots)
+{
+	ASSERT(!pSharedPoses && sampleRate > 0.f && numSlots > 0);
+
+	ozz::memory::Allocator* allocator = ozz::memory::default_allocator();
+
+	mNumSharedFrames = max((unsigned int)ceilf(GetDuration() * sampleRate), 1u);
+	mNumSharedPoses = numSlots;
+	pSharedPoses = (ClipSharedPose*)conf_calloc(mNumSharedPoses, sizeof(ClipSharedPose));
+	for (unsigned int i = 0; i < mNumSharedPoses; i++)
+	{
+		conf_placement_new<ClipSharedPose>(&pSharedPoses[i]);
+		pSharedPoses[i].mLocalTrans = allocator->AllocateRange<SoaTransform>(mAnimation.num_soa_tracks());
+	}
+}
 
 bool Clip::Sample(ozz::animation::SamplingCache* cacheInput, ozz::Range<SoaTransform>& localTransOutput, float timeRatio)
 {
+	if (pSharedPoses)
+		return SampleShared(cacheInput, localTransOutput, timeRatio);
+
 	// Setup sampling job.
 	ozz::animation::SamplingJob samplingJob;
 	samplingJob.animation = &mAnimation;
@@ -44,6 +88,43 @@ bool Clip::Sample(ozz::animation::SamplingCache* cacheInput, ozz::Range<SoaTrans
 	return true;
 }
 
+bool Clip::SampleShared(ozz::animation::SamplingCache* cacheInput, ozz::Range<SoaTransform>& localTransOutput, float timeRatio)
+{
+	const unsigned int numSoaTracks = (unsigned int)mAnimation.num_soa_tracks();
+	if (localTransOutput.count() < numSoaTracks)
+		return false;
+
+	// Snap to the closest interval, the slots are reused round robin as the clip plays
+	const int       frame = (int)(clamp(timeRatio, 0.f, 1.f) * mNumSharedFrames + 0.5f);
+	ClipSharedPose& pose = pSharedPoses[frame % mNumSharedPoses];
+
+	MutexLock lock(pose.mMutex);
+	if (pose.mFrame == frame)
+	{
+		tfrg_atomic64_add_relaxed(&mNumSharedSamples, 1);
+	}
+	else
+	{
+		ozz::animation::SamplingJob samplingJob;
+		samplingJob.animation = &mAnimation;
+		samplingJob.cache = cacheInput;
+		samplingJob.ratio = (float)frame / mNumSharedFrames;
+		samplingJob.output = pose.mLocalTrans;
+
+		if (!samplingJob.Run())
+		{
+			pose.mFrame = -1;
+			return false;
+		}
+
+		pose.mFrame = frame;
+	}
+
+	for (unsigned int i = 0; i < numSoaTracks; ++i)
+		localTransOutput.begin[i] = pose.mLocalTrans.begin[i];
+	return true;
+}
+
 bool Clip::LoadClip(const char* fileName)
 {
 	ozz::io::File file(fileName, "rb");
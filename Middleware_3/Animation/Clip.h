@@ -25,6 +25,7 @@
 #pragma once
 
 #include "../../Common_3/OS/Math/MathTypes.h"
+#include "../../Common_3/OS/Core/Atomics.h"
 
 #include "../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/runtime/animation.h"
 #include "../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/runtime/sampling_job.h"
@@ -35,6 +36,8 @@
 
 #include "Rig.h"
 
+struct ClipSharedPose;
+
 //Responsible for loading and storing a clip. Only need one per clip file
 //all rigs can sample the same clip object
 class Clip
@@ -52,10 +55,32 @@ class Clip
 	// Get the length of the clip
 	inline float GetDuration() { return mAnimation.duration(); };
 
+	// Lets the rigs sampling this clip at the same time share one sampled pose. Sample snaps the time to
+	// intervals of 1/sampleRate seconds, and the poses of the last numSlots intervals sampled are kept so
+	// a crowd playing the clip in step samples it once and copies the pose for every other character.
+	// Rigs playing the clip at unrelated times gain nothing, so only enable it for such crowds
+	void EnableSharedSampling(float sampleRate = 30.f, unsigned int numSlots = 4);
+
+	// Get the number of samples served from a shared pose instead of running the sampling job
+	inline uint64_t GetNumSharedSamples() { return tfrg_atomic64_load_relaxed(&mNumSharedSamples); };
+
 	private:
 	// Load a clip from an ozz animation file
 	bool LoadClip(const char* animationFile);
 
+	// Sample through the shared poses
+	bool SampleShared(ozz::animation::SamplingCache* cacheInput, ozz::Range<SoaTransform>& localTransOutput, float timeRatio);
+
 	// Runtime animation.
 	ozz::animation::Animation mAnimation;
+
+	// Poses shared by the rigs sampling the same interval, null if shared sampling is not enabled
+	ClipSharedPose* pSharedPoses = nullptr;
+	unsigned int    mNumSharedPoses = 0;
+
+	// Number of intervals the clip is split into by shared sampling
+	unsigned int mNumSharedFrames = 0;
+
+	// Samples served from a shared pose
+	tfrg_atomic64_t mNumSharedSamples = 0;
 };
\ No newline at end of file
@@ -44,6 +44,8 @@ void Rig::Initialize(const char* skeletonFile)
 	}
 
 	mJointWorldMats = eastl::vector<Matrix4>(mNumJoints, Matrix4::identity());
+	mJointWorldMatsNoScale = eastl::vector<Matrix4>(mNumJoints, Matrix4::identity());
+	mPoseDirty = true;
 	mBoneWorldMats = eastl::vector<Matrix4>(mNumJoints, Matrix4::identity());
 	mJointScales = eastl::vector<Vector3>(mNumJoints, Vector3(1.0f, 1.0f, 1.0f));
 
@@ -60,73 +62,170 @@ void Rig::Destroy()
 	allocator->Deallocate(mJointModelMats);
 }
 
-void Rig::Pose(const Matrix4& rootTransform)
+// Normalizes 4 vectors at once with the same Newton-Raphson refined reciprocal square root estimate as normalize
+static inline SoaFloat3 NormalizeEst(const SoaFloat3& v) { return v * rSqrtEstNR(Dot(v, v)); }
+
+// Transforms 4 vectors (w = 0) or points (w = 1) by a matrix given as splatted elements splats[col][row]
+// and transposes the results back to one Vector4 per vector
+static inline void TransformSoa(const Vector4 splats[4][4], const SoaFloat3& v, bool point, Vector4 out[4])
 {
-	// Set the world matrix of each joint
-	for (unsigned int jointIndex = 0; jointIndex < mNumJoints; jointIndex++)
+	Vector4 soa[4];
+	for (unsigned int row = 0; row < 4; row++)
 	{
-		mJointWorldMats[jointIndex] = rootTransform * mJointModelMats[jointIndex];
+		soa[row] = mulPerElem(splats[0][row], v.x) + mulPerElem(splats[1][row], v.y) + mulPerElem(splats[2][row], v.z);
+		if (point)
+			soa[row] += splats[3][row];
 	}
+	transpose4x4(soa, out);
+}
 
-	// If we wish to update the world matricies of the bones and the scales of the joints
-	// based on the distance between each joint
-	if (mUpdateBones)
+void Rig::Pose(const Matrix4& rootTransform)
+{
+	// Skip the whole pass if neither the joint model matrices nor the root transform changed since the last pose
+	if (!mPoseDirty && memcmp(&mPosedRootTransform, &rootTransform, sizeof(Matrix4)) == 0)
+		return;
+
+	mPosedRootTransform = rootTransform;
+	mPoseDirty = false;
+
+	const ozz::Range<const ozz::animation::Skeleton::JointProperties> properties = mSkeleton.joint_properties();
+
+	// Root transform elements broadcast to all 4 lanes, to place 4 bones at once
+	Vector4 rootSplats[4][4];
+	for (unsigned int col = 0; col < 4; col++)
+		for (unsigned int row = 0; row < 4; row++)
+			rootSplats[col][row] = Vector4(rootTransform[col].getElem(row));
+
+	// Store smallest bone lenth to be reused for root joint scale
+	float minBoneLen = 0.f;
+	bool  minBoneLenSet = false;
+
+	// Joints are processed 4 at a time, the columns of the 4 matrices are transposed so the normalizations,
+	// cross products and lengths are computed once for all 4 joints. The last block repeats its last joint
+	for (unsigned int first = 0; first < mNumJoints; first += 4)
 	{
+		const unsigned int count = min(mNumJoints - first, 4u);
+
+		unsigned int childIndices[4];
+		unsigned int parentIndices[4];
+		Matrix4      worldMats[4];
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			childIndices[i] = first + min(i, count - 1);
+			const unsigned int parent = properties[childIndices[i]].parent;
+			// Joints without a parent make a bone with themselves, which is discarded below
+			parentIndices[i] = parent == ozz::animation::Skeleton::kNoParentIndex ? childIndices[i] : parent;
+
+			// Set the world matrix of each joint
+			worldMats[i] = rootTransform * mJointModelMats[childIndices[i]];
+		}
+
+		// World matrix of each joint without scale: normalize the first three collumns
+		Vector4 noScaleCols[3][4];
+		for (unsigned int col = 0; col < 3; col++)
+		{
+			const Vector4 aos[4] = { worldMats[0][col], worldMats[1][col], worldMats[2][col], worldMats[3][col] };
+			Vector4       soa[4];
+			transpose4x4(aos, soa);
+			const SoaFloat3 axis = NormalizeEst(SoaFloat3::Load(soa[0], soa[1], soa[2]));
+			soa[0] = axis.x;
+			soa[1] = axis.y;
+			soa[2] = axis.z;
+			transpose4x4(soa, noScaleCols[col]);
+		}
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			mJointWorldMats[first + i] = worldMats[i];
+			mJointWorldMatsNoScale[first + i] = mat4(noScaleCols[0][i], noScaleCols[1][i], noScaleCols[2][i], worldMats[i].getCol3());
+		}
+
+		// If we wish to update the world matricies of the bones and the scales of the joints
+		// based on the distance between each joint
+		if (!mUpdateBones)
+			continue;
+
 		// Traverses through the skeleton's joint hierarchy, placing bones between
 		// joints and altering the size of joints and bones to reflect distances
 		// between joints
+		Vector4 parentPos[4];
+		Vector4 childPos[4];
+		Vector4 parentCol1[4];
+		Vector4 parentCol2[4];
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			// Selects joint matrices.
+			const Matrix4& parentMat = mJointModelMats[parentIndices[i]];
+			parentPos[i] = parentMat.getCol3();
+			parentCol1[i] = parentMat.getCol1();
+			parentCol2[i] = parentMat.getCol2();
+			childPos[i] = mJointModelMats[childIndices[i]].getCol3();
+		}
+
+		Vector4 soa[4];
+		transpose4x4(parentPos, soa);
+		const SoaFloat3 parentPosSoa = SoaFloat3::Load(soa[0], soa[1], soa[2]);
+		transpose4x4(childPos, soa);
+		const SoaFloat3 boneDir = SoaFloat3::Load(soa[0], soa[1], soa[2]) - parentPosSoa;
+		transpose4x4(parentCol1, soa);
+		const SoaFloat3 parentCol1Soa = SoaFloat3::Load(soa[0], soa[1], soa[2]);
+		transpose4x4(parentCol2, soa);
+		const SoaFloat3 parentCol2Soa = SoaFloat3::Load(soa[0], soa[1], soa[2]);
+
+		const Vector4 boneLen = Length(boneDir);
 
-		// Store smallest bone lenth to be reused for root joint scale
-		float minBoneLen = 0.f;
-		bool  minBoneLenSet = false;
+		// Use the parent and child world matricies to create a bone world
+		// matrix which will place it between the two joints
+		// Using Gramm Schmidt process'
+		const Vector4    absDotProd = absPerElem(Dot(parentCol2Soa, boneDir));
+		const Vector4Int useCol2 = cmpLt(absDotProd, Vector4(0.01f));
+		const Vector4Int useCol1 = cmpGe(absDotProd, Vector4(0.01f));
+		const SoaFloat3  binormal = SoaFloat3::Load(
+			orPerElem(andPerElem(parentCol2Soa.x, useCol2), andPerElem(parentCol1Soa.x, useCol1)),
+			orPerElem(andPerElem(parentCol2Soa.y, useCol2), andPerElem(parentCol1Soa.y, useCol1)),
+			orPerElem(andPerElem(parentCol2Soa.z, useCol2), andPerElem(parentCol1Soa.z, useCol1)));
 
-		// For each joint
-		for (unsigned int childIndex = 0; childIndex < mNumJoints; childIndex++)
+		const SoaFloat3 boneCol1 = NormalizeEst(CrossProduct(binormal, boneDir)) * boneLen;
+		const SoaFloat3 boneCol2 = NormalizeEst(CrossProduct(boneDir, boneCol1)) * boneLen;
+
+		Vector4 boneWorldCols[4][4];
+		TransformSoa(rootSplats, boneDir, false, boneWorldCols[0]);
+		TransformSoa(rootSplats, boneCol1, false, boneWorldCols[1]);
+		TransformSoa(rootSplats, boneCol2, false, boneWorldCols[2]);
+		TransformSoa(rootSplats, parentPosSoa, true, boneWorldCols[3]);
+
+		for (unsigned int i = 0; i < count; i++)
 		{
+			const unsigned int childIndex = first + i;
+
 			// Do not make a bone if it is the root
 			// Handle the root joint specially after the loop
-			if (childIndex == mRootIndex)
+			if (parentIndices[i] == childIndex)
 			{
 				mBoneWorldMats[childIndex] = mat4::scale(vec3(0.0f, 0.0f, 0.0f));
 				continue;
 			}
 
-			// Get the index of the parent of childIndex
-			const int parentIndex = mSkeleton.joint_properties()[childIndex].parent;
-
-			// Selects joint matrices.
-			const mat4 parentMat = mJointModelMats[parentIndex];
-			const mat4 childMat = mJointModelMats[childIndex];
-
-			vec3  boneDir = childMat.getCol3().getXYZ() - parentMat.getCol3().getXYZ();
-			float boneLen = length(boneDir);
+			const float len = boneLen.getElem(i);
 
 			// Save smallest boneLen for the root joints scale size
-			if ((!minBoneLenSet) || (boneLen < minBoneLen))
+			if ((!minBoneLenSet) || (len < minBoneLen))
 			{
-				minBoneLen = boneLen;
+				minBoneLen = len;
+				minBoneLenSet = true;
 			}
 
-			// Use the parent and child world matricies to create a bone world
-			// matrix which will place it between the two joints
-			// Using Gramm Schmidt process'
-			float dotProd = dot(parentMat.getCol2().getXYZ(), boneDir);
-			vec3  binormal = abs(dotProd) < 0.01f ? parentMat.getCol2().getXYZ() : parentMat.getCol1().getXYZ();
-
-			vec4 col0 = vec4(boneDir, 0.0f);
-			vec4 col1 = vec4(boneLen * normalize(cross(binormal, boneDir)), 0.0f);
-			vec4 col2 = vec4(boneLen * normalize(cross(boneDir, col1.getXYZ())), 0.0f);
-			vec4 col3 = vec4(parentMat.getCol3().getXYZ(), 1.0f);
-			mBoneWorldMats[childIndex] = rootTransform * mat4(col0, col1, col2, col3);
+			mBoneWorldMats[childIndex] = mat4(boneWorldCols[0][i], boneWorldCols[1][i], boneWorldCols[2][i], boneWorldCols[3][i]);
 
 			// Sets the scale of the joint equivilant to the boneLen between it and its parent joint
 			// Separete from world so outside objects can use a joint's world mat w/o its scale
-			mJointScales[childIndex] = vec3(boneLen / 2.0f);
+			mJointScales[childIndex] = vec3(len / 2.0f);
 		}
+	}
 
-		// Set the root joints scale based on the saved min value
+	// Set the root joints scale based on the saved min value
+	if (mUpdateBones)
 		mJointScales[mRootIndex] = vec3(minBoneLen / 2.0f);
-	}
 }
 
 bool Rig::LoadSkeleton(const char* fileName)
@@ -159,3 +258,15 @@ int Rig::FindJoint(const char* jointName)
 	}
 	return -1;
 }
+
+void Rig::WriteSkinningPalette(const Matrix4* pInverseBindMats, Vector4* pPalette)
+{
+	for (unsigned int i = 0; i < mNumJoints; i++)
+	{
+		// The bottom row of an affine matrix is always (0, 0, 0, 1), the shader does not need it
+		const Matrix4 rows = transpose(mJointWorldMats[i] * pInverseBindMats[i]);
+		pPalette[i * 3 + 0] = rows.getCol0();
+		pPalette[i * 3 + 1] = rows.getCol1();
+		pPalette[i * 3 + 2] = rows.getCol2();
+	}
+}
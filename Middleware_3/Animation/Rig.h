@@ -55,6 +55,7 @@ class Rig
 	void Destroy();
 
 	// Updates the skeleton's joint and bone world matricies based on mJointModelMats
+	// Does nothing if GetJointModelMats was not called and rootTransform did not change since the last call
 	void Pose(const Matrix4& rootTransform);
 
 	// Set the color of the joints
@@ -64,10 +65,26 @@ class Rig
 	inline void SetBoneColor(const Vector4& color) { mBoneColor = color; };
 
 	// Toggle whether or not to update the bones world matricies
-	inline void SetUpdateBones(bool setValue) { mUpdateBones = setValue; };
+	inline void SetUpdateBones(bool setValue)
+	{
+		mUpdateBones = setValue;
+		mPoseDirty = true;
+	};
 
 	// For hard setting the world matrix of a specific joint
-	inline void HardSetJointWorldMat(const Matrix4& worldMat, unsigned int index) { mJointWorldMats[index] = worldMat; };
+	inline void HardSetJointWorldMat(const Matrix4& worldMat, unsigned int index)
+	{
+		mJointWorldMats[index] = worldMat;
+
+		// Normalize the first three collumns
+		vec4 col0 = vec4(normalize(worldMat.getCol0().getXYZ()), worldMat.getCol0().getW());
+		vec4 col1 = vec4(normalize(worldMat.getCol1().getXYZ()), worldMat.getCol1().getW());
+		vec4 col2 = vec4(normalize(worldMat.getCol2().getXYZ()), worldMat.getCol2().getW());
+		mJointWorldMatsNoScale[index] = mat4(col0, col1, col2, worldMat.getCol3());
+
+		// Next Pose has to overwrite it again
+		mPoseDirty = true;
+	};
 
 	// Gets a pointer to the skeleton of this rig
 	inline ozz::animation::Skeleton* GetSkeleton() { return &mSkeleton; };
@@ -90,15 +107,7 @@ class Rig
 	{
 		if ((0 <= index) && (index < mNumJoints))
 		{
-			mat4 withScale = mJointWorldMats[index];
-
-			// Normalize the first three collumns
-			vec4 col0 = vec4(normalize(withScale.getCol0().getXYZ()), withScale.getCol0().getW());
-			vec4 col1 = vec4(normalize(withScale.getCol1().getXYZ()), withScale.getCol1().getW());
-			vec4 col2 = vec4(normalize(withScale.getCol2().getXYZ()), withScale.getCol2().getW());
-
-			mat4 withoutScale = mat4(col0, col1, col2, withScale.getCol3());
-			return withoutScale;
+			return mJointWorldMatsNoScale[index];
 		}
 		else
 		{
@@ -119,8 +128,12 @@ class Rig
 		}
 	};
 
-	// Gets the joint's model matricies so they can be set by animations
-	inline ozz::Range<Matrix4> GetJointModelMats() { return mJointModelMats; };
+	// Gets the joint's model matricies so they can be set by animations, the next Pose updates the world matricies
+	inline ozz::Range<Matrix4> GetJointModelMats()
+	{
+		mPoseDirty = true;
+		return mJointModelMats;
+	};
 
 	// Gets the scale of joint at index
 	inline Vector3 GetJointScale(unsigned int index) { return mJointScales[index]; };
@@ -140,6 +153,10 @@ class Rig
 	// Finds the index of the joint with name jointName, if it cannot find it returns -1
 	int FindJoint(const char* jointName);
 
+	// Writes the skinning matrix (joint world matrix * inverse bind matrix) of every joint to pPalette as a 3x4 matrix,
+	// the top three rows, so the palette takes 3 Vector4 per joint. pPalette can point straight into mapped GPU memory
+	void WriteSkinningPalette(const Matrix4* pInverseBindMats, Vector4* pPalette);
+
 	private:
 	// Load a runtime skeleton from a skeleton.ozz file
 	bool LoadSkeleton(const char* fileName);
@@ -169,6 +186,9 @@ class Rig
 	// Buffer of world model space matrices for joints.
 	eastl::vector<Matrix4> mJointWorldMats;
 
+	// Buffer of world model space matrices for joints with the scale removed, computed along with mJointWorldMats
+	eastl::vector<Matrix4> mJointWorldMatsNoScale;
+
 	// Buffer of world model space matrices for bones.
 	eastl::vector<Matrix4> mBoneWorldMats;
 
@@ -177,4 +197,8 @@ class Rig
 
 	// Scales to apply to each joint - will be proportional to length of its child's bone
 	eastl::vector<Vector3> mJointScales;
+
+	// Root transform of the last Pose and whether mJointModelMats may have changed since, used to skip posing an unchanged rig
+	Matrix4 mPosedRootTransform;
+	bool    mPoseDirty = true;
 };
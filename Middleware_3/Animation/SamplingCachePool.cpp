@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+
+#include "SamplingCachePool.h"
+
+#include "../../Common_3/OS/Interfaces/ILogManager.h"
+#include "../../Common_3/OS/Interfaces/IThread.h"
+#include "../../Common_3/OS/Interfaces/IMemoryManager.h"
+
+void SamplingCachePool::Initialize(unsigned int maxNumJoints)
+{
+	ASSERT(maxNumJoints > 0);
+
+	mMaxNumJoints = maxNumJoints;
+	pMutex = conf_new<Mutex>();
+}
+
+void SamplingCachePool::Destroy()
+{
+	ozz::memory::Allocator* allocator = ozz::memory::default_allocator();
+
+	ASSERT(mFreeEntries.size() == mEntries.size() && "Entries are still leased");
+	for (unsigned int i = 0; i < (unsigned int)mEntries.size(); i++)
+	{
+		allocator->Delete(mEntries[i]->pCache);
+		allocator->Deallocate(mEntries[i]->mLocalTrans);
+		conf_delete(mEntries[i]);
+	}
+
+	mEntries.set_capacity(0);
+	mFreeEntries.set_capacity(0);
+
+	conf_delete(pMutex);
+	pMutex = nullptr;
+}
+
+SamplingCacheEntry* SamplingCachePool::Acquire()
+{
+	{
+		MutexLock lock(*pMutex);
+		if (!mFreeEntries.empty())
+		{
+			SamplingCacheEntry* pEntry = mFreeEntries.back();
+			mFreeEntries.pop_back();
+			return pEntry;
+		}
+	}
+
+	// Allocate outside of the lock, other threads keep leasing free entries meanwhile
+	ozz::memory::Allocator* allocator = ozz::memory::default_allocator();
+
+	SamplingCacheEntry* pEntry = conf_new<SamplingCacheEntry>();
+	pEntry->pCache = allocator->New<ozz::animation::SamplingCache>(mMaxNumJoints);
+	pEntry->mLocalTrans = allocator->AllocateRange<SoaTransform>((mMaxNumJoints + 3) / 4);
+
+	MutexLock lock(*pMutex);
+	mEntries.push_back(pEntry);
+	return pEntry;
+}
+
+void SamplingCachePool::Release(SamplingCacheEntry* pEntry)
+{
+	ASSERT(pEntry);
+
+	MutexLock lock(*pMutex);
+	mFreeEntries.push_back(pEntry);
+}
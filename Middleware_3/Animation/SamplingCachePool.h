@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2018-2019 Confetti Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+
+#pragma once
+
+#include "../../Common_3/OS/Math/MathTypes.h"
+
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/vector.h"
+
+#include "../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/animation/runtime/sampling_job.h"
+#include "../../Common_3/ThirdParty/OpenSource/ozz-animation/include/ozz/base/memory/allocator.h"
+
+struct Mutex;
+
+// A sampling cache and the local transforms a clip is sampled into, leased from a SamplingCachePool
+struct SamplingCacheEntry
+{
+	ozz::animation::SamplingCache* pCache;
+	ozz::Range<SoaTransform>       mLocalTrans;
+};
+
+// Shares sampling caches and sampled pose buffers between Animations.
+// An Animation only needs them between sampling its clips and blending them, so instead of every
+// Animation owning a cache and a buffer per clip, the entries are leased from the pool for the duration
+// of Animation::Sample and returned afterwards. The pool only grows to the number of entries in use
+// at the same time, which is the number of clips of one animation times the number of threads sampling.
+class SamplingCachePool
+{
+	public:
+	// Set up a pool for rigs of up to maxNumJoints joints
+	void Initialize(unsigned int maxNumJoints);
+
+	// Must be called to clean up the pool if it has been initialized
+	void Destroy();
+
+	// Leases an entry, allocating a new one when all of them are in use
+	SamplingCacheEntry* Acquire();
+
+	// Returns an entry leased by Acquire
+	void Release(SamplingCacheEntry* pEntry);
+
+	// Get the number of entries allocated by the pool
+	inline unsigned int GetNumEntries() { return (unsigned int)mEntries.size(); };
+
+	private:
+	// Every entry allocated by the pool
+	eastl::vector<SamplingCacheEntry*> mEntries;
+
+	// Entries not leased at the moment
+	eastl::vector<SamplingCacheEntry*> mFreeEntries;
+
+	// Guards mEntries and mFreeEntries, Animations may sample on several threads
+	Mutex* pMutex = nullptr;
+
+	unsigned int mMaxNumJoints = 0;
+};
@@ -24,6 +24,8 @@
 
 #include "SkeletonBatcher.h"
 
+#include "../../Common_3/OS/Core/RingBuffer.h"
+
 void SkeletonBatcher::Initialize(const SkeletonRenderDesc& skeletonRenderDesc)
 {
 	// Set member render variables based on the description
@@ -32,9 +34,7 @@ void SkeletonBatcher::Initialize(const SkeletonRenderDesc& skeletonRenderDesc)
 	mRootSignature = skeletonRenderDesc.mRootSignature;
 	mJointVertexBuffer = skeletonRenderDesc.mJointVertexBuffer;
 	mNumJointPoints = skeletonRenderDesc.mNumJointPoints;
-
-	DescriptorBinderDesc descriptorBinderDescSkeleton = { mRootSignature, 0, MAX_BATCHES * 2}; // 2 because updates buffer twice per instanced draw call: one for joints and one for bones
-	addDescriptorBinder(mRenderer, 0, 1, &descriptorBinderDescSkeleton, &mDescriptorBinder);
+	mCreationFlag = skeletonRenderDesc.mCreationFlag;
 
 	// Determine if we will ever expect to use this renderer to draw bones
 	mDrawBones = skeletonRenderDesc.mDrawBones;
@@ -44,41 +44,60 @@ void SkeletonBatcher::Initialize(const SkeletonRenderDesc& skeletonRenderDesc)
 		mNumBonePoints = skeletonRenderDesc.mNumBonePoints;
 	}
 
-	// Initialize all the buffer that will be used for each batch per each frame index
-	BufferLoadDesc ubDesc = {};
-	ubDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	ubDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
-	ubDesc.mDesc.mSize = sizeof(UniformSkeletonBlock);
-	ubDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | skeletonRenderDesc.mCreationFlag;
-	ubDesc.pData = NULL;
-	for (unsigned int i = 0; i < MAX_BATCHES; i++)
-	{
-		for (uint32_t j = 0; j < ImageCount; ++j)
-		{
-			ubDesc.ppBuffer = &mProjViewUniformBufferJoints[i][j];
-			addResource(&ubDesc);
-			if (mDrawBones)
-			{
-				ubDesc.ppBuffer = &mProjViewUniformBufferBones[i][j];
-				addResource(&ubDesc);
-			}
-		}
-	}
+	// Initialize the ring buffer and descriptor binder all batches of all frame indices use
+	mUniformBlockSize = round_up((uint32_t)sizeof(UniformSkeletonBlock), (uint32_t)mRenderer->pActiveGpuSettings->mUniformBufferAlignment);
+	mMaxBatches = 0;
+	Reserve(InitialBatchCapacity, 0);
 }
 
 void SkeletonBatcher::Destroy()
 {
+	for (uint32_t i = 0; i < ImageCount; ++i)
+	{
+		ReleaseRetired(i);
+		mJointUniformOffsets[i].set_capacity(0);
+		mBoneUniformOffsets[i].set_capacity(0);
+	}
+
 	removeDescriptorBinder(mRenderer, mDescriptorBinder);
-	for (unsigned int i = 0; i < MAX_BATCHES; i++)
+	removeGPURingBuffer(pUniformRingBuffer);
+	mDescriptorBinder = NULL;
+	pUniformRingBuffer = NULL;
+}
+
+void SkeletonBatcher::Reserve(unsigned int numBatches, uint32_t frameIndex)
+{
+	if (numBatches <= mMaxBatches)
+		return;
+
+	// Frames in flight may still read from the current ring buffer and descriptor sets
+	if (pUniformRingBuffer)
 	{
-		for (uint32_t j = 0; j < ImageCount; ++j)
-		{
-			removeResource(mProjViewUniformBufferJoints[i][j]);
-			if (mDrawBones)
-			{
-				removeResource(mProjViewUniformBufferBones[i][j]);
-			}
-		}
+		pRetiredRingBuffers[frameIndex] = pUniformRingBuffer;
+		pRetiredDescriptorBinders[frameIndex] = mDescriptorBinder;
+	}
+
+	mMaxBatches = max(numBatches, mMaxBatches * 2);
+
+	// 2 because updates buffer twice per instanced draw call: one for joints and one for bones
+	const uint32_t blocksPerFrame = mMaxBatches * (mDrawBones ? 2 : 1);
+
+	// One frame more than can be in flight, as the ring skips the blocks that do not fit before wrapping around
+	const bool ownMemory = (mCreationFlag & BUFFER_CREATION_FLAG_OWN_MEMORY_BIT) != 0;
+	addUniformGPURingBuffer(mRenderer, (uint32_t)mUniformBlockSize * blocksPerFrame * (ImageCount + 1), &pUniformRingBuffer, ownMemory);
+
+	DescriptorBinderDesc descriptorBinderDescSkeleton = { mRootSignature, 0, blocksPerFrame };
+	addDescriptorBinder(mRenderer, 0, 1, &descriptorBinderDescSkeleton, &mDescriptorBinder);
+}
+
+void SkeletonBatcher::ReleaseRetired(uint32_t frameIndex)
+{
+	if (pRetiredRingBuffers[frameIndex])
+	{
+		removeGPURingBuffer(pRetiredRingBuffers[frameIndex]);
+		removeDescriptorBinder(mRenderer, pRetiredDescriptorBinders[frameIndex]);
+		pRetiredRingBuffers[frameIndex] = NULL;
+		pRetiredDescriptorBinders[frameIndex] = NULL;
 	}
 }
 
@@ -96,20 +115,64 @@ void SkeletonBatcher::SetSharedUniforms(const Matrix4& projViewMat, const Vector
 	}
 }
 
+UniformSkeletonBlock* SkeletonBatcher::BeginBatch(UniformSkeletonBlock* pStaging, uint64_t* pOffset)
+{
+	GPURingBufferOffset offset = getGPURingBufferOffset(pUniformRingBuffer, (uint32_t)mUniformBlockSize);
+	*pOffset = offset.mOffset;
+
+	if (!offset.pBuffer->pCpuMappedAddress)
+		return pStaging;
+
+	// Only the shared uniforms and the instances of the batch are written, not the unused part of the arrays
+	UniformSkeletonBlock* pBlock = (UniformSkeletonBlock*)((uint8_t*)offset.pBuffer->pCpuMappedAddress + offset.mOffset);
+	pBlock->mProjectView = pStaging->mProjectView;
+	pBlock->mLightPosition = pStaging->mLightPosition;
+	pBlock->mLightColor = pStaging->mLightColor;
+	return pBlock;
+}
+
+void SkeletonBatcher::EndBatch(UniformSkeletonBlock* pBlock, UniformSkeletonBlock* pStaging, uint64_t offset)
+{
+	if (pBlock != pStaging)
+		return;
+
+	BufferUpdateDesc updateDesc = { pUniformRingBuffer->pBuffer, pStaging, 0, offset, sizeof(UniformSkeletonBlock) };
+	updateResource(&updateDesc);
+}
+
 void SkeletonBatcher::SetPerInstanceUniforms(const uint32_t& frameIndex, int numRigs)
 {
+	// The frame that used frameIndex last has completed, and with it every frame that used the retired buffers
+	ReleaseRetired(frameIndex);
+
+	// If the numRigs parameter was not initialized, used the data from all the rigs
+	if (numRigs == -1)
+	{
+		numRigs = mNumRigs;
+	}
+
+	// Make room for all batches of this frame
+	unsigned int numInstances = 0;
+	for (int rigIndex = 0; rigIndex < numRigs; rigIndex++)
+		numInstances += mRigs[rigIndex]->GetNumJoints();
+	const unsigned int numBatches = (numInstances + MAX_INSTANCES - 1) / MAX_INSTANCES;
+	Reserve(numBatches, frameIndex);
+
+	mJointUniformOffsets[frameIndex].resize(numBatches);
+	if (mDrawBones)
+		mBoneUniformOffsets[frameIndex].resize(numBatches);
+
 	// Will keep track of the current batch we are setting the uniforms for
 	// and will indicate how many catches to draw when draw is called for this frame index
 	mBatchCounts[frameIndex] = 0;
+	mLastBatchSize[frameIndex] = 0;
 
 	// Will keep track of the number of instances that have their data added
 	unsigned int instanceCount = 0;
 
-	// If the numRigs parameter was not initialized, used the data from all the rigs
-	if (numRigs == -1)
-	{
-		numRigs = mNumRigs;
-	}
+	// Uniforms of the current batch
+	UniformSkeletonBlock* pJoints = NULL;
+	UniformSkeletonBlock* pBones = NULL;
 
 	// For every rig
 	for (int rigIndex = 0; rigIndex < numRigs; rigIndex++)
@@ -120,22 +183,31 @@ void SkeletonBatcher::SetPerInstanceUniforms(const uint32_t& frameIndex, int num
 		// For every joint in the rig
 		for (unsigned int jointIndex = 0; jointIndex < numJoints; jointIndex++)
 		{
+			// Start a new batch
+			if (instanceCount == 0)
+			{
+				unsigned int currBatch = mBatchCounts[frameIndex];
+				pJoints = BeginBatch(&mUniformDataJoints, &mJointUniformOffsets[frameIndex][currBatch]);
+				if (mDrawBones)
+					pBones = BeginBatch(&mUniformDataBones, &mBoneUniformOffsets[frameIndex][currBatch]);
+			}
+
 			if (mDrawBones)
 			{
 				// add bones data to the uniform
-				mUniformDataBones.mToWorldMat[instanceCount] = mRigs[rigIndex]->GetBoneWorldMat(jointIndex);
-				mUniformDataBones.mColor[instanceCount] = mRigs[rigIndex]->GetBoneColor();
+				pBones->mToWorldMat[instanceCount] = mRigs[rigIndex]->GetBoneWorldMat(jointIndex);
+				pBones->mColor[instanceCount] = mRigs[rigIndex]->GetBoneColor();
 
 				// add joint data to the uniform while scaling the joints by their determined chlid bone length
-				mUniformDataJoints.mToWorldMat[instanceCount] =
+				pJoints->mToWorldMat[instanceCount] =
 					mRigs[rigIndex]->GetJointWorldMatNoScale(jointIndex) * mat4::scale(mRigs[rigIndex]->GetJointScale(jointIndex));
 			}
 			else
 			{
 				// add joint data to the uniform without scaling
-				mUniformDataJoints.mToWorldMat[instanceCount] = mRigs[rigIndex]->GetJointWorldMatNoScale(jointIndex);
+				pJoints->mToWorldMat[instanceCount] = mRigs[rigIndex]->GetJointWorldMatNoScale(jointIndex);
 			}
-			mUniformDataJoints.mColor[instanceCount] = mRigs[rigIndex]->GetJointColor();
+			pJoints->mColor[instanceCount] = mRigs[rigIndex]->GetJointColor();
 
 			// increment the count of uniform data that has been filled for this batch
 			instanceCount++;
@@ -147,29 +219,18 @@ void SkeletonBatcher::SetPerInstanceUniforms(const uint32_t& frameIndex, int num
 
 				unsigned int currBatch = mBatchCounts[frameIndex];
 
-				BufferUpdateDesc viewProjCbvJoints = { mProjViewUniformBufferJoints[currBatch][frameIndex], &mUniformDataJoints };
-				updateResource(&viewProjCbvJoints);
-
+				EndBatch(pJoints, &mUniformDataJoints, mJointUniformOffsets[frameIndex][currBatch]);
 				if (mDrawBones)
-				{
-					BufferUpdateDesc viewProjCbvBones = { mProjViewUniformBufferBones[currBatch][frameIndex], &mUniformDataBones };
-					updateResource(&viewProjCbvBones);
-				}
+					EndBatch(pBones, &mUniformDataBones, mBoneUniformOffsets[frameIndex][currBatch]);
 
 				// Increment the total batch count for this frame index
 				mBatchCounts[frameIndex]++;
 
-				// If we have reached the end of our data, save the number of instances in this
-				// last batch as it could be less than MAX_INSTANCES
-				if ((rigIndex == numRigs - 1) && (jointIndex == numJoints - 1))
-				{
-					mLastBatchSize[frameIndex] = instanceCount;
-				}
-				// Otherwise reset the count so it can be used for the next batch
-				else
-				{
-					instanceCount = 0;
-				}
+				// Save the number of instances in this batch as the last one could be less than MAX_INSTANCES
+				mLastBatchSize[frameIndex] = instanceCount;
+
+				// Reset the count so it can be used for the next batch
+				instanceCount = 0;
 			}
 		}
 	}
@@ -190,6 +251,8 @@ void SkeletonBatcher::Draw(Cmd* cmd, const uint32_t& frameIndex)
 	cmdBindPipeline(cmd, mSkeletonPipeline);
 	DescriptorData params[1] = {};
 	params[0].pName = "uniformBlock";
+	params[0].ppBuffers = &pUniformRingBuffer->pBuffer;
+	params[0].pSizes = &mUniformBlockSize;
 
 	// Joints
 	cmdBeginDebugMarker(cmd, 1, 0, 1, "Draw Skeletons Joints");
@@ -198,7 +261,7 @@ void SkeletonBatcher::Draw(Cmd* cmd, const uint32_t& frameIndex)
 	// for each batch of joints
 	for (unsigned int batchIndex = 0; batchIndex < numBatches; batchIndex++)
 	{
-		params[0].ppBuffers = &mProjViewUniformBufferJoints[batchIndex][frameIndex];
+		params[0].pOffsets = &mJointUniformOffsets[frameIndex][batchIndex];
 		cmdBindDescriptors(cmd, mDescriptorBinder, mRootSignature, 1, params);
 
 		if (batchIndex < numBatches - 1)
@@ -224,7 +287,7 @@ void SkeletonBatcher::Draw(Cmd* cmd, const uint32_t& frameIndex)
 		// for each batch of bones
 		for (unsigned int batchIndex = 0; batchIndex < numBatches; batchIndex++)
 		{
-			params[0].ppBuffers = &mProjViewUniformBufferBones[batchIndex][frameIndex];
+			params[0].pOffsets = &mBoneUniformOffsets[frameIndex][batchIndex];
 			cmdBindDescriptors(cmd, mDescriptorBinder, mRootSignature, 1, params);
 
 			if (batchIndex < numBatches - 1)
@@ -29,12 +29,14 @@
 
 #include "Rig.h"
 
-#define MAX_INSTANCES 815    // For allocating space in uniform block. Must match with shader and application.
+struct GPURingBuffer;
 
-#define MAX_BATCHES 500    // Batch count must always be less than this
+#define MAX_INSTANCES 815    // For allocating space in uniform block. Must match with shader and application.
 
 const uint32_t ImageCount = 3;    // must match the application
 
+const uint32_t InitialBatchCapacity = 16;    // Batches per frame the buffers are sized for up front, they grow when more are needed
+
 // Uniform data to send
 struct UniformSkeletonBlock
 {
@@ -88,6 +90,18 @@ class SkeletonBatcher
 	void Draw(Cmd* cmd, const uint32_t& frameIndex);
 
 	private:
+	// Grow the ring buffer and descriptor binder so a frame can hold numBatches batches
+	void Reserve(unsigned int numBatches, uint32_t frameIndex);
+
+	// Release the buffers retired ImageCount frames ago at frameIndex, no frame in flight uses them anymore
+	void ReleaseRetired(uint32_t frameIndex);
+
+	// Gets the memory the uniforms of the next batch are written to, in place in the mapped ring buffer when possible
+	UniformSkeletonBlock* BeginBatch(UniformSkeletonBlock* pStaging, uint64_t* pOffset);
+
+	// Uploads the batch if it had to be written to pStaging
+	void EndBatch(UniformSkeletonBlock* pBlock, UniformSkeletonBlock* pStaging, uint64_t offset);
+
 	// List of Rigs whose skeletons need to be rendered
 	eastl::vector<Rig*> mRigs;
 	unsigned int          mNumRigs = 0;
@@ -102,13 +116,28 @@ class SkeletonBatcher
 	int            mNumBonePoints;
 
 	// Descriptor binder with all required memory allocation space
-	DescriptorBinder* mDescriptorBinder;
+	DescriptorBinder* mDescriptorBinder = NULL;
+
+	// Persistently mapped uniform memory of all batches of the frames in flight. Each batch writes its
+	// instances straight into its part of the ring instead of filling a copy and uploading it
+	GPURingBuffer* pUniformRingBuffer = NULL;
+	BufferCreationFlags mCreationFlag;
+
+	// Ring buffer offsets of each batch's joint and bone uniforms for each frame index
+	eastl::vector<uint64_t> mJointUniformOffsets[ImageCount];
+	eastl::vector<uint64_t> mBoneUniformOffsets[ImageCount];
+
+	// Size of the uniforms of one batch in the ring buffer
+	uint64_t mUniformBlockSize = 0;
+
+	// Number of batches per frame the ring buffer and descriptor binder can hold
+	unsigned int mMaxBatches = 0;
 
-	// Buffer pointers that will get updated for each batch to be rendered
-	Buffer* mProjViewUniformBufferJoints[MAX_BATCHES][ImageCount] = {{ NULL }};
-	Buffer* mProjViewUniformBufferBones[MAX_BATCHES][ImageCount] = {{ NULL } };
+	// Replaced ring buffers and descriptor binders that frames in flight may still use
+	GPURingBuffer*    pRetiredRingBuffers[ImageCount] = { NULL };
+	DescriptorBinder* pRetiredDescriptorBinders[ImageCount] = { NULL };
 
-	// Uniform data for the joints and bones
+	// Shared uniform data for the joints and bones, also used as staging by APIs that do not keep buffers mapped
 	UniformSkeletonBlock mUniformDataJoints;
 	UniformSkeletonBlock mUniformDataBones;
 
@@ -36,11 +36,57 @@
 #include "../../Common_3/Renderer/ResourceLoader.h"
 
 #include "../../Common_3/ThirdParty/OpenSource/EASTL/vector.h"
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/hash_set.h"
+#include "../../Common_3/ThirdParty/OpenSource/EASTL/sort.h"
 
 #include "../../Common_3/OS/Interfaces/IMemoryManager.h"
 
 // TODO: this should be configurable
 #define MAX_SHADER_RESOURCE_UPDATES_PER_FRAME 40 
+// Size of the glyph vertex ring buffer, about 85000 glyphs
+#define FONTSTASH_MAX_BATCH_VERTICES (512 * 1024)
+
+// Glyph vertex with the color of its text, in the RGBA8 fontstash gives it
+typedef struct TextVertex
+{
+	float2   mPosition;
+	float2   mTexCoord;
+	uint32_t mColor;
+} TextVertex;
+
+// Strings drawn more than once are not shaped again, until the atlas changes. When there are this many, the least recently
+// used quarter is dropped
+#define FONTSTASH_MAX_CACHED_LAYOUTS 1024
+// Strings that were only drawn once are remembered by hash until there are this many, a string is cached when it comes back
+#define FONTSTASH_MAX_SEEN_LAYOUTS (4 * FONTSTASH_MAX_CACHED_LAYOUTS)
+// Where strings are laid out. Fontstash truncates the glyph positions, so they are kept positive to snap the same way
+// wherever the string is drawn
+#define FONTSTASH_LAYOUT_ORIGIN 1024.0f
+
+// What a string looks like with given font settings, other than its position and color
+typedef struct TextLayoutKey
+{
+	int   mFontID;
+	float mSize;
+	float mSpacing;
+	float mBlur;
+	int   mAlign;
+	float mFractionX;    // Positions in the same pixel may snap to different pixels
+	float mFractionY;
+} TextLayoutKey;
+
+// Glyph quads and bounds of a string, laid out at FONTSTASH_LAYOUT_ORIGIN plus the fraction of its position
+typedef struct TextLayout
+{
+	TextLayoutKey             mKey;
+	eastl::string             mText;
+	eastl::vector<TextVertex> mVertices;    // Without color
+	float                     mBounds[4];
+	float                     mAdvance;
+	uint64_t                  mLastUse;
+	bool                      mHasVertices;
+	bool                      mHasBounds;
+} TextLayout;
 
 FSRoot FSR_MIDDLEWARE_TEXT = FSR_Middleware0;
 
@@ -54,10 +100,19 @@ class _Impl_FontStash
 		mHeight = 0;
 		pContext = NULL;
 
-		mText3D = false;
+		pBatchCmd = NULL;
+		mBatchRenderPassHash = 0;
+		mBatchOffset = 0;
+		mBatchVertexCount = 0;
+		mBatchText3D = false;
+
+		pLayoutCapture = NULL;
+		mLayoutOffset = float2(0.0f, 0.0f);
+		mLayoutComplete = true;
+		mLayoutUseCount = 0;
 	}
 
-	void init(Renderer* renderer, int width_, int height_)
+	void init(Renderer* renderer, int width_, int height_, bool signedDistanceField)
 	{
 		pRenderer = renderer;
 
@@ -69,7 +124,7 @@ class _Impl_FontStash
 		memset(&params, 0, sizeof(params));
 		params.width = width_;
 		params.height = height_;
-		params.flags = (unsigned char)FONS_ZERO_TOPLEFT;
+		params.flags = (unsigned char)(FONS_ZERO_TOPLEFT | (signedDistanceField ? FONS_SDF : 0));
 		params.renderCreate = fonsImplementationGenerateTexture;
 		params.renderResize = fonsImplementationResizeTexture;
 		params.renderUpdate = fonsImplementationModifyTexture;
@@ -78,6 +133,7 @@ class _Impl_FontStash
 		params.userPtr = this;
 
 		pContext = fonsCreateInternal(&params);
+		fonsSetErrorCallback(pContext, fonsImplementationError, this);
 		/************************************************************************/
 		// Rendering resources
 		/************************************************************************/
@@ -120,12 +176,14 @@ class _Impl_FontStash
 		rasterizerStateFrontDesc.mScissor = true;
 		addRasterizerState(pRenderer, &rasterizerStateFrontDesc, &pRasterizerStates[1]);
 
+		ShaderMacro    sdfMacro = { "FONTSTASH_SDF", "" };
+		uint32_t       fragMacroCount = signedDistanceField ? 1 : 0;
 		ShaderLoadDesc text2DShaderDesc = {};
 		text2DShaderDesc.mStages[0] = { "fontstash2D.vert", NULL, 0, FSR_MIDDLEWARE_TEXT };
-		text2DShaderDesc.mStages[1] = { "fontstash.frag", NULL, 0, FSR_MIDDLEWARE_TEXT };
+		text2DShaderDesc.mStages[1] = { "fontstash.frag", &sdfMacro, fragMacroCount, FSR_MIDDLEWARE_TEXT };
 		ShaderLoadDesc text3DShaderDesc = {};
 		text3DShaderDesc.mStages[0] = { "fontstash3D.vert", NULL, 0, FSR_MIDDLEWARE_TEXT };
-		text3DShaderDesc.mStages[1] = { "fontstash.frag", NULL, 0, FSR_MIDDLEWARE_TEXT };
+		text3DShaderDesc.mStages[1] = { "fontstash.frag", &sdfMacro, fragMacroCount, FSR_MIDDLEWARE_TEXT };
 
 		addShader(pRenderer, &text2DShaderDesc, &pShaders[0]);
 		addShader(pRenderer, &text3DShaderDesc, &pShaders[1]);
@@ -151,12 +209,12 @@ class _Impl_FontStash
 		BufferDesc vbDesc = {};
 		vbDesc.mDescriptors = DESCRIPTOR_TYPE_VERTEX_BUFFER;
 		vbDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
-		vbDesc.mSize = 1024 * 1024 * sizeof(float4);
-		vbDesc.mVertexStride = sizeof(float4);
+		vbDesc.mSize = FONTSTASH_MAX_BATCH_VERTICES * sizeof(TextVertex);
+		vbDesc.mVertexStride = sizeof(TextVertex);
 		vbDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
 		addGPURingBuffer(pRenderer, &vbDesc, &pMeshRingBuffer);
 
-		mVertexLayout.mAttribCount = 2;
+		mVertexLayout.mAttribCount = 3;
 		mVertexLayout.mAttribs[0].mSemantic = SEMANTIC_POSITION;
 		mVertexLayout.mAttribs[0].mFormat = ImageFormat::RG32F;
 		mVertexLayout.mAttribs[0].mBinding = 0;
@@ -169,12 +227,21 @@ class _Impl_FontStash
 		mVertexLayout.mAttribs[1].mLocation = 1;
 		mVertexLayout.mAttribs[1].mOffset = ImageFormat::GetImageFormatStride(ImageFormat::RG32F);
 
+		mVertexLayout.mAttribs[2].mSemantic = SEMANTIC_COLOR;
+		mVertexLayout.mAttribs[2].mFormat = ImageFormat::RGBA8;
+		mVertexLayout.mAttribs[2].mBinding = 0;
+		mVertexLayout.mAttribs[2].mLocation = 2;
+		mVertexLayout.mAttribs[2].mOffset = mVertexLayout.mAttribs[1].mOffset + ImageFormat::GetImageFormatStride(ImageFormat::RG32F);
+
 #ifdef FORGE_JHABLE_EDITS_V01
 		mVertexLayout.mAttribs[0].mSemanticType = 0;
 		mVertexLayout.mAttribs[0].mSemanticIndex = 0;
 
 		mVertexLayout.mAttribs[1].mSemanticType = 7;
 		mVertexLayout.mAttribs[1].mSemanticIndex = 0;
+
+		mVertexLayout.mAttribs[2].mSemanticType = 3;
+		mVertexLayout.mAttribs[2].mSemanticIndex = 0;
 #endif
 
 		mPipelineDesc = {};
@@ -226,15 +293,34 @@ class _Impl_FontStash
 		removeSampler(pRenderer, pDefaultSampler);
 
 		mTextureList.clear();
+		mLayouts.clear();
+		mSeenLayouts.clear();
 	}
 
+	void beginBatch(Cmd* pCmd, bool text3D);
+	void flushBatch();
+	TextVertex* allocateVertices(uint32_t count);
+
+	// Returns the layout of the string drawn at x, y with the current font settings, which is empty if it was not laid out
+	// yet. The first time a string is drawn, and for strings that are only measured, this is mScratchLayout, which is not
+	// cached. pOffset is what has to be added to the positions of the layout
+	TextLayout* getLayout(const char* message, const TextLayoutKey& key, float x, float y, bool draw, float2* pOffset);
+	void        evictLayouts();
+	void        drawLayout(const TextLayout* pLayout, float2 offset, uint32_t color);
+	// Draws the string with fontstash and records its glyphs into pLayout, unless it is mScratchLayout
+	void layOutText(TextLayout* pLayout, float2 offset, const char* message, uint32_t color);
+	void setState(const TextLayoutKey& key, uint32_t color);
+
 	static int  fonsImplementationGenerateTexture(void* userPtr, int width, int height);
 	static int  fonsImplementationResizeTexture(void* userPtr, int width, int height);
 	static void fonsImplementationModifyTexture(void* userPtr, int* rect, const unsigned char* data);
 	static void fonsImplementationRenderText(void* userPtr, const float* verts, const float* tcoords, const unsigned int* colors, int nverts);
 	static void fonsImplementationRemoveTexture(void* userPtr);
+	static void fonsImplementationError(void* userPtr, int error, int value);
 
 	using PipelineMap = eastl::hash_map<uint64_t, Pipeline*>;
+	using LayoutMap = eastl::hash_map<uint64_t, TextLayout>;
+	using LayoutHashSet = eastl::hash_set<uint64_t>;
 
 	Renderer*    pRenderer;
 	FONScontext* pContext;
@@ -252,7 +338,6 @@ class _Impl_FontStash
 
 	mat4 mProjView;
 	mat4 mWorldMat;
-	Cmd* pCmd;
 
 	Shader*        pShaders[2];
 	RootSignature* pRootSignature;
@@ -269,10 +354,29 @@ class _Impl_FontStash
 	PipelineDesc		 mPipelineDesc = {};
 	float2               mDpiScale;
 	float                mDpiScaleMin;
-	bool                 mText3D;
+
+	// Glyphs of the drawText calls since the last flush. They are written straight into pMeshRingBuffer, or into
+	// mStagingVertices when it can not be mapped, and drawn with one draw
+	Cmd*                      pBatchCmd;
+	uint64_t                  mBatchRenderPassHash;
+	uint64_t                  mBatchOffset;
+	uint32_t                  mBatchVertexCount;
+	bool                      mBatchText3D;
+	eastl::vector<TextVertex> mStagingVertices;
+
+	// Layouts by hash of their key and string. While a string is laid out, the glyphs fontstash draws are also recorded
+	// into pLayoutCapture, unless the atlas changed or could not fit a glyph in the meantime. Strings that change every
+	// frame only ever use mScratchLayout, so they do not push the static ones out of the cache
+	LayoutMap     mLayouts;
+	LayoutHashSet mSeenLayouts;
+	TextLayout    mScratchLayout;
+	uint64_t      mLayoutUseCount;
+	TextLayout*   pLayoutCapture;
+	float2        mLayoutOffset;
+	bool          mLayoutComplete;
 };
 
-Fontstash::Fontstash(Renderer* renderer, int width, int height)
+Fontstash::Fontstash(Renderer* renderer, int width, int height, bool signedDistanceField)
 {
 	impl = conf_placement_new<_Impl_FontStash>(conf_calloc(1, sizeof(_Impl_FontStash)));
 	impl->mDpiScale = getDpiScale();
@@ -281,8 +385,11 @@ Fontstash::Fontstash(Renderer* renderer, int width, int height)
 	width = width * (int)ceilf(impl->mDpiScale.x);
 	height = height * (int)ceilf(impl->mDpiScale.y);
 
-	impl->init(renderer, width, height);
+	impl->init(renderer, width, height, signedDistanceField);
 	m_fFontMaxSize = min(width, height) / 10.0f;    // see fontstash.h, line 1271, for fontSize calculation
+	// Distance fields are scaled to any size, fontstash only keeps the size in a short
+	if (signedDistanceField)
+		m_fFontMaxSize = SHRT_MAX / 10.0f;
 }
 
 void Fontstash::destroy()
@@ -340,46 +447,60 @@ void Fontstash::drawText(
 	Cmd* pCmd, const char* message, float x, float y, int fontID, unsigned int color /*=0xffffffff*/, float size /*=16.0f*/,
 	float spacing /*=3.0f*/, float blur /*=0.0f*/)
 {
-	impl->mText3D = false;
-	impl->pCmd = pCmd;
+	impl->beginBatch(pCmd, false);
 	// clamp the font size to max size.
 	// Precomputed font texture puts limitation to the maximum size.
 	size = min(size, m_fFontMaxSize);
 
-	FONScontext* fs = impl->pContext;
-	fonsSetSize(fs, size * impl->mDpiScaleMin);
-	fonsSetFont(fs, fontID);
-	fonsSetColor(fs, color);
-	fonsSetSpacing(fs, spacing * impl->mDpiScaleMin);
-	fonsSetBlur(fs, blur);
-	fonsSetAlign(fs, FONS_ALIGN_LEFT | FONS_ALIGN_TOP);
-
 	// considering the retina scaling:
 	// the render target is already scaled up (w/ retina) and the (x,y) position given to this function
 	// is expected to be in the render target's area. Hence, we don't scale up the position again.
-	fonsDrawText(fs, x /** impl->mDpiScale.x*/, y /** impl->mDpiScale.y*/, message, NULL);
+	TextLayoutKey key = { fontID, size * impl->mDpiScaleMin, spacing * impl->mDpiScaleMin, blur, FONS_ALIGN_LEFT | FONS_ALIGN_TOP };
+	float2        offset;
+	TextLayout*   pLayout = impl->getLayout(message, key, x /** impl->mDpiScale.x*/, y /** impl->mDpiScale.y*/, true, &offset);
+	if (pLayout->mHasVertices)
+		impl->drawLayout(pLayout, offset, color);
+	else
+		impl->layOutText(pLayout, offset, message, color);
 }
 
 void Fontstash::drawText(
 	Cmd* pCmd, const char* message, const mat4& projView, const mat4& worldMat, int fontID, unsigned int color /*=0xffffffff*/,
 	float size /*=16.0f*/, float spacing /*=3.0f*/, float blur /*=0.0f*/)
 {
-	impl->mText3D = true;
+	impl->beginBatch(pCmd, true);
 	impl->mProjView = projView;
 	impl->mWorldMat = worldMat;
-	impl->pCmd = pCmd;
 	// clamp the font size to max size.
 	// Precomputed font texture puts limitation to the maximum size.
 	size = min(size, m_fFontMaxSize);
 
-	FONScontext* fs = impl->pContext;
-	fonsSetSize(fs, size * impl->mDpiScaleMin);
-	fonsSetFont(fs, fontID);
-	fonsSetColor(fs, color);
-	fonsSetSpacing(fs, spacing * impl->mDpiScaleMin);
-	fonsSetBlur(fs, blur);
-	fonsSetAlign(fs, FONS_ALIGN_CENTER | FONS_ALIGN_MIDDLE);
-	fonsDrawText(fs, 0.0f, 0.0f, message, NULL);
+	TextLayoutKey key = { fontID, size * impl->mDpiScaleMin, spacing * impl->mDpiScaleMin, blur, FONS_ALIGN_CENTER | FONS_ALIGN_MIDDLE };
+	float2        offset;
+	TextLayout*   pLayout = impl->getLayout(message, key, 0.0f, 0.0f, true, &offset);
+	if (pLayout->mHasVertices)
+		impl->drawLayout(pLayout, offset, color);
+	else
+		impl->layOutText(pLayout, offset, message, color);
+
+	// Every text in world space has its own transform
+	impl->flushBatch();
+}
+
+void Fontstash::flush(Cmd* pCmd)
+{
+	if (impl->pBatchCmd == pCmd)
+		impl->flushBatch();
+}
+
+void Fontstash::beginFrame()
+{
+	if (impl->mBatchVertexCount)
+	{
+		LOGF(LogLevel::eWARNING, "Dropping %u text vertices of the last frame that were never flushed.", impl->mBatchVertexCount);
+		impl->mBatchVertexCount = 0;
+	}
+	impl->pBatchCmd = NULL;
 }
 
 float Fontstash::measureText(
@@ -395,19 +516,30 @@ float Fontstash::measureText(
 	if (out_bounds == NULL)
 		return 0;
 
-	const int    messageLength = (int)strlen(message);
-	FONScontext* fs = impl->pContext;
-	fonsSetSize(fs, size * impl->mDpiScaleMin);
-	fonsSetFont(fs, fontID);
-	fonsSetColor(fs, color);
-	fonsSetSpacing(fs, spacing * impl->mDpiScaleMin);
-	fonsSetBlur(fs, blur);
-	fonsSetAlign(fs, FONS_ALIGN_LEFT | FONS_ALIGN_TOP);
-
 	// considering the retina scaling:
 	// the render target is already scaled up (w/ retina) and the (x,y) position given to this function
 	// is expected to be in the render target's area. Hence, we don't scale up the position again.
-	return fonsTextBounds(fs, x /** impl->mDpiScale.x*/, y /** impl->mDpiScale.y*/, message, message + messageLength, out_bounds);
+	TextLayoutKey key = { fontID, size * impl->mDpiScaleMin, spacing * impl->mDpiScaleMin, blur, FONS_ALIGN_LEFT | FONS_ALIGN_TOP };
+	float2        offset;
+	TextLayout*   pLayout = impl->getLayout(message, key, x /** impl->mDpiScale.x*/, y /** impl->mDpiScale.y*/, false, &offset);
+	if (!pLayout->mHasBounds)
+	{
+		const int    messageLength = (int)strlen(message);
+		FONScontext* fs = impl->pContext;
+		impl->setState(key, color);
+		impl->mLayoutComplete = true;
+		pLayout->mAdvance = fonsTextBounds(
+			fs, FONTSTASH_LAYOUT_ORIGIN + pLayout->mKey.mFractionX, FONTSTASH_LAYOUT_ORIGIN + pLayout->mKey.mFractionY, message,
+			message + messageLength,
+			pLayout->mBounds);
+		pLayout->mHasBounds = impl->mLayoutComplete;
+	}
+
+	out_bounds[0] = pLayout->mBounds[0] + offset.x;
+	out_bounds[1] = pLayout->mBounds[1] + offset.y;
+	out_bounds[2] = pLayout->mBounds[2] + offset.x;
+	out_bounds[3] = pLayout->mBounds[3] + offset.y;
+	return pLayout->mAdvance;
 }
 
 // --  FONS renderer implementation --
@@ -448,6 +580,21 @@ int _Impl_FontStash::fonsImplementationGenerateTexture(void* userPtr, int width,
 
 int _Impl_FontStash::fonsImplementationResizeTexture(void* userPtr, int width, int height)
 {
+	// The texture coordinates of the glyphs in the batch are only valid in the current texture. Glyphs added to it keep
+	// them valid, so the batch only has to be drawn before a resize
+	_Impl_FontStash* ctx = (_Impl_FontStash*)userPtr;
+	ctx->flushBatch();
+
+	// The texture coordinates of the cached layouts are not valid anymore either
+	for (LayoutMap::iterator it = ctx->mLayouts.begin(); it != ctx->mLayouts.end(); ++it)
+	{
+		it->second.mHasVertices = false;
+		it->second.mHasBounds = false;
+	}
+	ctx->mScratchLayout.mHasVertices = false;
+	ctx->mScratchLayout.mHasBounds = false;
+	ctx->mLayoutComplete = false;
+
 	// Reuse create to resize too.
 	return fonsImplementationGenerateTexture(userPtr, width, height);
 }
@@ -462,52 +609,65 @@ void _Impl_FontStash::fonsImplementationModifyTexture(void* userPtr, int* rect,
 	fonsImplementationGenerateTexture(userPtr, ctx->mWidth, ctx->mHeight);    // rebuild texture
 }
 
-void _Impl_FontStash::fonsImplementationRenderText(
-	void* userPtr, const float* verts, const float* tcoords, const unsigned int* colors, int nverts)
+void _Impl_FontStash::beginBatch(Cmd* pCmd, bool text3D)
 {
-	_Impl_FontStash* ctx = (_Impl_FontStash*)userPtr;
-	if (ctx->pCurrentTexture == NULL)
-		return;
-
-	Cmd* pCmd = ctx->pCmd;
+	if (mBatchVertexCount && (pBatchCmd != pCmd || mBatchRenderPassHash != pCmd->mRenderPassHash))
+	{
+		// The render pass of the batch may be over, it can not be drawn anymore
+		LOGF(LogLevel::eWARNING, "Dropping %u text vertices that were not flushed in their render pass.", mBatchVertexCount);
+		mBatchVertexCount = 0;
+	}
+	else if (mBatchVertexCount && mBatchText3D != text3D)
+	{
+		flushBatch();
+	}
 
-	float4* vtx = (float4*)alloca(nverts * sizeof(float4));
+	if (!mBatchVertexCount)
+	{
+		pBatchCmd = pCmd;
+		mBatchRenderPassHash = pCmd->mRenderPassHash;
+		mBatchOffset = pMeshRingBuffer->mCurrentBufferOffset;
+		mBatchText3D = text3D;
+	}
+}
 
-	// build vertices
-	for (int impl = 0; impl < nverts; impl++)
+void _Impl_FontStash::flushBatch()
+{
+	if (!mBatchVertexCount || pCurrentTexture == NULL)
 	{
-		vtx[impl].setX(verts[impl * 2 + 0]);
-		vtx[impl].setY(verts[impl * 2 + 1]);
-		vtx[impl].setZ(tcoords[impl * 2 + 0]);
-		vtx[impl].setW(tcoords[impl * 2 + 1]);
+		mBatchVertexCount = 0;
+		return;
 	}
 
-	GPURingBufferOffset buffer = getGPURingBufferOffset(ctx->pMeshRingBuffer, nverts * sizeof(float4));
-	BufferUpdateDesc update = { buffer.pBuffer, vtx, 0, buffer.mOffset, nverts * sizeof(float4) };
-	updateResource(&update);
+	Cmd*     pCmd = pBatchCmd;
+	uint32_t vertexCount = mBatchVertexCount;
+	mBatchVertexCount = 0;
 
-	// extract color
-	ubyte* colorByte = (ubyte*)colors;
-	float4 color;
-	for (int i = 0; i < 4; i++)
-		color[i] = ((float)colorByte[i]) / 255.0f;
+	// The batch was kept clear of the end of the ring buffer, so this is where its vertices are
+	GPURingBufferOffset buffer = getGPURingBufferOffset(pMeshRingBuffer, vertexCount * sizeof(TextVertex));
+	ASSERT(buffer.mOffset == mBatchOffset);
+	if (!buffer.pBuffer->pCpuMappedAddress)
+	{
+		BufferUpdateDesc update = { buffer.pBuffer, mStagingVertices.data(), 0, buffer.mOffset, vertexCount * sizeof(TextVertex) };
+		updateResource(&update);
+	}
 
 	Pipeline*                              pPipeline = NULL;
-	_Impl_FontStash::PipelineMap::iterator it = ctx->mPipelines[ctx->mText3D].find(pCmd->mRenderPassHash);
-	if (it == ctx->mPipelines[ctx->mText3D].end())
+	_Impl_FontStash::PipelineMap::iterator it = mPipelines[mBatchText3D].find(mBatchRenderPassHash);
+	if (it == mPipelines[mBatchText3D].end())
 	{
-		GraphicsPipelineDesc& pipelineDesc = ctx->mPipelineDesc.mGraphicsDesc;
+		GraphicsPipelineDesc& pipelineDesc = mPipelineDesc.mGraphicsDesc;
 		pipelineDesc.mDepthStencilFormat = (ImageFormat::Enum)pCmd->mBoundDepthStencilFormat;
 		pipelineDesc.mRenderTargetCount = pCmd->mBoundRenderTargetCount;
 		pipelineDesc.mSampleCount = pCmd->mBoundSampleCount;
 		pipelineDesc.mSampleQuality = pCmd->mBoundSampleQuality;
 		pipelineDesc.pColorFormats = (ImageFormat::Enum*)pCmd->pBoundColorFormats;
-		pipelineDesc.pDepthState = ctx->pDepthStates[ctx->mText3D];
-		pipelineDesc.pRasterizerState = ctx->pRasterizerStates[ctx->mText3D];
+		pipelineDesc.pDepthState = pDepthStates[mBatchText3D];
+		pipelineDesc.pRasterizerState = pRasterizerStates[mBatchText3D];
 		pipelineDesc.pSrgbValues = pCmd->pBoundSrgbValues;
-		pipelineDesc.pShaderProgram = ctx->pShaders[ctx->mText3D];
-		addPipeline(pCmd->pRenderer, &ctx->mPipelineDesc, &pPipeline);
-		ctx->mPipelines[ctx->mText3D].insert({ pCmd->mRenderPassHash, pPipeline });
+		pipelineDesc.pShaderProgram = pShaders[mBatchText3D];
+		addPipeline(pCmd->pRenderer, &mPipelineDesc, &pPipeline);
+		mPipelines[mBatchText3D].insert({ mBatchRenderPassHash, pPipeline });
 	}
 	else
 	{
@@ -516,49 +676,223 @@ void _Impl_FontStash::fonsImplementationRenderText(
 
 	cmdBindPipeline(pCmd, pPipeline);
 
-	struct UniformData
-	{
-		float4 color;
-		float2 scaleBias;
-	} data;
-
-	data.color = color;
-	data.scaleBias = { 2.0f / (float)pCmd->mBoundWidth, -2.0f / (float)pCmd->mBoundHeight };
+	float2 scaleBias = { 2.0f / (float)pCmd->mBoundWidth, -2.0f / (float)pCmd->mBoundHeight };
 
-	if (ctx->mText3D)
+	if (mBatchText3D)
 	{
-		mat4 mvp = ctx->mProjView * ctx->mWorldMat;
-		data.color = color;
-		data.scaleBias.x = -data.scaleBias.x;
+		mat4 mvp = mProjView * mWorldMat;
+		scaleBias.x = -scaleBias.x;
 
 		GPURingBufferOffset uniformBlock = {};
-		uniformBlock = getGPURingBufferOffset(ctx->pUniformRingBuffer, sizeof(mvp));
+		uniformBlock = getGPURingBufferOffset(pUniformRingBuffer, sizeof(mvp));
 		BufferUpdateDesc updateDesc = { uniformBlock.pBuffer, &mvp, 0, uniformBlock.mOffset, sizeof(mvp) };
 		updateResource(&updateDesc);
 
 		DescriptorData params[3] = {};
 		params[0].pName = "uRootConstants";
-		params[0].pRootConstant = &data;
+		params[0].pRootConstant = &scaleBias;
 		params[1].pName = "uniformBlock";
 		params[1].ppBuffers = &uniformBlock.pBuffer;
 		params[1].pOffsets = &uniformBlock.mOffset;
 		params[2].pName = "uTex0";
-		params[2].ppTextures = &ctx->pCurrentTexture;
-		cmdBindDescriptors(pCmd, ctx->pDescriptorBinder, ctx->pRootSignature, 3, params);
-		cmdBindVertexBuffer(pCmd, 1, &buffer.pBuffer, &buffer.mOffset);
-		cmdDraw(pCmd, nverts, 0);
+		params[2].ppTextures = &pCurrentTexture;
+		cmdBindDescriptors(pCmd, pDescriptorBinder, pRootSignature, 3, params);
 	}
 	else
 	{
 		DescriptorData params[2] = {};
 		params[0].pName = "uRootConstants";
-		params[0].pRootConstant = &data;
+		params[0].pRootConstant = &scaleBias;
 		params[1].pName = "uTex0";
-		params[1].ppTextures = &ctx->pCurrentTexture;
-		cmdBindDescriptors(pCmd, ctx->pDescriptorBinder, ctx->pRootSignature, 2, params);
-		cmdBindVertexBuffer(pCmd, 1, &buffer.pBuffer, &buffer.mOffset);
-		cmdDraw(pCmd, nverts, 0);
+		params[1].ppTextures = &pCurrentTexture;
+		cmdBindDescriptors(pCmd, pDescriptorBinder, pRootSignature, 2, params);
+	}
+
+	cmdBindVertexBuffer(pCmd, 1, &buffer.pBuffer, &buffer.mOffset);
+	cmdDraw(pCmd, vertexCount, 0);
+
+	// The next batch starts where this one ended
+	mBatchOffset = pMeshRingBuffer->mCurrentBufferOffset;
+}
+
+TextVertex* _Impl_FontStash::allocateVertices(uint32_t count)
+{
+	// Draw what there is when the batch would reach the end of the ring buffer, and start again from its beginning
+	GPURingBuffer* pRingBuffer = pMeshRingBuffer;
+	uint64_t       batchSize = round_up((mBatchVertexCount + count) * (uint32_t)sizeof(TextVertex), pRingBuffer->mBufferAlignment);
+	if (mBatchOffset + batchSize >= pRingBuffer->mMaxBufferSize)
+	{
+		flushBatch();
+		resetGPURingBuffer(pRingBuffer);
+		mBatchOffset = 0;
 	}
+
+	TextVertex* pVertices = NULL;
+	if (pRingBuffer->pBuffer->pCpuMappedAddress)
+	{
+		pVertices = (TextVertex*)((uint8_t*)pRingBuffer->pBuffer->pCpuMappedAddress + mBatchOffset) + mBatchVertexCount;
+	}
+	else
+	{
+		if (mStagingVertices.size() < mBatchVertexCount + count)
+			mStagingVertices.resize(mBatchVertexCount + count);
+		pVertices = mStagingVertices.data() + mBatchVertexCount;
+	}
+
+	mBatchVertexCount += count;
+	return pVertices;
+}
+
+TextLayout* _Impl_FontStash::getLayout(const char* message, const TextLayoutKey& key, float x, float y, bool draw, float2* pOffset)
+{
+	TextLayoutKey layoutKey = key;
+	const float   pixelX = floorf(x);
+	const float   pixelY = floorf(y);
+	layoutKey.mFractionX = x - pixelX;
+	layoutKey.mFractionY = y - pixelY;
+	*pOffset = float2(pixelX - FONTSTASH_LAYOUT_ORIGIN, pixelY - FONTSTASH_LAYOUT_ORIGIN);
+
+	// 64 bit FNV-1a of the key and the string
+	uint64_t       hash = 0xcbf29ce484222325ull;
+	const uint8_t* pKeyBytes = (const uint8_t*)&layoutKey;
+	for (size_t i = 0; i < sizeof(layoutKey); ++i)
+		hash = (hash ^ pKeyBytes[i]) * 0x100000001b3ull;
+	for (const char* c = message; *c; ++c)
+		hash = (hash ^ (uint8_t)*c) * 0x100000001b3ull;
+
+	LayoutMap::iterator it = mLayouts.find(hash);
+	if (it != mLayouts.end() && memcmp(&it->second.mKey, &layoutKey, sizeof(layoutKey)) == 0 && it->second.mText == message)
+	{
+		it->second.mLastUse = ++mLayoutUseCount;
+		return &it->second;
+	}
+
+	// Strings that change every frame are only ever drawn once, they are laid out without copying them into the cache.
+	// Measuring does not count, the text is usually measured right before it is drawn
+	if (!draw || (it == mLayouts.end() && mSeenLayouts.find(hash) == mSeenLayouts.end()))
+	{
+		if (draw)
+		{
+			if (mSeenLayouts.size() >= FONTSTASH_MAX_SEEN_LAYOUTS)
+				mSeenLayouts.clear();
+			mSeenLayouts.insert(hash);
+		}
+
+		mScratchLayout.mKey = layoutKey;
+		mScratchLayout.mHasVertices = false;
+		mScratchLayout.mHasBounds = false;
+		return &mScratchLayout;
+	}
+
+	if (it == mLayouts.end() && mLayouts.size() >= FONTSTASH_MAX_CACHED_LAYOUTS)
+		evictLayouts();
+
+	mSeenLayouts.erase(hash);
+	TextLayout& layout = mLayouts[hash];
+	layout.mKey = layoutKey;
+	layout.mText = message;
+	layout.mVertices.clear();
+	layout.mLastUse = ++mLayoutUseCount;
+	layout.mHasVertices = false;
+	layout.mHasBounds = false;
+	return &layout;
+}
+
+void _Impl_FontStash::evictLayouts()
+{
+	// Drop the least recently used quarter, so the strings drawn every frame stay
+	eastl::vector<uint64_t> lastUses;
+	lastUses.reserve(mLayouts.size());
+	for (LayoutMap::iterator it = mLayouts.begin(); it != mLayouts.end(); ++it)
+		lastUses.push_back(it->second.mLastUse);
+
+	eastl::vector<uint64_t>::iterator threshold = lastUses.begin() + lastUses.size() / 4;
+	eastl::nth_element(lastUses.begin(), threshold, lastUses.end());
+
+	for (LayoutMap::iterator it = mLayouts.begin(); it != mLayouts.end();)
+	{
+		if (it->second.mLastUse <= *threshold)
+			it = mLayouts.erase(it);
+		else
+			++it;
+	}
+}
+
+void _Impl_FontStash::drawLayout(const TextLayout* pLayout, float2 offset, uint32_t color)
+{
+	if (pCurrentTexture == NULL)
+		return;
+
+	const uint32_t    vertexCount = (uint32_t)pLayout->mVertices.size();
+	const TextVertex* pSource = pLayout->mVertices.data();
+	TextVertex*       pVertices = allocateVertices(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; ++i)
+	{
+		pVertices[i].mPosition = float2(pSource[i].mPosition.x + offset.x, pSource[i].mPosition.y + offset.y);
+		pVertices[i].mTexCoord = pSource[i].mTexCoord;
+		pVertices[i].mColor = color;
+	}
+}
+
+void _Impl_FontStash::setState(const TextLayoutKey& key, uint32_t color)
+{
+	fonsSetSize(pContext, key.mSize);
+	fonsSetFont(pContext, key.mFontID);
+	fonsSetColor(pContext, color);
+	fonsSetSpacing(pContext, key.mSpacing);
+	fonsSetBlur(pContext, key.mBlur);
+	fonsSetAlign(pContext, key.mAlign);
+}
+
+void _Impl_FontStash::layOutText(TextLayout* pLayout, float2 offset, const char* message, uint32_t color)
+{
+	setState(pLayout->mKey, color);
+
+	const bool capture = pLayout != &mScratchLayout;
+	if (capture)
+		pLayout->mVertices.clear();
+	pLayoutCapture = capture ? pLayout : NULL;
+	mLayoutOffset = offset;
+	mLayoutComplete = true;
+	fonsDrawText(
+		pContext, FONTSTASH_LAYOUT_ORIGIN + pLayout->mKey.mFractionX, FONTSTASH_LAYOUT_ORIGIN + pLayout->mKey.mFractionY, message, NULL);
+	pLayoutCapture = NULL;
+	pLayout->mHasVertices = capture && mLayoutComplete;
+}
+
+void _Impl_FontStash::fonsImplementationRenderText(
+	void* userPtr, const float* verts, const float* tcoords, const unsigned int* colors, int nverts)
+{
+	_Impl_FontStash* ctx = (_Impl_FontStash*)userPtr;
+	if (ctx->pCurrentTexture == NULL)
+		return;
+
+	TextVertex* pVertices = ctx->allocateVertices((uint32_t)nverts);
+	for (int i = 0; i < nverts; ++i)
+	{
+		pVertices[i].mPosition = float2(verts[i * 2 + 0] + ctx->mLayoutOffset.x, verts[i * 2 + 1] + ctx->mLayoutOffset.y);
+		pVertices[i].mTexCoord = float2(tcoords[i * 2 + 0], tcoords[i * 2 + 1]);
+		pVertices[i].mColor = colors[i];
+	}
+
+	if (ctx->pLayoutCapture)
+	{
+		TextLayout* pLayout = ctx->pLayoutCapture;
+		for (int i = 0; i < nverts; ++i)
+		{
+			TextVertex vertex = { float2(verts[i * 2 + 0], verts[i * 2 + 1]), float2(tcoords[i * 2 + 0], tcoords[i * 2 + 1]), 0 };
+			pLayout->mVertices.push_back(vertex);
+		}
+	}
+}
+
+void _Impl_FontStash::fonsImplementationError(void* userPtr, int error, int value)
+{
+	// A glyph that did not fit in the atlas is missing from the string being laid out, it is not kept
+	UNREF_PARAM(value);
+	_Impl_FontStash* ctx = (_Impl_FontStash*)userPtr;
+	if (error == FONS_ATLAS_FULL)
+		ctx->mLayoutComplete = false;
 }
 
 void _Impl_FontStash::fonsImplementationRemoveTexture(void* userPtr)
@@ -51,7 +51,9 @@ typedef struct TextDrawDesc
 class Fontstash
 {
 	public:
-	Fontstash(Renderer* renderer, int width, int height);
+	//! With signedDistanceField, glyphs are stored as distance fields that are made once and drawn at any size, instead of
+	//! a bitmap for every size and blur they are drawn with. Text at large sizes stays sharp, blur is not supported.
+	Fontstash(Renderer* renderer, int width, int height, bool signedDistanceField = false);
 	void destroy();
 
 	//! Makes a font available to the font stash.
@@ -77,6 +79,14 @@ class Fontstash
 		struct Cmd* pCmd, const char* message, const mat4& projView, const mat4& worldMat, int fontID, unsigned int color = 0xffffffff,
 		float size = 16.0f, float spacing = 0.0f, float blur = 0.0f);
 
+	//! Draw the text of the screen space drawText calls so far, which are batched into one draw. Has to be called in the
+	//! render pass of those calls, anything drawn after it goes on top of the text.
+	void flush(struct Cmd* pCmd);
+
+	//! Drops the text of the last frame that was never flushed, so it is not drawn into a command buffer of this frame.
+	//! Call once per frame before the first drawText.
+	void beginFrame();
+
 	//! Measure text boundaries. Results will be written to out_bounds (x,y,x2,y2).
 	float measureText(
 		float* out_bounds, const char* message, float x, float y, int fontID, unsigned int color = 0xffffffff, float size = 16.0f,
@@ -2,12 +2,7 @@ struct PsIn
 {
 	float4 position: SV_Position;
 	float2 texCoord: TEXCOORD0;
-};
-
-cbuffer uRootConstants : register(b0)
-{
-	float4 color;
-	float2 scaleBias;
+	float4 color: COLOR;
 };
 
 Texture2D uTex0 : register(t1);
@@ -15,5 +10,12 @@ SamplerState uSampler0 : register(s2);
 
 float4 main(PsIn In) : SV_Target
 {
-	return float4(1.0, 1.0, 1.0, uTex0.Sample(uSampler0, In.texCoord).r) * color;
+#ifdef FONTSTASH_SDF
+	// Signed distance field, the outline is at 0.5. Blend over about a pixel on screen
+	float distance = uTex0.Sample(uSampler0, In.texCoord).r;
+	float alpha = saturate((distance - 0.5) / max(fwidth(distance), 0.0001) + 0.5);
+	return float4(1.0, 1.0, 1.0, alpha) * In.color;
+#else
+	return float4(1.0, 1.0, 1.0, uTex0.Sample(uSampler0, In.texCoord).r) * In.color;
+#endif
 }
\ No newline at end of file
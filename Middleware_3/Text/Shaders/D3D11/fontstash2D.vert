@@ -2,17 +2,18 @@ struct VsIn
 {
 	float2 position: Position;
 	float2 texCoord: TEXCOORD0;
+	float4 color: COLOR;
 };
 
 struct PsIn
 {
 	float4 position: SV_Position;
 	float2 texCoord: TEXCOORD0;
+	float4 color: COLOR;
 };
 
 cbuffer uRootConstants : register(b0)
 {
-	float4 color;
 	float2 scaleBias;
 };
 
@@ -22,5 +23,6 @@ PsIn main(VsIn In)
 	Out.position = float4 (In.position, 0.0f, 1.0f);
 	Out.position.xy = Out.position.xy * scaleBias.xy + float2(-1.0f, 1.0f);
 	Out.texCoord = In.texCoord;
+	Out.color = In.color;
 	return Out;
 };
\ No newline at end of file
@@ -2,17 +2,18 @@ struct VsIn
 {
 	float2 position: Position;
 	float2 texCoord: TEXCOORD0;
+	float4 color: COLOR;
 };
 
 struct PsIn
 {
 	float4 position: SV_Position;
 	float2 texCoord: TEXCOORD0;
+	float4 color: COLOR;
 };
 
 cbuffer uRootConstants : register(b0)
 {
-	float4 color;
 	float2 scaleBias;
 };
 
@@ -26,5 +27,6 @@ PsIn main(VsIn In)
 	PsIn Out;
 	Out.position = mul(mvp , float4(In.position * scaleBias.xy, 1.0f, 1.0f));
 	Out.texCoord = In.texCoord;
+	Out.color = In.color;
 	return Out;
 }
\ No newline at end of file
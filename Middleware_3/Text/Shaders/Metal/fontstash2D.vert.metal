@@ -7,15 +7,16 @@ struct Vertex_Shader
     {
         float2 position [[attribute(0)]];
         float2 texCoord [[attribute(1)]];
+        float4 color [[attribute(2)]];
     };
     struct PsIn
     {
         float4 position [[position]];
         float2 texCoord;
+        float4 color;
     };
     struct Uniforms_uRootConstants
     {
-        packed_float4 color;
         packed_float2 scaleBias;
     };
     constant Uniforms_uRootConstants & uRootConstants;
@@ -25,6 +26,7 @@ struct Vertex_Shader
         ((Out).position = float4((In).position, 0.0, 1.0));
         (((Out).position).xy = ((((Out).position).xy * (uRootConstants.scaleBias).xy) + float2((-1.0), 1.0)));
         ((Out).texCoord = (In).texCoord);
+        ((Out).color = (In).color);
         return Out;
     };
 
@@ -41,6 +43,7 @@ vertex Vertex_Shader::PsIn stageMain(
     Vertex_Shader::VsIn In0;
     In0.position = In.position;
     In0.texCoord = In.texCoord;
+    In0.color = In.color;
     Vertex_Shader main(
     uRootConstants);
     return main.main(In0);
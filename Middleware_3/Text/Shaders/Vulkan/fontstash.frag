@@ -1,26 +1,29 @@
 #version 450 core
 
 layout(location = 0) in vec2 fragInput_TEXCOORD0;
+layout(location = 1) in vec4 fragInput_COLOR;
 layout(location = 0) out vec4 rast_FragData0; 
 
 struct PsIn
 {
     vec4 position;
     vec2 texCoord;
-};
-
-layout(push_constant) uniform uRootConstants_Block
-{
     vec4 color;
-    vec2 scaleBias;
-} uRootConstants;
+};
 
 layout(set = 2, binding = 2) uniform texture2D uTex0;
 layout(set = 2, binding = 3) uniform sampler uSampler0; // todo: set should be 0. Temporarily set this to 1 due to a bug.
 
 vec4 HLSLmain(PsIn In)
 {
-    return (vec4(1.0, 1.0, 1.0, (texture(sampler2D( uTex0, uSampler0), vec2((In).texCoord))).r) * uRootConstants.color);
+#ifdef FONTSTASH_SDF
+    // Signed distance field, the outline is at 0.5. Blend over about a pixel on screen
+    float distance = (texture(sampler2D( uTex0, uSampler0), vec2((In).texCoord))).r;
+    float alpha = clamp(((distance - 0.5) / max(fwidth(distance), 0.0001) + 0.5), 0.0, 1.0);
+    return (vec4(1.0, 1.0, 1.0, alpha) * (In).color);
+#else
+    return (vec4(1.0, 1.0, 1.0, (texture(sampler2D( uTex0, uSampler0), vec2((In).texCoord))).r) * (In).color);
+#endif
 }
 
 void main()
@@ -28,6 +31,7 @@ void main()
     PsIn In;
     In.position = vec4(gl_FragCoord.xyz, 1.0 / gl_FragCoord.w);
     In.texCoord = fragInput_TEXCOORD0;
+    In.color = fragInput_COLOR;
     vec4 result = HLSLmain(In);
     rast_FragData0 = result;
 }
\ No newline at end of file
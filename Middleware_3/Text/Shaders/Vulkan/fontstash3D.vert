@@ -3,23 +3,26 @@
 
 layout(location = 0) in vec2 Position;
 layout(location = 1) in vec2 TEXCOORD0;
+layout(location = 2) in vec4 COLOR;
 layout(location = 0) out vec2 vertOutput_TEXCOORD0;
+layout(location = 1) out vec4 vertOutput_COLOR;
 
 struct VsIn
 {
     vec2 position;
     vec2 texCoord;
+    vec4 color;
 };
 
 struct PsIn
 {
     vec4 position;
     vec2 texCoord;
+    vec4 color;
 };
 
 layout(push_constant) uniform uRootConstants_Block
 {
-    vec4 color;
     vec2 scaleBias;
 } uRootConstants;
 
@@ -33,6 +36,7 @@ PsIn HLSLmain(VsIn In)
     PsIn Out;
     ((Out).position = ((mvp)*(vec4(((In).position * (uRootConstants.scaleBias).xy), 1.0, 1.0))));
     ((Out).texCoord = (In).texCoord);
+    ((Out).color = (In).color);
     return Out;
 }
 
@@ -41,7 +45,9 @@ void main()
     VsIn In;
     In.position = Position;
     In.texCoord = TEXCOORD0;
+    In.color = COLOR;
     PsIn result = HLSLmain(In);
     gl_Position = result.position;
     vertOutput_TEXCOORD0 = result.texCoord;
+    vertOutput_COLOR = result.color;
 }
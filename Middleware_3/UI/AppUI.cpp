@@ -278,10 +278,11 @@ IWidget* CheckboxWidget::Clone() const
 // UI Implementation
 /************************************************************************/
 
-UIApp::UIApp(int32_t const fontAtlasSize, uint32_t const maxDynamicUIUpdatesPerBatch)
+UIApp::UIApp(int32_t const fontAtlasSize, uint32_t const maxDynamicUIUpdatesPerBatch, bool const fontSignedDistanceField)
 {
 	mFontAtlasSize = fontAtlasSize;
 	mMaxDynamicUIUpdatesPerBatch = maxDynamicUIUpdatesPerBatch;
+	mFontSignedDistanceField = fontSignedDistanceField;
 }
 
 bool UIApp::Init(Renderer* renderer)
@@ -302,7 +303,7 @@ bool UIApp::Init(Renderer* renderer)
 		mFontAtlasSize = 256;
 
 	pImpl->pFontStash =
-		conf_placement_new<Fontstash>(conf_calloc(1, sizeof(Fontstash)), renderer, mFontAtlasSize, mFontAtlasSize);
+		conf_placement_new<Fontstash>(conf_calloc(1, sizeof(Fontstash)), renderer, mFontAtlasSize, mFontAtlasSize, mFontSignedDistanceField);
 	initGUIDriver(pImpl->pRenderer, &pDriver, mMaxDynamicUIUpdatesPerBatch);
 
 	MutexLock lock(gMutex);
@@ -370,6 +371,8 @@ void UIApp::DrawText(Cmd* cmd, const float2& screenCoordsInPx, const char* pText
 	pImpl->pFontStash->drawText(
 		cmd, pText, screenCoordsInPx.getX(), screenCoordsInPx.getY(), pDesc->mFontID, pDesc->mFontColor, pDesc->mFontSize,
 		pDesc->mFontSpacing, pDesc->mFontBlur);
+	// Drawn right away, so the text keeps its order with what the app and the profiler draw around it
+	pImpl->pFontStash->flush(cmd);
 }
 
 void UIApp::DrawTextInWorldSpace(Cmd* pCmd, const char* pText, const mat4& matWorld, const mat4& matProjView, const TextDrawDesc* pDrawDesc)
@@ -428,6 +431,8 @@ void UIApp::DrawDebugGpuProfile(Cmd * pCmd, const float2& screenCoordsInPx, GpuP
 	pos.y += pDesc->mHeightOffset;
 
 	draw_gpu_profile_recurse(pCmd, pImpl->pFontStash, pos, pDesc, pGpuProfiler, &pGpuProfiler->mRoot);
+	// All the timer lines go out in one draw
+	pImpl->pFontStash->flush(pCmd);
 }
 
 GuiComponent* UIApp::AddGuiComponent(const char* pTitle, const GuiDesc* pDesc)
@@ -486,6 +491,7 @@ void UIApp::RemoveAllGuiComponents()
 void UIApp::Update(float deltaTime)
 {
 	pImpl->mUpdated = true;
+	pImpl->pFontStash->beginFrame();
 
 	eastl::vector<GuiComponent*> activeComponents(pImpl->mComponentsToUpdate.size());
 	uint32_t                       activeComponentCount = 0;
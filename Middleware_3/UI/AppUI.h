@@ -647,7 +647,7 @@ struct UIAppImpl
 class UIApp: public IMiddleware
 {
 	public:
-	UIApp(int32_t const fontAtlasSize = 0, uint32_t const maxDynamicUIUpdatesPerBatch = 20u);
+	UIApp(int32_t const fontAtlasSize = 0, uint32_t const maxDynamicUIUpdatesPerBatch = 20u, bool const fontSignedDistanceField = false);
 
 	bool Init(Renderer* renderer);
 	void Exit();
@@ -699,6 +699,7 @@ class UIApp: public IMiddleware
 	float   mHeight;
 	int32_t  mFontAtlasSize = 0;
 	uint32_t mMaxDynamicUIUpdatesPerBatch = 20;
+	bool     mFontSignedDistanceField = false;
 };
 
 class VirtualJoystickUI
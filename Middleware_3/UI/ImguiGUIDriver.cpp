@@ -153,8 +153,18 @@ class ImguiGUIDriver: public GUIDriver
 	RootSignature*     pRootSignatureTextured;
 	DescriptorBinder*  pDescriptorBinderTextured;
 	PipelineMap        mPipelinesTextured;
+	/// Pipeline of the render pass of the last draw, so the map is only searched when the render pass changes
+	uint64_t           mLastRenderPassHash;
+	Pipeline*          pLastPipeline;
+	/// Persistently mapped, MAX_FRAMES regions of mVertexBufferSize / mIndexBufferSize bytes each
 	Buffer*            pVertexBuffer;
 	Buffer*            pIndexBuffer;
+	uint64_t           mVertexBufferSize;
+	uint64_t           mIndexBufferSize;
+	/// Buffers replaced by bigger ones, removed once the frame that retired them comes around again
+	eastl::vector<Buffer*> mRetiredBuffers[MAX_FRAMES];
+	/// Draw data of a frame gathered for a single update when the buffers are not mapped
+	eastl::vector<uint8_t> mStagingData;
 	Buffer*            pUniformBuffer;
 	uint64_t           mUniformSize;
 	/// Default states
@@ -165,9 +175,55 @@ class ImguiGUIDriver: public GUIDriver
 	VertexLayout     mVertexLayoutTextured = {};
 };
 
+// Initial size of a frame of draw data, the buffers grow when a frame needs more
 static const uint64_t VERTEX_BUFFER_SIZE = 1024 * 64 * sizeof(ImDrawVert);
 static const uint64_t INDEX_BUFFER_SIZE = 128 * 1024 * sizeof(ImDrawIdx);
 
+static void addStreamBuffer(DescriptorType type, uint64_t size, Buffer** ppBuffer)
+{
+	BufferLoadDesc desc = {};
+	desc.mDesc.mDescriptors = type;
+	desc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
+	desc.mDesc.mVertexStride = sizeof(ImDrawVert);
+	desc.mDesc.mIndexType = INDEX_TYPE_UINT16;
+	desc.mDesc.mSize = size;
+	desc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+	desc.ppBuffer = ppBuffer;
+	addResource(&desc);
+}
+
+// Copies the vertices or indices of all lists into a frame of pBuffer, straight into the mapped memory if there is any,
+// otherwise through pStaging in a single update
+template <typename T>
+static void writeDrawData(
+	ImDrawData* pDrawData, eastl::vector<T> ImDrawList::*pData, Buffer* pBuffer, uint64_t offset, uint64_t size,
+	eastl::vector<uint8_t>* pStaging)
+{
+	uint8_t* pDst = NULL;
+	if (pBuffer->pCpuMappedAddress)
+	{
+		pDst = (uint8_t*)pBuffer->pCpuMappedAddress + offset;
+	}
+	else
+	{
+		pStaging->resize((size_t)size);
+		pDst = pStaging->data();
+	}
+
+	for (int n = 0; n < pDrawData->CmdListsCount; n++)
+	{
+		const eastl::vector<T>& data = pDrawData->CmdLists[n]->*pData;
+		memcpy(pDst, data.data(), data.size() * sizeof(T));
+		pDst += data.size() * sizeof(T);
+	}
+
+	if (!pBuffer->pCpuMappedAddress && size)
+	{
+		BufferUpdateDesc update = { pBuffer, pStaging->data(), 0, offset, size };
+		updateResource(&update);
+	}
+}
+
 void initGUIDriver(Renderer* pRenderer, GUIDriver** ppDriver, uint32_t const maxDynamicUIUpdatesPerBatch)
 {
 	ImguiGUIDriver* pDriver = conf_placement_new<ImguiGUIDriver>(conf_calloc(1, sizeof(ImguiGUIDriver)));
@@ -510,21 +566,12 @@ bool ImguiGUIDriver::init(Renderer* renderer, uint32_t const maxDynamicUIUpdates
 	DescriptorBinderDesc descriptorBinderDesc = { pRootSignatureTextured, maxDynamicUIUpdatesPerBatch };
 	addDescriptorBinder(pRenderer, 0, 1, &descriptorBinderDesc, &pDescriptorBinderTextured);
 
-	BufferLoadDesc vbDesc = {};
-	vbDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_VERTEX_BUFFER;
-	vbDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
-	vbDesc.mDesc.mVertexStride = sizeof(ImDrawVert);
-	vbDesc.mDesc.mSize = VERTEX_BUFFER_SIZE * MAX_FRAMES;
-	vbDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
-	vbDesc.ppBuffer = &pVertexBuffer;
-	addResource(&vbDesc);
-
-	BufferLoadDesc ibDesc = vbDesc;
-	ibDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_INDEX_BUFFER;
-	ibDesc.mDesc.mIndexType = INDEX_TYPE_UINT16;
-	ibDesc.mDesc.mSize = INDEX_BUFFER_SIZE * MAX_FRAMES;
-	ibDesc.ppBuffer = &pIndexBuffer;
-	addResource(&ibDesc);
+	mVertexBufferSize = VERTEX_BUFFER_SIZE;
+	mIndexBufferSize = INDEX_BUFFER_SIZE;
+	addStreamBuffer(DESCRIPTOR_TYPE_VERTEX_BUFFER, mVertexBufferSize * MAX_FRAMES, &pVertexBuffer);
+	addStreamBuffer(DESCRIPTOR_TYPE_INDEX_BUFFER, mIndexBufferSize * MAX_FRAMES, &pIndexBuffer);
+	mLastRenderPassHash = 0;
+	pLastPipeline = NULL;
 
 	BufferLoadDesc ubDesc = {};
 	mUniformSize = round_up_64(256, pRenderer->mGpuSettings->mUniformBufferAlignment);
@@ -577,6 +624,15 @@ void ImguiGUIDriver::exit()
 	}
 
 	mPipelinesTextured.clear();
+	pLastPipeline = NULL;
+
+	for (uint32_t i = 0; i < MAX_FRAMES; ++i)
+	{
+		for (Buffer* pBuffer : mRetiredBuffers[i])
+			removeResource(pBuffer);
+		mRetiredBuffers[i].clear();
+	}
+	mStagingData.set_capacity(0);
 
 	removeSampler(pRenderer, pDefaultSampler);
 	removeBlendState(pBlendAlpha);
@@ -912,62 +968,73 @@ void ImguiGUIDriver::draw(Cmd* pCmd)
 
 	ImDrawData* draw_data = ImGui::GetDrawData();
 
-	Pipeline*            pPipeline = NULL;
-	PipelineDesc desc = {};
-	desc.mType = PIPELINE_TYPE_GRAPHICS;
-	GraphicsPipelineDesc& pipelineDesc = desc.mGraphicsDesc;
-	pipelineDesc.mDepthStencilFormat = (ImageFormat::Enum)pCmd->mBoundDepthStencilFormat;
-	pipelineDesc.mRenderTargetCount = pCmd->mBoundRenderTargetCount;
-	pipelineDesc.mSampleCount = pCmd->mBoundSampleCount;
-	pipelineDesc.pBlendState = pBlendAlpha;
-	pipelineDesc.mSampleQuality = pCmd->mBoundSampleQuality;
-	pipelineDesc.pColorFormats = (ImageFormat::Enum*)pCmd->pBoundColorFormats;
-	pipelineDesc.pDepthState = pDepthState;
-	pipelineDesc.pRasterizerState = pRasterizerState;
-	pipelineDesc.pSrgbValues = pCmd->pBoundSrgbValues;
-	PipelineMap::iterator it = mPipelinesTextured.find(pCmd->mRenderPassHash);
-	if (it == mPipelinesTextured.end())
-	{
-		pipelineDesc.pRootSignature = pRootSignatureTextured;
-		pipelineDesc.pShaderProgram = pShaderTextured;
-		pipelineDesc.pVertexLayout = &mVertexLayoutTextured;
-		pipelineDesc.mPrimitiveTopo = PRIMITIVE_TOPO_TRI_LIST;
-		addPipeline(pCmd->pRenderer, &desc, &pPipeline);
-		mPipelinesTextured.insert({ pCmd->mRenderPassHash, pPipeline });
-	}
-	else
+	// Buffers retired MAX_FRAMES draws ago are not in use anymore
+	for (Buffer* pBuffer : mRetiredBuffers[frameIdx])
+		removeResource(pBuffer);
+	mRetiredBuffers[frameIdx].clear();
+
+	Pipeline* pPipeline = pLastPipeline;
+	if (!pPipeline || pCmd->mRenderPassHash != mLastRenderPassHash)
 	{
-		pPipeline = it->second;
+		PipelineMap::iterator it = mPipelinesTextured.find(pCmd->mRenderPassHash);
+		if (it == mPipelinesTextured.end())
+		{
+			PipelineDesc desc = {};
+			desc.mType = PIPELINE_TYPE_GRAPHICS;
+			GraphicsPipelineDesc& pipelineDesc = desc.mGraphicsDesc;
+			pipelineDesc.mDepthStencilFormat = (ImageFormat::Enum)pCmd->mBoundDepthStencilFormat;
+			pipelineDesc.mRenderTargetCount = pCmd->mBoundRenderTargetCount;
+			pipelineDesc.mSampleCount = pCmd->mBoundSampleCount;
+			pipelineDesc.pBlendState = pBlendAlpha;
+			pipelineDesc.mSampleQuality = pCmd->mBoundSampleQuality;
+			pipelineDesc.pColorFormats = (ImageFormat::Enum*)pCmd->pBoundColorFormats;
+			pipelineDesc.pDepthState = pDepthState;
+			pipelineDesc.pRasterizerState = pRasterizerState;
+			pipelineDesc.pSrgbValues = pCmd->pBoundSrgbValues;
+			pipelineDesc.pRootSignature = pRootSignatureTextured;
+			pipelineDesc.pShaderProgram = pShaderTextured;
+			pipelineDesc.pVertexLayout = &mVertexLayoutTextured;
+			pipelineDesc.mPrimitiveTopo = PRIMITIVE_TOPO_TRI_LIST;
+			addPipeline(pCmd->pRenderer, &desc, &pPipeline);
+			mPipelinesTextured.insert({ pCmd->mRenderPassHash, pPipeline });
+		}
+		else
+		{
+			pPipeline = it->second;
+		}
+		mLastRenderPassHash = pCmd->mRenderPassHash;
+		pLastPipeline = pPipeline;
 	}
-	uint32_t vSize = 0;
-	uint32_t iSize = 0;
+
+	uint64_t vSize = 0;
+	uint64_t iSize = 0;
 	for (int n = 0; n < draw_data->CmdListsCount; n++)
 	{
 		const ImDrawList* cmd_list = draw_data->CmdLists[n];
-		vSize += (int)(cmd_list->VtxBuffer.size() * sizeof(ImDrawVert));
-		iSize += (int)(cmd_list->IdxBuffer.size() * sizeof(ImDrawIdx));
+		vSize += cmd_list->VtxBuffer.size() * sizeof(ImDrawVert);
+		iSize += cmd_list->IdxBuffer.size() * sizeof(ImDrawIdx);
 	}
 
-	vSize = min<uint32_t>(vSize, VERTEX_BUFFER_SIZE);
-	iSize = min<uint32_t>(iSize, INDEX_BUFFER_SIZE);
-
-	// Copy and convert all vertices into a single contiguous buffer
-	uint64_t vOffset = frameIdx * VERTEX_BUFFER_SIZE;
-	uint64_t iOffset = frameIdx * INDEX_BUFFER_SIZE;
-	uint64_t vtx_dst = vOffset;
-	uint64_t idx_dst = iOffset;
-	for (int n = 0; n < draw_data->CmdListsCount; n++)
+	// Grow geometrically instead of truncating the draw data. The frames in flight keep using the old buffers
+	if (vSize > mVertexBufferSize)
 	{
-		const ImDrawList* cmd_list = draw_data->CmdLists[n];
-		BufferUpdateDesc  update = { pVertexBuffer, cmd_list->VtxBuffer.data(), 0, vtx_dst,
-                                    cmd_list->VtxBuffer.size() * sizeof(ImDrawVert) };
-		updateResource(&update);
-		update = { pIndexBuffer, cmd_list->IdxBuffer.data(), 0, idx_dst, cmd_list->IdxBuffer.size() * sizeof(ImDrawIdx) };
-		updateResource(&update);
-
-		vtx_dst += (cmd_list->VtxBuffer.size() * sizeof(ImDrawVert));
-		idx_dst += (cmd_list->IdxBuffer.size() * sizeof(ImDrawIdx));
+		mRetiredBuffers[frameIdx].push_back(pVertexBuffer);
+		while (mVertexBufferSize < vSize)
+			mVertexBufferSize *= 2;
+		addStreamBuffer(DESCRIPTOR_TYPE_VERTEX_BUFFER, mVertexBufferSize * MAX_FRAMES, &pVertexBuffer);
 	}
+	if (iSize > mIndexBufferSize)
+	{
+		mRetiredBuffers[frameIdx].push_back(pIndexBuffer);
+		while (mIndexBufferSize < iSize)
+			mIndexBufferSize *= 2;
+		addStreamBuffer(DESCRIPTOR_TYPE_INDEX_BUFFER, mIndexBufferSize * MAX_FRAMES, &pIndexBuffer);
+	}
+
+	uint64_t vOffset = frameIdx * mVertexBufferSize;
+	uint64_t iOffset = frameIdx * mIndexBufferSize;
+	writeDrawData(draw_data, &ImDrawList::VtxBuffer, pVertexBuffer, vOffset, vSize, &mStagingData);
+	writeDrawData(draw_data, &ImDrawList::IdxBuffer, pIndexBuffer, iOffset, iSize, &mStagingData);
 
 	float L = draw_data->DisplayPos.x;
 	float R = draw_data->DisplayPos.x + draw_data->DisplaySize.x;